@@ -7,37 +7,40 @@
 #include <zephyr/kernel.h>
 #include <zephyr/drivers/gpio.h>
 
-/* 1000 msec = 1 sec */
-#define SLEEP_TIME_MS   1000
+#include "led_pattern.h"
 
 /* The devicetree node identifier for the "led0" alias. */
 #define LED0_NODE DT_ALIAS(led0)
+#define PWM_LED0_NODE DT_ALIAS(pwm_led0)
 
+/* On for 1 sec, off for 1 sec, forever */
+LED_PATTERN_DEFINE(blink, 0, { 2000, 50, 1 });
+
+#if DT_NODE_HAS_STATUS(PWM_LED0_NODE, okay) && defined(CONFIG_PWM)
+static const struct pwm_dt_spec led = PWM_DT_SPEC_GET(PWM_LED0_NODE);
+#else
 /*
  * A build error on this line means your board is unsupported.
  * See the sample documentation for information on how to fix this.
  */
 static const struct gpio_dt_spec led = GPIO_DT_SPEC_GET(LED0_NODE, gpios);
+#endif
 
 int main(void)
 {
-	int ret;
-
-	if (!gpio_is_ready_dt(&led)) {
+	int id;
+
+#if DT_NODE_HAS_STATUS(PWM_LED0_NODE, okay) && defined(CONFIG_PWM)
+	id = led_pattern_add_pwm(&led);
+#else
+	id = led_pattern_add_gpio(&led);
+#endif
+	if (id < 0) {
 		return 0;
 	}
 
-	ret = gpio_pin_configure_dt(&led, GPIO_OUTPUT_ACTIVE);
-	if (ret < 0) {
-		return 0;
-	}
+	/* The pattern runs from a timer or the PWM hardware, main is done */
+	led_pattern_play(id, &blink);
 
-	while (1) {
-		ret = gpio_pin_toggle_dt(&led);
-		if (ret < 0) {
-			return 0;
-		}
-		k_msleep(SLEEP_TIME_MS);
-	}
 	return 0;
 }
@@ -12,8 +12,43 @@
 #include <zephyr/sys/printk.h>
 #include <inttypes.h>
 
+#include "irq_latency.h"
+#include "mirror_stats.h"
+
 #define SLEEP_TIME_MS	1
 
+/*
+ * How the LED follows the button:
+ *  - MIRROR_POLL: read the button every SLEEP_TIME_MS (1000 wake-ups/s).
+ *  - MIRROR_IRQ:  both-edge interrupt, the LED is set from the callback and
+ *                 the CPU stays idle between presses.
+ */
+#define MIRROR_POLL	0
+#define MIRROR_IRQ	1
+#define MIRROR_MODE	MIRROR_IRQ
+
+/*
+ * Set REPORT_INTERVAL_MS to 0 to disable the wake-up/latency report
+ * (common/mirror_stats). In MIRROR_IRQ mode it is the only output: the
+ * callback does not print.
+ */
+#define REPORT_INTERVAL_MS	10000
+
+/*
+ * Interrupt-to-thread latency harness (common/irq_latency), run at boot
+ * when something can toggle the button: a "latency-out" output pin
+ * wired to the button pin.
+ */
+#define LATENCY_EDGES		400
+#define LATENCY_GAP_US		500
+#define LATENCY_OUT_NODE	DT_ALIAS(latency_out)
+
+#if DT_NODE_EXISTS(LATENCY_OUT_NODE)
+#define LATENCY_HARNESS		1
+#else
+#define LATENCY_HARNESS		0
+#endif
+
 /*
  * Get button configuration from the devicetree sw0 alias. This is mandatory.
  */
@@ -25,6 +60,16 @@ static const struct gpio_dt_spec button = GPIO_DT_SPEC_GET_OR(SW0_NODE, gpios,
 							      {0});
 static struct gpio_callback button_cb_data;
 
+#if DT_NODE_EXISTS(LATENCY_OUT_NODE)
+static const struct gpio_dt_spec latency_out =
+	GPIO_DT_SPEC_GET(LATENCY_OUT_NODE, gpios);
+
+static int latency_drive(int level)
+{
+	return gpio_pin_set_dt(&latency_out, level);
+}
+#endif
+
 /*
  * The led0 devicetree alias is optional. If present, we'll use it
  * to turn on the LED whenever the button is pressed.
@@ -35,8 +80,55 @@ static struct gpio_dt_spec led = GPIO_DT_SPEC_GET_OR(DT_ALIAS(led0), gpios,
 void button_pressed(const struct device *dev, struct gpio_callback *cb,
 		    uint32_t pins)
 {
-	printk("Button pressed at %" PRIu32 "\n", k_cycle_get_32());
+#if LATENCY_HARNESS
+	/* The harness owns the button while it runs */
+	if (irq_latency_active()) {
+		irq_latency_isr();
+		return;
+	}
+#endif
+
+	mirror_stats_edge();
+
+#if MIRROR_MODE == MIRROR_IRQ
+	/*
+	 * No printk() from interrupt context: it would swamp the wake-up and
+	 * latency figures being measured. The report counts the edges.
+	 */
+	int val = gpio_pin_get_dt(&button);
+
+	mirror_stats_wakeup();
+	if (led.port && val >= 0) {
+		gpio_pin_set_dt(&led, val);
+		mirror_stats_mirrored();
+	}
+#endif
+}
+
+#if LATENCY_HARNESS
+static void run_latency_harness(void)
+{
+	static const struct irq_latency_cfg cfg = {
+		.drive = latency_drive,
+		.edges = LATENCY_EDGES,
+		.gap_us = LATENCY_GAP_US,
+	};
+	int ret;
+
+#if DT_NODE_EXISTS(LATENCY_OUT_NODE)
+	ret = gpio_pin_configure_dt(&latency_out, GPIO_OUTPUT_INACTIVE);
+	if (ret != 0) {
+		printk("Error %d: failed to configure latency-out pin\n", ret);
+		return;
+	}
+#endif
+
+	ret = irq_latency_run(&cfg);
+	if (ret != 0) {
+		printk("Error %d: latency harness failed\n", ret);
+	}
 }
+#endif
 
 int main(void)
 {
@@ -55,8 +147,11 @@ int main(void)
 		return 0;
 	}
 
-	ret = gpio_pin_interrupt_configure_dt(&button,
-					      GPIO_INT_EDGE_TO_ACTIVE);
+	/*
+	 * Both edges are stamped in either mode so that press and release
+	 * latencies can be reported; only MIRROR_IRQ drives the LED from it.
+	 */
+	ret = gpio_pin_interrupt_configure_dt(&button, GPIO_INT_EDGE_BOTH);
 	if (ret != 0) {
 		printk("Error %d: failed to configure interrupt on %s pin %d\n",
 			ret, button.port->name, button.pin);
@@ -83,17 +178,57 @@ int main(void)
 		}
 	}
 
+#if LATENCY_HARNESS
+	run_latency_harness();
+#endif
+
 	printk("Press the button\n");
+
+#if MIRROR_MODE == MIRROR_IRQ
+	/* Match the LED to the button once; the callback handles the rest. */
 	if (led.port) {
-		while (1) {
-			/* If we have an LED, match its state to the button's. */
-			int val = gpio_pin_get_dt(&button);
+		ret = gpio_pin_get_dt(&button);
+		if (ret >= 0) {
+			gpio_pin_set_dt(&led, ret);
+		}
+	}
+
+	while (REPORT_INTERVAL_MS > 0) {
+		k_msleep(REPORT_INTERVAL_MS);
+		mirror_stats_report("irq", REPORT_INTERVAL_MS);
+	}
+#else
+	int last = -1;
+	uint32_t elapsed_ms = 0;
+
+	while (1) {
+		/* Match the LED, if we have one, to the button's state. */
+		int val = gpio_pin_get_dt(&button);
 
-			if (val >= 0) {
+		mirror_stats_wakeup();
+		if (val >= 0 && val != last) {
+			if (led.port) {
 				gpio_pin_set_dt(&led, val);
 			}
-			k_msleep(SLEEP_TIME_MS);
+			if (last >= 0) {
+				if (led.port) {
+					mirror_stats_mirrored();
+				}
+				printk("Button %s at %" PRIu32 "\n",
+				       val > 0 ? "pressed" : "released",
+				       mirror_stats_last_edge());
+			}
+			last = val;
+		}
+		k_msleep(SLEEP_TIME_MS);
+
+		elapsed_ms += SLEEP_TIME_MS;
+		if (REPORT_INTERVAL_MS > 0 &&
+		    elapsed_ms >= REPORT_INTERVAL_MS) {
+			mirror_stats_report("poll", elapsed_ms);
+			elapsed_ms = 0;
 		}
 	}
+#endif
 	return 0;
 }
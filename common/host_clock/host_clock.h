@@ -0,0 +1,24 @@
+/*
+ * Host monotonic clock for benches on native_sim.
+ *
+ * Every native_sim clock, native_rtc included, reads simulated time, which
+ * does not move while code runs. host_clock.c is built into the native
+ * simulator runner against the host C library, add it with:
+ *
+ *   target_sources(native_simulator INTERFACE .../host_clock/host_clock.c)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef HOST_CLOCK_H_
+#define HOST_CLOCK_H_
+
+#include <stdint.h>
+
+/* Microseconds of the host's CLOCK_MONOTONIC */
+uint64_t host_clock_us(void);
+
+/* The same in nanoseconds, for intervals of a few microseconds */
+uint64_t host_clock_ns(void);
+
+#endif /* HOST_CLOCK_H_ */
@@ -0,0 +1,666 @@
+/*
+ * Raw IEEE 802.15.4 link layer core, see raw154.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/random/random.h>
+#include <zephyr/sys/byteorder.h>
+#include <errno.h>
+#include <string.h>
+
+#include "raw154.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(raw154, LOG_LEVEL_INF);
+
+size_t raw154_put_hdr(uint8_t *buf, uint16_t fcf, uint8_t seq, uint16_t pan_id,
+		      uint16_t dst, uint16_t src)
+{
+	uint8_t *ptr = buf + 3;
+
+	fcf |= RAW154_FCF_VERSION_2006 |
+	       (RAW154_ADDR_MODE_SHORT << RAW154_FCF_SRC_SHIFT);
+
+	if (dst != RAW154_NO_ADDR) {
+		fcf |= RAW154_FCF_PANID_COMP |
+		       (RAW154_ADDR_MODE_SHORT << RAW154_FCF_DST_SHIFT);
+		sys_put_le16(pan_id, ptr);
+		sys_put_le16(dst, ptr + 2);
+		ptr += 4;
+	} else {
+		/* No destination: the PAN ID goes with the source */
+		sys_put_le16(pan_id, ptr);
+		ptr += 2;
+	}
+
+	sys_put_le16(src, ptr);
+	ptr += 2;
+
+	sys_put_le16(fcf, buf);
+	buf[2] = seq;
+
+	return ptr - buf;
+}
+
+static int get_addr(const uint8_t **ptr, const uint8_t *end, uint8_t mode,
+		    uint16_t *short_addr, uint64_t *ext_addr)
+{
+	switch (mode) {
+	case RAW154_ADDR_MODE_NONE:
+		*short_addr = RAW154_NO_ADDR;
+		return 0;
+	case RAW154_ADDR_MODE_SHORT:
+		if (end - *ptr < 2) {
+			return -EINVAL;
+		}
+		*short_addr = sys_get_le16(*ptr);
+		*ptr += 2;
+		return 0;
+	case RAW154_ADDR_MODE_EXT:
+		if (end - *ptr < 8) {
+			return -EINVAL;
+		}
+		*ext_addr = sys_get_le64(*ptr);
+		/* Keep the low bits around as a compact neighbour key */
+		*short_addr = (uint16_t)*ext_addr;
+		*ptr += 8;
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+int raw154_parse_hdr(const uint8_t *buf, size_t len, struct raw154_hdr *hdr)
+{
+	const uint8_t *end = buf + len;
+	const uint8_t *ptr = buf + 3;
+
+	if (len < 3) {
+		return -EINVAL;
+	}
+
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->fcf = sys_get_le16(buf);
+	hdr->seq = buf[2];
+	hdr->dst_mode = (hdr->fcf >> RAW154_FCF_DST_SHIFT) & 0x3;
+	hdr->src_mode = (hdr->fcf >> RAW154_FCF_SRC_SHIFT) & 0x3;
+	hdr->dst_pan = RAW154_BROADCAST;
+
+	if (hdr->dst_mode != RAW154_ADDR_MODE_NONE) {
+		if (end - ptr < 2) {
+			return -EINVAL;
+		}
+		hdr->dst_pan = sys_get_le16(ptr);
+		ptr += 2;
+	}
+
+	if (get_addr(&ptr, end, hdr->dst_mode, &hdr->dst_short,
+		     &hdr->dst_ext) < 0) {
+		return -EINVAL;
+	}
+
+	hdr->src_pan = hdr->dst_pan;
+	if (hdr->src_mode != RAW154_ADDR_MODE_NONE &&
+	    !(hdr->fcf & RAW154_FCF_PANID_COMP)) {
+		if (end - ptr < 2) {
+			return -EINVAL;
+		}
+		hdr->src_pan = sys_get_le16(ptr);
+		ptr += 2;
+	}
+
+	if (get_addr(&ptr, end, hdr->src_mode, &hdr->src_short,
+		     &hdr->src_ext) < 0) {
+		return -EINVAL;
+	}
+
+	hdr->len = ptr - buf;
+
+	return 0;
+}
+
+int raw154_init(struct raw154 *node, const struct device *dev,
+		uint16_t pan_id, uint16_t short_addr, uint16_t channel,
+		raw154_recv_t recv)
+{
+	struct ieee802154_filter filter;
+
+	if (!device_is_ready(dev)) {
+		LOG_ERR("IEEE 802.15.4 device not ready");
+		return -ENODEV;
+	}
+
+	memset(node, 0, sizeof(*node));
+	node->dev = dev;
+	node->api = dev->api;
+	node->caps = node->api->get_capabilities(dev);
+	node->pan_id = pan_id;
+	node->short_addr = short_addr;
+	node->channel = channel;
+	node->coord = RAW154_NO_ADDR;
+	node->recv = recv;
+	node->seq = sys_rand32_get();
+
+	k_mutex_init(&node->send_lock);
+	k_mutex_init(&node->tx_lock);
+	k_sem_init(&node->sync_sem, 0, 1);
+	k_sem_init(&node->ack_sem, 0, 1);
+	raw154_frag_init(node);
+
+	if (node->caps & IEEE802154_HW_FILTER) {
+		filter.pan_id = pan_id;
+		node->api->filter(dev, true, IEEE802154_FILTER_TYPE_PAN_ID,
+				  &filter);
+		filter.short_addr = short_addr;
+		node->api->filter(dev, true, IEEE802154_FILTER_TYPE_SHORT_ADDR,
+				  &filter);
+	}
+
+	return node->api->set_channel(dev, channel);
+}
+
+int raw154_radio_on(struct raw154 *node)
+{
+	int r;
+
+	if (node->rx_on) {
+		return 0;
+	}
+
+	r = node->api->start(node->dev);
+	if (r == 0) {
+		node->rx_on = true;
+		node->on_since = k_uptime_ticks();
+	}
+
+	return r;
+}
+
+int raw154_radio_off(struct raw154 *node)
+{
+	int r;
+
+	if (!node->rx_on) {
+		return 0;
+	}
+
+	r = node->api->stop(node->dev);
+	if (r == 0) {
+		node->rx_on = false;
+		node->stats.on_ticks += k_uptime_ticks() - node->on_since;
+	}
+
+	return r;
+}
+
+uint32_t raw154_duty_cycle_permille(struct raw154 *node, int64_t since)
+{
+	int64_t now = k_uptime_ticks();
+	int64_t on = node->stats.on_ticks;
+
+	if (node->rx_on) {
+		on += now - node->on_since;
+	}
+
+	if (now <= since) {
+		return 0;
+	}
+
+	return (uint32_t)(on * 1000 / (now - since));
+}
+
+void raw154_set_arq(struct raw154 *node, const struct raw154_arq_cfg *cfg)
+{
+	node->arq = *cfg;
+}
+
+static int tx_frame(struct raw154 *node, enum ieee802154_tx_mode mode,
+		    const uint8_t *frame, size_t len)
+{
+	struct net_pkt *pkt;
+	int r;
+
+	pkt = net_pkt_alloc_with_buffer(NULL, len, AF_UNSPEC, 0, K_NO_WAIT);
+	if (!pkt) {
+		return -ENOMEM;
+	}
+
+	r = net_pkt_write(pkt, frame, len);
+	if (r == 0) {
+		r = node->api->tx(node->dev, mode, pkt, pkt->buffer);
+	}
+
+	net_pkt_unref(pkt);
+
+	return r;
+}
+
+int raw154_tx_frame(struct raw154 *node, const uint8_t *frame, size_t len)
+{
+	enum ieee802154_tx_mode mode = IEEE802154_TX_MODE_DIRECT;
+	int r;
+
+	if (node->caps & IEEE802154_HW_CSMA) {
+		mode = IEEE802154_TX_MODE_CSMA_CA;
+	}
+
+	k_mutex_lock(&node->tx_lock, K_FOREVER);
+	r = tx_frame(node, mode, frame, len);
+	k_mutex_unlock(&node->tx_lock);
+
+	if (r == -EBUSY) {
+		/* Channel access failure, the radio never found it clear */
+		node->stats.tx_cca_fail++;
+	} else if (r < 0) {
+		node->stats.tx_failed++;
+	} else {
+		node->stats.tx_frames++;
+	}
+
+	return r;
+}
+
+int raw154_tx_acked(struct raw154 *node, const uint8_t *frame, size_t len,
+		    k_timeout_t timeout)
+{
+	int r;
+
+	if (!raw154_frame_ack_req(frame)) {
+		return raw154_tx_frame(node, frame, len);
+	}
+
+	if (node->caps & IEEE802154_HW_TX_RX_ACK) {
+		/* The driver waits for the ACK, any error means no ACK */
+		r = raw154_tx_frame(node, frame, len);
+		if (r < 0) {
+			return -ENOMSG;
+		}
+		node->stats.tx_acked++;
+		return 0;
+	}
+
+	k_sem_reset(&node->ack_sem);
+	node->ack_seq = frame[2];
+	node->ack_wait = true;
+
+	r = raw154_tx_frame(node, frame, len);
+	if (r == 0 && k_sem_take(&node->ack_sem, timeout) != 0) {
+		r = -ENOMSG;
+	}
+
+	node->ack_wait = false;
+
+	if (r == 0) {
+		node->stats.tx_acked++;
+	}
+
+	return r;
+}
+
+int raw154_build_frame(struct raw154 *node, uint8_t *frame, uint16_t fcf,
+		       uint16_t dst, const uint8_t *payload, size_t len)
+{
+	size_t hdr_len;
+	int r;
+
+	if (node->sec) {
+		fcf |= RAW154_FCF_SECURITY;
+	}
+
+	k_mutex_lock(&node->tx_lock, K_FOREVER);
+
+	hdr_len = raw154_put_hdr(frame, fcf, node->seq++, node->pan_id, dst,
+				 node->short_addr);
+
+	if (node->sec) {
+		r = raw154_sec_secure(node, frame, hdr_len, payload, len);
+	} else if (hdr_len + len > RAW154_MAX_FRAME) {
+		r = -EMSGSIZE;
+	} else {
+		memcpy(frame + hdr_len, payload, len);
+		r = hdr_len + len;
+	}
+
+	k_mutex_unlock(&node->tx_lock);
+
+	return r;
+}
+
+int raw154_send_fcf(struct raw154 *node, uint16_t fcf, uint16_t dst,
+		    const uint8_t *payload, size_t len)
+{
+	uint8_t frame[RAW154_MAX_FRAME];
+	uint32_t backoff = node->arq.backoff_ms;
+	int frame_len;
+	int r;
+
+	k_mutex_lock(&node->send_lock, K_FOREVER);
+
+	node->ack_dst = dst;
+
+	/*
+	 * Retransmissions reuse the sequence number, for duplicate detection,
+	 * and the frame counter
+	 */
+	frame_len = raw154_build_frame(node, frame, fcf, dst, payload, len);
+	if (frame_len < 0) {
+		r = frame_len;
+		goto out;
+	}
+
+	for (int attempt = 0; ; attempt++) {
+		raw154_link_apply_power(node, dst);
+
+		r = raw154_mac_send(node, frame, frame_len);
+		if ((fcf & RAW154_FCF_ACK_REQ) && (r == 0 || r == -ENOMSG)) {
+			raw154_link_tx_done(node, dst, r == 0);
+		}
+
+		if (r != -ENOMSG) {
+			break;
+		}
+
+		if (attempt >= node->arq.max_retries) {
+			node->stats.tx_no_ack++;
+			break;
+		}
+
+		node->stats.tx_retries++;
+		if (backoff) {
+			k_msleep(backoff + sys_rand32_get() % backoff);
+			backoff *= 2;
+		}
+	}
+
+out:
+	k_mutex_unlock(&node->send_lock);
+
+	return r;
+}
+
+int raw154_send_type(struct raw154 *node, uint16_t type, uint16_t dst,
+		     const uint8_t *payload, size_t len)
+{
+	uint16_t fcf = type;
+
+	if (node->arq.ack_req && dst != RAW154_BROADCAST) {
+		fcf |= RAW154_FCF_ACK_REQ;
+	}
+
+	return raw154_send_fcf(node, fcf, dst, payload, len);
+}
+
+int raw154_send(struct raw154 *node, uint16_t dst, const uint8_t *payload,
+		size_t len)
+{
+	return raw154_send_type(node, RAW154_FCF_TYPE_DATA, dst, payload, len);
+}
+
+static bool frame_is_for_us(struct raw154 *node, const struct raw154_hdr *hdr)
+{
+	if (hdr->dst_mode == RAW154_ADDR_MODE_NONE) {
+		return true;
+	}
+
+	if (hdr->dst_pan != node->pan_id && hdr->dst_pan != RAW154_BROADCAST) {
+		return false;
+	}
+
+	return hdr->dst_mode == RAW154_ADDR_MODE_SHORT &&
+	       (hdr->dst_short == node->short_addr ||
+		hdr->dst_short == RAW154_BROADCAST);
+}
+
+void raw154_set_allow_list(struct raw154 *node,
+			   const struct raw154_nbr_set *set)
+{
+	node->allow = set;
+}
+
+bool raw154_accept(struct raw154 *node, const uint8_t *frame, size_t len,
+		   struct raw154_hdr *hdr)
+{
+	if (raw154_parse_hdr(frame, len, hdr) < 0 ||
+	    !frame_is_for_us(node, hdr)) {
+		node->stats.rx_dropped++;
+		return false;
+	}
+
+	/*
+	 * ACKs carry no source, they are matched on the sequence number.
+	 * The set only holds short addresses, see struct raw154_nbr_set.
+	 */
+	if (node->allow && hdr->src_mode != RAW154_ADDR_MODE_NONE &&
+	    (hdr->src_mode != RAW154_ADDR_MODE_SHORT ||
+	     !raw154_nbr_contains(node->allow, hdr->src_short))) {
+		node->stats.rx_filtered++;
+		return false;
+	}
+
+	return true;
+}
+
+/* Sliding window per sender, tolerates reordering within the window */
+static bool is_duplicate(struct raw154 *node, uint16_t src, uint8_t seq)
+{
+	struct raw154_dup_entry *entry = NULL;
+	struct raw154_dup_entry *oldest = &node->dup[0];
+	int8_t diff;
+
+	node->dup_clock++;
+
+	for (int i = 0; i < RAW154_DUP_SENDERS; i++) {
+		if (node->dup[i].last_use && node->dup[i].src == src) {
+			entry = &node->dup[i];
+			break;
+		}
+		if (node->dup[i].last_use < oldest->last_use) {
+			oldest = &node->dup[i];
+		}
+	}
+
+	if (!entry) {
+		oldest->src = src;
+		oldest->seq = seq;
+		oldest->seen = BIT(0);
+		oldest->last_use = node->dup_clock;
+		return false;
+	}
+
+	entry->last_use = node->dup_clock;
+	diff = (int8_t)(seq - entry->seq);
+
+	if (diff > 0) {
+		entry->seen = diff < RAW154_DUP_WINDOW ?
+			      (entry->seen << diff) | BIT(0) : BIT(0);
+		entry->seq = seq;
+		return false;
+	}
+
+	if (-diff >= RAW154_DUP_WINDOW) {
+		/* Far behind the window: the sender restarted */
+		entry->seq = seq;
+		entry->seen = BIT(0);
+		return false;
+	}
+
+	if (entry->seen & BIT(-diff)) {
+		return true;
+	}
+
+	entry->seen |= BIT(-diff);
+
+	return false;
+}
+
+static void cmd_rx(struct raw154 *node, const struct raw154_hdr *hdr,
+		   const uint8_t *payload, size_t len)
+{
+	if (len == 0) {
+		return;
+	}
+
+	switch (payload[0]) {
+	case RAW154_CMD_FRAG:
+	case RAW154_CMD_FRAG_LAST:
+	case RAW154_CMD_FRAG_STATUS:
+		raw154_frag_cmd_rx(node, hdr, payload, len);
+		break;
+	default:
+		raw154_chan_cmd_rx(node, hdr, payload, len);
+		break;
+	}
+}
+
+static void ack_rx(struct raw154 *node, uint8_t seq, uint8_t lqi, int8_t rssi)
+{
+	if (node->ack_wait && node->ack_seq == seq) {
+		raw154_link_rx(node, node->ack_dst, lqi, rssi);
+		k_sem_give(&node->ack_sem);
+	}
+}
+
+static void send_ack(struct raw154 *node, uint8_t seq)
+{
+	uint8_t ack[3];
+	int r;
+
+	sys_put_le16(RAW154_FCF_TYPE_ACK | RAW154_FCF_VERSION_2006, ack);
+	ack[2] = seq;
+
+	/*
+	 * Sent right away, the sender only waits a short while for it, and
+	 * at full power whatever the last unicast left set
+	 */
+	k_mutex_lock(&node->tx_lock, K_FOREVER);
+	raw154_link_apply_power(node, RAW154_BROADCAST);
+	r = tx_frame(node, IEEE802154_TX_MODE_DIRECT, ack, sizeof(ack));
+	k_mutex_unlock(&node->tx_lock);
+
+	if (r == 0) {
+		node->stats.acks_sent++;
+	}
+}
+
+/* Acknowledge copies too, our previous ACK may have been lost */
+static void ack_frame(struct raw154 *node, const struct raw154_hdr *hdr)
+{
+	if ((hdr->fcf & RAW154_FCF_ACK_REQ) &&
+	    hdr->dst_mode == RAW154_ADDR_MODE_SHORT &&
+	    hdr->dst_short == node->short_addr &&
+	    !(node->caps & IEEE802154_HW_RX_TX_ACK)) {
+		send_ack(node, hdr->seq);
+	}
+}
+
+void raw154_input(struct raw154 *node, struct net_pkt *pkt)
+{
+	uint8_t frame[IEEE802154_MAX_PHY_PACKET_SIZE];
+	struct raw154_hdr hdr;
+	struct net_buf *buf = pkt->buffer;
+	size_t len = net_pkt_get_len(pkt);
+	uint8_t lqi = net_pkt_ieee802154_lqi(pkt);
+	int8_t rssi = net_pkt_ieee802154_rssi(pkt);
+	int r;
+
+	if (!buf || len > sizeof(frame) || len < RAW154_RX_FCS_LEN) {
+		node->stats.rx_dropped++;
+		net_pkt_unref(pkt);
+		return;
+	}
+
+	len -= RAW154_RX_FCS_LEN;
+
+	/*
+	 * Filter on the driver's buffer so that traffic for other nodes is
+	 * never copied. The MAC header always fits in the first fragment.
+	 */
+	if (!raw154_accept(node, buf->data, MIN(buf->len, len), &hdr)) {
+		net_pkt_unref(pkt);
+		return;
+	}
+
+	net_pkt_cursor_init(pkt);
+	if (net_pkt_read(pkt, frame, len) < 0) {
+		node->stats.rx_dropped++;
+		net_pkt_unref(pkt);
+		return;
+	}
+
+	net_pkt_unref(pkt);
+
+	node->stats.rx_frames++;
+
+	if (raw154_frame_type(&hdr) == RAW154_FCF_TYPE_ACK) {
+		ack_rx(node, hdr.seq, lqi, rssi);
+		return;
+	}
+
+	/*
+	 * Nothing unauthenticated gets to the link table or the MAC. ACKs,
+	 * handled above, are the only frames that cannot be secured. A
+	 * retransmission reuses the frame counter and is dropped as a replay,
+	 * but still acknowledged, as the radio's auto-ACK would have done.
+	 */
+	if (hdr.fcf & RAW154_FCF_SECURITY) {
+		r = raw154_sec_unsecure(node, &hdr, frame, len);
+		if (r == -EALREADY) {
+			ack_frame(node, &hdr);
+		}
+		if (r < 0) {
+			return;
+		}
+		len = r;
+	} else if (node->sec && node->sec->cfg.require) {
+		node->stats.sec_unsecured++;
+		return;
+	}
+
+	if (hdr.src_mode != RAW154_ADDR_MODE_NONE) {
+		raw154_link_rx(node, hdr.src_short, lqi, rssi);
+	}
+
+	raw154_mac_rx(node, &hdr);
+
+	ack_frame(node, &hdr);
+
+	if (raw154_frame_type(&hdr) == RAW154_FCF_TYPE_CMD) {
+		cmd_rx(node, &hdr, frame + hdr.len, len - hdr.len);
+		return;
+	}
+
+	if (raw154_frame_type(&hdr) != RAW154_FCF_TYPE_DATA) {
+		return;
+	}
+
+	if (is_duplicate(node, hdr.src_short, hdr.seq)) {
+		node->stats.rx_dup++;
+		return;
+	}
+
+	if (node->recv) {
+		node->recv(node, &hdr, frame + hdr.len, len - hdr.len, lqi);
+	}
+}
+
+enum net_verdict raw154_handle_ack(struct raw154 *node, struct net_pkt *pkt)
+{
+	uint8_t ack[3];
+
+	net_pkt_cursor_init(pkt);
+	if (net_pkt_read(pkt, ack, sizeof(ack)) < 0 ||
+	    (sys_get_le16(ack) & RAW154_FCF_TYPE_MASK) != RAW154_FCF_TYPE_ACK) {
+		return NET_CONTINUE;
+	}
+
+	if (!node->ack_wait || node->ack_seq != ack[2]) {
+		return NET_CONTINUE;
+	}
+
+	ack_rx(node, ack[2], net_pkt_ieee802154_lqi(pkt),
+	       net_pkt_ieee802154_rssi(pkt));
+
+	return NET_OK;
+}
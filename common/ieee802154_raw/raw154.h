@@ -0,0 +1,645 @@
+/*
+ * Thin link layer over the raw IEEE 802.15.4 radio API, shared by the
+ * ieee802154_radioapi_* samples and the raw radio bench.
+ *
+ * A struct raw154 wraps one radio device: it builds and parses MAC headers,
+ * keeps radio-on time, and runs the duty-cycled MAC that decides when the
+ * receiver listens and how a sender reaches a sleeping receiver.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef RAW154_H_
+#define RAW154_H_
+
+#include <zephyr/kernel.h>
+#include <zephyr/crypto/crypto.h>
+#include <zephyr/device.h>
+#include <zephyr/net/ieee802154_radio.h>
+#include <zephyr/net/net_pkt.h>
+
+/* Largest MAC frame we build, the FCS is appended by the radio */
+#define RAW154_MAX_FRAME (IEEE802154_MAX_PHY_PACKET_SIZE - IEEE802154_FCS_LENGTH)
+
+/*
+ * Trailing bytes the driver leaves on received frames. Set to
+ * IEEE802154_FCS_LENGTH for drivers that pass the FCS up.
+ */
+#define RAW154_RX_FCS_LEN 0
+
+#define RAW154_BROADCAST 0xffff
+#define RAW154_NO_ADDR	 0xfffe
+
+/* Frame control field */
+#define RAW154_FCF_TYPE_MASK	0x0007
+#define RAW154_FCF_TYPE_BEACON	0x0000
+#define RAW154_FCF_TYPE_DATA	0x0001
+#define RAW154_FCF_TYPE_ACK	0x0002
+#define RAW154_FCF_TYPE_CMD	0x0003
+#define RAW154_FCF_SECURITY	BIT(3)
+#define RAW154_FCF_PENDING	BIT(4)
+#define RAW154_FCF_ACK_REQ	BIT(5)
+#define RAW154_FCF_PANID_COMP	BIT(6)
+#define RAW154_FCF_DST_SHIFT	10
+#define RAW154_FCF_VERSION_2006	(1 << 12)
+#define RAW154_FCF_SRC_SHIFT	14
+
+#define RAW154_ADDR_MODE_NONE	0
+#define RAW154_ADDR_MODE_SHORT	2
+#define RAW154_ADDR_MODE_EXT	3
+
+/* Parsed MAC header */
+struct raw154_hdr {
+	uint16_t fcf;
+	uint8_t seq;
+	uint8_t dst_mode;
+	uint8_t src_mode;
+	uint16_t dst_pan;
+	uint16_t src_pan;
+	uint16_t dst_short;
+	uint16_t src_short;
+	uint64_t dst_ext;
+	uint64_t src_ext;
+	uint8_t len;
+};
+
+static inline uint16_t raw154_frame_type(const struct raw154_hdr *hdr)
+{
+	return hdr->fcf & RAW154_FCF_TYPE_MASK;
+}
+
+static inline bool raw154_frame_ack_req(const uint8_t *frame)
+{
+	return frame[0] & RAW154_FCF_ACK_REQ;
+}
+
+/*
+ * Write a MAC header with short addresses into buf. dst may be RAW154_NO_ADDR
+ * for frames without a destination (beacons). Returns the header length.
+ */
+size_t raw154_put_hdr(uint8_t *buf, uint16_t fcf, uint8_t seq, uint16_t pan_id,
+		      uint16_t dst, uint16_t src);
+
+/* Returns 0 and fills hdr, or -EINVAL if the frame is truncated */
+int raw154_parse_hdr(const uint8_t *buf, size_t len, struct raw154_hdr *hdr);
+
+/* Duty-cycled MAC */
+enum raw154_mac_mode {
+	/* Receiver always on, as the original samples did */
+	RAW154_MAC_ALWAYS_ON,
+	/*
+	 * Asynchronous low-power listening (preamble sampling): the receiver
+	 * wakes every period for a short window, the sender repeats the frame
+	 * for a whole period so that one copy lands in a window.
+	 */
+	RAW154_MAC_LPL,
+	/*
+	 * Synchronous: the listener sends a sync beacon when its window
+	 * opens, senders learn the schedule and only transmit inside it.
+	 */
+	RAW154_MAC_SLOTTED,
+};
+
+struct raw154_mac_cfg {
+	enum raw154_mac_mode mode;
+	/* Duty-cycle the receiver; senders leave it off between sends */
+	bool listener;
+	uint32_t period_ms;
+	uint32_t listen_ms;
+	/* LPL: pause between two copies of a frame */
+	uint32_t strobe_gap_us;
+	/* Slotted: wake this much ahead of a predicted window */
+	uint32_t guard_ms;
+};
+
+/*
+ * Acknowledged unicast: data frames carry the ACK request flag, the sender
+ * waits ack_timeout_us for the ACK and retransmits up to max_retries times,
+ * backing off a random time in [backoff, 2 * backoff) with backoff doubling
+ * from backoff_ms on every retry. Radios reporting IEEE802154_HW_TX_RX_ACK
+ * wait for the ACK in tx(), radios reporting IEEE802154_HW_RX_TX_ACK send
+ * it themselves; otherwise both are done here.
+ */
+struct raw154_arq_cfg {
+	bool ack_req;
+	uint8_t max_retries;
+	uint32_t ack_timeout_us;
+	uint32_t backoff_ms;
+};
+
+/*
+ * Set of neighbour short addresses, open addressing with linear probing in
+ * caller-provided storage. It holds short addresses only: the low 16 bits
+ * of two extended addresses can collide, so raw154_accept() drops frames
+ * with an extended source while an allow-list is set. The slot count must
+ * be a power of two; the set fills to 3/4 of it.
+ */
+struct raw154_nbr_set {
+	uint16_t *slots;
+	uint16_t mask;
+	uint8_t shift;
+	uint16_t count;
+	uint16_t used;		/* entries plus deleted slots */
+};
+
+int raw154_nbr_init(struct raw154_nbr_set *set, uint16_t *slots,
+		    size_t num_slots);
+void raw154_nbr_clear(struct raw154_nbr_set *set);
+int raw154_nbr_add(struct raw154_nbr_set *set, uint16_t addr);
+int raw154_nbr_del(struct raw154_nbr_set *set, uint16_t addr);
+bool raw154_nbr_contains(const struct raw154_nbr_set *set, uint16_t addr);
+
+/*
+ * Link quality per neighbour, from the frames and ACKs it sends us, and the
+ * TX power we use towards it. Averages are EWMAs with weight 1/8.
+ */
+#define RAW154_LINKS 8
+
+struct raw154_link {
+	uint16_t addr;
+	uint32_t last_use;	/* 0: free slot */
+	uint16_t lqi;		/* x16 */
+	int16_t rssi;		/* dBm x16 */
+	uint16_t delivery;	/* ACKed share of our frames, permille */
+	uint8_t ack_run;	/* frames ACKed in a row at this power */
+	int8_t tx_power;	/* dBm */
+	bool heard;		/* lqi and rssi are valid */
+};
+
+/*
+ * Adaptive TX power: start each neighbour at max_dbm, go up step_db on
+ * every missing ACK, and go down step_db after a run of ACKs while the
+ * delivery average stays above target_permille and our frames would still
+ * reach the neighbour above rssi_floor_dbm. That estimate assumes a
+ * symmetric link and neighbours sending at max_dbm. Not adaptive: always
+ * max_dbm. Broadcasts, ACKs, sync beacons and fragment status commands
+ * always go out at max_dbm.
+ */
+struct raw154_txp_cfg {
+	bool adaptive;
+	int8_t min_dbm;
+	int8_t max_dbm;
+	uint8_t step_db;
+	uint16_t target_permille;
+	int8_t rssi_floor_dbm;
+};
+
+/* ACKs in a row before trying the next lower power */
+#define RAW154_TXP_PROBE_RUN 8
+
+/*
+ * Channel selection. Channels are ranked on the energy the radio measures
+ * with ed_scan() (lower is quieter, in the driver's units) or, for radios
+ * without IEEE802154_HW_ENERGY_SCAN, on the share of busy CCA checks.
+ * Channel masks have bit n set for channel n.
+ */
+#define RAW154_CHAN_MASK_2_4_GHZ 0x07fff800
+#define RAW154_CHAN_MAX		 26
+
+/* Only move when the best channel is this much quieter than ours */
+#define RAW154_CHAN_HYST	 6
+
+/* Channel switch announcements sent before moving */
+#define RAW154_CHAN_ANNOUNCE	 3
+#define RAW154_CHAN_ANNOUNCE_GAP_MS 5
+
+/* MAC command identifiers, from the vendor-specific range */
+#define RAW154_CMD_CHANNEL_SWITCH 0xa0
+#define RAW154_CMD_PROBE	  0xa1
+#define RAW154_CMD_FRAG		  0xa2
+#define RAW154_CMD_FRAG_LAST	  0xa3
+#define RAW154_CMD_FRAG_STATUS	  0xa4
+
+struct raw154_chan_scan {
+	uint32_t mask;		/* channels scanned */
+	int16_t energy[RAW154_CHAN_MAX + 1];
+	uint16_t best;
+};
+
+/*
+ * Messages larger than a frame. Each fragment goes in a command frame
+ * behind a 4-byte header: command, message tag, index, fragment count. All
+ * fragments but the last carry RAW154_FRAG_DATA bytes. The sender sends a
+ * burst, the last fragment of the burst asking for a status; the receiver
+ * answers with the bitmap of fragments it holds and the sender resends only
+ * the missing ones, for up to RAW154_FRAG_ROUNDS bursts.
+ *
+ * Fragments are reassembled in whatever order they come into one of
+ * RAW154_FRAG_RX_SLOTS preallocated buffers, shared by all nodes. A
+ * reassembly that got nothing for RAW154_FRAG_TIMEOUT_MS gives its buffer
+ * up to the next message that needs one.
+ */
+#define RAW154_FRAG_HDR_LEN	4
+#define RAW154_FRAG_DATA	96
+#define RAW154_FRAG_MAX_COUNT	64
+#define RAW154_FRAG_MSG_MAX	4096
+#define RAW154_FRAG_RX_SLOTS	2
+#define RAW154_FRAG_TIMEOUT_MS	2000
+#define RAW154_FRAG_STATUS_MS	20
+#define RAW154_FRAG_ROUNDS	8
+
+/* Messages recently completed, to answer senders that missed our status */
+#define RAW154_FRAG_DONE	4
+
+struct raw154_frag_id {
+	uint16_t src;
+	uint8_t tag;
+	bool valid;
+};
+
+/* Senders tracked by the duplicate filter, and window size in frames */
+#define RAW154_DUP_SENDERS 8
+#define RAW154_DUP_WINDOW  32
+
+struct raw154_dup_entry {
+	uint16_t src;
+	uint8_t seq;		/* highest sequence number seen */
+	uint32_t seen;		/* bit n: seq - n was received */
+	uint32_t last_use;
+};
+
+/*
+ * Link-layer security, AES-CCM* as IEEE 802.15.4-2006 specifies it. Secured
+ * frames carry the security bit in the frame control field and an
+ * auxiliary security header after the MAC header: security control (level,
+ * key identifier mode 1), 4-byte frame counter and key index. The MIC
+ * follows the payload, which is encrypted for the ENC levels. The CCM*
+ * nonce takes the sender's extended address; nodes here only have short
+ * addresses, so it is derived from PAN ID and short address the way
+ * RFC 4944 derives an interface identifier.
+ *
+ * The AES work goes through the crypto driver API, to the SoC's AES engine
+ * where there is a driver for it and to the TinyCrypt shim otherwise. That
+ * shim does not do CCM* without a MIC, so level 4 (ENC) is not offered.
+ *
+ * Replay protection keeps the last frame counter of each neighbour in a
+ * table of RAW154_SEC_NBRS entries. Frames from a neighbour must carry a
+ * higher counter than the last one accepted. Retransmissions and strobes
+ * reuse the counter, so their copies are dropped as replays; the ones that
+ * request an ACK still get it. Beacons are secured too, only ACKs go in
+ * clear.
+ * When the table is full, frames from new neighbours are dropped until
+ * raw154_sec_forget() frees an entry.
+ *
+ * A sender that starts over from counter 0 after a reset would reuse CCM*
+ * nonces, and its frames would be dropped as replays by neighbours that
+ * kept running. raw154_sec_persist() keeps the counter in NVS on the
+ * storage partition: a block of RAW154_SEC_COUNTER_BLOCK counters is
+ * reserved in flash before the first of them goes out, and after a reset
+ * sending continues past the last reserved block. There is one stored
+ * counter, so one secured node per device can persist it.
+ */
+#define RAW154_SEC_LEVEL_MIC_32		1
+#define RAW154_SEC_LEVEL_MIC_64		2
+#define RAW154_SEC_LEVEL_MIC_128	3
+#define RAW154_SEC_LEVEL_ENC_MIC_32	5
+#define RAW154_SEC_LEVEL_ENC_MIC_64	6
+#define RAW154_SEC_LEVEL_ENC_MIC_128	7
+
+#define RAW154_SEC_KEY_LEN	16
+#define RAW154_SEC_NONCE_LEN	13
+#define RAW154_SEC_AUX_LEN	6	/* control, counter, key index */
+#define RAW154_SEC_NBRS		16
+
+/* Frame counters reserved per flash write, see raw154_sec_persist() */
+#ifndef RAW154_SEC_COUNTER_BLOCK
+#define RAW154_SEC_COUNTER_BLOCK	1024
+#endif
+
+/* Name of the SoC's AES driver, tried before the TinyCrypt shim */
+#ifndef RAW154_SEC_HW_CRYPTO
+#define RAW154_SEC_HW_CRYPTO	"CRYPTO_AES"	/* CC13xx/CC26xx */
+#endif
+
+struct raw154_sec_cfg {
+	uint8_t level;
+	uint8_t key_index;
+	uint8_t key[RAW154_SEC_KEY_LEN];
+	/* First frame counter to send, continue from a persisted value */
+	uint32_t frame_counter;
+	/* Drop frames that are not secured, except ACKs */
+	bool require;
+};
+
+struct raw154_sec_nbr {
+	uint16_t addr;
+	bool used;
+	uint32_t counter;	/* last accepted */
+};
+
+struct raw154_sec {
+	struct raw154_sec_cfg cfg;
+	uint8_t mic_len;
+	/* Next to send, taken under tx_lock */
+	atomic_t frame_counter;
+	/* Counters below this are reserved in flash, when persist is set */
+	uint32_t counter_limit;
+	bool persist;
+	struct cipher_ctx enc;
+	struct cipher_ctx dec;
+	struct raw154_sec_nbr nbrs[RAW154_SEC_NBRS];
+};
+
+/* The hardware AES driver if there is one, else the TinyCrypt shim */
+const struct device *raw154_sec_default_dev(void);
+
+/* Open the crypto sessions for cfg on dev */
+int raw154_sec_init(struct raw154_sec *sec, const struct device *dev,
+		    const struct raw154_sec_cfg *cfg);
+
+/*
+ * Fill in the key and key index from CONFIG_RAW154_SEC_KEY and
+ * CONFIG_RAW154_SEC_KEY_INDEX. -ENOENT when the key is not set, -EINVAL
+ * when it is not 32 hex digits.
+ */
+int raw154_sec_config_key(struct raw154_sec_cfg *cfg);
+
+/*
+ * Keep the frame counter across resets, after raw154_sec_init(): sending
+ * continues past the counters reserved before the reset. -ENOTSUP without
+ * CONFIG_NVS and a storage partition.
+ */
+int raw154_sec_persist(struct raw154_sec *sec);
+
+/* Close the sessions, after raw154_set_security(node, NULL) */
+void raw154_sec_free(struct raw154_sec *sec);
+
+/* Forget a neighbour's frame counter, it may start over from 0 */
+void raw154_sec_forget(struct raw154_sec *sec, uint16_t addr);
+
+/* Bytes security adds to a frame at this level */
+size_t raw154_sec_overhead(uint8_t level);
+
+struct raw154_stats {
+	uint32_t tx_frames;	/* handed to the driver, strobes included */
+	uint32_t tx_failed;
+	uint32_t tx_cca_fail;	/* channel never clear, with CSMA-CA */
+	uint32_t tx_acked;	/* unicast frames acknowledged */
+	uint32_t tx_retries;
+	uint32_t tx_no_ack;	/* given up after max_retries */
+	uint32_t rx_frames;
+	uint32_t rx_dropped;	/* not for us or malformed */
+	uint32_t rx_filtered;	/* source not in the allow-list */
+	uint32_t rx_dup;	/* copies, sec_replay counts them when secured */
+	uint32_t acks_sent;
+	uint32_t windows;	/* listen windows opened */
+	uint32_t sync_lost;	/* slotted sends that fell back to strobing */
+	uint32_t frag_tx;	/* fragments sent, first copies */
+	uint32_t frag_retx;	/* fragments resent after a status */
+	uint32_t frag_rx;
+	uint32_t frag_dup;
+	uint32_t msgs_rx;	/* fragmented messages reassembled */
+	uint32_t reasm_timeouts; /* reassemblies abandoned */
+	uint32_t reasm_dropped;	/* malformed fragments or no free buffer */
+	uint32_t sec_tx;	/* frames secured */
+	uint32_t sec_rx;	/* frames authenticated */
+	uint32_t sec_failed;	/* bad MIC, level or key */
+	uint32_t sec_replay;	/* frame counter not above the last one */
+	uint32_t sec_unsecured;	/* plaintext dropped, security required */
+	uint32_t sec_no_nbr;	/* replay table full */
+	int64_t on_ticks;	/* time the receiver was on */
+};
+
+struct raw154;
+
+/* Payload of a data frame addressed to us */
+typedef void (*raw154_recv_t)(struct raw154 *node, const struct raw154_hdr *hdr,
+			      const uint8_t *payload, size_t len, uint8_t lqi);
+
+/* Reassembled message, msg is only valid during the call */
+typedef void (*raw154_msg_recv_t)(struct raw154 *node, uint16_t src,
+				  const uint8_t *msg, size_t len);
+
+struct raw154 {
+	const struct device *dev;
+	const struct ieee802154_radio_api *api;
+	enum ieee802154_hw_caps caps;
+	uint16_t pan_id;
+	uint16_t short_addr;
+	uint16_t channel;
+	uint16_t coord;		/* channel switches obeyed from, if any */
+	uint8_t seq;
+
+	raw154_recv_t recv;
+	void *user_data;
+
+	/* Only accept frames from these sources, all if NULL */
+	const struct raw154_nbr_set *allow;
+
+	/* Secure outgoing frames and check incoming ones, off if NULL */
+	struct raw154_sec *sec;
+
+	/*
+	 * send_lock is held for a whole exchange (retries, ACK waits, scans).
+	 * tx_lock only around each use of the radio and of the sequence
+	 * number, so the RX thread can take it to send ACKs and status frames
+	 * while a sender waits.
+	 */
+	struct k_mutex send_lock;
+	struct k_mutex tx_lock;
+	bool rx_on;
+	int64_t on_since;
+
+	struct raw154_mac_cfg mac;
+	struct k_work_delayable mac_work;
+	bool window_open;
+	int64_t window_start;
+	int64_t window_end;
+	struct k_sem sync_sem;
+	bool synced;
+	int64_t sync_time;
+
+	struct raw154_arq_cfg arq;
+	struct k_sem ack_sem;
+	bool ack_wait;
+	uint8_t ack_seq;
+	uint16_t ack_dst;
+
+	struct raw154_link links[RAW154_LINKS];
+	uint32_t link_clock;
+	struct raw154_txp_cfg txp;
+	bool txp_set;
+	int16_t tx_power;	/* last set on the radio */
+
+	raw154_msg_recv_t msg_recv;
+	struct k_mutex frag_lock;	/* one message in flight */
+	struct k_sem frag_sem;
+	bool frag_wait;
+	uint8_t frag_tag;
+	uint16_t frag_peer;
+	uint64_t frag_have;		/* bitmap from the last status */
+	struct raw154_frag_id frag_done[RAW154_FRAG_DONE];
+	uint8_t frag_done_next;
+
+	/* Per-sender sequence windows, least recently used is replaced */
+	struct raw154_dup_entry dup[RAW154_DUP_SENDERS];
+	uint32_t dup_clock;
+
+	struct raw154_stats stats;
+};
+
+int raw154_init(struct raw154 *node, const struct device *dev,
+		uint16_t pan_id, uint16_t short_addr, uint16_t channel,
+		raw154_recv_t recv);
+
+int raw154_radio_on(struct raw154 *node);
+int raw154_radio_off(struct raw154 *node);
+
+/* Enable or disable acknowledged unicast, off after raw154_init() */
+void raw154_set_arq(struct raw154 *node, const struct raw154_arq_cfg *cfg);
+
+/*
+ * Hand one complete frame to the driver, without any MAC scheduling. Takes
+ * tx_lock for the transmission only.
+ */
+int raw154_tx_frame(struct raw154 *node, const uint8_t *frame, size_t len);
+
+/*
+ * As raw154_tx_frame(), and if the frame requests an ACK wait for it until
+ * timeout. Returns 0 once acknowledged, -ENOMSG if no ACK came.
+ */
+int raw154_tx_acked(struct raw154 *node, const uint8_t *frame, size_t len,
+		    k_timeout_t timeout);
+
+/* Send payload in a data frame to dst, through the MAC */
+int raw154_send(struct raw154 *node, uint16_t dst, const uint8_t *payload,
+		size_t len);
+
+/* Same for another frame type, RAW154_FCF_TYPE_CMD */
+int raw154_send_type(struct raw154 *node, uint16_t type, uint16_t dst,
+		     const uint8_t *payload, size_t len);
+
+/*
+ * Send a message of up to RAW154_FRAG_MSG_MAX bytes to dst, fragmented.
+ * Fragments request ACKs only if raw154_set_arq() enabled them, and then
+ * only the first of each burst, which goes through the MAC to wake the
+ * receiver; the rest follow right behind it. Returns 0 once the receiver
+ * reports every fragment, -ETIMEDOUT if it still misses some after
+ * RAW154_FRAG_ROUNDS bursts.
+ */
+int raw154_send_msg(struct raw154 *node, uint16_t dst, const uint8_t *msg,
+		    size_t len);
+
+/* Deliver reassembled messages to cb */
+void raw154_set_msg_recv(struct raw154 *node, raw154_msg_recv_t cb);
+
+/*
+ * Measure every channel in mask for duration_ms, then come back to the
+ * current one. The radio is deaf meanwhile.
+ */
+int raw154_chan_scan(struct raw154 *node, uint32_t mask, uint16_t duration_ms,
+		     struct raw154_chan_scan *scan);
+
+/*
+ * Coordinator side: scan and, if another channel is clearly quieter,
+ * announce it and move there. Returns the channel in use afterwards.
+ */
+int raw154_chan_select(struct raw154 *node, uint32_t mask,
+		       uint16_t duration_ms, struct raw154_chan_scan *scan);
+
+/*
+ * Announce a channel switch to the nodes in range, then switch. The radio
+ * is powered for the announcement and left as it was, so a duty-cycled
+ * MAC must be stopped first, as the RX sample does around its scan, or
+ * its windows would turn the radio off in the middle. Only always-on
+ * followers hear it: duty-cycled ones have their radio off and find the
+ * new channel with raw154_chan_find().
+ */
+int raw154_chan_switch(struct raw154 *node, uint16_t channel);
+
+/*
+ * Follower side: obey channel switch commands from coord only. Nodes that
+ * never call it, coordinators included, ignore them.
+ */
+void raw154_chan_follow(struct raw154 *node, uint16_t coord);
+
+/*
+ * Follower side, after losing the coordinator: probe dst on each channel
+ * of mask, starting with the current one, until it ACKs. Needs ACKs
+ * enabled with raw154_set_arq(). Returns the channel found.
+ */
+int raw154_chan_find(struct raw154 *node, uint32_t mask, uint16_t dst);
+
+/* Set the TX power policy, until then the radio's power is left alone */
+void raw154_set_txp(struct raw154 *node, const struct raw154_txp_cfg *cfg);
+
+/* Link quality towards addr, NULL if never heard of */
+const struct raw154_link *raw154_link_get(struct raw154 *node, uint16_t addr);
+
+/*
+ * Restrict reception to the short sources in set, or accept any if NULL.
+ * Frames from extended sources are dropped while a set is in place.
+ */
+void raw154_set_allow_list(struct raw154 *node,
+			   const struct raw154_nbr_set *set);
+
+/* Secure the frames we send and check the secured ones we get, or stop */
+void raw154_set_security(struct raw154 *node, struct raw154_sec *sec);
+
+/*
+ * Early receive filter, on the frame as it sits in the driver's buffer:
+ * destination PAN and address, then the allow-list. Fills hdr and returns
+ * true if the frame is worth copying.
+ */
+bool raw154_accept(struct raw154 *node, const uint8_t *frame, size_t len,
+		   struct raw154_hdr *hdr);
+
+/* Feed a frame received by the driver, the packet is consumed */
+void raw154_input(struct raw154 *node, struct net_pkt *pkt);
+
+/*
+ * For ieee802154_handle_ack(): match an ACK frame passed up by the driver
+ * against the frame we are waiting on. The packet is not consumed.
+ */
+enum net_verdict raw154_handle_ack(struct raw154 *node, struct net_pkt *pkt);
+
+/* Receiver duty cycle in permille since the stats were last cleared */
+uint32_t raw154_duty_cycle_permille(struct raw154 *node, int64_t since);
+
+int raw154_mac_start(struct raw154 *node, const struct raw154_mac_cfg *cfg);
+void raw154_mac_stop(struct raw154 *node);
+
+/* Internal hooks between the core and the MAC */
+int raw154_mac_send(struct raw154 *node, const uint8_t *frame, size_t len);
+void raw154_mac_rx(struct raw154 *node, const struct raw154_hdr *hdr);
+
+/* Internal hooks between the core and the link table */
+void raw154_link_rx(struct raw154 *node, uint16_t addr, uint8_t lqi,
+		    int8_t rssi);
+void raw154_link_tx_done(struct raw154 *node, uint16_t addr, bool acked);
+void raw154_link_apply_power(struct raw154 *node, uint16_t dst);
+
+/* Send with a ready-made frame control field, retransmitting as configured */
+int raw154_send_fcf(struct raw154 *node, uint16_t fcf, uint16_t dst,
+		    const uint8_t *payload, size_t len);
+
+/*
+ * Write the MAC header and the payload for a frame to dst, secured if
+ * security is on. Takes the next sequence number under tx_lock. Returns the
+ * frame length.
+ */
+int raw154_build_frame(struct raw154 *node, uint8_t *frame, uint16_t fcf,
+		       uint16_t dst, const uint8_t *payload, size_t len);
+
+/*
+ * Internal hooks between the core and security. raw154_sec_secure() turns
+ * the payload behind a header of hdr_len into the auxiliary header,
+ * payload and MIC, returning the frame length. raw154_sec_unsecure()
+ * checks a received frame and leaves the plain payload right after the MAC
+ * header, returning the frame length without the security fields.
+ */
+int raw154_sec_secure(struct raw154 *node, uint8_t *frame, size_t hdr_len,
+		      const uint8_t *payload, size_t len);
+int raw154_sec_unsecure(struct raw154 *node, const struct raw154_hdr *hdr,
+			uint8_t *frame, size_t len);
+
+/* Internal hooks for MAC command frames */
+void raw154_chan_cmd_rx(struct raw154 *node, const struct raw154_hdr *hdr,
+			const uint8_t *payload, size_t len);
+void raw154_frag_cmd_rx(struct raw154 *node, const struct raw154_hdr *hdr,
+			const uint8_t *payload, size_t len);
+
+/* Internal hook for raw154_init(), forgets the node's reassemblies */
+void raw154_frag_init(struct raw154 *node);
+
+#endif /* RAW154_H_ */
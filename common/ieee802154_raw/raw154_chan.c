@@ -0,0 +1,283 @@
+/*
+ * Channel assessment and coordinated channel switch, see raw154.h
+ *
+ * The coordinator (the listener in the samples) scans, picks the quietest
+ * channel and broadcasts a channel switch command a few times before moving.
+ * Followers that set it with raw154_chan_follow() switch as soon as they
+ * hear it. A follower that missed it stops getting ACKs and finds the
+ * coordinator again with raw154_chan_find().
+ *
+ * Only always-on followers can hear the announcement. LPL and slotted
+ * senders keep their radio off outside their own sends, so for them the
+ * switch is scan-based: the announcement is lost and raw154_chan_find()
+ * does the work.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <errno.h>
+#include <string.h>
+
+#include "raw154.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_DECLARE(raw154, LOG_LEVEL_INF);
+
+/* Without energy detection: one CCA every this many us */
+#define CCA_SAMPLE_US 320
+
+/* ed_scan() completion carries no context, scans are serialized */
+static K_MUTEX_DEFINE(scan_lock);
+static K_SEM_DEFINE(scan_sem, 0, 1);
+static int16_t scan_energy;
+
+static void scan_done(const struct device *dev, int16_t max_ed)
+{
+	scan_energy = max_ed;
+	k_sem_give(&scan_sem);
+}
+
+/* Busy CCA checks in percent, so that RAW154_CHAN_HYST stays meaningful */
+static int cca_busy_percent(struct raw154 *node, uint16_t duration_ms)
+{
+	int64_t end = k_uptime_get() + duration_ms;
+	uint32_t checks = 0;
+	uint32_t busy = 0;
+
+	do {
+		if (node->api->cca(node->dev) != 0) {
+			busy++;
+		}
+		checks++;
+		k_usleep(CCA_SAMPLE_US);
+	} while (k_uptime_get() < end);
+
+	return busy * 100 / checks;
+}
+
+static int measure(struct raw154 *node, uint16_t duration_ms, int16_t *energy)
+{
+	int r;
+
+	if (!(node->caps & IEEE802154_HW_ENERGY_SCAN) || !node->api->ed_scan) {
+		*energy = cca_busy_percent(node, duration_ms);
+		return 0;
+	}
+
+	k_sem_reset(&scan_sem);
+
+	r = node->api->ed_scan(node->dev, duration_ms, scan_done);
+	if (r < 0) {
+		return r;
+	}
+
+	if (k_sem_take(&scan_sem, K_MSEC(2 * duration_ms + 10)) != 0) {
+		return -ETIMEDOUT;
+	}
+
+	*energy = scan_energy;
+
+	return 0;
+}
+
+static int set_channel(struct raw154 *node, uint16_t channel)
+{
+	int r;
+
+	k_mutex_lock(&node->send_lock, K_FOREVER);
+	k_mutex_lock(&node->tx_lock, K_FOREVER);
+
+	r = node->api->set_channel(node->dev, channel);
+	if (r == 0) {
+		node->channel = channel;
+	}
+
+	k_mutex_unlock(&node->tx_lock);
+	k_mutex_unlock(&node->send_lock);
+
+	return r;
+}
+
+int raw154_chan_scan(struct raw154 *node, uint32_t mask, uint16_t duration_ms,
+		     struct raw154_chan_scan *scan)
+{
+	bool was_on = node->rx_on;
+	int r = 0;
+
+	memset(scan, 0, sizeof(*scan));
+	scan->best = node->channel;
+
+	k_mutex_lock(&scan_lock, K_FOREVER);
+	k_mutex_lock(&node->send_lock, K_FOREVER);
+	k_mutex_lock(&node->tx_lock, K_FOREVER);
+
+	raw154_radio_on(node);
+
+	for (uint16_t ch = 0; ch <= RAW154_CHAN_MAX; ch++) {
+		if (!(mask & BIT(ch))) {
+			continue;
+		}
+
+		r = node->api->set_channel(node->dev, ch);
+		r = r ?: measure(node, duration_ms, &scan->energy[ch]);
+		if (r < 0) {
+			break;
+		}
+
+		scan->mask |= BIT(ch);
+	}
+
+	/* Ties go to the channel we are on, then the lowest */
+	for (uint16_t ch = 0; ch <= RAW154_CHAN_MAX; ch++) {
+		if ((scan->mask & BIT(ch)) &&
+		    (!(scan->mask & BIT(scan->best)) ||
+		     scan->energy[ch] < scan->energy[scan->best])) {
+			scan->best = ch;
+		}
+	}
+
+	node->api->set_channel(node->dev, node->channel);
+	if (!was_on) {
+		raw154_radio_off(node);
+	}
+
+	k_mutex_unlock(&node->tx_lock);
+	k_mutex_unlock(&node->send_lock);
+	k_mutex_unlock(&scan_lock);
+
+	return r;
+}
+
+void raw154_chan_follow(struct raw154 *node, uint16_t coord)
+{
+	node->coord = coord;
+}
+
+int raw154_chan_switch(struct raw154 *node, uint16_t channel)
+{
+	const uint8_t cmd[] = { RAW154_CMD_CHANNEL_SWITCH, channel };
+	bool was_on = node->rx_on;
+	int r;
+
+	if (channel == node->channel) {
+		return 0;
+	}
+
+	/*
+	 * raw154_mac_send() only powers the radio for senders; a stopped
+	 * listener's is off and its strobes would not go out
+	 */
+	raw154_radio_on(node);
+
+	for (int i = 0; i < RAW154_CHAN_ANNOUNCE; i++) {
+		raw154_send_type(node, RAW154_FCF_TYPE_CMD, RAW154_BROADCAST,
+				 cmd, sizeof(cmd));
+		raw154_radio_on(node);
+		k_msleep(RAW154_CHAN_ANNOUNCE_GAP_MS);
+	}
+
+	r = set_channel(node, channel);
+	if (r == 0) {
+		LOG_INF("Moved to channel %u", channel);
+	}
+
+	if (!was_on) {
+		raw154_radio_off(node);
+	}
+
+	return r;
+}
+
+int raw154_chan_select(struct raw154 *node, uint32_t mask,
+		       uint16_t duration_ms, struct raw154_chan_scan *scan)
+{
+	uint16_t best;
+	int r;
+
+	r = raw154_chan_scan(node, mask, duration_ms, scan);
+	if (r < 0) {
+		return r;
+	}
+
+	best = scan->best;
+	if (best == node->channel) {
+		return node->channel;
+	}
+
+	/* Hysteresis, unless our channel is not a candidate any more */
+	if ((scan->mask & BIT(node->channel)) &&
+	    scan->energy[node->channel] - scan->energy[best] <
+	    RAW154_CHAN_HYST) {
+		return node->channel;
+	}
+
+	r = raw154_chan_switch(node, best);
+
+	return r < 0 ? r : node->channel;
+}
+
+int raw154_chan_find(struct raw154 *node, uint32_t mask, uint16_t dst)
+{
+	const uint8_t probe = RAW154_CMD_PROBE;
+	uint16_t start = node->channel;
+
+	if (!node->arq.ack_req) {
+		return -ENOTSUP;
+	}
+
+	for (int i = -1; i <= RAW154_CHAN_MAX; i++) {
+		uint16_t ch = i < 0 ? start : i;
+
+		if ((i >= 0 && ch == start) || !(mask & BIT(ch))) {
+			continue;
+		}
+
+		if (set_channel(node, ch) < 0) {
+			continue;
+		}
+
+		if (raw154_send_type(node, RAW154_FCF_TYPE_CMD, dst,
+				     &probe, sizeof(probe)) == 0) {
+			return ch;
+		}
+	}
+
+	set_channel(node, start);
+
+	return -ENOENT;
+}
+
+void raw154_chan_cmd_rx(struct raw154 *node, const struct raw154_hdr *hdr,
+			const uint8_t *payload, size_t len)
+{
+	uint16_t channel;
+
+	if (len < 2 || payload[0] != RAW154_CMD_CHANNEL_SWITCH) {
+		/* Probes only want the ACK, already sent */
+		return;
+	}
+
+	/* Only from our coordinator, which never follows anyone itself */
+	if (hdr->src_mode != RAW154_ADDR_MODE_SHORT ||
+	    node->coord == RAW154_NO_ADDR || hdr->src_short != node->coord) {
+		return;
+	}
+
+	channel = payload[1];
+	if (channel == node->channel || channel > RAW154_CHAN_MAX) {
+		return;
+	}
+
+	/*
+	 * From the RX thread, so not under send_lock: a sender may hold it
+	 * waiting for an ACK. tx_lock keeps the switch between two frames.
+	 */
+	k_mutex_lock(&node->tx_lock, K_FOREVER);
+	if (node->api->set_channel(node->dev, channel) == 0) {
+		node->channel = channel;
+		LOG_INF("Following 0x%04x to channel %u", hdr->src_short,
+			channel);
+	}
+	k_mutex_unlock(&node->tx_lock);
+}
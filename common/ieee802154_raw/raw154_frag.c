@@ -0,0 +1,378 @@
+/*
+ * Fragmentation and reassembly of messages larger than a frame, see raw154.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/random/random.h>
+#include <zephyr/sys/byteorder.h>
+#include <errno.h>
+#include <string.h>
+
+#include "raw154.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_DECLARE(raw154, LOG_LEVEL_INF);
+
+/* Status: command, tag, bitmap of the fragments held */
+#define STATUS_LEN 10
+
+struct reasm_slot {
+	struct raw154 *node;	/* NULL: free */
+	uint16_t src;
+	uint8_t tag;
+	uint8_t count;
+	uint16_t len;
+	uint64_t have;
+	int64_t last_rx;
+	uint8_t buf[RAW154_FRAG_MSG_MAX];
+};
+
+static K_MUTEX_DEFINE(slots_lock);
+static struct reasm_slot slots[RAW154_FRAG_RX_SLOTS];
+
+static uint64_t all_fragments(uint8_t count)
+{
+	return count >= 64 ? UINT64_MAX : BIT64(count) - 1;
+}
+
+void raw154_frag_init(struct raw154 *node)
+{
+	k_mutex_init(&node->frag_lock);
+	k_sem_init(&node->frag_sem, 0, 1);
+	node->frag_tag = sys_rand32_get();
+
+	k_mutex_lock(&slots_lock, K_FOREVER);
+	for (int i = 0; i < ARRAY_SIZE(slots); i++) {
+		if (slots[i].node == node) {
+			slots[i].node = NULL;
+		}
+	}
+	k_mutex_unlock(&slots_lock);
+}
+
+void raw154_set_msg_recv(struct raw154 *node, raw154_msg_recv_t cb)
+{
+	node->msg_recv = cb;
+}
+
+/* Right behind the first fragment of a burst, the receiver is listening */
+static int send_direct(struct raw154 *node, uint16_t dst,
+		       const uint8_t *payload, size_t len)
+{
+	uint8_t frame[RAW154_MAX_FRAME];
+	int r;
+
+	k_mutex_lock(&node->send_lock, K_FOREVER);
+
+	r = raw154_build_frame(node, frame, RAW154_FCF_TYPE_CMD, dst, payload,
+			       len);
+	if (r >= 0) {
+		raw154_link_apply_power(node, dst);
+		r = raw154_tx_frame(node, frame, r);
+	}
+
+	k_mutex_unlock(&node->send_lock);
+
+	return r;
+}
+
+static int send_burst(struct raw154 *node, uint16_t dst, uint8_t tag,
+		      uint8_t count, const uint8_t *msg, size_t len,
+		      uint64_t burst, bool resend)
+{
+	uint8_t payload[RAW154_FRAG_HDR_LEN + RAW154_FRAG_DATA];
+	uint16_t fcf = RAW154_FCF_TYPE_CMD;
+	uint8_t last = 63 - __builtin_clzll(burst);
+	bool first = true;
+	int r;
+
+	if (node->arq.ack_req) {
+		fcf |= RAW154_FCF_ACK_REQ;
+	}
+
+	payload[1] = tag;
+	payload[3] = count;
+
+	for (uint8_t idx = 0; idx <= last; idx++) {
+		size_t offset = (size_t)idx * RAW154_FRAG_DATA;
+		size_t n = MIN(len - offset, RAW154_FRAG_DATA);
+
+		if (!(burst & BIT64(idx))) {
+			continue;
+		}
+
+		payload[0] = idx == last ? RAW154_CMD_FRAG_LAST :
+					   RAW154_CMD_FRAG;
+		payload[2] = idx;
+		memcpy(payload + RAW154_FRAG_HDR_LEN, msg + offset, n);
+
+		if (first) {
+			r = raw154_send_fcf(node, fcf, dst, payload,
+					    RAW154_FRAG_HDR_LEN + n);
+			/* A duty-cycled MAC turns senders off after a send */
+			raw154_radio_on(node);
+			first = false;
+		} else {
+			r = send_direct(node, dst, payload,
+					RAW154_FRAG_HDR_LEN + n);
+		}
+
+		if (r == -ENOMSG) {
+			/* Receiver unreachable, no use sending the rest */
+			return r;
+		}
+
+		if (resend) {
+			node->stats.frag_retx++;
+		} else {
+			node->stats.frag_tx++;
+		}
+	}
+
+	return 0;
+}
+
+int raw154_send_msg(struct raw154 *node, uint16_t dst, const uint8_t *msg,
+		    size_t len)
+{
+	uint8_t count = DIV_ROUND_UP(len, RAW154_FRAG_DATA);
+	uint64_t need = all_fragments(count);
+	uint64_t burst = need;
+	int r = 0;
+
+	if (len == 0 || dst == RAW154_BROADCAST) {
+		return -EINVAL;
+	}
+
+	if (len > RAW154_FRAG_MSG_MAX) {
+		return -EMSGSIZE;
+	}
+
+	k_mutex_lock(&node->frag_lock, K_FOREVER);
+
+	node->frag_peer = dst;
+	node->frag_tag++;
+
+	for (int round = 0; round < RAW154_FRAG_ROUNDS && need; round++) {
+		/* The status may come before we get to wait for it */
+		k_sem_reset(&node->frag_sem);
+		node->frag_wait = true;
+
+		r = send_burst(node, dst, node->frag_tag, count, msg, len,
+			       burst, round > 0);
+		if (r < 0) {
+			break;
+		}
+
+		if (k_sem_take(&node->frag_sem,
+			       K_MSEC(RAW154_FRAG_STATUS_MS)) == 0) {
+			need &= ~node->frag_have;
+			burst = need;
+		} else {
+			/* Status lost: only ask for it again */
+			burst = BIT64(63 - __builtin_clzll(need));
+		}
+	}
+
+	node->frag_wait = false;
+
+	if (node->mac.mode != RAW154_MAC_ALWAYS_ON && !node->mac.listener) {
+		raw154_radio_off(node);
+	}
+
+	k_mutex_unlock(&node->frag_lock);
+
+	if (r < 0) {
+		return r;
+	}
+
+	return need ? -ETIMEDOUT : 0;
+}
+
+static void send_status(struct raw154 *node, uint16_t dst, uint8_t tag,
+			uint64_t have)
+{
+	uint8_t frame[RAW154_MAX_FRAME];
+	uint8_t status[STATUS_LEN];
+	int len;
+
+	status[0] = RAW154_CMD_FRAG_STATUS;
+	status[1] = tag;
+	sys_put_le64(have, status + 2);
+
+	/*
+	 * From the RX thread, without send_lock: a sender of ours may hold it
+	 * waiting for an ACK this thread has to deliver.
+	 */
+	len = raw154_build_frame(node, frame, RAW154_FCF_TYPE_CMD, dst, status,
+				 sizeof(status));
+	if (len > 0) {
+		/* Not acknowledged, so at full power: a lost one costs a round */
+		k_mutex_lock(&node->tx_lock, K_FOREVER);
+		raw154_link_apply_power(node, RAW154_BROADCAST);
+		raw154_tx_frame(node, frame, len);
+		k_mutex_unlock(&node->tx_lock);
+	}
+}
+
+static bool recently_done(struct raw154 *node, uint16_t src, uint8_t tag)
+{
+	for (int i = 0; i < RAW154_FRAG_DONE; i++) {
+		if (node->frag_done[i].valid && node->frag_done[i].src == src &&
+		    node->frag_done[i].tag == tag) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void mark_done(struct raw154 *node, uint16_t src, uint8_t tag)
+{
+	struct raw154_frag_id *id = &node->frag_done[node->frag_done_next];
+
+	id->src = src;
+	id->tag = tag;
+	id->valid = true;
+	node->frag_done_next = (node->frag_done_next + 1) % RAW154_FRAG_DONE;
+}
+
+/* Called with slots_lock held */
+static struct reasm_slot *get_slot(struct raw154 *node, uint16_t src,
+				   uint8_t tag, uint8_t count)
+{
+	struct reasm_slot *slot = NULL;
+	int64_t now = k_uptime_get();
+
+	for (int i = 0; i < ARRAY_SIZE(slots); i++) {
+		if (slots[i].node == node && slots[i].src == src &&
+		    slots[i].tag == tag && slots[i].count == count) {
+			return &slots[i];
+		}
+	}
+
+	for (int i = 0; i < ARRAY_SIZE(slots); i++) {
+		if (!slots[i].node) {
+			slot = &slots[i];
+			break;
+		}
+
+		if (now - slots[i].last_rx > RAW154_FRAG_TIMEOUT_MS &&
+		    (!slot || slots[i].last_rx < slot->last_rx)) {
+			slot = &slots[i];
+		}
+	}
+
+	if (!slot) {
+		return NULL;
+	}
+
+	if (slot->node) {
+		LOG_DBG("Reassembly from 0x%04x timed out", slot->src);
+		slot->node->stats.reasm_timeouts++;
+	}
+
+	slot->node = node;
+	slot->src = src;
+	slot->tag = tag;
+	slot->count = count;
+	slot->len = 0;
+	slot->have = 0;
+
+	return slot;
+}
+
+static void frag_rx(struct raw154 *node, uint16_t src, const uint8_t *payload,
+		    size_t len)
+{
+	bool last = payload[0] == RAW154_CMD_FRAG_LAST;
+	uint8_t tag = payload[1];
+	uint8_t idx = payload[2];
+	uint8_t count = payload[3];
+	const uint8_t *data = payload + RAW154_FRAG_HDR_LEN;
+	size_t n = len - RAW154_FRAG_HDR_LEN;
+	size_t offset = (size_t)idx * RAW154_FRAG_DATA;
+	struct reasm_slot *slot;
+
+	if (count == 0 || count > RAW154_FRAG_MAX_COUNT || idx >= count ||
+	    n == 0 || n > RAW154_FRAG_DATA ||
+	    (idx < count - 1 && n != RAW154_FRAG_DATA) ||
+	    offset + n > RAW154_FRAG_MSG_MAX) {
+		node->stats.reasm_dropped++;
+		return;
+	}
+
+	if (recently_done(node, src, tag)) {
+		/* Our last status was lost, tell the sender again */
+		node->stats.frag_dup++;
+		if (last) {
+			send_status(node, src, tag, all_fragments(count));
+		}
+		return;
+	}
+
+	k_mutex_lock(&slots_lock, K_FOREVER);
+
+	slot = get_slot(node, src, tag, count);
+	if (!slot) {
+		k_mutex_unlock(&slots_lock);
+		node->stats.reasm_dropped++;
+		return;
+	}
+
+	slot->last_rx = k_uptime_get();
+
+	if (slot->have & BIT64(idx)) {
+		node->stats.frag_dup++;
+	} else {
+		memcpy(slot->buf + offset, data, n);
+		slot->have |= BIT64(idx);
+		if (idx == count - 1) {
+			slot->len = offset + n;
+		}
+		node->stats.frag_rx++;
+	}
+
+	if (last) {
+		send_status(node, src, tag, slot->have);
+	}
+
+	if (slot->have == all_fragments(count)) {
+		node->stats.msgs_rx++;
+		mark_done(node, src, tag);
+
+		if (node->msg_recv) {
+			node->msg_recv(node, src, slot->buf, slot->len);
+		}
+
+		slot->node = NULL;
+	}
+
+	k_mutex_unlock(&slots_lock);
+}
+
+void raw154_frag_cmd_rx(struct raw154 *node, const struct raw154_hdr *hdr,
+			const uint8_t *payload, size_t len)
+{
+	if (hdr->src_mode == RAW154_ADDR_MODE_NONE ||
+	    hdr->dst_short != node->short_addr) {
+		return;
+	}
+
+	if (payload[0] != RAW154_CMD_FRAG_STATUS) {
+		if (len > RAW154_FRAG_HDR_LEN) {
+			frag_rx(node, hdr->src_short, payload, len);
+		} else {
+			node->stats.reasm_dropped++;
+		}
+		return;
+	}
+
+	if (len >= STATUS_LEN && node->frag_wait &&
+	    hdr->src_short == node->frag_peer && payload[1] == node->frag_tag) {
+		node->frag_have = sys_get_le64(payload + 2);
+		k_sem_give(&node->frag_sem);
+	}
+}
@@ -0,0 +1,158 @@
+/*
+ * Neighbour link quality and adaptive TX power, see raw154.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <string.h>
+
+#include "raw154.h"
+
+/* EWMA weight 1/2^EWMA_SHIFT */
+#define EWMA_SHIFT 3
+
+static struct raw154_link *link_find(struct raw154 *node, uint16_t addr,
+				     bool create)
+{
+	struct raw154_link *oldest = &node->links[0];
+
+	for (int i = 0; i < RAW154_LINKS; i++) {
+		struct raw154_link *link = &node->links[i];
+
+		if (link->last_use && link->addr == addr) {
+			link->last_use = ++node->link_clock;
+			return link;
+		}
+		if (link->last_use < oldest->last_use) {
+			oldest = link;
+		}
+	}
+
+	if (!create) {
+		return NULL;
+	}
+
+	memset(oldest, 0, sizeof(*oldest));
+	oldest->addr = addr;
+	oldest->last_use = ++node->link_clock;
+	oldest->delivery = 1000;
+	oldest->tx_power = node->txp.max_dbm;
+
+	return oldest;
+}
+
+/* Moves at least one unit, so it reaches the sample instead of stalling */
+static int16_t ewma(int16_t avg, int16_t sample)
+{
+	int16_t step = (sample - avg) / (1 << EWMA_SHIFT);
+
+	if (step == 0 && sample != avg) {
+		step = sample > avg ? 1 : -1;
+	}
+
+	return avg + step;
+}
+
+const struct raw154_link *raw154_link_get(struct raw154 *node, uint16_t addr)
+{
+	return link_find(node, addr, false);
+}
+
+void raw154_link_rx(struct raw154 *node, uint16_t addr, uint8_t lqi,
+		    int8_t rssi)
+{
+	struct raw154_link *link;
+
+	if (addr == RAW154_BROADCAST || addr == RAW154_NO_ADDR) {
+		return;
+	}
+
+	link = link_find(node, addr, true);
+
+	/* Kept x16 so that the 1/8 steps do not round away */
+	if (!link->heard) {
+		link->lqi = lqi * 16;
+		link->rssi = rssi * 16;
+		link->heard = true;
+		return;
+	}
+
+	link->lqi = ewma(link->lqi, lqi * 16);
+	link->rssi = ewma(link->rssi, rssi * 16);
+}
+
+void raw154_set_txp(struct raw154 *node, const struct raw154_txp_cfg *cfg)
+{
+	node->txp = *cfg;
+	node->txp_set = true;
+
+	for (int i = 0; i < RAW154_LINKS; i++) {
+		node->links[i].tx_power = cfg->max_dbm;
+	}
+
+	/* Full power until a unicast sets its neighbour's */
+	if (node->api->set_txpower(node->dev, cfg->max_dbm) == 0) {
+		node->tx_power = cfg->max_dbm;
+	}
+}
+
+void raw154_link_tx_done(struct raw154 *node, uint16_t addr, bool acked)
+{
+	const struct raw154_txp_cfg *txp = &node->txp;
+	struct raw154_link *link = link_find(node, addr, true);
+
+	link->delivery = ewma(link->delivery, acked ? 1000 : 0);
+
+	if (!txp->adaptive) {
+		return;
+	}
+
+	if (!acked) {
+		link->ack_run = 0;
+		link->tx_power = MIN(link->tx_power + txp->step_db,
+				     txp->max_dbm);
+		return;
+	}
+
+	if (++link->ack_run < RAW154_TXP_PROBE_RUN) {
+		return;
+	}
+
+	link->ack_run = 0;
+
+	if (link->delivery < txp->target_permille ||
+	    link->tx_power - txp->step_db < txp->min_dbm) {
+		return;
+	}
+
+	/* Their RSSI at our end, minus what we would send below full power */
+	if (link->heard &&
+	    link->rssi / 16 - (txp->max_dbm - link->tx_power + txp->step_db) <
+	    txp->rssi_floor_dbm) {
+		return;
+	}
+
+	link->tx_power -= txp->step_db;
+}
+
+void raw154_link_apply_power(struct raw154 *node, uint16_t dst)
+{
+	int16_t dbm = node->txp.max_dbm;
+
+	if (!node->txp_set) {
+		return;
+	}
+
+	if (node->txp.adaptive && dst != RAW154_BROADCAST) {
+		dbm = link_find(node, dst, true)->tx_power;
+	}
+
+	/* The RX thread sets full power for ACKs under tx_lock too */
+	k_mutex_lock(&node->tx_lock, K_FOREVER);
+	if (dbm != node->tx_power &&
+	    node->api->set_txpower(node->dev, dbm) == 0) {
+		node->tx_power = dbm;
+	}
+	k_mutex_unlock(&node->tx_lock);
+}
@@ -0,0 +1,232 @@
+/*
+ * Duty-cycled MAC for the raw IEEE 802.15.4 link layer, see raw154.h
+ *
+ * Listener side: a delayable work item opens a listen window every period
+ * (radio start), and closes it listen_ms later (radio stop). Traffic heard
+ * in a window keeps it open for another listen_ms. In slotted mode the
+ * listener opens each window with a sync beacon.
+ *
+ * Sender side: in LPL mode a frame is repeated for a whole period, so one
+ * copy lands in the next window. In slotted mode the sender wakes guard_ms
+ * before the predicted window, waits for the beacon and sends once; if the
+ * beacon is missed it falls back to strobing.
+ *
+ * raw154_mac_send() returns -ENOMSG when a frame that requests an ACK was
+ * not acknowledged, raw154_send() then retransmits it.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <errno.h>
+
+#include "raw154.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_DECLARE(raw154, LOG_LEVEL_INF);
+
+/* Secured as any other frame, so a forged beacon cannot move the slots */
+static void send_sync_beacon(struct raw154 *node)
+{
+	uint8_t frame[RAW154_MAX_FRAME];
+	int len;
+
+	k_mutex_lock(&node->tx_lock, K_FOREVER);
+	len = raw154_build_frame(node, frame, RAW154_FCF_TYPE_BEACON,
+				 RAW154_NO_ADDR, NULL, 0);
+	if (len >= 0) {
+		raw154_link_apply_power(node, RAW154_BROADCAST);
+		raw154_tx_frame(node, frame, len);
+	}
+	k_mutex_unlock(&node->tx_lock);
+}
+
+static void mac_work_handler(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+	struct raw154 *node = CONTAINER_OF(dwork, struct raw154, mac_work);
+	int64_t now = k_uptime_get();
+
+	if (!node->window_open) {
+		node->window_open = true;
+		node->window_start = now;
+		node->window_end = now + node->mac.listen_ms;
+		node->stats.windows++;
+
+		raw154_radio_on(node);
+		if (node->mac.mode == RAW154_MAC_SLOTTED) {
+			send_sync_beacon(node);
+		}
+
+		k_work_schedule(dwork, K_MSEC(node->mac.listen_ms));
+		return;
+	}
+
+	/* Traffic pushed the end of the window out */
+	if (now < node->window_end) {
+		k_work_schedule(dwork, K_MSEC(node->window_end - now));
+		return;
+	}
+
+	raw154_radio_off(node);
+	node->window_open = false;
+
+	/* Keep windows on period boundaries so senders can predict them */
+	k_work_schedule(dwork, K_MSEC(MAX(node->window_start +
+					  node->mac.period_ms - now, 0)));
+}
+
+int raw154_mac_start(struct raw154 *node, const struct raw154_mac_cfg *cfg)
+{
+	node->mac = *cfg;
+	node->window_open = false;
+	node->synced = false;
+	k_work_init_delayable(&node->mac_work, mac_work_handler);
+
+	if (cfg->mode == RAW154_MAC_ALWAYS_ON) {
+		return raw154_radio_on(node);
+	}
+
+	if (cfg->listen_ms == 0 || cfg->period_ms <= cfg->listen_ms) {
+		return -EINVAL;
+	}
+
+	if (cfg->listener) {
+		k_work_schedule(&node->mac_work, K_NO_WAIT);
+		return 0;
+	}
+
+	return raw154_radio_off(node);
+}
+
+void raw154_mac_stop(struct raw154 *node)
+{
+	struct k_work_sync sync;
+
+	k_work_cancel_delayable_sync(&node->mac_work, &sync);
+	node->window_open = false;
+	raw154_radio_off(node);
+}
+
+void raw154_mac_rx(struct raw154 *node, const struct raw154_hdr *hdr)
+{
+	if (node->mac.mode == RAW154_MAC_ALWAYS_ON) {
+		return;
+	}
+
+	if (node->mac.listener) {
+		/* Give a burst the chance to finish in this window */
+		if (node->window_open &&
+		    (raw154_frame_type(hdr) == RAW154_FCF_TYPE_DATA ||
+		     raw154_frame_type(hdr) == RAW154_FCF_TYPE_CMD)) {
+			node->window_end = k_uptime_get() + node->mac.listen_ms;
+		}
+		return;
+	}
+
+	if (node->mac.mode == RAW154_MAC_SLOTTED &&
+	    raw154_frame_type(hdr) == RAW154_FCF_TYPE_BEACON) {
+		node->sync_time = k_uptime_get();
+		node->synced = true;
+		k_sem_give(&node->sync_sem);
+	}
+}
+
+/*
+ * Repeat the frame for a whole period, so that a window sees one copy. If
+ * the frame requests an ACK, each gap doubles as the ACK wait and strobing
+ * stops as soon as the receiver answers.
+ */
+static int strobe(struct raw154 *node, const uint8_t *frame, size_t len)
+{
+	int64_t end = k_uptime_get() + node->mac.period_ms + node->mac.listen_ms;
+	bool ack = raw154_frame_ack_req(frame);
+	int sent = 0;
+	int r;
+
+	do {
+		int64_t gap_end = k_uptime_ticks() +
+				  k_us_to_ticks_ceil64(node->mac.strobe_gap_us);
+
+		r = raw154_tx_acked(node, frame, len,
+				    K_TIMEOUT_ABS_TICKS(gap_end));
+		if (r == 0) {
+			if (ack) {
+				return 0;
+			}
+			sent++;
+		}
+
+		k_sleep(K_TIMEOUT_ABS_TICKS(gap_end));
+	} while (k_uptime_get() < end);
+
+	if (ack) {
+		return -ENOMSG;
+	}
+
+	return sent > 0 ? 0 : -EIO;
+}
+
+/* Sleep until the next predicted window and wait for its beacon */
+static bool wait_for_slot(struct raw154 *node)
+{
+	uint32_t period = node->mac.period_ms;
+	k_timeout_t timeout = K_MSEC(period + node->mac.listen_ms);
+	int64_t now = k_uptime_get();
+
+	if (node->synced) {
+		int64_t next = node->sync_time +
+			       DIV_ROUND_UP(now + node->mac.guard_ms -
+					    node->sync_time, period) * period;
+
+		k_sleep(K_TIMEOUT_ABS_MS(next - node->mac.guard_ms));
+		timeout = K_MSEC(2 * node->mac.guard_ms + node->mac.listen_ms);
+	}
+
+	k_sem_reset(&node->sync_sem);
+	raw154_radio_on(node);
+
+	if (k_sem_take(&node->sync_sem, timeout) != 0) {
+		node->synced = false;
+		node->stats.sync_lost++;
+		return false;
+	}
+
+	return true;
+}
+
+int raw154_mac_send(struct raw154 *node, const uint8_t *frame, size_t len)
+{
+	k_timeout_t ack_timeout = K_USEC(node->arq.ack_timeout_us);
+	int r;
+
+	switch (node->mac.mode) {
+	case RAW154_MAC_LPL:
+		/* Senders only power the radio while strobing, to hear ACKs */
+		if (!node->mac.listener) {
+			raw154_radio_on(node);
+		}
+		r = strobe(node, frame, len);
+		break;
+
+	case RAW154_MAC_SLOTTED:
+		if (node->mac.listener) {
+			/* Our own windows are the schedule */
+			r = raw154_tx_acked(node, frame, len, ack_timeout);
+		} else if (wait_for_slot(node)) {
+			r = raw154_tx_acked(node, frame, len, ack_timeout);
+		} else {
+			r = strobe(node, frame, len);
+		}
+		break;
+
+	default:
+		return raw154_tx_acked(node, frame, len, ack_timeout);
+	}
+
+	if (!node->mac.listener) {
+		raw154_radio_off(node);
+	}
+
+	return r;
+}
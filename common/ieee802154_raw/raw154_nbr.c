@@ -0,0 +1,130 @@
+/*
+ * Neighbour address set for the raw link layer allow-list, see raw154.h
+ *
+ * Keys are 16-bit short addresses. 0xffff (broadcast) marks a free slot and
+ * 0xfffe (no short address) a deleted one; neither is a valid source.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <errno.h>
+
+#include "raw154.h"
+
+#define SLOT_FREE    RAW154_BROADCAST
+#define SLOT_DELETED RAW154_NO_ADDR
+
+/* Fibonacci hashing, consecutive addresses land far apart */
+static inline uint16_t slot_of(const struct raw154_nbr_set *set, uint16_t addr)
+{
+	return (uint16_t)(addr * 40503U) >> set->shift;
+}
+
+int raw154_nbr_init(struct raw154_nbr_set *set, uint16_t *slots,
+		    size_t num_slots)
+{
+	uint8_t bits = 0;
+
+	if (num_slots < 2 || num_slots > 0x8000 ||
+	    (num_slots & (num_slots - 1)) != 0) {
+		return -EINVAL;
+	}
+
+	while ((1U << bits) < num_slots) {
+		bits++;
+	}
+
+	set->slots = slots;
+	set->mask = num_slots - 1;
+	set->shift = 16 - bits;
+	raw154_nbr_clear(set);
+
+	return 0;
+}
+
+void raw154_nbr_clear(struct raw154_nbr_set *set)
+{
+	for (uint32_t i = 0; i <= set->mask; i++) {
+		set->slots[i] = SLOT_FREE;
+	}
+
+	set->count = 0;
+	set->used = 0;
+}
+
+bool raw154_nbr_contains(const struct raw154_nbr_set *set, uint16_t addr)
+{
+	uint16_t i = slot_of(set, addr);
+
+	/* Not an address, and would match the free or deleted slots */
+	if (addr == SLOT_FREE || addr == SLOT_DELETED) {
+		return false;
+	}
+
+	/* Terminates: at least a quarter of the slots stay free */
+	while (set->slots[i] != SLOT_FREE) {
+		if (set->slots[i] == addr) {
+			return true;
+		}
+		i = (i + 1) & set->mask;
+	}
+
+	return false;
+}
+
+int raw154_nbr_add(struct raw154_nbr_set *set, uint16_t addr)
+{
+	uint16_t i = slot_of(set, addr);
+	int reuse = -1;
+
+	if (addr == SLOT_FREE || addr == SLOT_DELETED) {
+		return -EINVAL;
+	}
+
+	while (set->slots[i] != SLOT_FREE) {
+		if (set->slots[i] == addr) {
+			return -EALREADY;
+		}
+		if (set->slots[i] == SLOT_DELETED && reuse < 0) {
+			reuse = i;
+		}
+		i = (i + 1) & set->mask;
+	}
+
+	if (reuse >= 0) {
+		set->slots[reuse] = addr;
+		set->count++;
+		return 0;
+	}
+
+	if ((set->used + 1) * 4 > (set->mask + 1) * 3) {
+		return -ENOSPC;
+	}
+
+	set->slots[i] = addr;
+	set->count++;
+	set->used++;
+
+	return 0;
+}
+
+int raw154_nbr_del(struct raw154_nbr_set *set, uint16_t addr)
+{
+	uint16_t i = slot_of(set, addr);
+
+	if (addr == SLOT_FREE || addr == SLOT_DELETED) {
+		return -EINVAL;
+	}
+
+	while (set->slots[i] != SLOT_FREE) {
+		if (set->slots[i] == addr) {
+			set->slots[i] = SLOT_DELETED;
+			set->count--;
+			return 0;
+		}
+		i = (i + 1) & set->mask;
+	}
+
+	return -ENOENT;
+}
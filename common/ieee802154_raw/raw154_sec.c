@@ -0,0 +1,438 @@
+/*
+ * Link-layer security for the raw IEEE 802.15.4 link layer, see raw154.h
+ *
+ * Frame layout: MAC header, auxiliary security header, payload (encrypted
+ * for the ENC levels), MIC. CCM* authenticates the MAC and auxiliary
+ * headers, and the payload too for the MIC-only levels, which pass it as
+ * additional data and encrypt nothing.
+ *
+ * The replay check runs before the MIC is computed, so replayed frames cost
+ * no AES work; the neighbour's counter only moves once the MIC checks out.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/crypto/crypto.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/util.h>
+#include <errno.h>
+#include <string.h>
+
+#include "raw154.h"
+
+#ifdef CONFIG_NVS
+#include <zephyr/drivers/flash.h>
+#include <zephyr/fs/nvs.h>
+#endif
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_DECLARE(raw154, LOG_LEVEL_INF);
+
+#define SEC_CTRL_KEY_ID_MODE_1	(1 << 3)
+
+#define SEC_CAPS (CAP_RAW_KEY | CAP_SEPARATE_IO_BUFS | CAP_SYNC_OPS)
+
+static uint8_t mic_len(uint8_t level)
+{
+	/* Levels 1 to 3 and 5 to 7: MIC of 4, 8 and 16 bytes */
+	return (level & 0x3) ? 2U << (level & 0x3) : 0;
+}
+
+size_t raw154_sec_overhead(uint8_t level)
+{
+	return RAW154_SEC_AUX_LEN + mic_len(level);
+}
+
+const struct device *raw154_sec_default_dev(void)
+{
+	const struct device *dev = device_get_binding(RAW154_SEC_HW_CRYPTO);
+
+#ifdef CONFIG_CRYPTO_TINYCRYPT_SHIM
+	if (dev == NULL) {
+		dev = device_get_binding(CONFIG_CRYPTO_TINYCRYPT_SHIM_DRV_NAME);
+	}
+#endif
+
+	return dev;
+}
+
+static int begin_session(const struct device *dev, struct raw154_sec *sec,
+			 struct cipher_ctx *ctx, enum cipher_op op)
+{
+	ctx->keylen = RAW154_SEC_KEY_LEN;
+	ctx->key.bit_stream = sec->cfg.key;
+	ctx->flags = SEC_CAPS;
+	ctx->mode_params.ccm_info.nonce_len = RAW154_SEC_NONCE_LEN;
+	ctx->mode_params.ccm_info.tag_len = sec->mic_len;
+
+	return cipher_begin_session(dev, ctx, CRYPTO_CIPHER_ALGO_AES,
+				    CRYPTO_CIPHER_MODE_CCM, op);
+}
+
+int raw154_sec_init(struct raw154_sec *sec, const struct device *dev,
+		    const struct raw154_sec_cfg *cfg)
+{
+	int r;
+
+	if (dev == NULL || !device_is_ready(dev)) {
+		return -ENODEV;
+	}
+
+	/* No MIC (levels 0 and 4) is not CCM, see raw154.h */
+	if (cfg->level > RAW154_SEC_LEVEL_ENC_MIC_128 ||
+	    mic_len(cfg->level) == 0) {
+		return -EINVAL;
+	}
+
+	if ((crypto_query_hwcaps(dev) & SEC_CAPS) != SEC_CAPS) {
+		return -ENOTSUP;
+	}
+
+	memset(sec, 0, sizeof(*sec));
+	sec->cfg = *cfg;
+	sec->mic_len = mic_len(cfg->level);
+	atomic_set(&sec->frame_counter, cfg->frame_counter);
+
+	r = begin_session(dev, sec, &sec->enc, CRYPTO_CIPHER_OP_ENCRYPT);
+	if (r < 0) {
+		LOG_ERR("No AES-CCM session (%d)", r);
+		return r;
+	}
+
+	r = begin_session(dev, sec, &sec->dec, CRYPTO_CIPHER_OP_DECRYPT);
+	if (r < 0) {
+		LOG_ERR("No AES-CCM session (%d)", r);
+		cipher_free_session(dev, &sec->enc);
+		return r;
+	}
+
+	return 0;
+}
+
+int raw154_sec_config_key(struct raw154_sec_cfg *cfg)
+{
+#ifdef CONFIG_RAW154_SEC_KEY
+	const char *hex = CONFIG_RAW154_SEC_KEY;
+
+	if (hex[0] == '\0') {
+		return -ENOENT;
+	}
+
+	if (strlen(hex) != 2 * RAW154_SEC_KEY_LEN ||
+	    hex2bin(hex, strlen(hex), cfg->key, sizeof(cfg->key)) !=
+	    sizeof(cfg->key)) {
+		return -EINVAL;
+	}
+
+	cfg->key_index = CONFIG_RAW154_SEC_KEY_INDEX;
+
+	return 0;
+#else
+	return -ENOENT;
+#endif
+}
+
+#if defined(CONFIG_NVS) && FIXED_PARTITION_EXISTS(storage_partition)
+
+#define COUNTER_NVS_ID	1
+
+static struct nvs_fs counter_fs = {
+	.flash_device = FIXED_PARTITION_DEVICE(storage_partition),
+	.offset = FIXED_PARTITION_OFFSET(storage_partition),
+};
+static bool counter_fs_ready;
+
+static int counter_mount(void)
+{
+	struct flash_pages_info info;
+	int r;
+
+	if (counter_fs_ready) {
+		return 0;
+	}
+
+	if (!device_is_ready(counter_fs.flash_device)) {
+		return -ENODEV;
+	}
+
+	r = flash_get_page_info_by_offs(counter_fs.flash_device,
+					counter_fs.offset, &info);
+	if (r < 0) {
+		return r;
+	}
+
+	counter_fs.sector_size = info.size;
+	counter_fs.sector_count =
+		FIXED_PARTITION_SIZE(storage_partition) / info.size;
+
+	r = nvs_mount(&counter_fs);
+	if (r < 0) {
+		return r;
+	}
+
+	counter_fs_ready = true;
+
+	return 0;
+}
+
+/* Store that counters from counter on may be in use, before using them */
+static int counter_reserve(struct raw154_sec *sec, uint32_t counter)
+{
+	uint32_t limit = counter + MIN(RAW154_SEC_COUNTER_BLOCK,
+				       UINT32_MAX - counter);
+	ssize_t n;
+
+	n = nvs_write(&counter_fs, COUNTER_NVS_ID, &limit, sizeof(limit));
+	if (n < 0) {
+		LOG_ERR("Frame counter not stored (%d)", (int)n);
+		return n;
+	}
+
+	sec->counter_limit = limit;
+
+	return 0;
+}
+
+int raw154_sec_persist(struct raw154_sec *sec)
+{
+	uint32_t stored = 0;
+	uint32_t counter;
+	ssize_t n;
+	int r;
+
+	r = counter_mount();
+	if (r < 0) {
+		return r;
+	}
+
+	n = nvs_read(&counter_fs, COUNTER_NVS_ID, &stored, sizeof(stored));
+	if (n < 0 && n != -ENOENT) {
+		return n;
+	}
+
+	/* Anything below the stored limit may have gone out before a reset */
+	counter = MAX((uint32_t)atomic_get(&sec->frame_counter), stored);
+
+	r = counter_reserve(sec, counter);
+	if (r < 0) {
+		return r;
+	}
+
+	atomic_set(&sec->frame_counter, counter);
+	sec->persist = true;
+
+	return 0;
+}
+
+#else /* !CONFIG_NVS || !FIXED_PARTITION_EXISTS(storage_partition) */
+
+static int counter_reserve(struct raw154_sec *sec, uint32_t counter)
+{
+	return -ENOTSUP;
+}
+
+int raw154_sec_persist(struct raw154_sec *sec)
+{
+	return -ENOTSUP;
+}
+
+#endif
+
+void raw154_sec_free(struct raw154_sec *sec)
+{
+	cipher_free_session(sec->enc.device, &sec->enc);
+	cipher_free_session(sec->dec.device, &sec->dec);
+}
+
+void raw154_sec_forget(struct raw154_sec *sec, uint16_t addr)
+{
+	for (int i = 0; i < RAW154_SEC_NBRS; i++) {
+		if (sec->nbrs[i].used && sec->nbrs[i].addr == addr) {
+			sec->nbrs[i].used = false;
+		}
+	}
+}
+
+void raw154_set_security(struct raw154 *node, struct raw154_sec *sec)
+{
+	k_mutex_lock(&node->tx_lock, K_FOREVER);
+	node->sec = sec;
+	k_mutex_unlock(&node->tx_lock);
+}
+
+/* PAN ID, 00ff:fe00 and the short address, big-endian as the nonce wants */
+static void put_short_ext(uint8_t *buf, uint16_t pan_id, uint16_t addr)
+{
+	sys_put_be16(pan_id, buf);
+	sys_put_be32(0x00fffe00, buf + 2);
+	sys_put_be16(addr, buf + 6);
+}
+
+static void put_nonce(uint8_t *nonce, uint32_t counter, uint8_t level)
+{
+	/* The first 8 bytes hold the sender's address already */
+	sys_put_be32(counter, nonce + 8);
+	nonce[12] = level;
+}
+
+int raw154_sec_secure(struct raw154 *node, uint8_t *frame, size_t hdr_len,
+		      const uint8_t *payload, size_t len)
+{
+	struct raw154_sec *sec = node->sec;
+	uint8_t nonce[RAW154_SEC_NONCE_LEN];
+	uint8_t *aux = frame + hdr_len;
+	uint8_t *data = aux + RAW154_SEC_AUX_LEN;
+	bool enc = sec->cfg.level & BIT(2);
+	struct cipher_pkt op = { 0 };
+	struct cipher_aead_pkt aead = { .pkt = &op, .ad = frame };
+	size_t total = hdr_len + RAW154_SEC_AUX_LEN + len + sec->mic_len;
+	atomic_val_t counter;
+	int r;
+
+	if (total > RAW154_MAX_FRAME) {
+		return -EMSGSIZE;
+	}
+
+	/* Each counter is used once; a wrap would reuse nonces, rekey first */
+	do {
+		counter = atomic_get(&sec->frame_counter);
+		if ((uint32_t)counter == UINT32_MAX) {
+			return -EOVERFLOW;
+		}
+	} while (!atomic_cas(&sec->frame_counter, counter, counter + 1));
+
+	/* Reserve the next block in flash before its first counter goes out */
+	if (sec->persist && (uint32_t)counter >= sec->counter_limit &&
+	    counter_reserve(sec, counter) < 0) {
+		return -EIO;
+	}
+
+	aux[0] = sec->cfg.level | SEC_CTRL_KEY_ID_MODE_1;
+	sys_put_le32(counter, aux + 1);
+	aux[5] = sec->cfg.key_index;
+
+	put_short_ext(nonce, node->pan_id, node->short_addr);
+	put_nonce(nonce, counter, sec->cfg.level);
+
+	if (enc) {
+		op.in_buf = (uint8_t *)payload;
+		op.in_len = len;
+		op.out_buf = data;
+		aead.ad_len = hdr_len + RAW154_SEC_AUX_LEN;
+	} else {
+		memcpy(data, payload, len);
+		op.in_buf = data + len;
+		op.out_buf = data + len;
+		aead.ad_len = hdr_len + RAW154_SEC_AUX_LEN + len;
+	}
+
+	op.out_buf_max = RAW154_MAX_FRAME - (op.out_buf - frame);
+	aead.tag = data + len;
+
+	r = cipher_ccm_op(&sec->enc, &aead, nonce);
+	if (r < 0) {
+		return r;
+	}
+
+	node->stats.sec_tx++;
+
+	return total;
+}
+
+static struct raw154_sec_nbr *nbr_find(struct raw154_sec *sec, uint16_t addr,
+				       struct raw154_sec_nbr **free_nbr)
+{
+	*free_nbr = NULL;
+
+	for (int i = 0; i < RAW154_SEC_NBRS; i++) {
+		if (!sec->nbrs[i].used) {
+			if (*free_nbr == NULL) {
+				*free_nbr = &sec->nbrs[i];
+			}
+		} else if (sec->nbrs[i].addr == addr) {
+			return &sec->nbrs[i];
+		}
+	}
+
+	return NULL;
+}
+
+int raw154_sec_unsecure(struct raw154 *node, const struct raw154_hdr *hdr,
+			uint8_t *frame, size_t len)
+{
+	struct raw154_sec *sec = node->sec;
+	uint8_t plain[RAW154_MAX_FRAME];
+	uint8_t nonce[RAW154_SEC_NONCE_LEN];
+	uint8_t *aux = frame + hdr->len;
+	uint8_t *data = aux + RAW154_SEC_AUX_LEN;
+	struct raw154_sec_nbr *nbr, *free_nbr;
+	struct cipher_pkt op = { 0 };
+	struct cipher_aead_pkt aead = { .pkt = &op, .ad = frame };
+	uint32_t counter;
+	size_t plen;
+	bool enc;
+
+	if (sec == NULL ||
+	    len < hdr->len + RAW154_SEC_AUX_LEN + sec->mic_len ||
+	    aux[0] != (sec->cfg.level | SEC_CTRL_KEY_ID_MODE_1) ||
+	    aux[5] != sec->cfg.key_index ||
+	    hdr->src_mode == RAW154_ADDR_MODE_NONE) {
+		node->stats.sec_failed++;
+		return -EBADMSG;
+	}
+
+	counter = sys_get_le32(aux + 1);
+	plen = len - hdr->len - RAW154_SEC_AUX_LEN - sec->mic_len;
+	enc = sec->cfg.level & BIT(2);
+
+	nbr = nbr_find(sec, hdr->src_short, &free_nbr);
+	if (nbr != NULL && counter <= nbr->counter) {
+		node->stats.sec_replay++;
+		return -EALREADY;
+	}
+	if (nbr == NULL && free_nbr == NULL) {
+		node->stats.sec_no_nbr++;
+		return -ENOSPC;
+	}
+
+	if (hdr->src_mode == RAW154_ADDR_MODE_EXT) {
+		sys_put_be64(hdr->src_ext, nonce);
+	} else {
+		put_short_ext(nonce, hdr->src_pan, hdr->src_short);
+	}
+	put_nonce(nonce, counter, sec->cfg.level);
+
+	/* The MIC follows what is decrypted, as the TinyCrypt shim expects */
+	aead.tag = data + plen;
+	op.out_buf = plain;
+	op.out_buf_max = sizeof(plain);
+
+	if (enc) {
+		op.in_buf = data;
+		op.in_len = plen;
+		aead.ad_len = hdr->len + RAW154_SEC_AUX_LEN;
+	} else {
+		op.in_buf = aead.tag;
+		aead.ad_len = hdr->len + RAW154_SEC_AUX_LEN + plen;
+	}
+
+	if (cipher_ccm_op(&sec->dec, &aead, nonce) < 0) {
+		node->stats.sec_failed++;
+		return -EBADMSG;
+	}
+
+	if (nbr == NULL) {
+		nbr = free_nbr;
+		nbr->addr = hdr->src_short;
+		nbr->used = true;
+	}
+	nbr->counter = counter;
+	node->stats.sec_rx++;
+
+	/* The payload takes the place of the auxiliary header */
+	memmove(aux, enc ? plain : data, plen);
+
+	return hdr->len + plen;
+}
@@ -0,0 +1,526 @@
+/*
+ * Interrupt-to-thread latency harness, see irq_latency.h
+ *
+ * One edge is in flight at a time: the runner arms the edge timer, and
+ * waits for the handler to record the edge before arming it again, after
+ * a gap of gap_us plus a pseudo-random part that keeps the edges from
+ * locking onto the load's own rhythm. The waiting thread outranks the
+ * load threads, so what the load adds is the switch away from a busy
+ * thread and whatever the kernel and the network stack do with
+ * interrupts locked.
+ *
+ * The load threads are started on first use and parked on a semaphore
+ * between runs. Their rounds end in k_busy_wait(), which spins on
+ * hardware and lets simulated time, and with it the edge timer, move on
+ * native_sim.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#ifdef CONFIG_NET_SOCKETS
+#include <zephyr/net/socket.h>
+#endif
+
+#ifdef CONFIG_ARCH_POSIX
+#include "host_clock.h"
+#endif
+
+#include "irq_latency.h"
+
+#define RECEIVER_PRIO		K_PRIO_PREEMPT(2)
+#define LOAD_PRIO		K_PRIO_PREEMPT(10)
+#define RECEIVER_STACK_SIZE	1024
+#define CPU_STACK_SIZE		512
+#define NET_STACK_SIZE		1536
+
+/* A CPU hog round: arithmetic, then a busy wait */
+#define CPU_SPIN		2000
+#define CPU_BUSY_US		100
+
+/* A network round: a burst of datagrams over the loopback interface */
+#define NET_PORT		4243
+#define NET_SIZE		128
+#define NET_BURST		8
+#define NET_BUSY_US		200
+
+/* Past its gap, an edge not recorded in this long counts as missed */
+#define EDGE_TIMEOUT_MS		100
+
+/* Under 1 us, then 1 to 2 us and up by powers of two, then the rest */
+#define HIST_BINS		11
+
+enum handoff {
+	HANDOFF_SEM,
+	HANDOFF_WORK,
+	HANDOFF_MSGQ,
+	HANDOFF_POLL,
+	HANDOFF_COUNT,
+};
+
+static const char *const handoff_names[HANDOFF_COUNT] = {
+	[HANDOFF_SEM] = "k_sem",
+	[HANDOFF_WORK] = "k_work",
+	[HANDOFF_MSGQ] = "k_msgq",
+	[HANDOFF_POLL] = "k_poll",
+};
+
+enum load {
+	LOAD_IDLE,
+	LOAD_CPU,
+	LOAD_NET,
+	LOAD_COUNT,
+};
+
+static const char *const load_names[LOAD_COUNT] = {
+	[LOAD_IDLE] = "idle",
+	[LOAD_CPU] = "cpu",
+	[LOAD_NET] = "net",
+};
+
+struct stamps {
+	uint32_t edge;		/* edge timer expiry */
+	uint32_t isr;		/* button callback */
+	uint32_t seq;		/* edge number, from 1 */
+};
+
+static const struct irq_latency_cfg *cfg;
+static bool running;
+static atomic_t active = ATOMIC_INIT(-1);
+/* The edge the runner waits for, 0 once it is recorded or given up on */
+static atomic_t armed_seq;
+static int level;
+static uint32_t jitter_state = 1;
+
+/* The edge in flight, for the hand-offs that carry no data */
+static struct stamps last;
+
+/* Per run, in ns */
+static uint32_t isr_lat[IRQ_LATENCY_MAX_EDGES];
+static uint32_t handler_lat[IRQ_LATENCY_MAX_EDGES];
+static uint32_t recorded;
+
+static K_SEM_DEFINE(edge_sem, 0, 1);
+static K_MSGQ_DEFINE(edge_msgq, sizeof(struct stamps), 4, 4);
+static struct k_poll_signal edge_signal;
+static K_SEM_DEFINE(recorded_sem, 0, 1);
+
+static void edge_work_handler(struct k_work *work);
+static K_WORK_DEFINE(edge_work, edge_work_handler);
+
+static void edge_timer_expiry(struct k_timer *timer);
+static K_TIMER_DEFINE(edge_timer, edge_timer_expiry, NULL);
+
+static K_THREAD_STACK_DEFINE(receiver_stack, RECEIVER_STACK_SIZE);
+static struct k_thread receiver_thread;
+
+static K_THREAD_STACK_DEFINE(cpu_stack, CPU_STACK_SIZE);
+static struct k_thread cpu_thread;
+static atomic_t cpu_on;
+static K_SEM_DEFINE(cpu_gate, 0, 1);
+static bool cpu_started;
+
+static uint32_t stamp(void)
+{
+#ifdef CONFIG_ARCH_POSIX
+	return (uint32_t)host_clock_ns();
+#else
+	return k_cycle_get_32();
+#endif
+}
+
+static uint32_t stamp_to_ns(uint32_t stamps)
+{
+#ifdef CONFIG_ARCH_POSIX
+	return stamps;
+#else
+	return k_cyc_to_ns_floor64(stamps);
+#endif
+}
+
+/* xorshift32, enough to spread the gaps */
+static uint32_t jitter(uint32_t max)
+{
+	jitter_state ^= jitter_state << 13;
+	jitter_state ^= jitter_state >> 17;
+	jitter_state ^= jitter_state << 5;
+
+	return jitter_state % (max + 1);
+}
+
+static void record(const struct stamps *s, uint32_t now)
+{
+	/* A late edge was counted as missed, it must not end the next wait */
+	if (!atomic_cas(&armed_seq, s->seq, 0)) {
+		return;
+	}
+
+	if (recorded < IRQ_LATENCY_MAX_EDGES) {
+		isr_lat[recorded] = stamp_to_ns(s->isr - s->edge);
+		handler_lat[recorded] = stamp_to_ns(now - s->isr);
+		recorded++;
+	}
+
+	k_sem_give(&recorded_sem);
+}
+
+bool irq_latency_active(void)
+{
+	return running;
+}
+
+void irq_latency_isr(void)
+{
+	last.isr = stamp();
+
+	switch (atomic_get(&active)) {
+	case HANDOFF_SEM:
+		k_sem_give(&edge_sem);
+		break;
+	case HANDOFF_WORK:
+		k_work_submit(&edge_work);
+		break;
+	case HANDOFF_MSGQ:
+		k_msgq_put(&edge_msgq, &last, K_NO_WAIT);
+		break;
+	case HANDOFF_POLL:
+		k_poll_signal_raise(&edge_signal, 0);
+		break;
+	default:
+		break;
+	}
+}
+
+static void edge_timer_expiry(struct k_timer *timer)
+{
+	ARG_UNUSED(timer);
+
+	level = !level;
+	last.seq = atomic_get(&armed_seq);
+	last.edge = stamp();
+	cfg->drive(level);
+}
+
+static void edge_work_handler(struct k_work *work)
+{
+	ARG_UNUSED(work);
+
+	record(&last, stamp());
+}
+
+static void receiver(void *p1, void *p2, void *p3)
+{
+	enum handoff handoff = POINTER_TO_INT(p1);
+	struct k_poll_event event = K_POLL_EVENT_INITIALIZER(
+		K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY, &edge_signal);
+	struct stamps s;
+	uint32_t now;
+
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	for (;;) {
+		switch (handoff) {
+		case HANDOFF_SEM:
+			k_sem_take(&edge_sem, K_FOREVER);
+			record(&last, stamp());
+			break;
+		case HANDOFF_MSGQ:
+			k_msgq_get(&edge_msgq, &s, K_FOREVER);
+			record(&s, stamp());
+			break;
+		case HANDOFF_POLL:
+			k_poll(&event, 1, K_FOREVER);
+			now = stamp();
+			k_poll_signal_reset(&edge_signal);
+			event.state = K_POLL_STATE_NOT_READY;
+			record(&last, now);
+			break;
+		default:
+			return;
+		}
+	}
+}
+
+static void cpu_load(void *p1, void *p2, void *p3)
+{
+	volatile uint32_t x = 1;
+
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	for (;;) {
+		while (!atomic_get(&cpu_on)) {
+			k_sem_take(&cpu_gate, K_FOREVER);
+		}
+
+		for (int i = 0; i < CPU_SPIN; i++) {
+			x = x * 1103515245U + 12345U;
+		}
+		k_busy_wait(CPU_BUSY_US);
+	}
+}
+
+#ifdef CONFIG_NET_SOCKETS
+static K_THREAD_STACK_DEFINE(net_flood_stack, NET_STACK_SIZE);
+static K_THREAD_STACK_DEFINE(net_sink_stack, NET_STACK_SIZE);
+static struct k_thread net_flood_thread;
+static struct k_thread net_sink_thread;
+static atomic_t net_on;
+static K_SEM_DEFINE(net_gate, 0, 1);
+static bool net_started;
+static uint32_t net_sent;
+
+static void net_sink(void *p1, void *p2, void *p3)
+{
+	struct sockaddr_in6 addr = {
+		.sin6_family = AF_INET6,
+		.sin6_port = htons(NET_PORT),
+		.sin6_addr = IN6ADDR_ANY_INIT,
+	};
+	static uint8_t buf[NET_SIZE];
+	int sock;
+
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	sock = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock < 0 ||
+	    bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		printk("latency net sink: socket failed: %d\n", errno);
+		return;
+	}
+
+	for (;;) {
+		recv(sock, buf, sizeof(buf), 0);
+	}
+}
+
+static void net_flood(void *p1, void *p2, void *p3)
+{
+	struct sockaddr_in6 dst = {
+		.sin6_family = AF_INET6,
+		.sin6_port = htons(NET_PORT),
+		.sin6_addr = IN6ADDR_LOOPBACK_INIT,
+	};
+	static uint8_t buf[NET_SIZE];
+	int sock;
+
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	sock = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock < 0) {
+		printk("latency net flood: socket failed: %d\n", errno);
+		return;
+	}
+
+	for (;;) {
+		while (!atomic_get(&net_on)) {
+			k_sem_take(&net_gate, K_FOREVER);
+		}
+
+		for (int i = 0; i < NET_BURST; i++) {
+			if (sendto(sock, buf, sizeof(buf), 0,
+				   (struct sockaddr *)&dst, sizeof(dst)) < 0) {
+				break;
+			}
+			net_sent++;
+		}
+		k_busy_wait(NET_BUSY_US);
+	}
+}
+#endif /* CONFIG_NET_SOCKETS */
+
+static void load_set(enum load load, bool on)
+{
+	if (load == LOAD_CPU) {
+		if (!cpu_started) {
+			k_thread_create(&cpu_thread, cpu_stack,
+					K_THREAD_STACK_SIZEOF(cpu_stack),
+					cpu_load, NULL, NULL, NULL, LOAD_PRIO,
+					0, K_NO_WAIT);
+			cpu_started = true;
+		}
+		atomic_set(&cpu_on, on);
+		if (on) {
+			k_sem_give(&cpu_gate);
+		}
+	}
+
+#ifdef CONFIG_NET_SOCKETS
+	if (load == LOAD_NET) {
+		if (!net_started) {
+			k_thread_create(&net_sink_thread, net_sink_stack,
+					K_THREAD_STACK_SIZEOF(net_sink_stack),
+					net_sink, NULL, NULL, NULL, LOAD_PRIO,
+					0, K_NO_WAIT);
+			k_thread_create(&net_flood_thread, net_flood_stack,
+					K_THREAD_STACK_SIZEOF(net_flood_stack),
+					net_flood, NULL, NULL, NULL, LOAD_PRIO,
+					0, K_NO_WAIT);
+			net_started = true;
+		}
+		atomic_set(&net_on, on);
+		if (on) {
+			net_sent = 0;
+			k_sem_give(&net_gate);
+		}
+	}
+#endif
+}
+
+static void sort_u32(uint32_t *v, size_t n)
+{
+	for (size_t i = 1; i < n; i++) {
+		uint32_t x = v[i];
+		size_t j;
+
+		for (j = i; j > 0 && v[j - 1] > x; j--) {
+			v[j] = v[j - 1];
+		}
+		v[j] = x;
+	}
+}
+
+static uint32_t percentile(const uint32_t *v, size_t n, uint32_t pct)
+{
+	return n > 0 ? v[MIN(n - 1, n * pct / 100)] : 0;
+}
+
+static void report(enum handoff handoff, enum load load, uint32_t missed)
+{
+	static const char *const bins[HIST_BINS] = {
+		"<1", "<2", "<4", "<8", "<16", "<32", "<64", "<128", "<256",
+		"<512", ">=512",
+	};
+	uint32_t hist[HIST_BINS] = { 0 };
+	size_t n = recorded;
+
+	for (size_t i = 0; i < n; i++) {
+		uint32_t us = handler_lat[i] / NSEC_PER_USEC;
+		int bin = us == 0 ? 0 : 32 - __builtin_clz(us);
+
+		hist[MIN(bin, HIST_BINS - 1)]++;
+	}
+
+	sort_u32(isr_lat, n);
+	sort_u32(handler_lat, n);
+
+	printk("%s %s: timer->isr p50 %u max %u ns, isr->%s min %u "
+	       "p50 %u p99 %u max %u ns, %u missed\n",
+	       handoff_names[handoff], load_names[load],
+	       percentile(isr_lat, n, 50), n ? isr_lat[n - 1] : 0,
+	       handoff == HANDOFF_WORK ? "work" : "thread",
+	       n ? handler_lat[0] : 0, percentile(handler_lat, n, 50),
+	       percentile(handler_lat, n, 99), n ? handler_lat[n - 1] : 0,
+	       missed);
+
+	printk("%s %s: us", handoff_names[handoff], load_names[load]);
+	for (int i = 0; i < HIST_BINS; i++) {
+		printk(" %s:%u", bins[i], hist[i]);
+	}
+	printk("\n");
+}
+
+static void run_one(enum handoff handoff, enum load load)
+{
+	uint32_t missed = 0;
+
+	recorded = 0;
+	k_sem_reset(&edge_sem);
+	k_msgq_purge(&edge_msgq);
+	k_poll_signal_reset(&edge_signal);
+
+	if (handoff != HANDOFF_WORK) {
+		k_thread_create(&receiver_thread, receiver_stack,
+				K_THREAD_STACK_SIZEOF(receiver_stack),
+				receiver, INT_TO_POINTER(handoff), NULL, NULL,
+				RECEIVER_PRIO, 0, K_NO_WAIT);
+	}
+
+	atomic_set(&active, handoff);
+
+	for (uint16_t i = 0; i < cfg->edges; i++) {
+		uint32_t gap = cfg->gap_us + jitter(cfg->gap_us);
+
+		k_sem_reset(&recorded_sem);
+		atomic_set(&armed_seq, i + 1);
+		k_timer_start(&edge_timer, K_USEC(gap), K_NO_WAIT);
+		if (k_sem_take(&recorded_sem,
+			       K_USEC(gap + EDGE_TIMEOUT_MS * USEC_PER_MSEC)) &&
+		    atomic_cas(&armed_seq, i + 1, 0)) {
+			missed++;
+		}
+	}
+
+	atomic_set(&active, -1);
+
+	if (handoff != HANDOFF_WORK) {
+		k_thread_abort(&receiver_thread);
+	} else {
+		struct k_work_sync sync;
+
+		k_work_cancel_sync(&edge_work, &sync);
+	}
+
+	report(handoff, load, missed);
+}
+
+int irq_latency_run(const struct irq_latency_cfg *new_cfg)
+{
+	if (new_cfg->drive == NULL || new_cfg->edges == 0 ||
+	    new_cfg->edges > IRQ_LATENCY_MAX_EDGES) {
+		return -EINVAL;
+	}
+
+	cfg = new_cfg;
+	running = true;
+	k_poll_signal_init(&edge_signal);
+
+	/* A known level, so that every expiry makes an edge */
+	level = 0;
+	cfg->drive(level);
+
+#ifdef CONFIG_ARCH_POSIX
+	printk("irq latency: %u edges per run, %u to %u us apart, "
+	       "host clock\n", cfg->edges, cfg->gap_us, 2 * cfg->gap_us);
+#else
+	printk("irq latency: %u edges per run, %u to %u us apart, "
+	       "cycle counter at %u Hz\n", cfg->edges, cfg->gap_us,
+	       2 * cfg->gap_us, (uint32_t)sys_clock_hw_cycles_per_sec());
+#endif
+
+	for (int load = 0; load < LOAD_COUNT; load++) {
+		if (load == LOAD_NET && !IS_ENABLED(CONFIG_NET_SOCKETS)) {
+			continue;
+		}
+
+		load_set(load, true);
+		for (int handoff = 0; handoff < HANDOFF_COUNT; handoff++) {
+			run_one(handoff, load);
+		}
+		load_set(load, false);
+
+#ifdef CONFIG_NET_SOCKETS
+		if (load == LOAD_NET) {
+			printk("net load: %u datagrams of %u B\n", net_sent,
+			       NET_SIZE);
+		}
+#endif
+	}
+
+	running = false;
+	printk("latency harness done\n");
+
+	return 0;
+}
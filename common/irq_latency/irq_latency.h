@@ -0,0 +1,55 @@
+/*
+ * Interrupt-to-thread latency harness for the button samples.
+ *
+ * irq_latency_run() toggles the button's input from a timer, through the
+ * sample's drive function: the native_sim GPIO emulator, or an output pin
+ * wired back to the button pin on hardware. The button's GPIO callback
+ * calls irq_latency_isr() first thing, which stamps the edge and hands it
+ * to a waiting thread or handler by one of:
+ *
+ *   k_sem     a thread blocked in k_sem_take()
+ *   k_work    a work item on the system work queue
+ *   k_msgq    a thread blocked in k_msgq_get(), the stamps in the message
+ *   k_poll    a thread blocked in k_poll() on a k_poll_signal
+ *
+ * Every hand-off runs idle, under a CPU hog and, with CONFIG_NET_SOCKETS
+ * and a loopback interface, under a UDP flood. Each run prints the
+ * timer-to-ISR and ISR-to-handler latencies (minimum, median, 99th
+ * percentile, maximum) and a histogram of the latter in power-of-two
+ * microsecond bins.
+ *
+ * Stamps come from the host clock on native_sim, where simulated time and
+ * the cycle counter stand still while code runs, and from the cycle
+ * counter elsewhere. The hand-offs need CONFIG_POLL.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef IRQ_LATENCY_H_
+#define IRQ_LATENCY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Edges stored per run, for the percentiles */
+#define IRQ_LATENCY_MAX_EDGES 1000
+
+/* Sets the button's input level, from the edge timer's expiry function */
+typedef int (*irq_latency_drive_t)(int level);
+
+struct irq_latency_cfg {
+	irq_latency_drive_t drive;
+	uint16_t edges;		/* per hand-off and load */
+	uint16_t gap_us;	/* between edges, plus up to as much again */
+};
+
+/* True while a run owns the button's callback */
+bool irq_latency_active(void);
+
+/* From the button's GPIO callback, before anything else */
+void irq_latency_isr(void);
+
+/* Every hand-off under every load, then prints "latency harness done" */
+int irq_latency_run(const struct irq_latency_cfg *cfg);
+
+#endif /* IRQ_LATENCY_H_ */
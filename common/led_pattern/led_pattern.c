@@ -0,0 +1,426 @@
+/*
+ * LED patterns, see led_pattern.h
+ *
+ * Each LED walks its pattern one phase at a time: the on and off parts of
+ * a period, or a whole step at once when the step is solid. Phase ends
+ * are absolute deadlines in ticks, each the previous one plus the phase,
+ * so a late expiry does not shift the edges after it. The timer expiry
+ * catches every LED up to the current tick and re-arms the timer for the
+ * earliest deadline left.
+ *
+ * Nothing touches the hardware under the spinlock: the expiry, play and
+ * stop only mark the LEDs whose level changed, and apply_work sets them
+ * from the system work queue, where GPIO expander and PWM drivers on I2C
+ * or SPI may sleep. The work runs on one queue only, so the levels are set
+ * in order and the last one set is always the latest.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+
+#include "led_pattern.h"
+
+struct led_state {
+	const struct gpio_dt_spec *gpio;
+#ifdef CONFIG_PWM
+	const struct pwm_dt_spec *pwm;
+#endif
+	const struct led_pattern *pattern;
+	int64_t deadline;	/* ticks, end of the current phase */
+	uint8_t step;
+	uint8_t period;		/* periods of the step played */
+	uint8_t round;		/* tables played */
+	bool on;
+	bool timed;		/* has a deadline */
+	bool hw;		/* played by the PWM hardware */
+};
+
+BUILD_ASSERT(LED_PATTERN_MAX_LEDS <= 32, "LEDs are tracked in 32 bits");
+
+static struct led_state leds[LED_PATTERN_MAX_LEDS];
+static uint8_t led_count;
+static struct k_spinlock lock;
+static struct led_pattern_stats stats;
+static led_pattern_edge_cb_t edge_cb;
+static uint32_t dirty;		/* LEDs whose level apply_work is to set */
+static uint32_t edges;		/* of those, switched by the timer */
+
+static void timer_expiry(struct k_timer *timer);
+static K_TIMER_DEFINE(timer, timer_expiry, NULL);
+
+static void apply_work_handler(struct k_work *work);
+static K_WORK_DEFINE(apply_work, apply_work_handler);
+
+static uint32_t on_ms(const struct led_pattern_step *st)
+{
+	return (uint32_t)st->period_ms * MIN(st->duty, 100) / 100;
+}
+
+static bool solid(const struct led_pattern_step *st)
+{
+	uint32_t on = on_ms(st);
+
+	return on == 0 || on == st->period_ms;
+}
+
+/* From apply_work only, the driver may sleep */
+static void set_level(struct led_state *s, bool on)
+{
+#ifdef CONFIG_PWM
+	if (s->pwm != NULL) {
+		pwm_set_dt(s->pwm, s->pwm->period, on ? s->pwm->period : 0);
+		return;
+	}
+#endif
+	gpio_pin_set_dt(s->gpio, on);
+}
+
+/* First phase of the current step, returns its length in ms */
+static uint32_t enter_step(struct led_state *s)
+{
+	const struct led_pattern_step *st = &s->pattern->steps[s->step];
+	uint8_t repeat = MAX(st->repeat, 1);
+
+	if (solid(st)) {
+		/* The whole step in one phase */
+		s->on = on_ms(st) > 0;
+		s->period = repeat - 1;
+
+		return (uint32_t)st->period_ms * repeat;
+	}
+
+	s->on = true;
+	s->period = 0;
+
+	return on_ms(st);
+}
+
+/* Next phase, returns its length in ms or 0 once the pattern is over */
+static uint32_t next_phase(struct led_state *s)
+{
+	const struct led_pattern_step *st = &s->pattern->steps[s->step];
+
+	if (!solid(st)) {
+		if (s->on) {
+			s->on = false;
+			return st->period_ms - on_ms(st);
+		}
+		if (++s->period < MAX(st->repeat, 1)) {
+			s->on = true;
+			return on_ms(st);
+		}
+	}
+
+	if (++s->step == s->pattern->count) {
+		s->step = 0;
+		if (s->pattern->repeat != 0 &&
+		    ++s->round >= s->pattern->repeat) {
+			s->on = false;
+			return 0;
+		}
+	}
+
+	return enter_step(s);
+}
+
+static void rearm(void)
+{
+	int64_t first = INT64_MAX;
+
+	for (int i = 0; i < led_count; i++) {
+		if (leds[i].timed) {
+			first = MIN(first, leds[i].deadline);
+		}
+	}
+
+	if (first == INT64_MAX) {
+		k_timer_stop(&timer);
+	} else {
+		k_timer_start(&timer, K_TIMEOUT_ABS_TICKS(first), K_NO_WAIT);
+	}
+}
+
+static void timer_expiry(struct k_timer *t)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	int64_t now = k_uptime_ticks();
+	uint32_t switched = 0;
+
+	ARG_UNUSED(t);
+
+	stats.wakeups++;
+
+	for (int i = 0; i < led_count; i++) {
+		struct led_state *s = &leds[i];
+		bool was_on = s->on;
+
+		while (s->timed && s->deadline <= now) {
+			uint32_t ms = next_phase(s);
+
+			if (ms == 0) {
+				s->timed = false;
+			} else {
+				s->deadline += k_ms_to_ticks_ceil64(ms);
+			}
+		}
+
+		if (s->on != was_on) {
+			stats.edges++;
+			switched |= BIT(i);
+		}
+	}
+
+	dirty |= switched;
+	edges |= switched;
+	rearm();
+	k_spin_unlock(&lock, key);
+
+	if (switched != 0) {
+		k_work_submit(&apply_work);
+	}
+}
+
+/* From the first step, for the timer; under the lock */
+static void start_timed(struct led_state *s)
+{
+	const struct led_pattern *pattern = s->pattern;
+	uint32_t ms;
+
+	s->step = 0;
+	s->round = 0;
+	ms = enter_step(s);
+	s->deadline = k_uptime_ticks() + k_ms_to_ticks_ceil64(ms);
+
+	/* A solid table forever never changes */
+	s->timed = !(pattern->count == 1 && pattern->repeat == 0 &&
+		     solid(&pattern->steps[0]));
+}
+
+#ifdef CONFIG_PWM
+/* A single step forever, in hardware if the period fits */
+static bool hw_pattern(const struct led_state *s,
+		       const struct led_pattern *pattern)
+{
+	return s->pwm != NULL && pattern->count == 1 && pattern->repeat == 0 &&
+	       !solid(&pattern->steps[0]);
+}
+
+static void play_pwm(int led, const struct led_pattern *pattern)
+{
+	const struct led_pattern_step *st = &pattern->steps[0];
+	struct led_state *s = &leds[led];
+	k_spinlock_key_t key;
+	int r;
+
+	r = pwm_set_dt(s->pwm, PWM_MSEC(st->period_ms), PWM_MSEC(on_ms(st)));
+
+	/* Unless played or stopped since, then apply_work comes again */
+	key = k_spin_lock(&lock);
+	if (s->hw && s->pattern == pattern && r == 0) {
+		stats.hw_patterns++;
+	} else if (s->hw && s->pattern == pattern) {
+		/* Out of the hardware's range, the timer plays it */
+		s->hw = false;
+		start_timed(s);
+		dirty |= BIT(led);
+		rearm();
+	}
+	k_spin_unlock(&lock, key);
+
+	if (r < 0) {
+		k_work_submit(&apply_work);
+	}
+}
+#endif
+
+static void apply_work_handler(struct k_work *work)
+{
+#ifdef CONFIG_PWM
+	const struct led_pattern *hw[LED_PATTERN_MAX_LEDS] = { 0 };
+#endif
+	led_pattern_edge_cb_t cb;
+	uint32_t apply, switched, on = 0;
+	k_spinlock_key_t key;
+
+	ARG_UNUSED(work);
+
+	key = k_spin_lock(&lock);
+	apply = dirty;
+	switched = edges;
+	dirty = 0;
+	edges = 0;
+	for (int i = 0; i < led_count; i++) {
+		on |= leds[i].on ? BIT(i) : 0;
+#ifdef CONFIG_PWM
+		hw[i] = leds[i].hw ? leds[i].pattern : NULL;
+#endif
+	}
+	cb = edge_cb;
+	k_spin_unlock(&lock, key);
+
+	for (int i = 0; i < led_count; i++) {
+		if (!(apply & BIT(i))) {
+			continue;
+		}
+#ifdef CONFIG_PWM
+		if (hw[i] != NULL) {
+			play_pwm(i, hw[i]);
+			continue;
+		}
+#endif
+		set_level(&leds[i], on & BIT(i));
+	}
+
+	for (int i = 0; cb != NULL && i < led_count; i++) {
+		if (switched & BIT(i)) {
+			cb(i, on & BIT(i));
+		}
+	}
+}
+
+static int add_led(struct led_state **s)
+{
+	if (led_count == LED_PATTERN_MAX_LEDS) {
+		return -ENOSPC;
+	}
+
+	if (led_count == 0) {
+		stats.since_ms = k_uptime_get();
+		stats.ram_bytes = sizeof(leds) + sizeof(led_count) +
+				  sizeof(lock) + sizeof(stats) +
+				  sizeof(edge_cb) + sizeof(dirty) +
+				  sizeof(edges) + sizeof(timer) +
+				  sizeof(apply_work);
+	}
+
+	*s = &leds[led_count];
+
+	return 0;
+}
+
+int led_pattern_add_gpio(const struct gpio_dt_spec *spec)
+{
+	struct led_state *s;
+	int r;
+
+	if (!gpio_is_ready_dt(spec)) {
+		return -ENODEV;
+	}
+
+	r = add_led(&s);
+	if (r < 0) {
+		return r;
+	}
+
+	r = gpio_pin_configure_dt(spec, GPIO_OUTPUT_INACTIVE);
+	if (r < 0) {
+		return r;
+	}
+
+	s->gpio = spec;
+
+	return led_count++;
+}
+
+#ifdef CONFIG_PWM
+int led_pattern_add_pwm(const struct pwm_dt_spec *spec)
+{
+	struct led_state *s;
+	int r;
+
+	if (!device_is_ready(spec->dev)) {
+		return -ENODEV;
+	}
+
+	r = add_led(&s);
+	if (r < 0) {
+		return r;
+	}
+
+	r = pwm_set_dt(spec, spec->period, 0);
+	if (r < 0) {
+		return r;
+	}
+
+	s->pwm = spec;
+
+	return led_count++;
+}
+#endif
+
+int led_pattern_play(int led, const struct led_pattern *pattern)
+{
+	struct led_state *s;
+	k_spinlock_key_t key;
+
+	if (led < 0 || led >= led_count || pattern->count == 0) {
+		return -EINVAL;
+	}
+
+	for (int i = 0; i < pattern->count; i++) {
+		if (pattern->steps[i].period_ms == 0) {
+			return -EINVAL;
+		}
+	}
+
+	s = &leds[led];
+
+	key = k_spin_lock(&lock);
+
+	s->pattern = pattern;
+#ifdef CONFIG_PWM
+	s->hw = hw_pattern(s, pattern);
+#endif
+	if (s->hw) {
+		/* Off the timer, apply_work hands it to the PWM hardware */
+		s->timed = false;
+	} else {
+		start_timed(s);
+	}
+	dirty |= BIT(led);
+
+	rearm();
+	k_spin_unlock(&lock, key);
+
+	k_work_submit(&apply_work);
+
+	return 0;
+}
+
+int led_pattern_stop(int led)
+{
+	k_spinlock_key_t key;
+
+	if (led < 0 || led >= led_count) {
+		return -EINVAL;
+	}
+
+	key = k_spin_lock(&lock);
+	leds[led].timed = false;
+	leds[led].hw = false;
+	leds[led].on = false;
+	dirty |= BIT(led);
+	rearm();
+	k_spin_unlock(&lock, key);
+
+	k_work_submit(&apply_work);
+
+	return 0;
+}
+
+void led_pattern_set_edge_cb(led_pattern_edge_cb_t cb)
+{
+	edge_cb = cb;
+}
+
+void led_pattern_get_stats(struct led_pattern_stats *out)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	*out = stats;
+	k_spin_unlock(&lock, key);
+}
@@ -0,0 +1,95 @@
+/*
+ * LED patterns from one kernel timer, or from PWM.
+ *
+ * A pattern is a constant table of steps, each a period, the share of it
+ * the LED is on and how many periods to play, and the table repeats a
+ * given number of times or forever. Every GPIO LED shares a single
+ * k_timer that is armed for the next edge of any of them and stopped when
+ * none is due, so an LED that stays on or off costs no wake-ups at all.
+ * The timer's expiry function only works out the edges; they are set, and
+ * the edge callback called, from one work item on the system work queue,
+ * so LEDs behind GPIO expanders or PWM controllers on I2C or SPI work too.
+ * There is no thread and no stack of its own.
+ *
+ * A PWM LED playing a single step forever is handed to the PWM hardware
+ * and then costs nothing either; if the period is out of the hardware's
+ * range, or the pattern has more steps, the timer switches it fully on and
+ * off like a GPIO LED.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef LED_PATTERN_H_
+#define LED_PATTERN_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zephyr/drivers/gpio.h>
+#ifdef CONFIG_PWM
+#include <zephyr/drivers/pwm.h>
+#endif
+#include <zephyr/sys/util.h>
+
+#define LED_PATTERN_MAX_LEDS 4
+
+struct led_pattern_step {
+	uint16_t period_ms;	/* at least 1 */
+	uint8_t duty;		/* percent on, 0 and 100 for solid */
+	uint8_t repeat;		/* periods, at least 1 */
+};
+
+struct led_pattern {
+	const struct led_pattern_step *steps;
+	uint8_t count;
+	uint8_t repeat;		/* whole tables, 0 for forever */
+};
+
+/*
+ * A constant pattern, e.g. two short flashes every two seconds:
+ *
+ *   LED_PATTERN_DEFINE(flash2, 0, { 200, 25, 2 }, { 1600, 0, 1 });
+ */
+#define LED_PATTERN_DEFINE(_name, _repeat, ...)				\
+	static const struct led_pattern_step _name##_steps[] = {	\
+		__VA_ARGS__						\
+	};								\
+	static const struct led_pattern _name = {			\
+		.steps = _name##_steps,					\
+		.count = ARRAY_SIZE(_name##_steps),			\
+		.repeat = _repeat,					\
+	}
+
+/* Called from the system work queue, after the LED was switched */
+typedef void (*led_pattern_edge_cb_t)(int led, bool on);
+
+struct led_pattern_stats {
+	uint32_t wakeups;	/* timer expiries */
+	uint32_t edges;		/* LED switched on or off by the timer */
+	uint32_t hw_patterns;	/* patterns handed to the PWM hardware */
+	uint32_t ram_bytes;	/* the engine's static state */
+	int64_t since_ms;	/* uptime of the first LED added */
+};
+
+/* Both return the LED's number, or -ENODEV, -ENOSPC or the driver error */
+int led_pattern_add_gpio(const struct gpio_dt_spec *spec);
+#ifdef CONFIG_PWM
+int led_pattern_add_pwm(const struct pwm_dt_spec *spec);
+#endif
+
+/*
+ * Starts over from the first step; the LED is left off when it ends.
+ * This and led_pattern_stop() may be called from interrupts, the LED
+ * switches once the system work queue gets to it.
+ */
+int led_pattern_play(int led, const struct led_pattern *pattern);
+
+/* Off, until the next led_pattern_play() */
+int led_pattern_stop(int led);
+
+/* One callback for every LED, NULL for none */
+void led_pattern_set_edge_cb(led_pattern_edge_cb_t cb);
+
+void led_pattern_get_stats(struct led_pattern_stats *stats);
+
+#endif /* LED_PATTERN_H_ */
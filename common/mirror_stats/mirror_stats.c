@@ -0,0 +1,111 @@
+/*
+ * LED mirroring counters, see mirror_stats.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <inttypes.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#include "mirror_stats.h"
+
+struct mirror_stats {
+	uint32_t wakeups;	/* poll iterations or edge callbacks */
+	uint32_t edges;		/* button edges, with or without an LED */
+	uint32_t mirrored;	/* of those, mirrored onto the LED */
+	uint32_t lat_min;	/* callback-to-LED latency, in cycles */
+	uint32_t lat_max;
+	uint64_t lat_sum;
+};
+
+static struct mirror_stats stats = {
+	.lat_min = UINT32_MAX,
+};
+
+/* Written by the callback, read by the polling loop */
+static atomic_t edge_cycles;
+
+/* The callback updates the counters while a report reads them */
+static struct k_spinlock lock;
+
+void mirror_stats_edge(void)
+{
+	k_spinlock_key_t key;
+
+	atomic_set(&edge_cycles, k_cycle_get_32());
+
+	key = k_spin_lock(&lock);
+	stats.edges++;
+	k_spin_unlock(&lock, key);
+}
+
+void mirror_stats_wakeup(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	stats.wakeups++;
+	k_spin_unlock(&lock, key);
+}
+
+void mirror_stats_mirrored(void)
+{
+	uint32_t lat = k_cycle_get_32() - (uint32_t)atomic_get(&edge_cycles);
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	stats.mirrored++;
+	stats.lat_min = MIN(stats.lat_min, lat);
+	stats.lat_max = MAX(stats.lat_max, lat);
+	stats.lat_sum += lat;
+	k_spin_unlock(&lock, key);
+}
+
+uint32_t mirror_stats_last_edge(void)
+{
+	return (uint32_t)atomic_get(&edge_cycles);
+}
+
+static unsigned int idle_percent(void)
+{
+	unsigned int idle_pct = 0;
+
+#ifdef CONFIG_SCHED_THREAD_USAGE_ALL
+	static uint64_t last_idle, last_total;
+	k_thread_runtime_stats_t rt;
+
+	if (k_thread_runtime_stats_all_get(&rt) == 0) {
+		/* execution_cycles already counts the idle time */
+		uint64_t total = rt.execution_cycles;
+
+		if (total > last_total) {
+			idle_pct = (unsigned int)((rt.idle_cycles - last_idle) *
+						  100U / (total - last_total));
+		}
+		last_idle = rt.idle_cycles;
+		last_total = total;
+	}
+#endif
+
+	return idle_pct;
+}
+
+void mirror_stats_report(const char *mode, uint32_t interval_ms)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct mirror_stats s = stats;
+
+	stats = (struct mirror_stats){ .lat_min = UINT32_MAX };
+	k_spin_unlock(&lock, key);
+
+	/* A count per interval: a rate in whole wake-ups/s rounds idle to 0 */
+	printk("%s: %" PRIu32 " wake-ups in %" PRIu32 " ms, %" PRIu32
+	       " edges, %" PRIu32 " mirrored, callback->LED min/avg/max %"
+	       PRIu32 "/%" PRIu32 "/%" PRIu32 " us, idle %u%%\n",
+	       mode, s.wakeups, interval_ms, s.edges, s.mirrored,
+	       s.mirrored ? k_cyc_to_us_floor32(s.lat_min) : 0,
+	       s.mirrored ?
+	       k_cyc_to_us_floor32((uint32_t)(s.lat_sum / s.mirrored)) : 0,
+	       k_cyc_to_us_floor32(s.lat_max), idle_percent());
+}
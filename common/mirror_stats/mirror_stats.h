@@ -0,0 +1,38 @@
+/*
+ * Wake-up and latency counters for the button samples' LED mirroring.
+ *
+ * The button callback stamps every edge with the cycle counter. Once the
+ * LED has been set to match, from the callback or from a polling loop,
+ * the time since that stamp is recorded. The stamp is taken inside the
+ * callback, so the interrupt entry and the GPIO driver's dispatch are not
+ * part of it: the figure is callback-to-LED, not press-to-LED. The
+ * irq_latency harness measures the part before the callback.
+ *
+ * Every report prints the wake-ups and edges of the interval, the
+ * callback-to-LED latencies and, with CONFIG_SCHED_THREAD_USAGE_ALL, the
+ * idle residency, then starts a new interval.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MIRROR_STATS_H_
+#define MIRROR_STATS_H_
+
+#include <stdint.h>
+
+/* From the button callback, first thing, whether there is an LED or not */
+void mirror_stats_edge(void);
+
+/* A poll iteration, or an edge callback that set the LED */
+void mirror_stats_wakeup(void);
+
+/* The LED now matches the last edge */
+void mirror_stats_mirrored(void);
+
+/* Cycle stamp of the last edge */
+uint32_t mirror_stats_last_edge(void);
+
+/* One line on the console, mode being "irq" or "poll" */
+void mirror_stats_report(const char *mode, uint32_t interval_ms);
+
+#endif /* MIRROR_STATS_H_ */
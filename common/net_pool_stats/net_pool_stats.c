@@ -0,0 +1,228 @@
+/*
+ * Network pool usage, see net_pool_stats.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/net/buf.h>
+#include <zephyr/net/net_pkt.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#include "net_pool_stats.h"
+
+static struct net_pool_stat stats[NET_POOLS] = {
+	[NET_POOL_RX_PKTS] = { .name = "RX pkts" },
+	[NET_POOL_TX_PKTS] = { .name = "TX pkts" },
+	[NET_POOL_RX_BUFS] = { .name = "RX bufs" },
+	[NET_POOL_TX_BUFS] = { .name = "TX bufs" },
+};
+
+#ifdef CONFIG_MEM_SLAB_TRACE_MAX_UTILIZATION
+/* The kernel's slab peaks run from boot, a rise past these is in window */
+static uint32_t slab_peak_base[2];
+#endif
+
+static struct k_spinlock lock;
+
+static void pool_usage(uint32_t size[NET_POOLS], uint32_t used[NET_POOLS])
+{
+	struct k_mem_slab *rx, *tx;
+	struct net_buf_pool *rx_data, *tx_data;
+
+	net_pkt_get_info(&rx, &tx, &rx_data, &tx_data);
+
+	used[NET_POOL_RX_PKTS] = k_mem_slab_num_used_get(rx);
+	size[NET_POOL_RX_PKTS] = used[NET_POOL_RX_PKTS] +
+				 k_mem_slab_num_free_get(rx);
+	used[NET_POOL_TX_PKTS] = k_mem_slab_num_used_get(tx);
+	size[NET_POOL_TX_PKTS] = used[NET_POOL_TX_PKTS] +
+				 k_mem_slab_num_free_get(tx);
+
+	size[NET_POOL_RX_BUFS] = rx_data->buf_count;
+	size[NET_POOL_TX_BUFS] = tx_data->buf_count;
+#ifdef CONFIG_NET_BUF_POOL_USAGE
+	used[NET_POOL_RX_BUFS] = rx_data->buf_count -
+				 atomic_get(&rx_data->avail_count);
+	used[NET_POOL_TX_BUFS] = tx_data->buf_count -
+				 atomic_get(&tx_data->avail_count);
+#else
+	used[NET_POOL_RX_BUFS] = 0;
+	used[NET_POOL_TX_BUFS] = 0;
+#endif
+}
+
+static void slab_peaks(uint32_t peak[2])
+{
+#ifdef CONFIG_MEM_SLAB_TRACE_MAX_UTILIZATION
+	struct k_mem_slab *rx, *tx;
+	struct net_buf_pool *rx_data, *tx_data;
+
+	net_pkt_get_info(&rx, &tx, &rx_data, &tx_data);
+	peak[0] = k_mem_slab_max_used_get(rx);
+	peak[1] = k_mem_slab_max_used_get(tx);
+#else
+	peak[0] = 0;
+	peak[1] = 0;
+#endif
+}
+
+void net_pool_stats_reset(void)
+{
+	uint32_t size[NET_POOLS], used[NET_POOLS];
+	k_spinlock_key_t key;
+
+	pool_usage(size, used);
+
+	key = k_spin_lock(&lock);
+
+	for (int i = 0; i < NET_POOLS; i++) {
+		const char *name = stats[i].name;
+
+		stats[i] = (struct net_pool_stat){
+			.name = name,
+			.size = size[i],
+			.used = used[i],
+			.high_water = used[i],
+		};
+	}
+
+#ifdef CONFIG_MEM_SLAB_TRACE_MAX_UTILIZATION
+	slab_peaks(slab_peak_base);
+#endif
+
+	k_spin_unlock(&lock, key);
+}
+
+void net_pool_stats_sample(void)
+{
+	uint32_t size[NET_POOLS], used[NET_POOLS];
+	uint32_t peak[2];
+	k_spinlock_key_t key;
+
+	pool_usage(size, used);
+	slab_peaks(peak);
+
+	key = k_spin_lock(&lock);
+
+	for (int i = 0; i < NET_POOLS; i++) {
+		stats[i].size = size[i];
+		stats[i].used = used[i];
+		stats[i].high_water = MAX(stats[i].high_water, used[i]);
+	}
+
+#ifdef CONFIG_MEM_SLAB_TRACE_MAX_UTILIZATION
+	for (int i = 0; i < 2; i++) {
+		if (peak[i] > slab_peak_base[i]) {
+			stats[i].high_water = MAX(stats[i].high_water, peak[i]);
+		}
+	}
+#else
+	ARG_UNUSED(peak);
+#endif
+
+	k_spin_unlock(&lock, key);
+}
+
+/* The TX pool a send would have to wait for, or -1 */
+static int tx_exhausted(void)
+{
+	uint32_t size[NET_POOLS], used[NET_POOLS];
+
+	pool_usage(size, used);
+
+	if (used[NET_POOL_TX_PKTS] >= size[NET_POOL_TX_PKTS]) {
+		return NET_POOL_TX_PKTS;
+	}
+
+	if (IS_ENABLED(CONFIG_NET_BUF_POOL_USAGE) &&
+	    used[NET_POOL_TX_BUFS] >= size[NET_POOL_TX_BUFS]) {
+		return NET_POOL_TX_BUFS;
+	}
+
+	return -1;
+}
+
+ssize_t net_pool_stats_sendto(int sock, const void *buf, size_t len,
+			      int flags, const struct sockaddr *addr,
+			      socklen_t addrlen)
+{
+	int pool = tx_exhausted();
+	int64_t start = k_uptime_ticks();
+	ssize_t r = sendto(sock, buf, len, flags, addr, addrlen);
+	uint32_t us = k_ticks_to_us_floor32(k_uptime_ticks() - start);
+	int err = errno;
+	k_spinlock_key_t key;
+
+	if (r < 0 && pool < 0 && (err == ENOMEM || err == ENOBUFS)) {
+		pool = tx_exhausted();
+		if (pool < 0) {
+			pool = NET_POOL_TX_BUFS;
+		}
+	}
+
+	key = k_spin_lock(&lock);
+
+	if (pool >= 0) {
+		if (r < 0) {
+			stats[pool].alloc_failures++;
+		}
+		if (us > 0) {
+			stats[pool].waits++;
+			stats[pool].wait_us += us;
+			stats[pool].wait_max_us = MAX(stats[pool].wait_max_us, us);
+		}
+	}
+
+	k_spin_unlock(&lock, key);
+
+	net_pool_stats_sample();
+	errno = err;
+
+	return r;
+}
+
+void net_pool_stats_rx_lost(uint32_t count)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct net_pool_stat *pkts = &stats[NET_POOL_RX_PKTS];
+	struct net_pool_stat *bufs = &stats[NET_POOL_RX_BUFS];
+
+	/* Charged to the pool that ran dry, packets when in doubt */
+	if (pkts->high_water < pkts->size && bufs->high_water >= bufs->size) {
+		bufs->alloc_failures += count;
+	} else {
+		pkts->alloc_failures += count;
+	}
+
+	k_spin_unlock(&lock, key);
+}
+
+void net_pool_stats_get(struct net_pool_stat out[NET_POOLS])
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	for (int i = 0; i < NET_POOLS; i++) {
+		out[i] = stats[i];
+	}
+
+	k_spin_unlock(&lock, key);
+}
+
+void net_pool_stats_print(void)
+{
+	struct net_pool_stat s[NET_POOLS];
+
+	net_pool_stats_get(s);
+
+	for (int i = 0; i < NET_POOLS; i++) {
+		printk("%-8s %3u/%u used, high-water %u, %u failures, "
+		       "%u waits (%u us, max %u us)\n", s[i].name, s[i].used,
+		       s[i].size, s[i].high_water, s[i].alloc_failures,
+		       s[i].waits, s[i].wait_us, s[i].wait_max_us);
+	}
+}
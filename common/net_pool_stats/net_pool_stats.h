@@ -0,0 +1,68 @@
+/*
+ * Usage of the network packet and buffer pools.
+ *
+ * Tracks the four pools behind CONFIG_NET_PKT_RX_COUNT, _PKT_TX_COUNT,
+ * _BUF_RX_COUNT and _BUF_TX_COUNT: high-water mark, allocation failures
+ * and the time senders waited for a packet or a buffer.
+ *
+ * The stack has no allocation hooks, so:
+ *  - Slab high-water marks come from the kernel with
+ *    CONFIG_MEM_SLAB_TRACE_MAX_UTILIZATION. Buffer pool marks are sampled
+ *    by net_pool_stats_sample(), which needs CONFIG_NET_BUF_POOL_USAGE.
+ *  - TX failures and waits are seen by net_pool_stats_sendto(). They are
+ *    charged to the TX pool that was exhausted when the send started.
+ *  - RX failures show up as datagrams that never arrive. The receiver
+ *    reports them with net_pool_stats_rx_lost(), and they are charged to
+ *    the RX pool that ran out.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef NET_POOL_STATS_H_
+#define NET_POOL_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <zephyr/net/socket.h>
+
+enum net_pool {
+	NET_POOL_RX_PKTS,
+	NET_POOL_TX_PKTS,
+	NET_POOL_RX_BUFS,
+	NET_POOL_TX_BUFS,
+	NET_POOLS,
+};
+
+struct net_pool_stat {
+	const char *name;
+	uint32_t size;
+	uint32_t used;
+	uint32_t high_water;
+	uint32_t alloc_failures;
+	uint32_t waits;
+	uint32_t wait_us;
+	uint32_t wait_max_us;
+};
+
+/* Start a new window: high-water marks from the current usage */
+void net_pool_stats_reset(void);
+
+/* Sample the current usage, call it where the pools are busiest */
+void net_pool_stats_sample(void);
+
+/* sendto() that records TX failures and waits */
+ssize_t net_pool_stats_sendto(int sock, const void *buf, size_t len,
+			      int flags, const struct sockaddr *addr,
+			      socklen_t addrlen);
+
+/* Datagrams the receiver knows were lost */
+void net_pool_stats_rx_lost(uint32_t count);
+
+void net_pool_stats_get(struct net_pool_stat stats[NET_POOLS]);
+
+/* One line per pool on the console */
+void net_pool_stats_print(void);
+
+#endif /* NET_POOL_STATS_H_ */
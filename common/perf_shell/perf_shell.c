@@ -0,0 +1,358 @@
+/*
+ * "perf" shell commands, see perf_shell.h
+ *
+ * Runtime shares cover the window since the previous "perf threads" (or
+ * "perf reset"): the sample keeps the execution cycles each thread had
+ * then. A thread's time includes the interrupts that hit it, "perf isr"
+ * gives their total.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <stdio.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/sys/slist.h>
+#include <zephyr/sys/util.h>
+
+#ifdef CONFIG_NETWORKING
+#include <zephyr/net/buf.h>
+#include <zephyr/net/net_pkt.h>
+#endif
+
+#include "perf_shell.h"
+
+/* Threads whose cycles are remembered between two samples */
+#define PERF_MAX_THREADS 24
+
+struct perf_thread {
+	const struct k_thread *thread;
+	uint64_t cycles;
+};
+
+static struct {
+	int64_t start_ms;
+	struct perf_thread threads[PERF_MAX_THREADS];
+	uint8_t count;
+} window;
+
+static struct {
+	struct k_work_q *queue;
+	const char *name;
+} workqs[PERF_MAX_WORKQ];
+
+#ifdef CONFIG_TRACING_USER
+/* Interrupt time, outermost ISRs only */
+static uint32_t isr_enter;
+static uint64_t isr_cycles;
+static uint32_t isr_count;
+static int isr_depth;
+static uint64_t isr_window_cycles;
+static uint32_t isr_window_count;
+static int64_t isr_window_ms;
+
+void sys_trace_isr_enter_user(int nested_interrupts)
+{
+	ARG_UNUSED(nested_interrupts);
+
+	if (isr_depth++ == 0) {
+		isr_enter = k_cycle_get_32();
+	}
+}
+
+void sys_trace_isr_exit_user(int nested_interrupts)
+{
+	ARG_UNUSED(nested_interrupts);
+
+	if (--isr_depth == 0) {
+		isr_cycles += k_cycle_get_32() - isr_enter;
+		isr_count++;
+	}
+}
+#endif
+
+int perf_register_workq(struct k_work_q *queue, const char *name)
+{
+	for (int i = 0; i < PERF_MAX_WORKQ; i++) {
+		if (workqs[i].queue == NULL || workqs[i].queue == queue) {
+			workqs[i].queue = queue;
+			workqs[i].name = name;
+			return 0;
+		}
+	}
+
+	return -ENOMEM;
+}
+
+static uint64_t ms_to_cycles(int64_t ms)
+{
+	return MAX(k_ms_to_cyc_floor64(ms), 1);
+}
+
+/* Per mille of the window, printed as a percentage with one decimal */
+static uint32_t permille(uint64_t part, uint64_t whole)
+{
+	return MIN(part * 1000U / whole, 1000U);
+}
+
+#ifdef CONFIG_SCHED_THREAD_USAGE
+static struct perf_thread *window_thread(const struct k_thread *thread)
+{
+	for (int i = 0; i < window.count; i++) {
+		if (window.threads[i].thread == thread) {
+			return &window.threads[i];
+		}
+	}
+
+	if (window.count == PERF_MAX_THREADS) {
+		return NULL;
+	}
+
+	window.threads[window.count].thread = thread;
+	window.threads[window.count].cycles = 0;
+
+	return &window.threads[window.count++];
+}
+#endif
+
+static void thread_reset(const struct k_thread *cthread, void *user_data)
+{
+	ARG_UNUSED(user_data);
+
+#ifdef CONFIG_SCHED_THREAD_USAGE
+	struct perf_thread *prev = window_thread(cthread);
+	k_thread_runtime_stats_t stats;
+
+	if (prev && k_thread_runtime_stats_get((k_tid_t)cthread, &stats) == 0) {
+		prev->cycles = stats.execution_cycles;
+	}
+#else
+	ARG_UNUSED(cthread);
+#endif
+}
+
+struct threads_ctx {
+	const struct shell *sh;
+	uint64_t window;
+};
+
+static void thread_print(const struct k_thread *cthread, void *user_data)
+{
+	struct k_thread *thread = (struct k_thread *)cthread;
+	struct threads_ctx *ctx = user_data;
+	const char *name = k_thread_name_get(thread);
+	char share[8] = "-";
+	char stack[32] = "-";
+
+#ifdef CONFIG_SCHED_THREAD_USAGE
+	struct perf_thread *prev = window_thread(thread);
+	k_thread_runtime_stats_t stats;
+
+	if (k_thread_runtime_stats_get(thread, &stats) == 0) {
+		uint64_t cycles = stats.execution_cycles;
+		uint32_t pm = permille(prev ? cycles - prev->cycles : cycles,
+				       ctx->window);
+
+		snprintf(share, sizeof(share), "%u.%u%s", pm / 10, pm % 10,
+			 prev ? "" : "*");
+		if (prev) {
+			prev->cycles = cycles;
+		}
+	}
+#endif
+
+#if defined(CONFIG_THREAD_STACK_INFO) && defined(CONFIG_INIT_STACKS)
+	size_t size = thread->stack_info.size;
+	size_t unused;
+
+	if (k_thread_stack_space_get(thread, &unused) == 0 && size > 0) {
+		snprintf(stack, sizeof(stack), "%u/%u (%u%%)",
+			 (uint32_t)(size - unused), (uint32_t)size,
+			 (uint32_t)((size - unused) * 100U / size));
+	}
+#endif
+
+	shell_print(ctx->sh, "%-20s %4d %6s%% %s",
+		    name && name[0] ? name : "?", thread->base.prio, share,
+		    stack);
+}
+
+static int cmd_perf_threads(const struct shell *sh, size_t argc, char **argv)
+{
+	struct threads_ctx ctx = {
+		.sh = sh,
+		.window = ms_to_cycles(k_uptime_get() - window.start_ms),
+	};
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	if (!IS_ENABLED(CONFIG_THREAD_MONITOR)) {
+		shell_error(sh, "needs CONFIG_THREAD_MONITOR");
+		return -ENOTSUP;
+	}
+
+	shell_print(sh, "window %u ms", (uint32_t)(k_uptime_get() -
+						    window.start_ms));
+	shell_print(sh, "%-20s %4s %7s stack high-water/size", "thread",
+		    "prio", "cpu");
+	k_thread_foreach_unlocked(thread_print, &ctx);
+
+	if (!IS_ENABLED(CONFIG_SCHED_THREAD_USAGE)) {
+		shell_print(sh, "cpu: needs CONFIG_SCHED_THREAD_USAGE");
+	} else if (window.count == PERF_MAX_THREADS) {
+		shell_print(sh, "* since boot, more than %d threads",
+			    PERF_MAX_THREADS);
+	}
+	if (!IS_ENABLED(CONFIG_INIT_STACKS)) {
+		shell_print(sh, "stack: needs CONFIG_INIT_STACKS");
+	}
+
+	window.start_ms = k_uptime_get();
+
+	return 0;
+}
+
+static int cmd_perf_isr(const struct shell *sh, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+#ifdef CONFIG_TRACING_USER
+	unsigned int key = irq_lock();
+	uint64_t cycles = isr_cycles - isr_window_cycles;
+	uint32_t count = isr_count - isr_window_count;
+	int64_t now = k_uptime_get();
+	uint32_t pm = permille(cycles, ms_to_cycles(now - isr_window_ms));
+
+	isr_window_cycles = isr_cycles;
+	isr_window_count = isr_count;
+	irq_unlock(key);
+
+	shell_print(sh, "%u interrupts in %u ms, %u.%u%% of the CPU, "
+		    "%u ns each", count, (uint32_t)(now - isr_window_ms),
+		    pm / 10, pm % 10,
+		    count ? (uint32_t)(k_cyc_to_ns_floor64(cycles) / count) : 0);
+	isr_window_ms = now;
+
+	return 0;
+#else
+	shell_error(sh, "needs CONFIG_TRACING_USER");
+
+	return -ENOTSUP;
+#endif
+}
+
+static void workq_print(const struct shell *sh, const char *name,
+			struct k_work_q *queue)
+{
+	/* Read without the kernel's lock, a snapshot */
+	uint32_t pending = sys_slist_len(&queue->pending);
+
+	shell_print(sh, "%-16s %3u pending, thread %s", name, pending,
+		    k_thread_name_get(k_work_queue_thread_get(queue)) ?: "?");
+}
+
+static int cmd_perf_workq(const struct shell *sh, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	workq_print(sh, "sysworkq", &k_sys_work_q);
+
+	for (int i = 0; i < PERF_MAX_WORKQ && workqs[i].queue; i++) {
+		workq_print(sh, workqs[i].name, workqs[i].queue);
+	}
+
+	return 0;
+}
+
+#ifdef CONFIG_NETWORKING
+static void slab_print(const struct shell *sh, const char *name,
+		       struct k_mem_slab *slab)
+{
+	uint32_t used = k_mem_slab_num_used_get(slab);
+	uint32_t total = used + k_mem_slab_num_free_get(slab);
+
+#ifdef CONFIG_MEM_SLAB_TRACE_MAX_UTILIZATION
+	shell_print(sh, "%-8s %3u/%u used, peak %u", name, used, total,
+		    k_mem_slab_max_used_get(slab));
+#else
+	shell_print(sh, "%-8s %3u/%u used", name, used, total);
+#endif
+}
+
+static void pool_print(const struct shell *sh, const char *name,
+		       struct net_buf_pool *pool)
+{
+#ifdef CONFIG_NET_BUF_POOL_USAGE
+	uint32_t avail = atomic_get(&pool->avail_count);
+
+	shell_print(sh, "%-8s %3u/%u used", name, pool->buf_count - avail,
+		    pool->buf_count);
+#else
+	shell_print(sh, "%-8s %u buffers, usage needs CONFIG_NET_BUF_POOL_USAGE",
+		    name, pool->buf_count);
+#endif
+}
+#endif
+
+static int cmd_perf_net(const struct shell *sh, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+#ifdef CONFIG_NETWORKING
+	struct k_mem_slab *rx, *tx;
+	struct net_buf_pool *rx_data, *tx_data;
+
+	net_pkt_get_info(&rx, &tx, &rx_data, &tx_data);
+	slab_print(sh, "RX pkts", rx);
+	slab_print(sh, "TX pkts", tx);
+	pool_print(sh, "RX data", rx_data);
+	pool_print(sh, "TX data", tx_data);
+
+	return 0;
+#else
+	shell_error(sh, "no networking");
+
+	return -ENOTSUP;
+#endif
+}
+
+static int cmd_perf_reset(const struct shell *sh, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	window.count = 0;
+	window.start_ms = k_uptime_get();
+	k_thread_foreach_unlocked(thread_reset, NULL);
+
+#ifdef CONFIG_TRACING_USER
+	unsigned int key = irq_lock();
+
+	isr_window_cycles = isr_cycles;
+	isr_window_count = isr_count;
+	isr_window_ms = window.start_ms;
+	irq_unlock(key);
+#endif
+
+	shell_print(sh, "new window");
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(perf_cmds,
+	SHELL_CMD(threads, NULL, "Runtime share and stack use per thread",
+		  cmd_perf_threads),
+	SHELL_CMD(isr, NULL, "Interrupt time", cmd_perf_isr),
+	SHELL_CMD(workq, NULL, "Work queue backlog", cmd_perf_workq),
+	SHELL_CMD(net, NULL, "Network packet and buffer pools", cmd_perf_net),
+	SHELL_CMD(reset, NULL, "Start a new sampling window", cmd_perf_reset),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(perf, &perf_cmds, "CPU and RAM usage", NULL);
@@ -0,0 +1,31 @@
+/*
+ * "perf" shell commands: where the CPU time and the RAM go, sampled on
+ * demand.
+ *
+ *   perf threads   runtime share of every thread since the last sample,
+ *                  stack size, high-water mark and headroom
+ *   perf isr       time spent in interrupts since the last sample
+ *   perf workq     backlog of the system and registered work queues
+ *   perf net       network packet and buffer pool usage
+ *   perf reset     start a new sampling window
+ *
+ * Nothing runs between commands. What the counters cost:
+ *   CONFIG_SCHED_THREAD_USAGE   a cycle counter read per context switch
+ *   CONFIG_INIT_STACKS          stacks filled once when threads start
+ *   CONFIG_TRACING_USER         a cycle counter read per ISR entry and exit
+ * Commands whose options are off say so instead of printing.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef PERF_SHELL_H_
+#define PERF_SHELL_H_
+
+#include <zephyr/kernel.h>
+
+#define PERF_MAX_WORKQ 4
+
+/* Add an application work queue to "perf workq", next to the system one */
+int perf_register_workq(struct k_work_q *queue, const char *name);
+
+#endif /* PERF_SHELL_H_ */
@@ -0,0 +1,125 @@
+/*
+ * HDC2010 humidity and temperature sensor emulator, see sensor_emul.h
+ *
+ * Byte-wide registers, the pointer increments after each byte. Setting the
+ * trigger bit of the measurement configuration is one measurement, the
+ * result and the data ready status are there at once.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define DT_DRV_COMPAT ti_hdc2010
+
+#include <string.h>
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/drivers/i2c_emul.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "sensor_emul.h"
+
+#define HDC2010_REG_TEMP		0x00
+#define HDC2010_REG_HUMIDITY		0x02
+#define HDC2010_REG_DRDY		0x04
+#define HDC2010_REG_CONFIG		0x0e
+#define HDC2010_REG_MEAS_CFG		0x0f
+#define HDC2010_REG_MANUFACTURER_ID	0xfc
+#define HDC2010_REG_DEVICE_ID		0xfe
+
+#define HDC2010_DRDY_STATUS		BIT(7)
+#define HDC2010_CONFIG_SOFT_RES		BIT(7)
+#define HDC2010_MEAS_CFG_TRIG		BIT(0)
+
+#define HDC2010_MANUFACTURER_ID		0x5449
+#define HDC2010_DEVICE_ID		0x07d0
+
+struct hdc2010_emul_data {
+	struct sensor_emul_script script;
+	struct sensor_emul_reg8 rf;
+	uint8_t regs[256];
+};
+
+/* A room warming up in the morning, (%RH, °C) x 100 */
+static const int32_t hdc2010_script[] = {
+	4510, 2350,	4498, 2356,	4485, 2361,	4470, 2370,
+	4452, 2382,	4440, 2391,	4431, 2398,	4420, 2405,
+	4414, 2411,	4409, 2414,	4406, 2416,	4410, 2415,
+	4418, 2411,	4431, 2404,	4455, 2390,	4483, 2371,
+};
+
+static void hdc2010_emul_reset(struct hdc2010_emul_data *data)
+{
+	memset(data->regs, 0, sizeof(data->regs));
+	sys_put_le16(HDC2010_MANUFACTURER_ID,
+		     &data->regs[HDC2010_REG_MANUFACTURER_ID]);
+	sys_put_le16(HDC2010_DEVICE_ID, &data->regs[HDC2010_REG_DEVICE_ID]);
+}
+
+static void hdc2010_emul_measure(struct hdc2010_emul_data *data)
+{
+	const int32_t *frame = sensor_emul_frame(&data->script);
+	int64_t rh = CLAMP(frame[0], 0, 10000);
+	int64_t t = CLAMP(frame[1], -4000, 12500);
+
+	/* RH = raw / 2^16 * 100, T = raw / 2^16 * 165 - 40 */
+	sys_put_le16(MIN(rh * 65536 / 10000, 0xffff),
+		     &data->regs[HDC2010_REG_HUMIDITY]);
+	sys_put_le16(MIN((t + 4000) * 65536 / 16500, 0xffff),
+		     &data->regs[HDC2010_REG_TEMP]);
+	data->regs[HDC2010_REG_DRDY] |= HDC2010_DRDY_STATUS;
+}
+
+static void hdc2010_emul_write(const struct emul *target, uint8_t reg)
+{
+	struct hdc2010_emul_data *data = target->data;
+
+	if (reg == HDC2010_REG_CONFIG &&
+	    (data->regs[reg] & HDC2010_CONFIG_SOFT_RES)) {
+		hdc2010_emul_reset(data);
+	} else if (reg == HDC2010_REG_MEAS_CFG &&
+		   (data->regs[reg] & HDC2010_MEAS_CFG_TRIG)) {
+		data->regs[reg] &= ~HDC2010_MEAS_CFG_TRIG;
+		hdc2010_emul_measure(data);
+	}
+}
+
+static int hdc2010_emul_transfer(const struct emul *target,
+				 struct i2c_msg *msgs, int num_msgs, int addr)
+{
+	struct hdc2010_emul_data *data = target->data;
+
+	ARG_UNUSED(addr);
+
+	return sensor_emul_reg8_transfer(target, &data->rf, msgs, num_msgs);
+}
+
+static const struct i2c_emul_api hdc2010_emul_api = {
+	.transfer = hdc2010_emul_transfer,
+};
+
+static int hdc2010_emul_init(const struct emul *target,
+			     const struct device *parent)
+{
+	struct hdc2010_emul_data *data = target->data;
+
+	ARG_UNUSED(parent);
+
+	hdc2010_emul_reset(data);
+	data->rf.regs = data->regs;
+	data->rf.write = hdc2010_emul_write;
+	data->script.channels = 2;
+
+	return sensor_emul_set_script(target, hdc2010_script,
+				      ARRAY_SIZE(hdc2010_script) / 2,
+				      SENSOR_EMUL_RATE_HZ);
+}
+
+#define HDC2010_EMUL(n)							\
+	static struct hdc2010_emul_data hdc2010_emul_data_##n;		\
+	EMUL_DT_INST_DEFINE(n, hdc2010_emul_init,			\
+			    &hdc2010_emul_data_##n, NULL,		\
+			    &hdc2010_emul_api, NULL)
+
+DT_INST_FOREACH_STATUS_OKAY(HDC2010_EMUL)
@@ -0,0 +1,347 @@
+/*
+ * LIS2DH accelerometer emulator, see sensor_emul.h
+ *
+ * Byte-wide registers, the pointer only increments when the register
+ * address has its MSB set. A read starting at the status or output
+ * registers is one measurement. Outputs are left-justified, so one mg is
+ * 16 LSB at ±2 g in every power mode (1 mg/digit << 4 in high resolution,
+ * 4 mg/digit << 6 in normal mode); the full scale in CTRL_REG4 is honoured.
+ *
+ * With FIFO_EN in CTRL_REG5 and a FIFO mode other than bypass, measurements
+ * follow the output data rate of CTRL_REG1 in simulated time instead, into
+ * a 32-sample FIFO (stream mode drops the oldest sample when full, FIFO
+ * mode stops). Each read of OUT_X_L pops a sample and the pointer wraps
+ * from OUT_Z_H back to OUT_X_L, so one burst drains the FIFO. FIFO_SRC_REG
+ * reports the level, and with I1_WTM in CTRL_REG3 the watermark drives the
+ * first irq-gpios line through the GPIO emulator.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define DT_DRV_COMPAT st_lis2dh
+
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/drivers/i2c_emul.h>
+#include <zephyr/sys/byteorder.h>
+
+#ifdef CONFIG_GPIO_EMUL
+#include <zephyr/drivers/gpio/gpio_emul.h>
+#endif
+
+#include "sensor_emul.h"
+
+#define LIS2DH_REG_WAI		0x0f
+#define LIS2DH_REG_CTRL0	0x1e
+#define LIS2DH_REG_CTRL1	0x20
+#define LIS2DH_REG_CTRL3	0x22
+#define LIS2DH_REG_CTRL4	0x23
+#define LIS2DH_REG_CTRL5	0x24
+#define LIS2DH_REG_STATUS	0x27
+#define LIS2DH_REG_OUT_X_L	0x28
+#define LIS2DH_REG_OUT_Z_H	0x2d
+#define LIS2DH_REG_FIFO_CTRL	0x2e
+#define LIS2DH_REG_FIFO_SRC	0x2f
+
+#define LIS2DH_CHIP_ID		0x33
+#define LIS2DH_CTRL0_RESET	0x10
+#define LIS2DH_AUTOINCREMENT	BIT(7)
+#define LIS2DH_STATUS_ZYXDA	BIT(3)
+#define LIS2DH_FS_SHIFT		4
+#define LIS2DH_FS_MASK		(BIT_MASK(2) << LIS2DH_FS_SHIFT)
+#define LIS2DH_ODR_SHIFT	4
+#define LIS2DH_ODR_1344		9	/* 5376 Hz in low-power mode */
+#define LIS2DH_LPEN		BIT(3)
+#define LIS2DH_I1_WTM		BIT(2)
+#define LIS2DH_FIFO_EN		BIT(6)
+#define LIS2DH_FM_SHIFT		6
+#define LIS2DH_FM_BYPASS	0
+#define LIS2DH_FM_FIFO		1
+#define LIS2DH_FTH_MASK		BIT_MASK(5)
+#define LIS2DH_FIFO_WTM		BIT(7)
+#define LIS2DH_FIFO_OVRN	BIT(6)
+#define LIS2DH_FIFO_EMPTY	BIT(5)
+#define LIS2DH_FIFO_DEPTH	32
+
+struct lis2dh_emul_cfg {
+	struct gpio_dt_spec int1;
+};
+
+struct lis2dh_emul_data {
+	struct sensor_emul_script script;
+	struct sensor_emul_reg8 rf;
+	uint8_t regs[256];
+	const struct emul *target;
+	struct k_timer wtm_timer;
+	uint32_t odr_hz;		/* 0 while the FIFO is off */
+	int64_t fifo_start_us;
+	uint64_t fifo_samples;		/* since fifo_start_us */
+	uint8_t fifo_head;
+	uint8_t fifo_level;
+	int16_t fifo[LIS2DH_FIFO_DEPTH][3];
+};
+
+/* mg per digit at high resolution, by full scale 2, 4, 8, 16 g */
+static const uint8_t lis2dh_sensitivity[] = { 1, 2, 4, 12 };
+
+/* By CTRL_REG1 ODR code, normal and high resolution modes */
+static const uint16_t lis2dh_odr_hz[] = {
+	0, 1, 10, 25, 50, 100, 200, 400, 1620, 1344,
+};
+
+/*
+ * Flat on the desk with some vibration, picked up, tilted 90° about Y and
+ * put back (X, Y, Z in mg)
+ */
+static const int32_t lis2dh_script[] = {
+	-12, 8, 1001,	5, -3, 996,	-8, 11, 1004,	3, -6, 998,
+	-10, 4, 1002,	140, 60, 1180,	420, 35, 905,	780, -20, 610,
+	995, 12, 40,	1002, -8, -15,	998, 5, 22,	760, 30, 640,
+	350, -45, 950,	60, 20, 1110,	-4, 7, 999,	6, -2, 1003,
+};
+
+static void lis2dh_emul_sample(struct lis2dh_emul_data *data,
+			       int16_t out[3])
+{
+	const int32_t *frame = sensor_emul_frame(&data->script);
+	uint8_t fs = (data->regs[LIS2DH_REG_CTRL4] & LIS2DH_FS_MASK) >>
+		     LIS2DH_FS_SHIFT;
+
+	for (int i = 0; i < 3; i++) {
+		int32_t raw = frame[i] * 16 / lis2dh_sensitivity[fs];
+
+		out[i] = CLAMP(raw, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void lis2dh_emul_put_out(struct lis2dh_emul_data *data,
+				const int16_t xyz[3])
+{
+	for (int i = 0; i < 3; i++) {
+		sys_put_le16(xyz[i], &data->regs[LIS2DH_REG_OUT_X_L + 2 * i]);
+	}
+
+	data->regs[LIS2DH_REG_STATUS] = LIS2DH_STATUS_ZYXDA;
+}
+
+static void lis2dh_emul_measure(struct lis2dh_emul_data *data)
+{
+	int16_t xyz[3];
+
+	lis2dh_emul_sample(data, xyz);
+	lis2dh_emul_put_out(data, xyz);
+}
+
+static uint8_t lis2dh_emul_fth(struct lis2dh_emul_data *data)
+{
+	return data->regs[LIS2DH_REG_FIFO_CTRL] & LIS2DH_FTH_MASK;
+}
+
+static int64_t lis2dh_emul_now_us(void)
+{
+	return k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+/* Samples the output data rate produced since the last call */
+static void lis2dh_emul_fifo_fill(struct lis2dh_emul_data *data)
+{
+	uint8_t fm = data->regs[LIS2DH_REG_FIFO_CTRL] >> LIS2DH_FM_SHIFT;
+	uint64_t due;
+
+	if (data->odr_hz == 0) {
+		return;
+	}
+
+	due = (lis2dh_emul_now_us() - data->fifo_start_us) * data->odr_hz /
+	      USEC_PER_SEC;
+
+	for (; data->fifo_samples < due; data->fifo_samples++) {
+		if (data->fifo_level == LIS2DH_FIFO_DEPTH) {
+			if (fm == LIS2DH_FM_FIFO) {
+				continue;
+			}
+			data->fifo_head = (data->fifo_head + 1) %
+					  LIS2DH_FIFO_DEPTH;
+			data->fifo_level--;
+		}
+
+		lis2dh_emul_sample(data, data->fifo[(data->fifo_head +
+						    data->fifo_level) %
+						   LIS2DH_FIFO_DEPTH]);
+		data->fifo_level++;
+	}
+}
+
+/* FIFO_SRC_REG, the INT1 line and the timer for the next watermark */
+static void lis2dh_emul_fifo_update(struct lis2dh_emul_data *data)
+{
+	const struct lis2dh_emul_cfg *cfg = data->target->cfg;
+	uint8_t level = data->fifo_level;
+	bool wtm = data->odr_hz && level > lis2dh_emul_fth(data);
+	bool int1 = data->regs[LIS2DH_REG_CTRL3] & LIS2DH_I1_WTM;
+	int64_t next_us;
+
+	data->regs[LIS2DH_REG_FIFO_SRC] =
+		(wtm ? LIS2DH_FIFO_WTM : 0) |
+		(level == LIS2DH_FIFO_DEPTH ? LIS2DH_FIFO_OVRN : 0) |
+		(level == 0 ? LIS2DH_FIFO_EMPTY : 0) |
+		MIN(level, LIS2DH_FIFO_DEPTH - 1);
+
+#ifdef CONFIG_GPIO_EMUL
+	if (cfg->int1.port != NULL) {
+		gpio_emul_input_set(cfg->int1.port, cfg->int1.pin, int1 && wtm);
+	}
+#else
+	ARG_UNUSED(cfg);
+#endif
+
+	if (!int1 || wtm || data->odr_hz == 0) {
+		k_timer_stop(&data->wtm_timer);
+		return;
+	}
+
+	next_us = data->fifo_start_us +
+		  DIV_ROUND_UP((data->fifo_samples + lis2dh_emul_fth(data) + 1 -
+				level) * USEC_PER_SEC, data->odr_hz);
+	k_timer_start(&data->wtm_timer,
+		      K_USEC(MAX(next_us - lis2dh_emul_now_us(), 0)),
+		      K_NO_WAIT);
+}
+
+static void lis2dh_emul_wtm_expiry(struct k_timer *timer)
+{
+	struct lis2dh_emul_data *data =
+		CONTAINER_OF(timer, struct lis2dh_emul_data, wtm_timer);
+
+	lis2dh_emul_fifo_fill(data);
+	lis2dh_emul_fifo_update(data);
+}
+
+/* After writes to the control registers: restart or stop the FIFO */
+static void lis2dh_emul_fifo_config(struct lis2dh_emul_data *data)
+{
+	uint8_t ctrl1 = data->regs[LIS2DH_REG_CTRL1];
+	uint8_t odr = ctrl1 >> LIS2DH_ODR_SHIFT;
+	uint8_t fm = data->regs[LIS2DH_REG_FIFO_CTRL] >> LIS2DH_FM_SHIFT;
+	uint32_t odr_hz = 0;
+
+	if ((data->regs[LIS2DH_REG_CTRL5] & LIS2DH_FIFO_EN) &&
+	    fm != LIS2DH_FM_BYPASS && odr < ARRAY_SIZE(lis2dh_odr_hz)) {
+		odr_hz = lis2dh_odr_hz[odr];
+		if (odr == LIS2DH_ODR_1344 && (ctrl1 & LIS2DH_LPEN)) {
+			odr_hz = 5376;
+		}
+	}
+
+	if (odr_hz == 0) {
+		data->fifo_level = 0;
+		data->fifo_head = 0;
+	}
+
+	if (odr_hz != data->odr_hz) {
+		data->odr_hz = odr_hz;
+		data->fifo_start_us = lis2dh_emul_now_us();
+		data->fifo_samples = 0;
+	}
+
+	data->rf.wrap_end = odr_hz ? LIS2DH_REG_OUT_Z_H : 0;
+	lis2dh_emul_fifo_update(data);
+}
+
+static void lis2dh_emul_read(const struct emul *target, uint8_t reg)
+{
+	struct lis2dh_emul_data *data = target->data;
+
+	if (data->odr_hz) {
+		lis2dh_emul_fifo_fill(data);
+		lis2dh_emul_fifo_update(data);
+	} else if (reg >= LIS2DH_REG_STATUS && reg <= LIS2DH_REG_OUT_Z_H) {
+		lis2dh_emul_measure(data);
+	}
+}
+
+/* In FIFO mode every read of OUT_X_L starts on the oldest sample */
+static void lis2dh_emul_get(const struct emul *target, uint8_t reg)
+{
+	struct lis2dh_emul_data *data = target->data;
+
+	if (data->odr_hz == 0 || reg != LIS2DH_REG_OUT_X_L ||
+	    data->fifo_level == 0) {
+		return;
+	}
+
+	lis2dh_emul_put_out(data, data->fifo[data->fifo_head]);
+	data->fifo_head = (data->fifo_head + 1) % LIS2DH_FIFO_DEPTH;
+	data->fifo_level--;
+	lis2dh_emul_fifo_update(data);
+}
+
+static void lis2dh_emul_write(const struct emul *target, uint8_t reg)
+{
+	struct lis2dh_emul_data *data = target->data;
+
+	switch (reg) {
+	case LIS2DH_REG_CTRL1:
+	case LIS2DH_REG_CTRL3:
+	case LIS2DH_REG_CTRL5:
+	case LIS2DH_REG_FIFO_CTRL:
+		lis2dh_emul_fifo_config(data);
+		break;
+	default:
+		break;
+	}
+}
+
+static int lis2dh_emul_transfer(const struct emul *target,
+				struct i2c_msg *msgs, int num_msgs, int addr)
+{
+	struct lis2dh_emul_data *data = target->data;
+
+	ARG_UNUSED(addr);
+
+	return sensor_emul_reg8_transfer(target, &data->rf, msgs, num_msgs);
+}
+
+static const struct i2c_emul_api lis2dh_emul_api = {
+	.transfer = lis2dh_emul_transfer,
+};
+
+static int lis2dh_emul_init(const struct emul *target,
+			    const struct device *parent)
+{
+	struct lis2dh_emul_data *data = target->data;
+
+	ARG_UNUSED(parent);
+
+	data->regs[LIS2DH_REG_WAI] = LIS2DH_CHIP_ID;
+	data->regs[LIS2DH_REG_CTRL0] = LIS2DH_CTRL0_RESET;
+	data->rf.regs = data->regs;
+	data->rf.inc_flag = LIS2DH_AUTOINCREMENT;
+	data->rf.read = lis2dh_emul_read;
+	data->rf.get = lis2dh_emul_get;
+	data->rf.write = lis2dh_emul_write;
+	data->rf.wrap_start = LIS2DH_REG_OUT_X_L;
+	data->target = target;
+	data->script.channels = 3;
+	k_timer_init(&data->wtm_timer, lis2dh_emul_wtm_expiry, NULL);
+
+	return sensor_emul_set_script(target, lis2dh_script,
+				      ARRAY_SIZE(lis2dh_script) / 3,
+				      SENSOR_EMUL_RATE_HZ);
+}
+
+#define LIS2DH_EMUL(n)							\
+	static struct lis2dh_emul_data lis2dh_emul_data_##n;		\
+	static const struct lis2dh_emul_cfg lis2dh_emul_cfg_##n = {	\
+		.int1 = GPIO_DT_SPEC_INST_GET_BY_IDX_OR(n, irq_gpios, 0, \
+							{ 0 }),		\
+	};								\
+	EMUL_DT_INST_DEFINE(n, lis2dh_emul_init,			\
+			    &lis2dh_emul_data_##n,			\
+			    &lis2dh_emul_cfg_##n,			\
+			    &lis2dh_emul_api, NULL)
+
+DT_INST_FOREACH_STATUS_OKAY(LIS2DH_EMUL)
@@ -0,0 +1,129 @@
+/*
+ * OPT3001 ambient light sensor emulator, see sensor_emul.h
+ *
+ * 16-bit big-endian registers behind a pointer. A read of the result
+ * register is one measurement.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define DT_DRV_COMPAT ti_opt3001
+
+#include <errno.h>
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/drivers/i2c_emul.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "sensor_emul.h"
+
+#define OPT3001_REG_RESULT		0x00
+#define OPT3001_REG_CONFIG		0x01
+#define OPT3001_REG_MANUFACTURER_ID	0x7e
+#define OPT3001_REG_DEVICE_ID		0x7f
+
+#define OPT3001_MANUFACTURER_ID		0x5449
+#define OPT3001_DEVICE_ID		0x3001
+#define OPT3001_CONFIG_RESET		0xc810
+
+struct opt3001_emul_data {
+	struct sensor_emul_script script;
+	uint16_t config;
+	uint8_t reg;
+};
+
+/* Indoor light, a hand over the sensor, then a desk lamp (lux x 100) */
+static const int32_t opt3001_script[] = {
+	8432, 8520, 8611, 8590, 8475, 8302, 4410, 85,
+	85, 92, 3120, 8399, 10664, 24010, 24388, 24102,
+};
+
+/* Result register: 4-bit exponent, 12-bit mantissa of 0.01 lux << e */
+static uint16_t opt3001_emul_result(int32_t centilux)
+{
+	uint32_t m = MAX(centilux, 0);
+	uint16_t e = 0;
+
+	while (m > 0xfff && e < 11) {
+		m >>= 1;
+		e++;
+	}
+
+	return e << 12 | MIN(m, 0xfff);
+}
+
+static uint16_t opt3001_emul_read(struct opt3001_emul_data *data)
+{
+	switch (data->reg) {
+	case OPT3001_REG_RESULT:
+		return opt3001_emul_result(sensor_emul_frame(&data->script)[0]);
+	case OPT3001_REG_CONFIG:
+		return data->config;
+	case OPT3001_REG_MANUFACTURER_ID:
+		return OPT3001_MANUFACTURER_ID;
+	case OPT3001_REG_DEVICE_ID:
+		return OPT3001_DEVICE_ID;
+	default:
+		return 0;
+	}
+}
+
+static int opt3001_emul_transfer(const struct emul *target,
+				 struct i2c_msg *msgs, int num_msgs, int addr)
+{
+	struct opt3001_emul_data *data = target->data;
+
+	ARG_UNUSED(addr);
+
+	for (int i = 0; i < num_msgs; i++) {
+		struct i2c_msg *msg = &msgs[i];
+
+		if (msg->flags & I2C_MSG_READ) {
+			if (msg->len != 2) {
+				return -EIO;
+			}
+			sys_put_be16(opt3001_emul_read(data), msg->buf);
+			continue;
+		}
+
+		if (msg->len != 1 && msg->len != 3) {
+			return -EIO;
+		}
+
+		data->reg = msg->buf[0];
+		if (msg->len == 3 && data->reg == OPT3001_REG_CONFIG) {
+			data->config = sys_get_be16(&msg->buf[1]);
+		}
+	}
+
+	return 0;
+}
+
+static const struct i2c_emul_api opt3001_emul_api = {
+	.transfer = opt3001_emul_transfer,
+};
+
+static int opt3001_emul_init(const struct emul *target,
+			     const struct device *parent)
+{
+	struct opt3001_emul_data *data = target->data;
+
+	ARG_UNUSED(parent);
+
+	data->config = OPT3001_CONFIG_RESET;
+	data->script.channels = 1;
+
+	return sensor_emul_set_script(target, opt3001_script,
+				      ARRAY_SIZE(opt3001_script),
+				      SENSOR_EMUL_RATE_HZ);
+}
+
+#define OPT3001_EMUL(n)							\
+	static struct opt3001_emul_data opt3001_emul_data_##n;		\
+	EMUL_DT_INST_DEFINE(n, opt3001_emul_init,			\
+			    &opt3001_emul_data_##n, NULL,		\
+			    &opt3001_emul_api, NULL)
+
+DT_INST_FOREACH_STATUS_OKAY(OPT3001_EMUL)
@@ -0,0 +1,109 @@
+/*
+ * Script playback shared by the sensor emulators, see sensor_emul.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+
+#include <zephyr/kernel.h>
+
+#include "sensor_emul.h"
+
+const int32_t *sensor_emul_frame(struct sensor_emul_script *script)
+{
+	uint32_t i;
+
+	if (script->rate_hz == 0) {
+		i = script->next++ % script->count;
+	} else {
+		i = (k_uptime_get() - script->start_ms) * script->rate_hz /
+		    MSEC_PER_SEC % script->count;
+	}
+
+	script->measurements++;
+
+	return &script->frames[i * script->channels];
+}
+
+void sensor_emul_set_rate(const struct emul *target, uint32_t rate_hz)
+{
+	struct sensor_emul_data *data = target->data;
+
+	data->script.rate_hz = rate_hz;
+	data->script.start_ms = k_uptime_get();
+	data->script.next = 0;
+}
+
+int sensor_emul_set_script(const struct emul *target, const int32_t *frames,
+			   uint16_t count, uint32_t rate_hz)
+{
+	struct sensor_emul_data *data = target->data;
+
+	if (frames == NULL || count == 0) {
+		return -EINVAL;
+	}
+
+	data->script.frames = frames;
+	data->script.count = count;
+	sensor_emul_set_rate(target, rate_hz);
+
+	return 0;
+}
+
+uint32_t sensor_emul_measurements(const struct emul *target)
+{
+	const struct sensor_emul_data *data = target->data;
+
+	return data->script.measurements;
+}
+
+int sensor_emul_reg8_transfer(const struct emul *target,
+			      struct sensor_emul_reg8 *rf,
+			      struct i2c_msg *msgs, int num_msgs)
+{
+	bool have_ptr = false;
+
+	for (int i = 0; i < num_msgs; i++) {
+		struct i2c_msg *msg = &msgs[i];
+		uint32_t j = 0;
+
+		if (msg->flags & I2C_MSG_READ) {
+			if (rf->read) {
+				rf->read(target, rf->ptr);
+			}
+			for (; j < msg->len; j++) {
+				if (rf->get) {
+					rf->get(target, rf->ptr);
+				}
+				msg->buf[j] = rf->regs[rf->ptr];
+				if (rf->inc && rf->wrap_end &&
+				    rf->ptr == rf->wrap_end) {
+					rf->ptr = rf->wrap_start;
+				} else {
+					rf->ptr += rf->inc;
+				}
+			}
+			continue;
+		}
+
+		if (!have_ptr && msg->len > 0) {
+			rf->ptr = msg->buf[j++];
+			rf->inc = !rf->inc_flag || (rf->ptr & rf->inc_flag);
+			if (rf->inc_flag) {
+				rf->ptr &= ~rf->inc_flag;
+			}
+			have_ptr = true;
+		}
+
+		for (; j < msg->len; j++) {
+			rf->regs[rf->ptr] = msg->buf[j];
+			if (rf->write) {
+				rf->write(target, rf->ptr);
+			}
+			rf->ptr += rf->inc;
+		}
+	}
+
+	return 0;
+}
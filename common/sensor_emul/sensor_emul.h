@@ -0,0 +1,93 @@
+/*
+ * I2C emulators for the BeagleConnect Freedom sensors, for native_sim.
+ *
+ * Each model answers on the emulated I2C bus with the register map of the
+ * real part, so the upstream Zephyr drivers (opt3001, ti_hdc20xx, lis2dh)
+ * run unmodified on top of them. Readings come from a script: a table of
+ * frames, one value per channel, played back in a loop.
+ *
+ *   OPT3001   1 channel    light, lux x 100
+ *   HDC2010   2 channels   relative humidity % x 100, temperature °C x 100
+ *   LIS2DH    3 channels   acceleration X, Y, Z in mg (±2 g range)
+ *
+ * With rate_hz > 0 the frame follows the uptime, rate_hz frames per
+ * second, whether or not anybody reads it. With rate_hz == 0 every
+ * measurement takes the next frame, which makes a run reproducible
+ * whatever the sampling rate.
+ *
+ * Recorded data plays back the same way: turn a trace (for example the
+ * output of sensortest's ts_tool) into a frame table and pass it to
+ * sensor_emul_set_script().
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef SENSOR_EMUL_H_
+#define SENSOR_EMUL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/i2c.h>
+
+/* Playback rate of the built-in scripts, frames per second */
+#define SENSOR_EMUL_RATE_HZ 10
+
+struct sensor_emul_script {
+	const int32_t *frames;		/* count x channels values */
+	uint16_t count;
+	uint8_t channels;
+	uint32_t rate_hz;
+	int64_t start_ms;
+	uint32_t next;			/* next frame when rate_hz is 0 */
+	uint32_t measurements;
+};
+
+/* First member of every model's data */
+struct sensor_emul_data {
+	struct sensor_emul_script script;
+};
+
+/* Frame for a new measurement, internal to the models */
+const int32_t *sensor_emul_frame(struct sensor_emul_script *script);
+
+/*
+ * Byte-wide register file behind a register pointer, set by the first byte
+ * a transaction writes, internal to the models. With inc_flag 0 the pointer
+ * always moves on after each byte, otherwise only when the register address
+ * carried inc_flag (LIS2DH style). read() runs before each read message,
+ * write() after each byte written. get(), if set, runs before each byte
+ * read. With wrap_end set, an incrementing pointer goes back to wrap_start
+ * after that register (LIS2DH FIFO readout).
+ */
+struct sensor_emul_reg8 {
+	uint8_t *regs;		/* 256 bytes */
+	uint8_t ptr;
+	uint8_t inc_flag;
+	bool inc;
+	uint8_t wrap_start;
+	uint8_t wrap_end;
+	void (*read)(const struct emul *target, uint8_t reg);
+	void (*get)(const struct emul *target, uint8_t reg);
+	void (*write)(const struct emul *target, uint8_t reg);
+};
+
+int sensor_emul_reg8_transfer(const struct emul *target,
+			      struct sensor_emul_reg8 *rf,
+			      struct i2c_msg *msgs, int num_msgs);
+
+/*
+ * Play frames back (count frames of the model's channel count) from now on.
+ * Returns -EINVAL if frames is NULL or count is 0. The table is not copied.
+ */
+int sensor_emul_set_script(const struct emul *target, const int32_t *frames,
+			   uint16_t count, uint32_t rate_hz);
+
+/* Restart the current script from its first frame at another rate */
+void sensor_emul_set_rate(const struct emul *target, uint32_t rate_hz);
+
+/* Measurements the driver took since boot */
+uint32_t sensor_emul_measurements(const struct emul *target);
+
+#endif /* SENSOR_EMUL_H_ */
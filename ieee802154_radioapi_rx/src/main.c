@@ -5,42 +5,122 @@
 #include <zephyr/sys/printk.h>
 // #include <zephyr/random/random.h>
 
+#include "raw154.h"
+
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(radioapi_rx, LOG_LEVEL_DBG);
 
 #define RX_PACKET_SIZE 128  // Example size for receiving packets
-#define IEEE802154_CHANNEL 11  // Set the channel to your network's channel
+#define IEEE802154_CHANNEL 11  // Start channel, see CHANNEL_MASK
 #define IEEE802154_PAN_ID 0xABCD // Example PAN ID
 #define IEEE802154_SHORT_ADDR 0x1234 // Example short address
 
-uint8_t mac_addr[8]; /* in little endian */
+/*
+ * Receiver duty cycle: RAW154_MAC_ALWAYS_ON keeps the radio listening all the
+ * time, RAW154_MAC_LPL and RAW154_MAC_SLOTTED only open a LISTEN_MS window
+ * every WAKEUP_PERIOD_MS. The TX sample must use the same mode and timing.
+ */
+#define MAC_MODE RAW154_MAC_LPL
+#define WAKEUP_PERIOD_MS 250
+#define LISTEN_MS 5
+
+#define STATS_INTERVAL_S 10
 
-/* IEEE802.15.4 frame + 1 byte len + 1 byte LQI */
-uint8_t tx_buf[IEEE802154_MAX_PHY_PACKET_SIZE + 1 + 1];
+/*
+ * Channel selection: at start-up and every CHANNEL_ASSESS_S, measure the
+ * energy on each channel of CHANNEL_MASK for SCAN_DURATION_MS and move to
+ * the quietest one, telling the TX sample with a channel switch command.
+ * Set CHANNEL_MASK to BIT(IEEE802154_CHANNEL) to stay on one channel.
+ */
+#define CHANNEL_MASK RAW154_CHAN_MASK_2_4_GHZ
+#define SCAN_DURATION_MS 5
+#define CHANNEL_ASSESS_S 300
+
+/*
+ * Only accept frames from these senders. Frames from anyone else on the
+ * channel are dropped before they are copied out of the driver's buffer.
+ * Leave the list empty to accept every sender.
+ */
+#define ALLOWED_SENDERS { 0x5678 }
+#define ALLOW_LIST_SLOTS 16 // Power of two, fills up to 3/4
+
+/*
+ * Link-layer security: every data and command frame is encrypted and
+ * authenticated with AES-CCM* at SECURITY_LEVEL, with the AES engine when
+ * there is a driver for it. Frames in clear and replayed frames are
+ * dropped. The key is CONFIG_RAW154_SEC_KEY, which is not in the sources:
+ * put it in a local .conf with CONFIG_RAW154_SEC_KEY_INDEX and build with
+ * -DEXTRA_CONF_FILE=<file>. Without it the link runs in clear, with a
+ * warning at boot. Key, key index and SECURITY_LEVEL must match
+ * the TX sample. The frame counter is kept in the storage partition, so
+ * it does not start over at boot and a peer that kept running does not
+ * drop our frames as replays.
+ */
+#define LINK_SECURITY true
+#define SECURITY_LEVEL RAW154_SEC_LEVEL_ENC_MIC_32
 
 /* ieee802.15.4 device */
-static struct ieee802154_radio_api *radio_api;
 static const struct device *const ieee802154_dev =
 	DEVICE_DT_GET(DT_CHOSEN(zephyr_ieee802154));
+static struct raw154 node;
+
+static const struct raw154_mac_cfg mac = {
+    .mode = MAC_MODE,
+    .listener = true,
+    .period_ms = WAKEUP_PERIOD_MS,
+    .listen_ms = LISTEN_MS,
+};
+
+static const uint16_t allowed_senders[] = ALLOWED_SENDERS;
+static uint16_t allow_slots[ALLOW_LIST_SLOTS];
+static struct raw154_nbr_set allow_list;
 
-// Function to process a received packet
-void process_packet(struct net_pkt *pkt)
+/* Secure our frames and only accept secured ones, if there is a key */
+static bool init_security(void)
 {
-    struct net_buf *frag;
-    size_t total_len = 0;
-
-    for (frag = pkt->frags; frag; frag = frag->frags) {
-        total_len += frag->len;
-        printk("Fragment Length: %d\n", frag->len);
-        printk("Fragment Data: ");
-        for (size_t i = 0; i < frag->len; i++) {
-            printk("%02x ", frag->data[i]);
-        }
-        printk("\n");
+    static struct raw154_sec sec;
+    struct raw154_sec_cfg cfg = {
+        .level = SECURITY_LEVEL,
+        .require = true,
+    };
+    const struct device *crypto = raw154_sec_default_dev();
+    int r;
+
+    r = raw154_sec_config_key(&cfg);
+    if (r == -ENOENT) {
+        LOG_WRN("CONFIG_RAW154_SEC_KEY not set, link security is off");
+        return true;
+    } else if (r < 0) {
+        LOG_ERR("Set CONFIG_RAW154_SEC_KEY to 32 hex digits");
+        return false;
     }
-    printk("Total packet length: %zu bytes\n", total_len);
 
-    net_pkt_unref(pkt);
+    if (raw154_sec_init(&sec, crypto, &cfg) < 0) {
+        LOG_ERR("No AES-CCM for link security");
+        return false;
+    }
+
+    r = raw154_sec_persist(&sec);
+    if (r < 0) {
+        LOG_WRN("Frame counter not persisted (%d), it restarts at boot", r);
+    }
+
+    raw154_set_security(&node, &sec);
+    LOG_INF("Link security level %u on %s", SECURITY_LEVEL, crypto->name);
+
+    return true;
+}
+
+// Function to process the payload of a received data frame
+void process_packet(struct raw154 *node, const struct raw154_hdr *hdr,
+                    const uint8_t *payload, size_t len, uint8_t lqi)
+{
+    printk("Frame from 0x%04x seq %u lqi %u: ", hdr->src_short, hdr->seq, lqi);
+    for (size_t i = 0; i < len; i++) {
+        printk("%02x ", payload[i]);
+    }
+    printk("\n");
+    printk("Total payload length: %zu bytes\n", len);
 }
 
 /**
@@ -51,14 +131,34 @@ int net_recv_data(struct net_if *iface, struct net_pkt *pkt)
 {
 	LOG_DBG("Received pkt %p, len %d", pkt, net_pkt_get_len(pkt));
 
-	process_packet(pkt);
+	raw154_input(&node, pkt);
 
 	return 0;
 }
 
+/* Called by drivers that pass ACK frames up separately */
 enum net_verdict ieee802154_handle_ack(struct net_if *iface, struct net_pkt *pkt)
 {
-	return NET_CONTINUE;
+	return raw154_handle_ack(&node, pkt);
+}
+
+/* Pick the quietest channel, the MAC is paused while the radio scans */
+static void assess_channel(const struct raw154_mac_cfg *mac)
+{
+    struct raw154_chan_scan scan;
+    int r;
+
+    raw154_mac_stop(&node);
+
+    r = raw154_chan_select(&node, CHANNEL_MASK, SCAN_DURATION_MS, &scan);
+    if (r < 0) {
+        LOG_ERR("Channel scan failed (%d)", r);
+    } else {
+        LOG_INF("Channel %u (energy %d, quietest %u at %d)", r,
+                scan.energy[r], scan.best, scan.energy[scan.best]);
+    }
+
+    raw154_mac_start(&node, mac);
 }
 
 /* Initialize the IEEE 802.15.4 interface */
@@ -66,46 +166,69 @@ static bool init_ieee802154(void)
 {
     LOG_INF("Initialize ieee802.15.4");
 
-    if (!device_is_ready(ieee802154_dev)) {
-        LOG_ERR("IEEE 802.15.4 device not ready");
+    /*
+     * Sets the channel and the PAN ID/short address hardware filter, the
+     * same checks are done in software for radios without one
+     */
+    if (raw154_init(&node, ieee802154_dev, IEEE802154_PAN_ID,
+                    IEEE802154_SHORT_ADDR, IEEE802154_CHANNEL,
+                    process_packet) < 0) {
         return false;
     }
 
-    radio_api = (struct ieee802154_radio_api *)ieee802154_dev->api;
-
-    if (IEEE802154_HW_FILTER & radio_api->get_capabilities(ieee802154_dev)) {
-        struct ieee802154_filter filter;
-        uint16_t short_addr;
+    if (ARRAY_SIZE(allowed_senders) > 0) {
+        raw154_nbr_init(&allow_list, allow_slots, ARRAY_SIZE(allow_slots));
+        for (int i = 0; i < ARRAY_SIZE(allowed_senders); i++) {
+            raw154_nbr_add(&allow_list, allowed_senders[i]);
+        }
+        raw154_set_allow_list(&node, &allow_list);
+    }
 
-        /* Set short address */
-        short_addr = (mac_addr[0] << 8) + mac_addr[1];
-        filter.short_addr = short_addr;
-       
-        /* Set PAN ID */
-        filter.pan_id = IEEE802154_PAN_ID;
-        radio_api->filter(ieee802154_dev, true, IEEE802154_FILTER_TYPE_PAN_ID, &filter);
+    if (LINK_SECURITY && !init_security()) {
+        return false;
     }
 
-    /* Set the channel */
-    radio_api->set_channel(ieee802154_dev, IEEE802154_CHANNEL);
+    /* Start the radio, or its listen windows */
+    if (raw154_mac_start(&node, &mac) < 0) {
+        LOG_ERR("Invalid MAC configuration");
+        return false;
+    }
 
-    /* Start the radio */
-    radio_api->start(ieee802154_dev);
+    assess_channel(&mac);
 
     return true;
 }
 
-void main(void)
+int main(void)
 {   
+    int64_t start = k_uptime_ticks();
+    int64_t next_assess = k_uptime_get() + CHANNEL_ASSESS_S * MSEC_PER_SEC;
+
     /* Initialize the IEEE 802.15.4 device */
     if (!init_ieee802154()) {
         LOG_ERR("Unable to initialize ieee802154");
-        return;
+        return 0;
     }
 
-    /* Receive and print packets in a loop */
+    /* Packets are handled from net_recv_data(), just report the duty cycle */
     while (1) {
-        // receive_packet();  // Call the receive function
-        k_sleep(K_SECONDS(1));  // Sleep between packet receptions
+        k_sleep(K_SECONDS(STATS_INTERVAL_S));
+        LOG_INF("rx %u frames (%u dropped, %u filtered, %u duplicates), "
+                "%u acks sent, %u windows, radio on %u permille",
+                node.stats.rx_frames, node.stats.rx_dropped,
+                node.stats.rx_filtered, node.stats.rx_dup, node.stats.acks_sent,
+                node.stats.windows, raw154_duty_cycle_permille(&node, start));
+        if (LINK_SECURITY) {
+            LOG_INF("secured %u, failed %u, replayed %u, in clear %u",
+                    node.stats.sec_rx, node.stats.sec_failed,
+                    node.stats.sec_replay, node.stats.sec_unsecured);
+        }
+
+        if (k_uptime_get() >= next_assess) {
+            assess_channel(&mac);
+            next_assess += CHANNEL_ASSESS_S * MSEC_PER_SEC;
+        }
     }
+
+    return 0;
 }
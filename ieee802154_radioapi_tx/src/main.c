@@ -5,138 +5,239 @@
 #include <zephyr/sys/printk.h>
 // #include <zephyr/random/random.h>
 
+#include "raw154.h"
+
+#include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(radioapi_tx, LOG_LEVEL_DBG);
 
-#define IEEE802154_CHANNEL 11  // Set the channel to your network's channel
+#define IEEE802154_CHANNEL 11  // Start channel, the RX sample may move us
 #define IEEE802154_PAN_ID 0xABCD // Example PAN ID
-#define IEEE802154_SHORT_ADDR 0x1234 // Example short address
-#define TX_PACKET_SIZE 31
-
-// Define macros without endianness
-#define FRAME_CONTROL  0xD841  // Frame control (MSB first)
-#define SEQUENCE_NUMBER 0x2B   // Sequence number
-#define PAN_ID        0xABCD   // PAN ID (MSB first)
-#define BROADCAST     0xFFFF   // Broadcast address (MSB first)
-#define MAC_ADDR      0x00124B00219FB2EB // MAC address (MSB first)
+#define IEEE802154_SHORT_ADDR 0x5678 // Example short address
+
+#define RX_SHORT_ADDR 0x1234 // Short address of the RX sample
 #define PAYLOAD       { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, \
                         0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F }
-#define FCS           0x56   // Frame Check Sequence (MSB first)
 
-#define TX_PACKET_SIZE 31  // Total packet size
+/*
+ * Must match the RX sample: in RAW154_MAC_LPL every frame is repeated for
+ * WAKEUP_PERIOD_MS so that it hits a listen window, in RAW154_MAC_SLOTTED it
+ * is sent once in the window announced by the receiver's beacon.
+ */
+#define MAC_MODE RAW154_MAC_LPL
+#define WAKEUP_PERIOD_MS 250
+#define LISTEN_MS 5
+#define STROBE_GAP_US 500
+#define GUARD_MS 2
+
+/*
+ * Request a link-layer ACK for every frame and retransmit up to
+ * MAX_RETRIES times, backing off BACKOFF_MS, then twice as long, ...
+ */
+#define ACK_REQUEST true
+#define MAX_RETRIES 3
+#define ACK_TIMEOUT_US 2000
+#define BACKOFF_MS 10
+
+/*
+ * Lower the TX power towards the receiver while it keeps acknowledging at
+ * least TX_TARGET_PERMILLE of the frames, raise it when ACKs go missing.
+ * TX_POWER_MAX_DBM is also used for everything that is not acknowledged.
+ */
+#define ADAPTIVE_TX_POWER true
+#define TX_POWER_MIN_DBM -20
+#define TX_POWER_MAX_DBM 5
+#define TX_POWER_STEP_DB 2
+#define TX_TARGET_PERMILLE 950
+#define RSSI_FLOOR_DBM -85
+
+/*
+ * The RX sample announces channel changes, which we only hear with
+ * RAW154_MAC_ALWAYS_ON: in the duty-cycled modes our radio is off between
+ * sends. If we missed one, after FIND_AFTER_FAILURES frames in a row
+ * without ACK look for the receiver on every channel of CHANNEL_MASK.
+ * Needs ACK_REQUEST.
+ */
+#define CHANNEL_MASK RAW154_CHAN_MASK_2_4_GHZ
+#define FIND_AFTER_FAILURES 3
+
+/*
+ * Link-layer security: every data and command frame is encrypted and
+ * authenticated with AES-CCM* at SECURITY_LEVEL, with the AES engine when
+ * there is a driver for it. Frames in clear and replayed frames are
+ * dropped. The key is CONFIG_RAW154_SEC_KEY, which is not in the sources:
+ * put it in a local .conf with CONFIG_RAW154_SEC_KEY_INDEX and build with
+ * -DEXTRA_CONF_FILE=<file>. Without it the link runs in clear, with a
+ * warning at boot. Key, key index and SECURITY_LEVEL must match
+ * the RX sample. The frame counter is kept in the storage partition, so
+ * it does not start over at boot and a peer that kept running does not
+ * drop our frames as replays.
+ */
+#define LINK_SECURITY true
+#define SECURITY_LEVEL RAW154_SEC_LEVEL_ENC_MIC_32
 
 /* ieee802.15.4 device */
-static struct ieee802154_radio_api *radio_api;
 static const struct device *const ieee802154_dev = DEVICE_DT_GET(DT_CHOSEN(zephyr_ieee802154));
-uint8_t mac_addr[8]; /* in little endian */
-
-// Frame construction
-uint8_t frame[TX_PACKET_SIZE];
-
-void construct_frame(uint8_t sequence_num) {
-    uint8_t payload[] = PAYLOAD;
-
-    // Pointer to the frame buffer
-    uint8_t *ptr = frame;
+static struct raw154 node;
 
-    // Frame Control
-    sys_put_le16(FRAME_CONTROL, ptr);
-    ptr += 2;
-
-    // Sequence Number
-    *ptr++ = sequence_num;
-
-    // PAN ID
-    sys_put_le16(PAN_ID, ptr);
-    ptr += 2;
-
-    // Broadcast Address
-    sys_put_le16(BROADCAST, ptr);
-    ptr += 2;
+/* Secure our frames and only accept secured ones, if there is a key */
+static bool init_security(void)
+{
+    static struct raw154_sec sec;
+    struct raw154_sec_cfg cfg = {
+        .level = SECURITY_LEVEL,
+        .require = true,
+    };
+    const struct device *crypto = raw154_sec_default_dev();
+    int r;
+
+    r = raw154_sec_config_key(&cfg);
+    if (r == -ENOENT) {
+        LOG_WRN("CONFIG_RAW154_SEC_KEY not set, link security is off");
+        return true;
+    } else if (r < 0) {
+        LOG_ERR("Set CONFIG_RAW154_SEC_KEY to 32 hex digits");
+        return false;
+    }
 
-    // MAC Address
-    sys_put_le64(MAC_ADDR, ptr);
-    ptr += 8;
+    if (raw154_sec_init(&sec, crypto, &cfg) < 0) {
+        LOG_ERR("No AES-CCM for link security");
+        return false;
+    }
 
-    // Payload
-    for (int i = 0; i < sizeof(payload); i++) {
-        *ptr++ = payload[i];
+    r = raw154_sec_persist(&sec);
+    if (r < 0) {
+        LOG_WRN("Frame counter not persisted (%d), it restarts at boot", r);
     }
 
-    // Frame Check Sequence
-    sys_put_le16(FCS, ptr);
-}
+    raw154_set_security(&node, &sec);
+    LOG_INF("Link security level %u on %s", SECURITY_LEVEL, crypto->name);
 
+    return true;
+}
 
 /* Initialize the IEEE 802.15.4 interface */
 static bool init_ieee802154(void) {
+    const struct raw154_mac_cfg mac = {
+        .mode = MAC_MODE,
+        .listener = false,
+        .period_ms = WAKEUP_PERIOD_MS,
+        .listen_ms = LISTEN_MS,
+        .strobe_gap_us = STROBE_GAP_US,
+        .guard_ms = GUARD_MS,
+    };
+    const struct raw154_arq_cfg arq = {
+        .ack_req = ACK_REQUEST,
+        .max_retries = MAX_RETRIES,
+        .ack_timeout_us = ACK_TIMEOUT_US,
+        .backoff_ms = BACKOFF_MS,
+    };
+    const struct raw154_txp_cfg txp = {
+        .adaptive = ADAPTIVE_TX_POWER,
+        .min_dbm = TX_POWER_MIN_DBM,
+        .max_dbm = TX_POWER_MAX_DBM,
+        .step_db = TX_POWER_STEP_DB,
+        .target_permille = TX_TARGET_PERMILLE,
+        .rssi_floor_dbm = RSSI_FLOOR_DBM,
+    };
+
     LOG_INF("Initializing IEEE 802.15.4");
 
-    if (!device_is_ready(ieee802154_dev)) {
-        LOG_ERR("IEEE 802.15.4 device not ready");
+    /* Set the channel */
+    if (raw154_init(&node, ieee802154_dev, IEEE802154_PAN_ID,
+                    IEEE802154_SHORT_ADDR, IEEE802154_CHANNEL, NULL) < 0) {
         return false;
     }
 
-    radio_api = (struct ieee802154_radio_api *)ieee802154_dev->api;
+    /* Channel switches are only taken from the receiver */
+    raw154_chan_follow(&node, RX_SHORT_ADDR);
 
-    /* Set the channel */
-    radio_api->set_channel(ieee802154_dev, IEEE802154_CHANNEL);
+    /* Uses the radio's auto-ACK when it has one */
+    raw154_set_arq(&node, &arq);
+    raw154_set_txp(&node, &txp);
+
+    if (LINK_SECURITY && !init_security()) {
+        return false;
+    }
+    LOG_INF("ACK %s", ACK_REQUEST ?
+            ((node.caps & IEEE802154_HW_TX_RX_ACK) ? "in hardware" : "in software") :
+            "disabled");
 
-    /* Start the radio */
-    radio_api->start(ieee802154_dev);
+    /* The radio is only started while a frame is being delivered */
+    if (raw154_mac_start(&node, &mac) < 0) {
+        LOG_ERR("Invalid MAC configuration");
+        return false;
+    }
 
     return true;
 }
 
 /* Transmit a packet over the IEEE 802.15.4 interface */
-// void transmit_packet(struct net_if *iface)
-void transmit_packet(struct net_if *iface)
+void transmit_packet(void)
 {
-    struct net_pkt *pkt;
-       
+    static int failures;
+    const uint8_t payload[] = PAYLOAD;
+    const struct raw154_link *link;
+    int r;
+
     LOG_INF("Transmitting packet");
 
-    /* Allocate a packet buffer with the specified size */
-    pkt = net_pkt_alloc_with_buffer(iface, TX_PACKET_SIZE, AF_UNSPEC, 0, K_NO_WAIT);
-    // net_pkt_alloc_buffer_raw(pkt, TX_PACKET_SIZE, K_NO_WAIT);
-    	
-    if (!pkt) {
-        LOG_ERR("Failed to allocate packet buffer");
-        return;
+    if (raw154_send(&node, RX_SHORT_ADDR, payload, sizeof(payload)) < 0) {
+        LOG_ERR("Failed to transmit packet");
+        failures++;
+    } else {
+        LOG_INF("Packet transmitted successfully");
+        failures = 0;
     }
 
-    /* Write data to the packet */
-    if (net_pkt_write(pkt, frame, sizeof(frame))) {
-        LOG_ERR("Failed to write data to packet");
-        net_pkt_unref(pkt);
-        return;
+    if (ACK_REQUEST && failures >= FIND_AFTER_FAILURES) {
+        r = raw154_chan_find(&node, CHANNEL_MASK, RX_SHORT_ADDR);
+        if (r < 0) {
+            LOG_WRN("Receiver not found on any channel");
+        } else {
+            LOG_INF("Receiver found on channel %d", r);
+        }
+        failures = 0;
     }
 
-    /* Transmit the packet using the radio API with CSMA-CA mode */
-    if (radio_api->tx(ieee802154_dev, IEEE802154_TX_MODE_CSMA_CA, pkt, pkt->buffer) < 0) {
-        LOG_ERR("Failed to transmit packet");
-    } else {
-        LOG_INF("Packet transmitted successfully");
+    LOG_DBG("acked %u, retries %u, given up %u", node.stats.tx_acked,
+            node.stats.tx_retries, node.stats.tx_no_ack);
+
+    link = raw154_link_get(&node, RX_SHORT_ADDR);
+    if (link) {
+        LOG_DBG("link: %d dBm, delivery %u permille, rssi %d dBm, lqi %u",
+                link->tx_power, link->delivery, link->rssi / 16,
+                link->lqi / 16);
     }
+}
+
+/**
+ * Interface to the network stack, will be called when the packet is
+ * received (beacons of the slotted MAC, ACKs without hardware ACK)
+ */
+int net_recv_data(struct net_if *iface, struct net_pkt *pkt)
+{
+    raw154_input(&node, pkt);
 
-    /* Free the packet */
-    net_pkt_unref(pkt);
+    return 0;
 }
 
-void main(void)
+/* Called by drivers that pass ACK frames up separately */
+enum net_verdict ieee802154_handle_ack(struct net_if *iface, struct net_pkt *pkt)
+{
+    return raw154_handle_ack(&node, pkt);
+}
+
+int main(void)
 {
-    uint8_t seq_num;
     /* Initialize the IEEE 802.15.4 device */
     if (!init_ieee802154()) {
         LOG_ERR("Unable to initialize ieee802154");
-        return;
+        return 0;
     }
-    
-    struct net_if *iface = net_if_get_default();
-    
+
     while (1) {
         /* Transmit packets every 1 second */
-        construct_frame(++seq_num);
-        transmit_packet(iface);
+        transmit_packet();
         k_sleep(K_MSEC(1000));
     }
 
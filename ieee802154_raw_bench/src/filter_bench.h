@@ -0,0 +1,11 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FILTER_BENCH_H_
+#define FILTER_BENCH_H_
+
+/* Print the receive filter cost for a range of allow-list sizes */
+void filter_bench_run(void);
+
+#endif /* FILTER_BENCH_H_ */
@@ -0,0 +1,669 @@
+/*
+ * Raw IEEE 802.15.4 link layer bench on simulated radios.
+ *
+ * A sender node streams timestamped messages to a listener node over
+ * sim_radio, once per MAC mode, and reports delivery ratio, delivery
+ * latency and how long each radio was on.
+ *
+ * A second run sends back to back over an always-on link with injected
+ * loss, with and without acknowledgements, and reports delivery ratio and
+ * goodput. A third run compares energy per delivered frame at fixed full
+ * TX power and with adaptive TX power, for a near and a far neighbour. A
+ * fourth puts an interferer on the channel and compares staying there with
+ * letting the listener scan and move both nodes to the quietest channel.
+ * A fifth sends 256 B to 4 KB messages fragmented over a lossy link and
+ * reports goodput and how many fragments had to be resent.
+ *
+ * Last, filter_bench.c times the receive filter and sec_bench.c what
+ * link-layer security costs per frame.
+ *
+ * Runs with a pass criterion print "<run> check done" or "<run> check
+ * failed: <reason>" after their results; sample.yaml has a scenario for each.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/random/random.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/printk.h>
+#include <string.h>
+
+#include "raw154.h"
+#include "sim_radio.h"
+#include "filter_bench.h"
+#include "sec_bench.h"
+
+/*
+ * Runs to do, can be set from the build with -DBENCH_RUN=BENCH_MAC (or an
+ * OR of several), all of them by default.
+ */
+#define BENCH_MAC	 BIT(0)
+#define BENCH_ARQ	 BIT(1)
+#define BENCH_TXP	 BIT(2)
+#define BENCH_NOISE	 BIT(3)
+#define BENCH_FRAG	 BIT(4)
+#define BENCH_FILTER	 BIT(5)
+#define BENCH_SEC	 BIT(6)
+#ifndef BENCH_RUN
+#define BENCH_RUN	 UINT32_MAX
+#endif
+
+#define BENCH_CHANNEL	 15
+#define BENCH_PAN_ID	 0xABCD
+#define SENDER_ADDR	 0x0001
+#define LISTENER_ADDR	 0x0002
+
+#define NUM_MESSAGES	 50
+/* Mean gap between two messages, +/- half of it */
+#define MSG_INTERVAL_MS	 1000
+
+/* Air loss applied to every frame */
+#define LOSS_PERMILLE	 0
+
+/*
+ * MAC check: each mode delivers at least this much, without duplicates,
+ * and the duty-cycled listeners keep their radio off most of the time
+ */
+#define MAC_MIN_DELIVERY_PERMILLE 900
+#define MAC_MAX_DUTY_PERMILLE	 100
+
+/* Loss sweep for the acknowledged delivery run */
+#define ARQ_MESSAGES	 200
+#define ARQ_PAYLOAD_LEN	 64
+#define ARQ_MAX_RETRIES	 3
+#define ARQ_ACK_TIMEOUT_US 1000
+#define ARQ_BACKOFF_MS	 2
+
+/*
+ * ARQ check: without loss every setup delivers this much, and from this
+ * loss on acknowledgements must deliver more than no-ack
+ */
+#define ARQ_MIN_DELIVERY_PERMILLE 950
+#define ARQ_GAIN_LOSS_PERMILLE	 200
+
+/* Adaptive TX power run */
+#define TXP_MESSAGES	 300
+#define TXP_MIN_DBM	 -20
+#define TXP_MAX_DBM	 20
+#define TXP_STEP_DB	 2
+#define TXP_TARGET_PERMILLE 950
+#define TXP_RSSI_FLOOR_DBM -85
+
+/* Noisy channel run: interferer on BENCH_CHANNEL */
+#define NOISE_DBM	 -60
+#define NOISE_BUSY_PERMILLE 500
+#define SCAN_MS		 5
+
+/* Fragmented message run */
+#define FRAG_MESSAGES	 10
+
+/*
+ * Frag check: up to this loss every message is delivered and confirmed,
+ * resending at most 1/FRAG_MAX_RETX_SHARE of the fragments
+ */
+#define FRAG_RELIABLE_LOSS_PERMILLE 50
+#define FRAG_MAX_RETX_SHARE	 4
+
+#define WAKEUP_PERIOD_MS 250
+#define LISTEN_MS	 5
+#define STROBE_GAP_US	 500
+#define GUARD_MS	 2
+
+struct scenario {
+	const char *name;
+	enum raw154_mac_mode mode;
+};
+
+static const struct scenario scenarios[] = {
+	{ "always-on", RAW154_MAC_ALWAYS_ON },
+	{ "lpl", RAW154_MAC_LPL },
+	{ "slotted", RAW154_MAC_SLOTTED },
+};
+
+struct arq_scenario {
+	const char *name;
+	bool ack_req;
+	enum ieee802154_hw_caps caps;
+};
+
+static const struct arq_scenario arq_scenarios[] = {
+	{ "no-ack", false, 0 },
+	{ "sw-ack", true, 0 },
+	{ "hw-ack", true, IEEE802154_HW_FILTER | IEEE802154_HW_TX_RX_ACK |
+			  IEEE802154_HW_RX_TX_ACK },
+};
+
+static const uint32_t arq_loss_permille[] = { 0, 50, 200, 400 };
+
+/* Delivered without ACKs, per loss rate, to compare the ACK setups with */
+static uint32_t no_ack_received[ARRAY_SIZE(arq_loss_permille)];
+
+/* Path loss between sender and listener for the TX power run */
+static const uint8_t txp_path_loss_db[] = { 70, 100 };
+
+static const uint16_t frag_msg_len[] = { 256, 512, 1024, 2048, 4096 };
+static const uint32_t frag_loss_permille[] = { 0, 50, 200 };
+
+/* Message payload: sequence number and send time */
+struct bench_msg {
+	uint32_t id;
+	uint32_t sent;
+};
+
+struct bench_result {
+	uint32_t received;
+	uint64_t latency_sum;
+	uint32_t latency_max;
+};
+
+static struct raw154 sender;
+static struct raw154 listener;
+static struct bench_result result;
+static uint8_t frag_msg[RAW154_FRAG_MSG_MAX];
+
+/* First expectation the current run missed, NULL if none */
+static const char *check_error;
+
+static void expect(bool ok, const char *what)
+{
+	if (!ok && check_error == NULL) {
+		check_error = what;
+	}
+}
+
+static void check_done(const char *run)
+{
+	if (check_error != NULL) {
+		printk("%s check failed: %s\n", run, check_error);
+	} else {
+		printk("%s check done\n", run);
+	}
+
+	check_error = NULL;
+}
+
+static void radio_rx(const struct device *dev, struct net_pkt *pkt,
+		     void *user_data)
+{
+	raw154_input(user_data, pkt);
+}
+
+static void listener_recv(struct raw154 *node, const struct raw154_hdr *hdr,
+			  const uint8_t *payload, size_t len, uint8_t lqi)
+{
+	uint32_t latency;
+
+	if (len < sizeof(struct bench_msg)) {
+		return;
+	}
+
+	latency = k_cycle_get_32() -
+		  sys_get_le32(payload + offsetof(struct bench_msg, sent));
+
+	result.received++;
+	result.latency_sum += latency;
+	result.latency_max = MAX(result.latency_max, latency);
+}
+
+static void listener_msg_recv(struct raw154 *node, uint16_t src,
+			      const uint8_t *msg, size_t len)
+{
+	if (memcmp(msg, frag_msg, len) == 0) {
+		result.received++;
+	}
+}
+
+static int setup_nodes(enum ieee802154_hw_caps caps)
+{
+	int r;
+
+	memset(&result, 0, sizeof(result));
+
+	sim_radio_set_caps(sim_radio_get(0), caps);
+	sim_radio_set_caps(sim_radio_get(1), caps);
+
+	r = raw154_init(&listener, sim_radio_get(1), BENCH_PAN_ID,
+			LISTENER_ADDR, BENCH_CHANNEL, listener_recv);
+	r = r ?: raw154_init(&sender, sim_radio_get(0), BENCH_PAN_ID,
+			     SENDER_ADDR, BENCH_CHANNEL, NULL);
+	if (r < 0) {
+		return r;
+	}
+
+	raw154_set_msg_recv(&listener, listener_msg_recv);
+	sim_radio_set_rx(listener.dev, radio_rx, &listener);
+	sim_radio_set_rx(sender.dev, radio_rx, &sender);
+
+	return 0;
+}
+
+static void teardown_nodes(void)
+{
+	raw154_mac_stop(&sender);
+	raw154_mac_stop(&listener);
+
+	/* Flush frames still queued in the simulated radios */
+	k_msleep(10);
+}
+
+static void put_msg(uint8_t *payload, uint32_t id)
+{
+	sys_put_le32(id, payload + offsetof(struct bench_msg, id));
+	sys_put_le32(k_cycle_get_32(),
+		     payload + offsetof(struct bench_msg, sent));
+}
+
+static int run_scenario(const struct scenario *sc)
+{
+	struct raw154_mac_cfg mac = {
+		.mode = sc->mode,
+		.period_ms = WAKEUP_PERIOD_MS,
+		.listen_ms = LISTEN_MS,
+		.strobe_gap_us = STROBE_GAP_US,
+		.guard_ms = GUARD_MS,
+	};
+	uint8_t payload[sizeof(struct bench_msg)];
+	uint32_t rx_duty, tx_duty;
+	int64_t start;
+	int r;
+
+	r = setup_nodes(0);
+	if (r < 0) {
+		return r;
+	}
+
+	start = k_uptime_ticks();
+
+	mac.listener = true;
+	r = raw154_mac_start(&listener, &mac);
+	mac.listener = false;
+	r = r ?: raw154_mac_start(&sender, &mac);
+	if (r < 0) {
+		return r;
+	}
+
+	for (uint32_t i = 0; i < NUM_MESSAGES; i++) {
+		k_msleep(MSG_INTERVAL_MS / 2 +
+			 sys_rand32_get() % MSG_INTERVAL_MS);
+
+		put_msg(payload, i);
+		raw154_send(&sender, LISTENER_ADDR, payload, sizeof(payload));
+	}
+
+	/* Let the last strobes and windows play out */
+	k_msleep(2 * WAKEUP_PERIOD_MS);
+
+	rx_duty = raw154_duty_cycle_permille(&listener, start);
+	tx_duty = raw154_duty_cycle_permille(&sender, start);
+
+	printk("%-10s %3u/%u delivered, latency avg %u ms max %u ms, "
+	       "%u frames sent, radio on: listener %u.%u%% sender %u.%u%%\n",
+	       sc->name, result.received, NUM_MESSAGES,
+	       result.received ?
+	       k_cyc_to_ms_floor32(result.latency_sum / result.received) : 0,
+	       k_cyc_to_ms_floor32(result.latency_max), sender.stats.tx_frames,
+	       rx_duty / 10, rx_duty % 10, tx_duty / 10, tx_duty % 10);
+
+	expect(result.received * 1000 >= NUM_MESSAGES * MAC_MIN_DELIVERY_PERMILLE,
+	       "delivery ratio too low");
+	expect(result.received <= NUM_MESSAGES, "strobed copies delivered");
+	expect(sc->mode == RAW154_MAC_ALWAYS_ON ||
+	       rx_duty <= MAC_MAX_DUTY_PERMILLE, "listener radio on too long");
+
+	teardown_nodes();
+
+	return 0;
+}
+
+static int run_arq_scenario(const struct arq_scenario *sc, int loss_idx)
+{
+	uint32_t loss = arq_loss_permille[loss_idx];
+	const struct raw154_mac_cfg mac = {
+		.mode = RAW154_MAC_ALWAYS_ON,
+	};
+	const struct raw154_arq_cfg arq = {
+		.ack_req = sc->ack_req,
+		.max_retries = ARQ_MAX_RETRIES,
+		.ack_timeout_us = ARQ_ACK_TIMEOUT_US,
+		.backoff_ms = ARQ_BACKOFF_MS,
+	};
+	uint8_t payload[ARQ_PAYLOAD_LEN] = { 0 };
+	uint32_t elapsed_ms;
+	int64_t start;
+	int r;
+
+	r = setup_nodes(sc->caps);
+	r = r ?: raw154_mac_start(&listener, &mac);
+	r = r ?: raw154_mac_start(&sender, &mac);
+	if (r < 0) {
+		return r;
+	}
+
+	raw154_set_arq(&sender, &arq);
+	sim_radio_set_loss(loss);
+
+	start = k_uptime_get();
+
+	for (uint32_t i = 0; i < ARQ_MESSAGES; i++) {
+		put_msg(payload, i);
+		raw154_send(&sender, LISTENER_ADDR, payload, sizeof(payload));
+	}
+
+	elapsed_ms = MAX(k_uptime_get() - start, 1);
+
+	/* Frames still in the listener's queue count as delivered */
+	k_msleep(10);
+
+	printk("%-7s loss %3u permille: %3u/%u delivered, %5u B/s, "
+	       "%u retries, %u given up, %u duplicates dropped\n",
+	       sc->name, loss, result.received, ARQ_MESSAGES,
+	       result.received * ARQ_PAYLOAD_LEN * 1000 / elapsed_ms,
+	       sender.stats.tx_retries, sender.stats.tx_no_ack,
+	       listener.stats.rx_dup);
+
+	/* Retransmits of frames whose ACK was lost must not come up again */
+	expect(result.received <= ARQ_MESSAGES, "duplicates delivered");
+	expect(loss > 0 ||
+	       result.received * 1000 >= ARQ_MESSAGES * ARQ_MIN_DELIVERY_PERMILLE,
+	       "frames lost without loss");
+
+	if (!sc->ack_req) {
+		no_ack_received[loss_idx] = result.received;
+	} else if (loss >= ARQ_GAIN_LOSS_PERMILLE) {
+		expect(result.received > no_ack_received[loss_idx],
+		       "ACKs do not improve delivery");
+	}
+
+	sim_radio_set_loss(0);
+	teardown_nodes();
+
+	return 0;
+}
+
+static int run_txp_scenario(bool adaptive, uint8_t path_loss)
+{
+	const struct raw154_mac_cfg mac = {
+		.mode = RAW154_MAC_ALWAYS_ON,
+	};
+	const struct raw154_arq_cfg arq = {
+		.ack_req = true,
+		.max_retries = ARQ_MAX_RETRIES,
+		.ack_timeout_us = ARQ_ACK_TIMEOUT_US,
+		.backoff_ms = ARQ_BACKOFF_MS,
+	};
+	struct raw154_txp_cfg txp = {
+		.adaptive = false,
+		.min_dbm = TXP_MIN_DBM,
+		.max_dbm = TXP_MAX_DBM,
+		.step_db = TXP_STEP_DB,
+		.target_permille = TXP_TARGET_PERMILLE,
+		.rssi_floor_dbm = TXP_RSSI_FLOOR_DBM,
+	};
+	uint8_t payload[ARQ_PAYLOAD_LEN] = { 0 };
+	const struct raw154_link *link;
+	uint64_t energy;
+	int r;
+
+	r = setup_nodes(0);
+	r = r ?: raw154_mac_start(&listener, &mac);
+	r = r ?: raw154_mac_start(&sender, &mac);
+	if (r < 0) {
+		return r;
+	}
+
+	sim_radio_set_path_loss(sender.dev, listener.dev, path_loss);
+	raw154_set_arq(&sender, &arq);
+	raw154_set_txp(&listener, &txp);
+	txp.adaptive = adaptive;
+	raw154_set_txp(&sender, &txp);
+
+	energy = sim_radio_tx_energy_nj(sender.dev);
+
+	for (uint32_t i = 0; i < TXP_MESSAGES; i++) {
+		put_msg(payload, i);
+		raw154_send(&sender, LISTENER_ADDR, payload, sizeof(payload));
+	}
+
+	k_msleep(10);
+
+	energy = sim_radio_tx_energy_nj(sender.dev) - energy;
+	energy = result.received ? energy / result.received : 0;
+	link = raw154_link_get(&sender, LISTENER_ADDR);
+
+	printk("%-8s path loss %3u dB: %3u/%u delivered, %u retries, "
+	       "%4u.%03u uJ/frame, ended at %d dBm, ack rssi %d dBm lqi %u\n",
+	       adaptive ? "adaptive" : "fixed", path_loss, result.received,
+	       TXP_MESSAGES, sender.stats.tx_retries,
+	       (uint32_t)(energy / 1000), (uint32_t)(energy % 1000),
+	       link ? link->tx_power : TXP_MAX_DBM,
+	       link ? link->rssi / 16 : 0, link ? link->lqi / 16 : 0);
+
+	sim_radio_set_path_loss(sender.dev, listener.dev, 60);
+	teardown_nodes();
+
+	return 0;
+}
+
+static int run_noise_scenario(bool select)
+{
+	const struct raw154_mac_cfg mac = {
+		.mode = RAW154_MAC_ALWAYS_ON,
+	};
+	const struct raw154_arq_cfg arq = {
+		.ack_req = true,
+		.max_retries = ARQ_MAX_RETRIES,
+		.ack_timeout_us = ARQ_ACK_TIMEOUT_US,
+		.backoff_ms = ARQ_BACKOFF_MS,
+	};
+	uint8_t payload[ARQ_PAYLOAD_LEN] = { 0 };
+	struct raw154_chan_scan scan;
+	uint32_t checks, busy, checks0, busy0;
+	uint32_t elapsed_ms;
+	int64_t start;
+	int r;
+
+	r = setup_nodes(0);
+	r = r ?: raw154_mac_start(&listener, &mac);
+	r = r ?: raw154_mac_start(&sender, &mac);
+	if (r < 0) {
+		return r;
+	}
+
+	raw154_set_arq(&sender, &arq);
+	raw154_chan_follow(&sender, LISTENER_ADDR);
+
+	if (select) {
+		r = raw154_chan_select(&listener, RAW154_CHAN_MASK_2_4_GHZ,
+				       SCAN_MS, &scan);
+		if (r < 0) {
+			teardown_nodes();
+			return r;
+		}
+
+		printk("scan: channel %u at %d, picked %u at %d, "
+		       "sender followed to %u\n", BENCH_CHANNEL,
+		       scan.energy[BENCH_CHANNEL], scan.best,
+		       scan.energy[scan.best], sender.channel);
+	}
+
+	sim_radio_cca_stats(sender.dev, &checks0, &busy0);
+	start = k_uptime_get();
+
+	for (uint32_t i = 0; i < ARQ_MESSAGES; i++) {
+		put_msg(payload, i);
+		raw154_send(&sender, LISTENER_ADDR, payload, sizeof(payload));
+	}
+
+	elapsed_ms = MAX(k_uptime_get() - start, 1);
+	k_msleep(10);
+
+	sim_radio_cca_stats(sender.dev, &checks, &busy);
+	checks -= checks0;
+	busy -= busy0;
+
+	printk("%-7s channel %2u: %3u/%u delivered, %5u B/s, CCA busy "
+	       "%u/%u, %u access failures, %u retries\n",
+	       select ? "moved" : "stayed", sender.channel, result.received,
+	       ARQ_MESSAGES, result.received * ARQ_PAYLOAD_LEN * 1000 / elapsed_ms,
+	       busy, checks, sender.stats.tx_cca_fail, sender.stats.tx_retries);
+
+	teardown_nodes();
+
+	return 0;
+}
+
+static int run_frag_scenario(size_t len, uint32_t loss)
+{
+	const struct raw154_mac_cfg mac = {
+		.mode = RAW154_MAC_ALWAYS_ON,
+	};
+	const struct raw154_arq_cfg arq = {
+		.ack_req = true,
+		.max_retries = ARQ_MAX_RETRIES,
+		.ack_timeout_us = ARQ_ACK_TIMEOUT_US,
+		.backoff_ms = ARQ_BACKOFF_MS,
+	};
+	uint32_t elapsed_ms;
+	uint32_t sent = 0;
+	int64_t start;
+	int r;
+
+	r = setup_nodes(0);
+	r = r ?: raw154_mac_start(&listener, &mac);
+	r = r ?: raw154_mac_start(&sender, &mac);
+	if (r < 0) {
+		return r;
+	}
+
+	raw154_set_arq(&sender, &arq);
+	sim_radio_set_loss(loss);
+
+	for (size_t i = 0; i < len; i++) {
+		frag_msg[i] = sys_rand32_get();
+	}
+
+	start = k_uptime_get();
+
+	for (uint32_t i = 0; i < FRAG_MESSAGES; i++) {
+		if (raw154_send_msg(&sender, LISTENER_ADDR, frag_msg, len) == 0) {
+			sent++;
+		}
+	}
+
+	elapsed_ms = MAX(k_uptime_get() - start, 1);
+
+	/* The listener confirms the last message before passing it up */
+	k_msleep(10);
+
+	printk("%4u B loss %3u permille: %2u/%u delivered (%u confirmed), "
+	       "%5u B/s, %u fragments + %u resent, %u duplicates\n",
+	       (uint32_t)len, loss, result.received, FRAG_MESSAGES, sent,
+	       (uint32_t)(result.received * len * 1000 / elapsed_ms),
+	       sender.stats.frag_tx, sender.stats.frag_retx,
+	       listener.stats.frag_dup);
+
+	expect(result.received <= FRAG_MESSAGES, "message delivered twice");
+	expect(sent <= result.received, "message confirmed but not delivered");
+	if (loss <= FRAG_RELIABLE_LOSS_PERMILLE) {
+		expect(result.received == FRAG_MESSAGES && sent == FRAG_MESSAGES,
+		       "message lost on a reliable link");
+		/* Only the missing fragments go again, not whole messages */
+		expect(sender.stats.frag_retx * FRAG_MAX_RETX_SHARE <=
+		       sender.stats.frag_tx, "too many fragments resent");
+	}
+
+	sim_radio_set_loss(0);
+	teardown_nodes();
+
+	return 0;
+}
+
+int main(void)
+{
+	sim_radio_set_loss(LOSS_PERMILLE);
+
+	printk("Raw 802.15.4 bench: %u messages, wake-up %u ms, listen %u ms, "
+	       "loss %u permille\n", NUM_MESSAGES, WAKEUP_PERIOD_MS, LISTEN_MS,
+	       LOSS_PERMILLE);
+
+	if (BENCH_RUN & BENCH_MAC) {
+		for (int i = 0; i < ARRAY_SIZE(scenarios); i++) {
+			if (run_scenario(&scenarios[i]) < 0) {
+				printk("%s: setup failed\n", scenarios[i].name);
+				expect(false, "setup failed");
+			}
+		}
+
+		check_done("mac");
+	}
+
+	if (BENCH_RUN & BENCH_ARQ) {
+		printk("Acknowledged delivery: %u x %u B back to back, "
+		       "%u retries\n", ARQ_MESSAGES, ARQ_PAYLOAD_LEN,
+		       ARQ_MAX_RETRIES);
+
+		for (int i = 0; i < ARRAY_SIZE(arq_scenarios); i++) {
+			for (int j = 0; j < ARRAY_SIZE(arq_loss_permille); j++) {
+				if (run_arq_scenario(&arq_scenarios[i], j) < 0) {
+					printk("%s: setup failed\n",
+					       arq_scenarios[i].name);
+					expect(false, "setup failed");
+				}
+			}
+		}
+
+		check_done("arq");
+	}
+
+	if (BENCH_RUN & BENCH_TXP) {
+		printk("TX power: %u x %u B acknowledged, %d to %d dBm\n",
+		       TXP_MESSAGES, ARQ_PAYLOAD_LEN, TXP_MIN_DBM, TXP_MAX_DBM);
+
+		for (int i = 0; i < ARRAY_SIZE(txp_path_loss_db); i++) {
+			run_txp_scenario(false, txp_path_loss_db[i]);
+			run_txp_scenario(true, txp_path_loss_db[i]);
+		}
+	}
+
+	if (BENCH_RUN & BENCH_NOISE) {
+		printk("Noisy channel: interferer on channel %u at %d dBm, "
+		       "busy %u permille\n", BENCH_CHANNEL, NOISE_DBM,
+		       NOISE_BUSY_PERMILLE);
+
+		sim_radio_set_noise(BENCH_CHANNEL, NOISE_DBM,
+				    NOISE_BUSY_PERMILLE);
+		run_noise_scenario(false);
+		run_noise_scenario(true);
+		sim_radio_set_noise(BENCH_CHANNEL, 0, 0);
+	}
+
+	if (BENCH_RUN & BENCH_FRAG) {
+		printk("Fragmentation: %u messages per size, %u B per "
+		       "fragment\n", FRAG_MESSAGES, RAW154_FRAG_DATA);
+
+		for (int i = 0; i < ARRAY_SIZE(frag_msg_len); i++) {
+			for (int j = 0; j < ARRAY_SIZE(frag_loss_permille); j++) {
+				if (run_frag_scenario(frag_msg_len[i],
+						      frag_loss_permille[j]) < 0) {
+					printk("frag: setup failed\n");
+					expect(false, "setup failed");
+				}
+			}
+		}
+
+		check_done("frag");
+	}
+
+	if (BENCH_RUN & BENCH_FILTER) {
+		filter_bench_run();
+	}
+
+	if (BENCH_RUN & BENCH_SEC) {
+		sec_bench_run();
+	}
+
+	printk("bench done\n");
+
+	return 0;
+}
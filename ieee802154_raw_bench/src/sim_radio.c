@@ -0,0 +1,543 @@
+/*
+ * Simulated IEEE 802.15.4 radios, see sim_radio.h
+ *
+ * Transmission busy-waits for the frame airtime at 250 kbit/s, then copies
+ * the frame into an RX packet for every radio listening on the channel.
+ * Each radio hands its packets to the rx callback from its own thread, like
+ * a driver's RX thread would. Frames are parsed only as far as needed for
+ * the simulated address filter and auto-ACK.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/net/ieee802154_radio.h>
+#include <zephyr/random/random.h>
+#include <zephyr/sys/byteorder.h>
+#include <errno.h>
+
+#include "sim_radio.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(sim_radio, LOG_LEVEL_INF);
+
+/* O-QPSK 2.4 GHz: 32 us per byte on air */
+#define SIM_BYTE_US	32
+/* Preamble, SFD and PHR ahead of the PSDU */
+#define SIM_SHR_PHR_LEN 6
+/* RX to TX turnaround before an ACK */
+#define SIM_TURNAROUND_US 192
+#define SIM_ACK_LEN	5
+
+#define SIM_DEFAULT_CAPS (IEEE802154_HW_FCS | IEEE802154_HW_2_4_GHZ | \
+			  IEEE802154_HW_CSMA | IEEE802154_HW_ENERGY_SCAN)
+
+/*
+ * Link budget: frames arrive at tx power minus path loss and are lost
+ * below the sensitivity; within SIM_FADE_DB above it the loss rate falls
+ * linearly from 100% to none.
+ */
+#define SIM_MIN_DBM	  -20
+#define SIM_MAX_DBM	  20
+#define SIM_DEFAULT_DBM	  0
+#define SIM_PATH_LOSS_DB  60
+#define SIM_SENSITIVITY_DBM -97
+#define SIM_FADE_DB	  8
+
+/*
+ * Interference: a channel with noise is busy busy_permille of the time at
+ * noise_dbm. CCA reports busy above SIM_CCA_DBM, ED reports the strongest
+ * level seen during the scan.
+ */
+#define SIM_NOISE_FLOOR_DBM -100
+#define SIM_CCA_DBM	  -75
+#define SIM_ED_SAMPLE_US  128
+
+/* CSMA-CA: macMinBE 3, macMaxBE 5, macMaxCSMABackoffs 4, 320 us unit */
+#define SIM_CSMA_MIN_BE	  3
+#define SIM_CSMA_MAX_BE	  5
+#define SIM_CSMA_BACKOFFS 4
+#define SIM_BACKOFF_US	  320
+
+/* TX power draw: radio core plus PA output at SIM_PA_EFF_PERCENT */
+#define SIM_TX_BASE_UW	  15000
+#define SIM_PA_EFF_PERCENT 30
+
+struct sim_radio_data {
+	bool started;
+	enum ieee802154_hw_caps caps;
+	uint16_t channel;
+	int16_t tx_power;
+	uint16_t pan_id;
+	uint16_t short_addr;
+	uint64_t tx_energy_nj;
+	uint32_t cca_checks;
+	uint32_t cca_busy;
+	struct k_fifo rx_fifo;
+	sim_radio_rx_t rx_cb;
+	void *user_data;
+};
+
+static uint32_t loss_permille;
+
+struct sim_noise {
+	int8_t dbm;
+	uint16_t busy_permille;
+};
+
+static struct sim_noise noise[SIM_RADIO_MAX_CHANNEL + 1];
+
+static bool channel_busy(uint16_t channel)
+{
+	return noise[channel].busy_permille &&
+	       (sys_rand32_get() % 1000) < noise[channel].busy_permille;
+}
+static uint8_t path_loss_db[SIM_RADIO_COUNT][SIM_RADIO_COUNT];
+
+static int radio_index(const struct device *dev)
+{
+	for (int i = 0; i < SIM_RADIO_COUNT; i++) {
+		if (sim_radio_get(i) == dev) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static int8_t rx_power(const struct device *from, const struct device *to)
+{
+	struct sim_radio_data *data = from->data;
+
+	return data->tx_power - path_loss_db[radio_index(from)][radio_index(to)];
+}
+
+static bool frame_lost(int8_t rssi)
+{
+	int margin = rssi - SIM_SENSITIVITY_DBM;
+	uint32_t permille = loss_permille;
+
+	if (margin < 0) {
+		return true;
+	}
+
+	if (margin < SIM_FADE_DB) {
+		permille += (SIM_FADE_DB - margin) * 1000 / SIM_FADE_DB;
+	}
+
+	return permille && (sys_rand32_get() % 1000) < permille;
+}
+
+/* 0 to 9 dBm in uW, for the decade scaling below */
+static const uint16_t dbm_uw[10] = {
+	1000, 1259, 1585, 1995, 2512, 3162, 3981, 5012, 6310, 7943,
+};
+
+static uint32_t dbm_to_uw(int dbm)
+{
+	int decades = (dbm + 100) / 10 - 10;
+	uint32_t uw = dbm_uw[(dbm + 100) % 10];
+
+	for (; decades > 0; decades--) {
+		uw *= 10;
+	}
+	for (; decades < 0; decades++) {
+		uw /= 10;
+	}
+
+	return uw;
+}
+
+static void account_tx(struct sim_radio_data *data, uint32_t air_us)
+{
+	uint32_t draw_uw = SIM_TX_BASE_UW +
+			   dbm_to_uw(data->tx_power) * 100 / SIM_PA_EFF_PERCENT;
+
+	data->tx_energy_nj += (uint64_t)draw_uw * air_us / 1000;
+}
+
+/* LQI from the margin above sensitivity, saturating 40 dB up */
+static uint8_t rssi_to_lqi(int8_t rssi)
+{
+	int margin = CLAMP(rssi - SIM_SENSITIVITY_DBM, 0, 40);
+
+	return margin * 255 / 40;
+}
+
+static void deliver(const struct device *dev, const uint8_t *frame, size_t len,
+		    int8_t rssi)
+{
+	struct sim_radio_data *data = dev->data;
+	struct net_pkt *pkt;
+
+	pkt = net_pkt_rx_alloc_with_buffer(NULL, len, AF_UNSPEC, 0, K_NO_WAIT);
+	if (!pkt) {
+		LOG_WRN("No RX packet");
+		return;
+	}
+
+	if (net_pkt_write(pkt, frame, len) < 0) {
+		net_pkt_unref(pkt);
+		return;
+	}
+
+	net_pkt_set_ieee802154_lqi(pkt, rssi_to_lqi(rssi));
+	net_pkt_set_ieee802154_rssi(pkt, rssi);
+	k_fifo_put(&data->rx_fifo, pkt);
+}
+
+/* Destination of a frame with short or no addressing */
+static bool frame_dst(const uint8_t *frame, size_t len, uint16_t *pan,
+		      uint16_t *addr)
+{
+	uint16_t fcf = sys_get_le16(frame);
+
+	if (((fcf >> 10) & 0x3) != 0x2 || len < 7) {
+		return false;
+	}
+
+	*pan = sys_get_le16(frame + 3);
+	*addr = sys_get_le16(frame + 5);
+
+	return true;
+}
+
+static bool accepts(struct sim_radio_data *data, const uint8_t *frame,
+		    size_t len)
+{
+	uint16_t pan, addr;
+
+	if (!(data->caps & IEEE802154_HW_FILTER) ||
+	    !frame_dst(frame, len, &pan, &addr)) {
+		return true;
+	}
+
+	return (pan == data->pan_id || pan == 0xffff) &&
+	       (addr == data->short_addr || addr == 0xffff);
+}
+
+/* Whether the receiver's hardware acknowledges this frame */
+static bool auto_acks(struct sim_radio_data *data, const uint8_t *frame,
+		      size_t len)
+{
+	uint16_t pan, addr;
+
+	return (data->caps & IEEE802154_HW_RX_TX_ACK) &&
+	       (frame[0] & BIT(5)) && frame_dst(frame, len, &pan, &addr) &&
+	       addr == data->short_addr;
+}
+
+static enum ieee802154_hw_caps sim_get_capabilities(const struct device *dev)
+{
+	struct sim_radio_data *data = dev->data;
+
+	return data->caps;
+}
+
+static int sim_cca(const struct device *dev)
+{
+	struct sim_radio_data *data = dev->data;
+	bool busy = channel_busy(data->channel) &&
+		    noise[data->channel].dbm > SIM_CCA_DBM;
+
+	data->cca_checks++;
+	if (busy) {
+		data->cca_busy++;
+	}
+
+	return busy ? -EBUSY : 0;
+}
+
+/* Unslotted CSMA-CA, returns -EBUSY on channel access failure */
+static int csma_ca(const struct device *dev)
+{
+	uint8_t be = SIM_CSMA_MIN_BE;
+
+	for (int nb = 0; nb <= SIM_CSMA_BACKOFFS; nb++) {
+		k_busy_wait((sys_rand32_get() % BIT(be)) * SIM_BACKOFF_US);
+
+		if (sim_cca(dev) == 0) {
+			return 0;
+		}
+
+		be = MIN(be + 1, SIM_CSMA_MAX_BE);
+	}
+
+	return -EBUSY;
+}
+
+static int sim_ed_scan(const struct device *dev, uint16_t duration,
+		       energy_scan_done_cb_t done_cb)
+{
+	struct sim_radio_data *data = dev->data;
+	uint32_t samples = MAX(duration * 1000U / SIM_ED_SAMPLE_US, 1U);
+	int16_t max_ed = SIM_NOISE_FLOOR_DBM;
+
+	for (uint32_t i = 0; i < samples; i++) {
+		if (channel_busy(data->channel)) {
+			max_ed = MAX(max_ed, noise[data->channel].dbm);
+		}
+	}
+
+	k_msleep(duration);
+	done_cb(dev, max_ed);
+
+	return 0;
+}
+
+static int sim_set_channel(const struct device *dev, uint16_t channel)
+{
+	struct sim_radio_data *data = dev->data;
+
+	if (channel < 11 || channel > SIM_RADIO_MAX_CHANNEL) {
+		return -EINVAL;
+	}
+
+	data->channel = channel;
+
+	return 0;
+}
+
+static int sim_filter(const struct device *dev, bool set,
+		      enum ieee802154_filter_type type,
+		      const struct ieee802154_filter *filter)
+{
+	struct sim_radio_data *data = dev->data;
+
+	if (!(data->caps & IEEE802154_HW_FILTER) || !set) {
+		return -ENOTSUP;
+	}
+
+	switch (type) {
+	case IEEE802154_FILTER_TYPE_PAN_ID:
+		data->pan_id = filter->pan_id;
+		return 0;
+	case IEEE802154_FILTER_TYPE_SHORT_ADDR:
+		data->short_addr = filter->short_addr;
+		return 0;
+	default:
+		return -ENOTSUP;
+	}
+}
+
+static int sim_set_txpower(const struct device *dev, int16_t dbm)
+{
+	struct sim_radio_data *data = dev->data;
+
+	if (dbm < SIM_MIN_DBM || dbm > SIM_MAX_DBM) {
+		return -EINVAL;
+	}
+
+	data->tx_power = dbm;
+
+	return 0;
+}
+
+static int sim_tx(const struct device *dev, enum ieee802154_tx_mode mode,
+		  struct net_pkt *pkt, struct net_buf *frag)
+{
+	struct sim_radio_data *data = dev->data;
+	uint32_t air_us = (SIM_SHR_PHR_LEN + frag->len + IEEE802154_FCS_LENGTH) *
+			  SIM_BYTE_US;
+	bool acked = false;
+
+	if (mode == IEEE802154_TX_MODE_CSMA_CA && csma_ca(dev) < 0) {
+		return -EBUSY;
+	}
+
+	k_busy_wait(air_us);
+	account_tx(data, air_us);
+
+	/* Without carrier sense we may talk over the interferer */
+	if (mode == IEEE802154_TX_MODE_DIRECT && channel_busy(data->channel) &&
+	    noise[data->channel].dbm > SIM_CCA_DBM) {
+		return 0;
+	}
+
+	for (int i = 0; i < SIM_RADIO_COUNT; i++) {
+		const struct device *peer = sim_radio_get(i);
+		struct sim_radio_data *peer_data = peer->data;
+		uint8_t ack[3];
+
+		if (peer == dev || !peer_data->started ||
+		    peer_data->channel != data->channel ||
+		    frame_lost(rx_power(dev, peer)) ||
+		    !accepts(peer_data, frag->data, frag->len)) {
+			continue;
+		}
+
+		deliver(peer, frag->data, frag->len, rx_power(dev, peer));
+
+		if (!auto_acks(peer_data, frag->data, frag->len) ||
+		    frame_lost(rx_power(peer, dev))) {
+			continue;
+		}
+
+		k_busy_wait(SIM_TURNAROUND_US +
+			    (SIM_SHR_PHR_LEN + SIM_ACK_LEN) * SIM_BYTE_US);
+		account_tx(peer_data, (SIM_SHR_PHR_LEN + SIM_ACK_LEN) * SIM_BYTE_US);
+
+		if (data->caps & IEEE802154_HW_TX_RX_ACK) {
+			acked = true;
+		} else if (data->started) {
+			/* Plain radio: the ACK goes up like any frame */
+			sys_put_le16(0x0002, ack);
+			ack[2] = frag->data[2];
+			deliver(dev, ack, sizeof(ack), rx_power(peer, dev));
+		}
+	}
+
+	if ((data->caps & IEEE802154_HW_TX_RX_ACK) && (frag->data[0] & BIT(5))) {
+		return acked ? 0 : -ENOMSG;
+	}
+
+	return 0;
+}
+
+static int sim_start(const struct device *dev)
+{
+	struct sim_radio_data *data = dev->data;
+
+	data->started = true;
+
+	return 0;
+}
+
+static int sim_stop(const struct device *dev)
+{
+	struct sim_radio_data *data = dev->data;
+
+	data->started = false;
+
+	return 0;
+}
+
+static const struct ieee802154_radio_api sim_radio_api = {
+	.get_capabilities = sim_get_capabilities,
+	.cca = sim_cca,
+	.set_channel = sim_set_channel,
+	.filter = sim_filter,
+	.set_txpower = sim_set_txpower,
+	.tx = sim_tx,
+	.start = sim_start,
+	.stop = sim_stop,
+	.ed_scan = sim_ed_scan,
+};
+
+static int sim_radio_init(const struct device *dev)
+{
+	struct sim_radio_data *data = dev->data;
+
+	int idx = radio_index(dev);
+
+	k_fifo_init(&data->rx_fifo);
+	data->caps = SIM_DEFAULT_CAPS;
+	data->channel = 11;
+	data->tx_power = SIM_DEFAULT_DBM;
+
+	for (int i = 0; i < SIM_RADIO_COUNT; i++) {
+		path_loss_db[idx][i] = SIM_PATH_LOSS_DB;
+	}
+
+	return 0;
+}
+
+static void sim_rx_thread(void *p1, void *p2, void *p3)
+{
+	const struct device *dev = p1;
+	struct sim_radio_data *data = dev->data;
+	struct net_pkt *pkt;
+
+	while (1) {
+		pkt = k_fifo_get(&data->rx_fifo, K_FOREVER);
+
+		if (data->rx_cb) {
+			data->rx_cb(dev, pkt, data->user_data);
+		} else {
+			net_pkt_unref(pkt);
+		}
+	}
+}
+
+#define SIM_RADIO_DEFINE(n)						\
+	static struct sim_radio_data sim_radio_data_##n;		\
+	DEVICE_DEFINE(sim_radio_##n, "sim_radio_" #n, sim_radio_init,	\
+		      NULL, &sim_radio_data_##n, NULL, POST_KERNEL,	\
+		      CONFIG_KERNEL_INIT_PRIORITY_DEVICE, &sim_radio_api); \
+	K_THREAD_DEFINE(sim_rx_##n, 2048, sim_rx_thread,		\
+			(void *)DEVICE_GET(sim_radio_##n), NULL, NULL,	\
+			K_PRIO_COOP(4), 0, 0)
+
+SIM_RADIO_DEFINE(0);
+SIM_RADIO_DEFINE(1);
+SIM_RADIO_DEFINE(2);
+
+static const struct device *const radios[SIM_RADIO_COUNT] = {
+	DEVICE_GET(sim_radio_0),
+	DEVICE_GET(sim_radio_1),
+	DEVICE_GET(sim_radio_2),
+};
+
+const struct device *sim_radio_get(int idx)
+{
+	if (idx < 0 || idx >= SIM_RADIO_COUNT) {
+		return NULL;
+	}
+
+	return radios[idx];
+}
+
+void sim_radio_set_rx(const struct device *dev, sim_radio_rx_t cb,
+		      void *user_data)
+{
+	struct sim_radio_data *data = dev->data;
+
+	data->user_data = user_data;
+	data->rx_cb = cb;
+}
+
+void sim_radio_set_caps(const struct device *dev, enum ieee802154_hw_caps caps)
+{
+	struct sim_radio_data *data = dev->data;
+
+	data->caps = SIM_DEFAULT_CAPS | caps;
+}
+
+void sim_radio_set_loss(uint32_t permille)
+{
+	loss_permille = MIN(permille, 1000U);
+}
+
+void sim_radio_set_path_loss(const struct device *a, const struct device *b,
+			     uint8_t db)
+{
+	path_loss_db[radio_index(a)][radio_index(b)] = db;
+	path_loss_db[radio_index(b)][radio_index(a)] = db;
+}
+
+uint64_t sim_radio_tx_energy_nj(const struct device *dev)
+{
+	struct sim_radio_data *data = dev->data;
+
+	return data->tx_energy_nj;
+}
+
+void sim_radio_set_noise(uint16_t channel, int8_t dbm, uint16_t busy_permille)
+{
+	if (channel > SIM_RADIO_MAX_CHANNEL) {
+		return;
+	}
+
+	noise[channel].dbm = dbm;
+	noise[channel].busy_permille = MIN(busy_permille, 1000U);
+}
+
+void sim_radio_cca_stats(const struct device *dev, uint32_t *checks,
+			 uint32_t *busy)
+{
+	struct sim_radio_data *data = dev->data;
+
+	*checks = data->cca_checks;
+	*busy = data->cca_busy;
+}
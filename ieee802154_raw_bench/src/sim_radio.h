@@ -0,0 +1,64 @@
+/*
+ * Simulated IEEE 802.15.4 radios sharing one lossy channel, for native_sim.
+ *
+ * Each radio implements struct ieee802154_radio_api. A frame sent by one
+ * radio is delivered, after its airtime, to every other radio that is
+ * started and tuned to the same channel, unless the channel drops it,
+ * either at random or because the signal arrives too weak.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef SIM_RADIO_H_
+#define SIM_RADIO_H_
+
+#include <zephyr/device.h>
+#include <zephyr/net/net_pkt.h>
+#include <zephyr/net/ieee802154_radio.h>
+
+#define SIM_RADIO_COUNT 3
+#define SIM_RADIO_MAX_CHANNEL 26
+
+/* Called from the radio's own RX thread, the packet must be consumed */
+typedef void (*sim_radio_rx_t)(const struct device *dev, struct net_pkt *pkt,
+			       void *user_data);
+
+const struct device *sim_radio_get(int idx);
+
+void sim_radio_set_rx(const struct device *dev, sim_radio_rx_t cb,
+		      void *user_data);
+
+/*
+ * Capabilities reported by get_capabilities(), before raw154_init().
+ * IEEE802154_HW_FILTER, IEEE802154_HW_TX_RX_ACK and IEEE802154_HW_RX_TX_ACK
+ * are simulated: address filtering, waiting for the ACK in tx() and sending
+ * the ACK on reception.
+ */
+void sim_radio_set_caps(const struct device *dev, enum ieee802154_hw_caps caps);
+
+/* Probability, in permille, that a frame is lost on the air */
+void sim_radio_set_loss(uint32_t permille);
+
+/*
+ * Path loss between two radios, both ways. Frames arrive at TX power minus
+ * path loss (RSSI, and LQI derived from it) and fade out near sensitivity.
+ * 60 dB by default.
+ */
+void sim_radio_set_path_loss(const struct device *a, const struct device *b,
+			     uint8_t db);
+
+/*
+ * Interferer on a channel, busy busy_permille of the time at dbm: seen by
+ * CCA (CSMA-CA, which the radios report) and ed_scan(), and it collides
+ * with frames sent without CCA.
+ */
+void sim_radio_set_noise(uint16_t channel, int8_t dbm, uint16_t busy_permille);
+
+/* CCA checks done and found busy so far */
+void sim_radio_cca_stats(const struct device *dev, uint32_t *checks,
+			 uint32_t *busy);
+
+/* Energy drawn while transmitting so far, depends on TX power */
+uint64_t sim_radio_tx_energy_nj(const struct device *dev);
+
+#endif /* SIM_RADIO_H_ */
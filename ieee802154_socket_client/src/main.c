@@ -1,7 +1,14 @@
 #include <zephyr/kernel.h>
+#include <zephyr/net/net_if.h>
+#include <zephyr/net/net_mgmt.h>
 #include <zephyr/net/socket.h>
 #include <zephyr/sys/printk.h>
 #include <zephyr/sys/sem.h>
+#include <zephyr/sys/util.h>
+
+#if defined(CONFIG_NET_L2_IEEE802154_SECURITY)
+#include <zephyr/net/ieee802154_mgmt.h>
+#endif
 
 #define SERVER_PORT 12345        // Server port
 #define MESSAGE "Hello from Client!"
@@ -11,6 +18,8 @@
 #define THREAD_STACK_SIZE 1024   // Stack size for each thread
 #define THREAD_PRIORITY 5        // Priority for threads
 
+#define LINK_SECURITY_LEVEL 5     // ENC-MIC-32, as IEEE 802.15.4 numbers it
+
 // Shared resources
 static int sock;
 static struct sockaddr_in6 server_addr;
@@ -24,6 +33,40 @@ K_THREAD_STACK_DEFINE(receive_stack, THREAD_STACK_SIZE);
 struct k_thread send_thread_data;
 struct k_thread receive_thread_data;
 
+#if defined(CONFIG_NET_L2_IEEE802154_SECURITY)
+// Key the 802.15.4 interface, frames are then encrypted and authenticated
+// at LINK_SECURITY_LEVEL with CONFIG_LINK_KEY. Key and level must match
+// the server sample. Without a key the link stays in clear.
+static int set_link_security(void)
+{
+    struct net_if *iface = net_if_get_first_by_type(&NET_L2_GET_NAME(IEEE802154));
+    struct ieee802154_security_params params = {
+        .key_len = 16,
+        .key_mode = 0,
+        .level = LINK_SECURITY_LEVEL,
+    };
+
+    if (!iface) {
+        return -ENODEV;
+    }
+
+    if (strlen(CONFIG_LINK_KEY) == 0) {
+        printk("CONFIG_LINK_KEY not set, link security is off\n");
+        return 0;
+    }
+
+    if (strlen(CONFIG_LINK_KEY) != 2 * params.key_len ||
+        hex2bin(CONFIG_LINK_KEY, strlen(CONFIG_LINK_KEY), params.key,
+                params.key_len) != params.key_len) {
+        printk("Set CONFIG_LINK_KEY to 32 hex digits\n");
+        return -EINVAL;
+    }
+
+    return net_mgmt(NET_REQUEST_IEEE802154_SET_SECURITY_SETTINGS, iface,
+                    &params, sizeof(params));
+}
+#endif
+
 static int initialize_socket(struct sockaddr_in6 *server_addr)
 {
     int sock;
@@ -101,14 +144,21 @@ void receive_message(void *arg1, void *arg2, void *arg3)
     }
 }
 
-void main(void)
+int main(void)
 {
     printk("Socket client with semaphores example\n");
 
+#if defined(CONFIG_NET_L2_IEEE802154_SECURITY)
+    if (set_link_security() < 0) {
+        printk("Failed to set link security\n");
+        return 0;
+    }
+#endif
+
     // Initialize socket
     sock = initialize_socket(&server_addr);
     if (sock < 0) {
-        return;
+        return 0;
     }
 
     // Create the sending thread
@@ -128,6 +178,7 @@ void main(void)
 
     // Close the socket (this part won't execute in the loop)
     close(sock);
+    return 0;
 }
 
 
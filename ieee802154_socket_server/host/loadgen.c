@@ -0,0 +1,607 @@
+/*
+ * Load generator for the UDP server, run on the host against the server on
+ * native_sim (prj_tap.conf), or on a board behind a border router.
+ *
+ *   loadgen [options]
+ *
+ *   -s ADDR    server address (2001:db8::1)
+ *   -p PORT    server port (12345)
+ *   -c N       clients, a socket each (100)
+ *   -r RATE    messages per second per client (1)
+ *   -l MIN[-MAX]  message size in bytes, uniform between MIN and MAX (18)
+ *   -b N       messages per burst, sent back to back (1)
+ *   -x         exponential (Poisson) instead of fixed intervals
+ *   -d S       duration in seconds (10)
+ *   -t MS      reply timeout (1000)
+ *   -w N       worker threads (2)
+ *   -P PID     server process (zephyr.exe) for its CPU time
+ *
+ * Each client starts at a random phase and sends "#<seq>;" padded with '.'
+ * to the message size. A reply that starts with "#<seq>" is matched to
+ * that request, any other reply to the oldest request the client is still
+ * waiting for. The server in this sample replies with a fixed string, so
+ * its latencies are matched that way. Requests without a reply within the
+ * timeout are lost.
+ *
+ * Server CPU is the user and system time of the server process over the
+ * run, from /proc/PID/stat, so it is only available for native_sim.
+ *
+ * Build: cc -O2 -pthread -o loadgen host/loadgen.c -lm
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_SERVER	"2001:db8::1"
+#define DEFAULT_PORT	12345
+#define MAX_WORKERS	32
+#define MAX_MSG		1232	/* IPv6 minimum MTU less the headers */
+#define MIN_MSG		8
+#define PENDING_MAX	64	/* requests a client waits for at once */
+#define REPORT_MS	1000
+
+#define MIN(a, b)	((a) < (b) ? (a) : (b))
+
+/* Latency histogram: 4 buckets per power of two of nanoseconds */
+#define LAT_SUB_BITS	2
+#define LAT_BUCKETS	(64 << LAT_SUB_BITS)
+
+struct config {
+	struct sockaddr_in6 server;
+	int clients;
+	double rate;
+	int size_min;
+	int size_max;
+	int burst;
+	bool poisson;
+	int duration_s;
+	uint64_t timeout_ns;
+	int workers;
+	int server_pid;
+};
+
+struct request {
+	uint32_t seq;
+	uint64_t sent_ns;
+};
+
+struct client {
+	int fd;
+	uint32_t seq;
+	uint64_t next_ns;
+	/* outstanding requests, oldest first */
+	struct request pending[PENDING_MAX];
+	int head;
+	int count;
+};
+
+struct counters {
+	uint64_t sent;
+	uint64_t send_errors;
+	uint64_t bytes;
+	uint64_t replies;
+	uint64_t lost;
+	uint64_t unmatched;
+	uint64_t overflow;	/* dropped from a full pending list */
+	uint64_t lat[LAT_BUCKETS];
+};
+
+struct worker {
+	pthread_t thread;
+	int first;
+	int count;
+	unsigned int seed;
+	struct counters c;
+	/* copy for the reporter */
+	pthread_mutex_t lock;
+	struct counters published;
+};
+
+static struct config cfg = {
+	.clients = 100,
+	.rate = 1,
+	.size_min = 18,
+	.size_max = 18,
+	.burst = 1,
+	.duration_s = 10,
+	.timeout_ns = 1000000000ULL,
+	.workers = 2,
+};
+
+static struct client *clients;
+static struct worker workers[MAX_WORKERS];
+static atomic_bool sending = true;
+static atomic_bool running = true;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000U + ts.tv_nsec;
+}
+
+static int lat_bucket(uint64_t ns)
+{
+	int msb;
+
+	if (ns < (1U << LAT_SUB_BITS)) {
+		return ns;
+	}
+
+	msb = 63 - __builtin_clzll(ns);
+
+	return ((msb - LAT_SUB_BITS + 1) << LAT_SUB_BITS) |
+	       ((ns >> (msb - LAT_SUB_BITS)) & ((1U << LAT_SUB_BITS) - 1));
+}
+
+/* Lower bound of a bucket */
+static uint64_t lat_bucket_ns(int bucket)
+{
+	int shift = (bucket >> LAT_SUB_BITS) - 1;
+	uint64_t sub = bucket & ((1U << LAT_SUB_BITS) - 1);
+
+	if (shift < 0) {
+		return bucket;
+	}
+
+	return ((1ULL << LAT_SUB_BITS) | sub) << shift;
+}
+
+static double uniform(unsigned int *seed)
+{
+	return (rand_r(seed) + 1.0) / ((double)RAND_MAX + 2.0);
+}
+
+/* Time from one burst to the next */
+static uint64_t interval_ns(unsigned int *seed)
+{
+	double mean = 1e9 * cfg.burst / cfg.rate;
+
+	return cfg.poisson ? -log(uniform(seed)) * mean : mean;
+}
+
+static void send_burst(struct worker *w, struct client *cl, uint64_t now)
+{
+	char msg[MAX_MSG];
+
+	for (int i = 0; i < cfg.burst; i++) {
+		int size = cfg.size_min +
+			   rand_r(&w->seed) % (cfg.size_max - cfg.size_min + 1);
+		int n = snprintf(msg, sizeof(msg), "#%u;", cl->seq);
+
+		if (n < size) {
+			memset(msg + n, '.', size - n);
+		}
+
+		if (sendto(cl->fd, msg, size, 0,
+			   (const struct sockaddr *)&cfg.server,
+			   sizeof(cfg.server)) < 0) {
+			w->c.send_errors++;
+			continue;
+		}
+
+		w->c.sent++;
+		w->c.bytes += size;
+
+		if (cl->count == PENDING_MAX) {
+			cl->head = (cl->head + 1) % PENDING_MAX;
+			cl->count--;
+			w->c.overflow++;
+		}
+		cl->pending[(cl->head + cl->count++) % PENDING_MAX] =
+			(struct request){ .seq = cl->seq, .sent_ns = now };
+		cl->seq++;
+	}
+}
+
+static void expire(struct worker *w, struct client *cl, uint64_t now)
+{
+	while (cl->count > 0 &&
+	       now - cl->pending[cl->head].sent_ns > cfg.timeout_ns) {
+		cl->head = (cl->head + 1) % PENDING_MAX;
+		cl->count--;
+		w->c.lost++;
+	}
+}
+
+/* Index into pending of the request a reply answers, -1 if none */
+static int match(struct client *cl, const char *reply, ssize_t len)
+{
+	char *end;
+	unsigned long seq;
+
+	if (cl->count == 0) {
+		return -1;
+	}
+
+	if (len < 2 || reply[0] != '#') {
+		return 0;
+	}
+
+	seq = strtoul(reply + 1, &end, 10);
+	for (int i = 0; i < cl->count; i++) {
+		if (cl->pending[(cl->head + i) % PENDING_MAX].seq == seq) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static void receive(struct worker *w, struct client *cl, uint64_t now)
+{
+	char reply[MAX_MSG + 1];
+	ssize_t len;
+	int i;
+
+	while ((len = recv(cl->fd, reply, MAX_MSG, MSG_DONTWAIT)) >= 0) {
+		reply[len] = '\0';
+		expire(w, cl, now);
+
+		i = match(cl, reply, len);
+		if (i < 0) {
+			w->c.unmatched++;
+			continue;
+		}
+
+		w->c.replies++;
+		w->c.lat[lat_bucket(now - cl->pending[(cl->head + i) %
+						      PENDING_MAX].sent_ns)]++;
+
+		/* Requests before the one answered stay pending */
+		for (; i > 0; i--) {
+			cl->pending[(cl->head + i) % PENDING_MAX] =
+				cl->pending[(cl->head + i - 1) % PENDING_MAX];
+		}
+		cl->head = (cl->head + 1) % PENDING_MAX;
+		cl->count--;
+	}
+}
+
+static void *worker_thread(void *arg)
+{
+	struct worker *w = arg;
+	struct epoll_event events[64];
+	uint64_t start = now_ns();
+	uint64_t next, now;
+	int ep = epoll_create1(0);
+	int n, timeout_ms;
+
+	for (int i = w->first; i < w->first + w->count; i++) {
+		struct epoll_event ev = { .events = EPOLLIN, .data.u32 = i };
+
+		/* A random phase, so clients do not send in lockstep */
+		clients[i].next_ns = start + uniform(&w->seed) *
+						     interval_ns(&w->seed);
+		epoll_ctl(ep, EPOLL_CTL_ADD, clients[i].fd, &ev);
+	}
+
+	while (atomic_load(&running)) {
+		now = now_ns();
+		next = now + REPORT_MS * 1000000ULL;
+
+		for (int i = w->first; i < w->first + w->count; i++) {
+			struct client *cl = &clients[i];
+
+			expire(w, cl, now);
+
+			if (!atomic_load(&sending)) {
+				continue;
+			}
+
+			while (cl->next_ns <= now) {
+				send_burst(w, cl, now);
+				cl->next_ns += interval_ns(&w->seed);
+			}
+			if (cl->next_ns < next) {
+				next = cl->next_ns;
+			}
+		}
+
+		pthread_mutex_lock(&w->lock);
+		w->published = w->c;
+		pthread_mutex_unlock(&w->lock);
+
+		timeout_ms = (next - MIN(next, now_ns()) + 999999) / 1000000;
+		n = epoll_wait(ep, events, 64, timeout_ms);
+		now = now_ns();
+		for (int e = 0; e < n; e++) {
+			receive(w, &clients[events[e].data.u32], now);
+		}
+	}
+
+	/* What is still pending after the last timeout was lost */
+	for (int i = w->first; i < w->first + w->count; i++) {
+		w->c.lost += clients[i].count;
+		clients[i].count = 0;
+	}
+
+	pthread_mutex_lock(&w->lock);
+	w->published = w->c;
+	pthread_mutex_unlock(&w->lock);
+
+	close(ep);
+
+	return NULL;
+}
+
+static void counters_sum(struct counters *sum)
+{
+	memset(sum, 0, sizeof(*sum));
+
+	for (int k = 0; k < cfg.workers; k++) {
+		struct counters c;
+
+		pthread_mutex_lock(&workers[k].lock);
+		c = workers[k].published;
+		pthread_mutex_unlock(&workers[k].lock);
+
+		sum->sent += c.sent;
+		sum->send_errors += c.send_errors;
+		sum->bytes += c.bytes;
+		sum->replies += c.replies;
+		sum->lost += c.lost;
+		sum->unmatched += c.unmatched;
+		sum->overflow += c.overflow;
+		for (int i = 0; i < LAT_BUCKETS; i++) {
+			sum->lat[i] += c.lat[i];
+		}
+	}
+}
+
+static double lat_percentile_ms(const struct counters *c, double pct)
+{
+	uint64_t want = c->replies * pct / 100;
+	uint64_t seen = 0;
+
+	for (int i = 0; i < LAT_BUCKETS; i++) {
+		seen += c->lat[i];
+		if (seen > want) {
+			return lat_bucket_ns(i) / 1e6;
+		}
+	}
+
+	return 0;
+}
+
+static double lat_max_ms(const struct counters *c)
+{
+	for (int i = LAT_BUCKETS - 1; i >= 0; i--) {
+		if (c->lat[i] > 0) {
+			return lat_bucket_ns(i) / 1e6;
+		}
+	}
+
+	return 0;
+}
+
+/* User and system time of pid in clock ticks, -1 if unknown */
+static long long process_ticks(int pid)
+{
+	char path[64];
+	char line[1024];
+	unsigned long long utime, stime;
+	char *p;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+	f = fopen(path, "r");
+	if (f == NULL) {
+		return -1;
+	}
+
+	p = fgets(line, sizeof(line), f);
+	fclose(f);
+
+	/* The command name can hold spaces, fields count from its ')' */
+	p = p ? strrchr(line, ')') : NULL;
+	if (p == NULL ||
+	    sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu",
+		   &utime, &stime) != 2) {
+		return -1;
+	}
+
+	return utime + stime;
+}
+
+static int open_clients(void)
+{
+	clients = calloc(cfg.clients, sizeof(*clients));
+	if (clients == NULL) {
+		return -ENOMEM;
+	}
+
+	for (int i = 0; i < cfg.clients; i++) {
+		clients[i].fd = socket(AF_INET6, SOCK_DGRAM, 0);
+		if (clients[i].fd < 0) {
+			perror("socket");
+			return -errno;
+		}
+	}
+
+	return 0;
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "usage: %s [-s addr] [-p port] [-c clients] "
+		"[-r msgs/s] [-l min[-max]] [-b burst] [-x] [-d seconds] "
+		"[-t timeout ms] [-w workers] [-P server pid]\n", argv0);
+}
+
+static int parse_args(int argc, char **argv)
+{
+	const char *server = DEFAULT_SERVER;
+	int port = DEFAULT_PORT;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "s:p:c:r:l:b:xd:t:w:P:")) != -1) {
+		switch (opt) {
+		case 's':
+			server = optarg;
+			break;
+		case 'p':
+			port = atoi(optarg);
+			break;
+		case 'c':
+			cfg.clients = atoi(optarg);
+			break;
+		case 'r':
+			cfg.rate = atof(optarg);
+			break;
+		case 'l':
+			if (sscanf(optarg, "%d-%d", &cfg.size_min,
+				   &cfg.size_max) < 2) {
+				cfg.size_max = cfg.size_min;
+			}
+			break;
+		case 'b':
+			cfg.burst = atoi(optarg);
+			break;
+		case 'x':
+			cfg.poisson = true;
+			break;
+		case 'd':
+			cfg.duration_s = atoi(optarg);
+			break;
+		case 't':
+			cfg.timeout_ns = strtoull(optarg, NULL, 10) * 1000000ULL;
+			break;
+		case 'w':
+			cfg.workers = atoi(optarg);
+			break;
+		case 'P':
+			cfg.server_pid = atoi(optarg);
+			break;
+		default:
+			return -EINVAL;
+		}
+	}
+
+	cfg.server.sin6_family = AF_INET6;
+	cfg.server.sin6_port = htons(port);
+	if (inet_pton(AF_INET6, server, &cfg.server.sin6_addr) != 1) {
+		fprintf(stderr, "invalid address %s\n", server);
+		return -EINVAL;
+	}
+
+	if (cfg.clients < 1 || cfg.rate <= 0 || cfg.burst < 1 ||
+	    cfg.size_min < MIN_MSG || cfg.size_max > MAX_MSG ||
+	    cfg.size_min > cfg.size_max || cfg.duration_s < 1 ||
+	    cfg.workers < 1 || cfg.workers > MAX_WORKERS) {
+		return -EINVAL;
+	}
+
+	cfg.workers = MIN(cfg.workers, cfg.clients);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct counters c, prev = { 0 };
+	long long ticks_start = -1, ticks_end;
+	uint64_t start, stop, elapsed;
+	double wall_s;
+
+	if (parse_args(argc, argv) < 0) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	if (open_clients() < 0) {
+		return 1;
+	}
+
+	printf("%d clients, %.3g msgs/s each in bursts of %d, %d-%d B, "
+	       "%s intervals, %d s\n", cfg.clients, cfg.rate, cfg.burst,
+	       cfg.size_min, cfg.size_max, cfg.poisson ? "exponential" : "fixed",
+	       cfg.duration_s);
+
+	if (cfg.server_pid > 0) {
+		ticks_start = process_ticks(cfg.server_pid);
+		if (ticks_start < 0) {
+			fprintf(stderr, "no process %d, no server CPU\n",
+				cfg.server_pid);
+		}
+	}
+
+	start = now_ns();
+	for (int k = 0; k < cfg.workers; k++) {
+		struct worker *w = &workers[k];
+
+		w->first = k * cfg.clients / cfg.workers;
+		w->count = (k + 1) * cfg.clients / cfg.workers - w->first;
+		w->seed = k + 1;
+		pthread_mutex_init(&w->lock, NULL);
+		pthread_create(&w->thread, NULL, worker_thread, w);
+	}
+
+	/* Send for the duration, then wait one timeout for the last replies */
+	stop = start + cfg.duration_s * 1000000000ULL;
+	while (now_ns() < stop + cfg.timeout_ns) {
+		usleep(REPORT_MS * 1000);
+
+		if (now_ns() >= stop) {
+			atomic_store(&sending, false);
+		}
+
+		counters_sum(&c);
+		printf("sent %" PRIu64 " (+%" PRIu64 "), replies %" PRIu64
+		       " (+%" PRIu64 "), lost %" PRIu64 "\n", c.sent,
+		       c.sent - prev.sent, c.replies, c.replies - prev.replies,
+		       c.lost);
+		prev = c;
+	}
+
+	elapsed = now_ns() - start;
+	ticks_end = cfg.server_pid > 0 ? process_ticks(cfg.server_pid) : -1;
+
+	atomic_store(&running, false);
+	for (int k = 0; k < cfg.workers; k++) {
+		pthread_join(workers[k].thread, NULL);
+	}
+
+	counters_sum(&c);
+	wall_s = elapsed / 1e9;
+
+	printf("sent %" PRIu64 " (%.1f msgs/s, %" PRIu64 " B), send errors %"
+	       PRIu64 "\n", c.sent, c.sent / (double)cfg.duration_s, c.bytes,
+	       c.send_errors);
+	printf("replies %" PRIu64 ", lost %" PRIu64 " (%.2f%%), unmatched %"
+	       PRIu64 ", pending overflow %" PRIu64 "\n", c.replies, c.lost,
+	       c.sent ? 100.0 * c.lost / c.sent : 0, c.unmatched, c.overflow);
+	printf("latency p50 %.3f p90 %.3f p99 %.3f max %.3f ms\n",
+	       lat_percentile_ms(&c, 50), lat_percentile_ms(&c, 90),
+	       lat_percentile_ms(&c, 99), lat_max_ms(&c));
+
+	if (ticks_start >= 0 && ticks_end >= 0) {
+		double cpu_s = (double)(ticks_end - ticks_start) /
+			       sysconf(_SC_CLK_TCK);
+
+		printf("server cpu %.2f s in %.1f s (%.1f%%), %.1f us/msg\n",
+		       cpu_s, wall_s, 100.0 * cpu_s / wall_s,
+		       c.sent ? cpu_s * 1e6 / c.sent : 0);
+	}
+
+	return 0;
+}
@@ -1,7 +1,14 @@
 #include <zephyr/kernel.h>
+#include <zephyr/net/net_if.h>
+#include <zephyr/net/net_mgmt.h>
 #include <zephyr/net/socket.h>
 #include <zephyr/sys/printk.h>
 #include <zephyr/sys/sem.h>
+#include <zephyr/sys/util.h>
+
+#if defined(CONFIG_NET_L2_IEEE802154_SECURITY)
+#include <zephyr/net/ieee802154_mgmt.h>
+#endif
 
 #define SERVER_PORT 12345         // Server listening port
 #define BUFFER_SIZE 128           // Buffer size for incoming messages
@@ -10,12 +17,48 @@
 #define THREAD_STACK_SIZE 1024    // Stack size for threads
 #define THREAD_PRIORITY 5         // Priority for threads
 
+#define LINK_SECURITY_LEVEL 5     // ENC-MIC-32, as IEEE 802.15.4 numbers it
+
 static struct k_sem sync_sem;     // Semaphore for synchronizing receive and transmit
 static char recv_buffer[BUFFER_SIZE]; // Buffer to store received messages
 static struct sockaddr_in6 client_addr; // Client address
 static socklen_t client_addr_len;
 static int server_sock;          // Server socket
 
+#if defined(CONFIG_NET_L2_IEEE802154_SECURITY)
+// Key the 802.15.4 interface, frames are then encrypted and authenticated
+// at LINK_SECURITY_LEVEL with CONFIG_LINK_KEY. Key and level must match
+// the client sample. Without a key the link stays in clear.
+static int set_link_security(void)
+{
+    struct net_if *iface = net_if_get_first_by_type(&NET_L2_GET_NAME(IEEE802154));
+    struct ieee802154_security_params params = {
+        .key_len = 16,
+        .key_mode = 0,
+        .level = LINK_SECURITY_LEVEL,
+    };
+
+    if (!iface) {
+        return -ENODEV;
+    }
+
+    if (strlen(CONFIG_LINK_KEY) == 0) {
+        printk("CONFIG_LINK_KEY not set, link security is off\n");
+        return 0;
+    }
+
+    if (strlen(CONFIG_LINK_KEY) != 2 * params.key_len ||
+        hex2bin(CONFIG_LINK_KEY, strlen(CONFIG_LINK_KEY), params.key,
+                params.key_len) != params.key_len) {
+        printk("Set CONFIG_LINK_KEY to 32 hex digits\n");
+        return -EINVAL;
+    }
+
+    return net_mgmt(NET_REQUEST_IEEE802154_SET_SECURITY_SETTINGS, iface,
+                    &params, sizeof(params));
+}
+#endif
+
 // Thread stack and thread definitions
 K_THREAD_STACK_DEFINE(receive_stack, THREAD_STACK_SIZE);
 K_THREAD_STACK_DEFINE(transmit_stack, THREAD_STACK_SIZE);
@@ -67,7 +110,7 @@ void transmit_thread(void *arg1, void *arg2, void *arg3) {
     }
 }
 
-void main(void) {
+int main(void) {
     struct sockaddr_in6 server_addr;
 
     printk("Starting UDP server with semaphore synchronization\n");
@@ -75,11 +118,18 @@ void main(void) {
     // Initialize semaphore
     k_sem_init(&sync_sem, 0, 1);
 
+#if defined(CONFIG_NET_L2_IEEE802154_SECURITY)
+    if (set_link_security() < 0) {
+        printk("Failed to set link security\n");
+        return 0;
+    }
+#endif
+
     // Create a UDP socket
     server_sock = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
     if (server_sock < 0) {
         printk("Failed to create socket: %d\n", errno);
-        return;
+        return 0;
     }
     printk("Socket created successfully\n");
 
@@ -93,7 +143,7 @@ void main(void) {
     if (bind(server_sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
         printk("Failed to bind socket: %d\n", errno);
         close(server_sock);
-        return;
+        return 0;
     }
     printk("Socket bound to port %d\n", SERVER_PORT);
 
@@ -106,4 +156,6 @@ void main(void) {
     k_thread_create(&transmit_thread_data, transmit_stack, THREAD_STACK_SIZE,
                     transmit_thread, NULL, NULL, NULL,
                     THREAD_PRIORITY, 0, K_NO_WAIT);
+
+    return 0;
 }
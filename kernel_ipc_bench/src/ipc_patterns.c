@@ -0,0 +1,205 @@
+/*
+ * The hand-off patterns of the samples, see ipc_patterns.h
+ *
+ *   fifo-malloc   k_malloc() a copy, k_fifo_put(), k_free() (threads)
+ *   msgq          copy into a k_msgq and out again (echo_bot)
+ *   sem-pingpong  one shared buffer, two semaphores (socket client/server)
+ *   work          a message per k_work item, submitted to one work queue
+ *                 per consumer (sensortest, timer_work_queue)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+
+#include "ipc_patterns.h"
+
+#define WORK_Q_STACK_SIZE 1024
+
+/* k_fifo + k_malloc */
+
+struct fifo_msg {
+	void *fifo_reserved;	/* 1st word reserved for use by fifo */
+	uint32_t t;
+	uint16_t size;
+	uint8_t data[];
+};
+
+static K_FIFO_DEFINE(fifo);
+
+static void fifo_setup(size_t size, int consumers)
+{
+	ARG_UNUSED(size);
+	ARG_UNUSED(consumers);
+}
+
+static void fifo_send(const uint8_t *data, size_t size, uint32_t t)
+{
+	struct fifo_msg *msg;
+
+	/* The heap only runs out if consumers fall behind, wait for them */
+	while ((msg = k_malloc(sizeof(*msg) + size)) == NULL) {
+		k_msleep(1);
+	}
+
+	msg->t = t;
+	msg->size = size;
+	memcpy(msg->data, data, size);
+	k_fifo_put(&fifo, msg);
+}
+
+static void fifo_consume(void)
+{
+	struct fifo_msg *msg;
+
+	for (;;) {
+		msg = k_fifo_get(&fifo, K_FOREVER);
+		ipc_delivered(msg->t, msg->data, msg->size);
+		k_free(msg);
+	}
+}
+
+/* k_msgq */
+
+struct msgq_msg {
+	uint32_t t;
+	uint8_t data[IPC_MAX_SIZE];
+};
+
+static struct k_msgq msgq;
+static char __aligned(4) msgq_buf[IPC_QUEUE_DEPTH * sizeof(struct msgq_msg)];
+static size_t msgq_size;
+
+static void msgq_setup(size_t size, int consumers)
+{
+	ARG_UNUSED(consumers);
+
+	msgq_size = size;
+	k_msgq_init(&msgq, msgq_buf, ROUND_UP(sizeof(uint32_t) + size, 4),
+		    IPC_QUEUE_DEPTH);
+}
+
+static void msgq_send(const uint8_t *data, size_t size, uint32_t t)
+{
+	struct msgq_msg msg;
+
+	msg.t = t;
+	memcpy(msg.data, data, size);
+	k_msgq_put(&msgq, &msg, K_FOREVER);
+}
+
+static void msgq_consume(void)
+{
+	struct msgq_msg msg;
+
+	for (;;) {
+		k_msgq_get(&msgq, &msg, K_FOREVER);
+		ipc_delivered(msg.t, msg.data, msgq_size);
+	}
+}
+
+/* k_sem ping-pong over one buffer */
+
+static struct {
+	uint32_t t;
+	uint16_t size;
+	uint8_t data[IPC_MAX_SIZE];
+} slot;
+
+static K_SEM_DEFINE(slot_free, 1, 1);
+static K_SEM_DEFINE(slot_full, 0, 1);
+
+static void sem_setup(size_t size, int consumers)
+{
+	ARG_UNUSED(size);
+	ARG_UNUSED(consumers);
+
+	k_sem_reset(&slot_full);
+	k_sem_reset(&slot_free);
+	k_sem_give(&slot_free);
+}
+
+static void sem_send(const uint8_t *data, size_t size, uint32_t t)
+{
+	k_sem_take(&slot_free, K_FOREVER);
+	slot.t = t;
+	slot.size = size;
+	memcpy(slot.data, data, size);
+	k_sem_give(&slot_full);
+}
+
+static void sem_consume(void)
+{
+	for (;;) {
+		k_sem_take(&slot_full, K_FOREVER);
+		ipc_delivered(slot.t, slot.data, slot.size);
+		k_sem_give(&slot_free);
+	}
+}
+
+/* k_work items, one work queue per consumer */
+
+struct work_msg {
+	struct k_work work;
+	uint32_t t;
+	uint16_t size;
+	uint8_t data[IPC_MAX_SIZE];
+};
+
+K_MEM_SLAB_DEFINE_STATIC(work_slab, sizeof(struct work_msg), IPC_QUEUE_DEPTH,
+			 4);
+static K_THREAD_STACK_ARRAY_DEFINE(work_q_stack, IPC_MAX_CONSUMERS,
+				   WORK_Q_STACK_SIZE);
+static struct k_work_q work_q[IPC_MAX_CONSUMERS];
+static int work_q_started;
+static int work_queues;
+static atomic_t work_next;
+
+static void work_handler(struct k_work *work)
+{
+	struct work_msg *msg = CONTAINER_OF(work, struct work_msg, work);
+
+	ipc_delivered(msg->t, msg->data, msg->size);
+	k_mem_slab_free(&work_slab, (void **)&msg);
+}
+
+static void work_setup(size_t size, int consumers)
+{
+	ARG_UNUSED(size);
+
+	for (; work_q_started < consumers; work_q_started++) {
+		k_work_queue_start(&work_q[work_q_started],
+				   work_q_stack[work_q_started],
+				   K_THREAD_STACK_SIZEOF(work_q_stack[0]),
+				   IPC_CONSUMER_PRIO, NULL);
+	}
+
+	work_queues = consumers;
+	atomic_set(&work_next, 0);
+}
+
+static void work_send(const uint8_t *data, size_t size, uint32_t t)
+{
+	struct work_msg *msg;
+
+	k_mem_slab_alloc(&work_slab, (void **)&msg, K_FOREVER);
+	k_work_init(&msg->work, work_handler);
+	msg->t = t;
+	msg->size = size;
+	memcpy(msg->data, data, size);
+	k_work_submit_to_queue(&work_q[atomic_inc(&work_next) % work_queues],
+			       &msg->work);
+}
+
+const struct ipc_pattern ipc_patterns[] = {
+	{ "fifo-malloc", fifo_setup, fifo_send, fifo_consume },
+	{ "msgq", msgq_setup, msgq_send, msgq_consume },
+	{ "sem-pingpong", sem_setup, sem_send, sem_consume },
+	{ "work", work_setup, work_send, NULL },
+};
+
+const size_t ipc_pattern_count = ARRAY_SIZE(ipc_patterns);
@@ -0,0 +1,52 @@
+/*
+ * Hand-off patterns timed by the kernel IPC bench.
+ *
+ * A pattern moves messages of one size from producer threads to consumers.
+ * Producers call send(); consumers call ipc_delivered() for every message,
+ * either from consumer threads running consume() or, for patterns that
+ * bring their own threads (k_work), from those.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef IPC_PATTERNS_H_
+#define IPC_PATTERNS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/kernel.h>
+
+#define IPC_MAX_SIZE		512
+#define IPC_MAX_CONSUMERS	4
+/* Messages a bounded pattern holds before producers block */
+#define IPC_QUEUE_DEPTH		8
+
+/*
+ * Consumers run above producers, so each message is handed over as soon
+ * as it is sent, the way the samples use these primitives.
+ */
+#define IPC_CONSUMER_PRIO	K_PRIO_PREEMPT(4)
+#define IPC_PRODUCER_PRIO	K_PRIO_PREEMPT(5)
+
+struct ipc_pattern {
+	const char *name;
+	/* Before each run */
+	void (*setup)(size_t size, int consumers);
+	/* Hand one message over, t is its ipc_stamp() */
+	void (*send)(const uint8_t *data, size_t size, uint32_t t);
+	/* Consumer thread body, never returns. NULL for own threads */
+	void (*consume)(void);
+};
+
+extern const struct ipc_pattern ipc_patterns[];
+extern const size_t ipc_pattern_count;
+
+/* Timestamp: cycles, or microseconds of host time on native_sim */
+uint32_t ipc_stamp(void);
+uint64_t ipc_stamp_to_ns(uint32_t stamps);
+
+/* Called by the consumers for every message, t as given to send() */
+void ipc_delivered(uint32_t t, const uint8_t *data, size_t size);
+
+#endif /* IPC_PATTERNS_H_ */
@@ -0,0 +1,230 @@
+/*
+ * Kernel IPC microbenchmark.
+ *
+ * Moves MESSAGES messages through each hand-off pattern of ipc_patterns.c,
+ * for every message size and producer/consumer topology below, and prints
+ * one CSV row per run: throughput and the send-to-delivery latency
+ * percentiles. Consumers check every payload.
+ *
+ * Times come from the host clock on native_sim, where simulated time does
+ * not move while the CPU is busy, and from the cycle counter elsewhere.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <string.h>
+
+#ifdef CONFIG_ARCH_POSIX
+#include "host_clock.h"
+#endif
+
+#include "ipc_patterns.h"
+
+/* Per run, a multiple of every producer count */
+#define MESSAGES	 2000
+#define MAX_PRODUCERS	 4
+#define RUN_TIMEOUT_S	 10
+
+#define PRODUCER_STACK_SIZE 1536
+#define CONSUMER_STACK_SIZE 1536
+
+static const size_t sizes[] = { 4, 32, 128, IPC_MAX_SIZE };
+
+static const struct {
+	uint8_t producers;
+	uint8_t consumers;
+} topologies[] = {
+	{ 1, 1 },
+	{ 1, IPC_MAX_CONSUMERS },
+	{ MAX_PRODUCERS, 1 },
+	{ MAX_PRODUCERS, IPC_MAX_CONSUMERS },
+};
+
+static K_THREAD_STACK_ARRAY_DEFINE(producer_stack, MAX_PRODUCERS,
+				   PRODUCER_STACK_SIZE);
+static K_THREAD_STACK_ARRAY_DEFINE(consumer_stack, IPC_MAX_CONSUMERS,
+				   CONSUMER_STACK_SIZE);
+static struct k_thread producer_thread[MAX_PRODUCERS];
+static struct k_thread consumer_thread[IPC_MAX_CONSUMERS];
+
+static uint8_t payload[IPC_MAX_SIZE];
+static uint8_t payload_sum;
+
+static K_SEM_DEFINE(run_done, 0, 1);
+static atomic_t delivered;
+static atomic_t corrupt;
+static uint32_t lat[MESSAGES];
+
+uint32_t ipc_stamp(void)
+{
+#ifdef CONFIG_ARCH_POSIX
+	return host_clock_us();
+#else
+	return k_cycle_get_32();
+#endif
+}
+
+uint64_t ipc_stamp_to_ns(uint32_t stamps)
+{
+#ifdef CONFIG_ARCH_POSIX
+	return (uint64_t)stamps * NSEC_PER_USEC;
+#else
+	return k_cyc_to_ns_floor64(stamps);
+#endif
+}
+
+void ipc_delivered(uint32_t t, const uint8_t *data, size_t size)
+{
+	uint32_t now = ipc_stamp();
+	atomic_val_t i = atomic_inc(&delivered);
+	uint8_t sum = 0;
+
+	/* Read the whole payload, as a real consumer would */
+	for (size_t j = 0; j < size; j++) {
+		sum += data[j];
+	}
+
+	if (sum != payload_sum) {
+		atomic_inc(&corrupt);
+	}
+
+	if (i < MESSAGES) {
+		lat[i] = now - t;
+	}
+
+	if (i + 1 == MESSAGES) {
+		k_sem_give(&run_done);
+	}
+}
+
+static void producer(void *p1, void *p2, void *p3)
+{
+	const struct ipc_pattern *pattern = p1;
+	uint32_t count = POINTER_TO_UINT(p2);
+	size_t size = POINTER_TO_UINT(p3);
+
+	for (uint32_t i = 0; i < count; i++) {
+		pattern->send(payload, size, ipc_stamp());
+	}
+}
+
+static void consumer(void *p1, void *p2, void *p3)
+{
+	const struct ipc_pattern *pattern = p1;
+
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	pattern->consume();
+}
+
+static void sort_u32(uint32_t *v, size_t n)
+{
+	for (size_t i = 1; i < n; i++) {
+		uint32_t x = v[i];
+		size_t j;
+
+		for (j = i; j > 0 && v[j - 1] > x; j--) {
+			v[j] = v[j - 1];
+		}
+		v[j] = x;
+	}
+}
+
+static uint32_t percentile_ns(size_t n, uint32_t pct)
+{
+	return n > 0 ? ipc_stamp_to_ns(lat[MIN(n - 1, n * pct / 100)]) : 0;
+}
+
+/* Returns false if messages were lost or corrupted */
+static bool run(const struct ipc_pattern *pattern, size_t size,
+		int producers, int consumers)
+{
+	uint32_t start, elapsed_us, rate;
+	size_t n;
+	int r;
+
+	payload_sum = 0;
+	for (size_t i = 0; i < size; i++) {
+		payload[i] = i * 7 + size;
+		payload_sum += payload[i];
+	}
+
+	atomic_set(&delivered, 0);
+	atomic_set(&corrupt, 0);
+	k_sem_reset(&run_done);
+	pattern->setup(size, consumers);
+
+	/* Nothing runs before main blocks on run_done */
+	for (int i = 0; pattern->consume && i < consumers; i++) {
+		k_thread_create(&consumer_thread[i], consumer_stack[i],
+				K_THREAD_STACK_SIZEOF(consumer_stack[i]),
+				consumer, (void *)pattern, NULL, NULL,
+				IPC_CONSUMER_PRIO, 0, K_NO_WAIT);
+	}
+
+	start = ipc_stamp();
+	for (int i = 0; i < producers; i++) {
+		k_thread_create(&producer_thread[i], producer_stack[i],
+				K_THREAD_STACK_SIZEOF(producer_stack[i]),
+				producer, (void *)pattern,
+				UINT_TO_POINTER(MESSAGES / producers),
+				UINT_TO_POINTER(size), IPC_PRODUCER_PRIO, 0,
+				K_NO_WAIT);
+	}
+
+	r = k_sem_take(&run_done, K_SECONDS(RUN_TIMEOUT_S));
+	elapsed_us = MAX(ipc_stamp_to_ns(ipc_stamp() - start) / NSEC_PER_USEC,
+			 1);
+
+	for (int i = 0; i < producers; i++) {
+		if (r < 0) {
+			k_thread_abort(&producer_thread[i]);
+		} else {
+			k_thread_join(&producer_thread[i], K_FOREVER);
+		}
+	}
+
+	/* Consumers wait for more, forever */
+	for (int i = 0; pattern->consume && i < consumers; i++) {
+		k_thread_abort(&consumer_thread[i]);
+	}
+
+	n = MIN(atomic_get(&delivered), MESSAGES);
+	sort_u32(lat, n);
+	rate = (uint64_t)n * USEC_PER_SEC / elapsed_us;
+
+	printk("%s,%u,%d,%d,%u,%u,%u,%u,%u,%u,%u,%u\n", pattern->name,
+	       (uint32_t)size, producers, consumers, (uint32_t)n, elapsed_us,
+	       rate, percentile_ns(n, 50), percentile_ns(n, 90),
+	       percentile_ns(n, 99), percentile_ns(n, 100),
+	       (uint32_t)atomic_get(&corrupt));
+
+	return r == 0 && atomic_get(&corrupt) == 0;
+}
+
+int main(void)
+{
+	bool ok = true;
+
+	printk("pattern,size,producers,consumers,messages,elapsed_us,msgs_per_s,"
+	       "p50_ns,p90_ns,p99_ns,max_ns,corrupt\n");
+
+	for (size_t p = 0; p < ipc_pattern_count; p++) {
+		for (size_t s = 0; s < ARRAY_SIZE(sizes); s++) {
+			for (size_t t = 0; t < ARRAY_SIZE(topologies); t++) {
+				ok &= run(&ipc_patterns[p], sizes[s],
+					  topologies[t].producers,
+					  topologies[t].consumers);
+			}
+		}
+	}
+
+	printk("%s\n", ok ? "bench done" : "bench failed");
+
+	return 0;
+}
@@ -0,0 +1,317 @@
+/*
+ * Network pool sizing on native_sim.
+ *
+ * Plays the traffic profile of profile.c over the loopback interface,
+ * first with the configured pools, then with one pool at a time held down
+ * to fewer packets or buffers, to find by bisection the smallest count at
+ * which at most TARGET_DROP_PPM of the datagrams are lost. The four counts
+ * are then checked together and printed as prj.conf lines.
+ *
+ * A pool is shrunk by allocating and holding what a smaller configuration
+ * would not have, so one build tries every size.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/net/buf.h>
+#include <zephyr/net/net_pkt.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#include "net_pool_stats.h"
+#include "profile.h"
+
+/* Datagrams lost per million sent, TX failures included */
+#define TARGET_DROP_PPM 1000
+
+#define PROFILE_PORT	4242
+#define MAX_DATAGRAM	512
+#define DRAIN_MS	1000
+#define MAX_HELD	128
+#define MAX_GROW	8
+
+#define RECEIVER_STACK_SIZE 2048
+#define RECEIVER_PRIO K_PRIO_PREEMPT(8)
+
+static const char *const conf_names[NET_POOLS] = {
+	[NET_POOL_RX_PKTS] = "CONFIG_NET_PKT_RX_COUNT",
+	[NET_POOL_TX_PKTS] = "CONFIG_NET_PKT_TX_COUNT",
+	[NET_POOL_RX_BUFS] = "CONFIG_NET_BUF_RX_COUNT",
+	[NET_POOL_TX_BUFS] = "CONFIG_NET_BUF_TX_COUNT",
+};
+
+static void *held[NET_POOLS][MAX_HELD];
+static uint32_t held_count[NET_POOLS];
+
+static K_THREAD_STACK_DEFINE(receiver_stack, RECEIVER_STACK_SIZE);
+static struct k_thread receiver_thread;
+
+static const struct sockaddr_in6 dest = {
+	.sin6_family = AF_INET6,
+	.sin6_port = htons(PROFILE_PORT),
+	.sin6_addr = IN6ADDR_LOOPBACK_INIT,
+};
+
+static int tx_sock = -1;
+static uint8_t tx_buf[MAX_DATAGRAM];
+static uint8_t rx_buf[MAX_DATAGRAM];
+
+/* Shared with the receiver, datagrams carry the run they belong to */
+static volatile uint32_t run_id;
+static volatile uint16_t rx_delay_ms;
+static atomic_t received;
+
+static void receiver(void *p1, void *p2, void *p3)
+{
+	struct sockaddr_in6 addr = {
+		.sin6_family = AF_INET6,
+		.sin6_port = htons(PROFILE_PORT),
+		.sin6_addr = IN6ADDR_ANY_INIT,
+	};
+	ssize_t len;
+	int sock;
+
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	sock = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock < 0 ||
+	    bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		printk("receiver: socket failed: %d\n", errno);
+		return;
+	}
+
+	for (;;) {
+		/* Queued datagrams hold RX packets and buffers until read */
+		net_pool_stats_sample();
+
+		len = recv(sock, rx_buf, sizeof(rx_buf), 0);
+		if (len < (ssize_t)sizeof(uint32_t) ||
+		    memcmp(rx_buf, (const void *)&run_id, sizeof(uint32_t))) {
+			continue;
+		}
+
+		atomic_inc(&received);
+
+		if (rx_delay_ms > 0) {
+			k_msleep(rx_delay_ms);
+		}
+	}
+}
+
+static void *hold_one(int pool)
+{
+	switch (pool) {
+	case NET_POOL_RX_PKTS:
+		return net_pkt_rx_alloc(K_NO_WAIT);
+	case NET_POOL_TX_PKTS:
+		return net_pkt_alloc(K_NO_WAIT);
+	case NET_POOL_RX_BUFS:
+		return net_pkt_get_reserve_rx_data(CONFIG_NET_BUF_DATA_SIZE,
+						   K_NO_WAIT);
+	case NET_POOL_TX_BUFS:
+		return net_pkt_get_reserve_tx_data(CONFIG_NET_BUF_DATA_SIZE,
+						   K_NO_WAIT);
+	default:
+		return NULL;
+	}
+}
+
+/* Hold pools down to count, returns false if they could not be */
+static bool hold(const uint32_t size[NET_POOLS], const uint32_t count[NET_POOLS])
+{
+	bool ok = true;
+
+	for (int p = 0; p < NET_POOLS; p++) {
+		while (held_count[p] < size[p] - count[p]) {
+			void *item = NULL;
+
+			if (held_count[p] < MAX_HELD) {
+				item = hold_one(p);
+			}
+
+			if (item == NULL) {
+				ok = false;
+				break;
+			}
+
+			held[p][held_count[p]++] = item;
+		}
+	}
+
+	return ok;
+}
+
+static void release(void)
+{
+	for (int p = 0; p < NET_POOLS; p++) {
+		for (uint32_t i = 0; i < held_count[p]; i++) {
+			if (p == NET_POOL_RX_PKTS || p == NET_POOL_TX_PKTS) {
+				net_pkt_unref(held[p][i]);
+			} else {
+				net_buf_unref(held[p][i]);
+			}
+		}
+
+		held_count[p] = 0;
+	}
+}
+
+static void play_phase(const struct profile_phase *ph, uint32_t *sent)
+{
+	uint32_t id = run_id;
+
+	rx_delay_ms = ph->rx_delay_ms;
+	memset(tx_buf, 0x5a, ph->size);
+	memcpy(tx_buf, &id, sizeof(id));
+
+	for (int i = 0; i < ph->datagrams; i++) {
+		net_pool_stats_sendto(tx_sock, tx_buf, ph->size, 0,
+				      (const struct sockaddr *)&dest,
+				      sizeof(dest));
+		(*sent)++;
+
+		if ((i + 1) % MAX(ph->burst, 1) == 0 && ph->gap_ms > 0) {
+			k_msleep(ph->gap_ms);
+		}
+	}
+}
+
+/*
+ * Play the whole profile with the pools held down to count. Returns the
+ * datagrams lost per million, or UINT32_MAX if the pools could not be
+ * held down.
+ */
+static uint32_t run_profile(const uint32_t size[NET_POOLS],
+			    const uint32_t count[NET_POOLS])
+{
+	struct net_pool_stat stats[NET_POOLS];
+	uint32_t sent = 0, lost, tx_failed;
+
+	if (!hold(size, count)) {
+		release();
+		return UINT32_MAX;
+	}
+
+	run_id++;
+	atomic_set(&received, 0);
+	net_pool_stats_reset();
+
+	for (size_t i = 0; i < profile_phases; i++) {
+		play_phase(&profile[i], &sent);
+	}
+
+	k_msleep(DRAIN_MS);
+
+	lost = sent - MIN((uint32_t)atomic_get(&received), sent);
+	net_pool_stats_get(stats);
+	tx_failed = stats[NET_POOL_TX_PKTS].alloc_failures +
+		    stats[NET_POOL_TX_BUFS].alloc_failures;
+	if (lost > tx_failed) {
+		net_pool_stats_rx_lost(lost - tx_failed);
+	}
+
+	release();
+
+	return (uint64_t)lost * 1000000U / MAX(sent, 1);
+}
+
+/* Bytes the pools take, near enough: blocks and buffer data */
+static uint32_t pools_ram(const uint32_t count[NET_POOLS])
+{
+	uint32_t pkt = sizeof(struct net_pkt);
+	uint32_t buf = sizeof(struct net_buf) + CONFIG_NET_BUF_DATA_SIZE;
+
+	return (count[NET_POOL_RX_PKTS] + count[NET_POOL_TX_PKTS]) * pkt +
+	       (count[NET_POOL_RX_BUFS] + count[NET_POOL_TX_BUFS]) * buf;
+}
+
+int main(void)
+{
+	struct net_pool_stat stats[NET_POOLS];
+	uint32_t size[NET_POOLS], count[NET_POOLS], best[NET_POOLS];
+	uint32_t ppm;
+	int grow;
+
+	k_thread_create(&receiver_thread, receiver_stack,
+			K_THREAD_STACK_SIZEOF(receiver_stack), receiver,
+			NULL, NULL, NULL, RECEIVER_PRIO, 0, K_NO_WAIT);
+	k_thread_name_set(&receiver_thread, "receiver");
+
+	tx_sock = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+	if (tx_sock < 0) {
+		printk("sizing failed: socket: %d\n", errno);
+		return 0;
+	}
+
+	k_msleep(DRAIN_MS);
+
+	net_pool_stats_reset();
+	net_pool_stats_get(stats);
+	for (int p = 0; p < NET_POOLS; p++) {
+		size[p] = stats[p].size;
+	}
+
+	ppm = run_profile(size, size);
+	printk("configured: drop %u ppm, target %u ppm\n", ppm,
+	       TARGET_DROP_PPM);
+	net_pool_stats_print();
+
+	if (ppm > TARGET_DROP_PPM) {
+		printk("sizing failed: the configured pools are too small\n");
+		return 0;
+	}
+
+	/* One pool at a time, the others at their configured size */
+	for (int p = 0; p < NET_POOLS; p++) {
+		uint32_t lo = size[p] > MAX_HELD ? size[p] - MAX_HELD : 1;
+		uint32_t hi = size[p];
+
+		while (lo < hi) {
+			uint32_t mid = lo + (hi - lo) / 2;
+
+			memcpy(count, size, sizeof(count));
+			count[p] = mid;
+			ppm = run_profile(size, count);
+			printk("%s=%u: drop %u ppm\n", conf_names[p], mid, ppm);
+
+			if (ppm <= TARGET_DROP_PPM) {
+				hi = mid;
+			} else {
+				lo = mid + 1;
+			}
+		}
+
+		best[p] = lo;
+	}
+
+	/* Pools shrunk together can fall short where each alone did not */
+	for (grow = 0; (ppm = run_profile(size, best)) > TARGET_DROP_PPM;
+	     grow++) {
+		if (grow == MAX_GROW) {
+			printk("sizing failed: no smaller set of pools found\n");
+			return 0;
+		}
+
+		for (int p = 0; p < NET_POOLS; p++) {
+			best[p] = MIN(best[p] + 1, size[p]);
+		}
+	}
+
+	printk("smallest pools, drop %u ppm:\n", ppm);
+	for (int p = 0; p < NET_POOLS; p++) {
+		printk("%s=%u\n", conf_names[p], best[p]);
+	}
+	printk("pools: about %u B instead of %u B\n", pools_ram(best),
+	       pools_ram(size));
+	printk("sizing done\n");
+
+	return 0;
+}
@@ -0,0 +1,21 @@
+/*
+ * The traffic the pools must absorb, modelled on the samples. Edit the
+ * table to match a deployment and run the sizing again.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/sys/util.h>
+
+#include "profile.h"
+
+const struct profile_phase profile[] = {
+	/* sensortest: a text datagram per sample */
+	{ "telemetry", 40, 48, 1, 100, 0 },
+	/* sensortest: the flash backlog drained in batches after an outage */
+	{ "backlog", 40, 512, 4, 100, 0 },
+	/* socket server: request bursts faster than they are handled */
+	{ "burst", 64, 200, 16, 50, 2 },
+};
+
+const size_t profile_phases = ARRAY_SIZE(profile);
@@ -0,0 +1,25 @@
+/*
+ * Traffic profile played by the pool sizing, one phase after the other.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct profile_phase {
+	const char *name;
+	uint16_t datagrams;
+	uint16_t size;		/* bytes per datagram */
+	uint8_t burst;		/* datagrams sent back to back */
+	uint16_t gap_ms;	/* after each burst */
+	uint16_t rx_delay_ms;	/* receiver processing time per datagram */
+};
+
+extern const struct profile_phase profile[];
+extern const size_t profile_phases;
+
+#endif /* PROFILE_H_ */
@@ -0,0 +1,104 @@
+/*
+ * Accelerometer streaming bench, see stream_bench.h
+ *
+ * Samples lost are those the emulator measured but the stream did not
+ * deliver, which accel_stream_stop() makes exact by draining the FIFO.
+ * Rates are over simulated time, which the emulated FIFO fills by; the
+ * bus utilization assumes the bus clock of the devicetree.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#include "accel_stream.h"
+#include "sensor_emul.h"
+#include "stream_bench.h"
+
+/* Sustained rates within this many permille of the data rate pass */
+#define STREAM_BENCH_RATE_TOLERANCE 20
+
+static const struct {
+	uint16_t odr_hz;
+	uint8_t watermark;
+} runs[] = {
+	{ 100, 1 }, { 100, 25 },
+	{ 400, 1 }, { 400, 25 },
+	{ 1344, 1 }, { 1344, 28 },
+};
+
+static uint32_t largest_block;
+
+static void count_block(const int16_t *xyz, size_t count, void *user_data)
+{
+	ARG_UNUSED(xyz);
+	ARG_UNUSED(user_data);
+
+	largest_block = MAX(largest_block, count);
+}
+
+static bool run_one(const struct emul *accel, uint16_t odr_hz,
+		    uint8_t watermark)
+{
+	const struct accel_stream_cfg cfg = {
+		.odr_hz = odr_hz,
+		.watermark = watermark,
+		.range_g = 2,
+		.cb = count_block,
+	};
+	struct accel_stream_stats st;
+	uint32_t measured, lost, rate, bus_permille;
+	uint64_t bus_hz = accel_stream_bus_hz();
+	int64_t start, ms;
+	int r;
+
+	largest_block = 0;
+	measured = sensor_emul_measurements(accel);
+	start = k_uptime_get();
+
+	r = accel_stream_start(&cfg);
+	if (r < 0) {
+		printk("stream %u Hz: start failed: %d\n", odr_hz, r);
+		return false;
+	}
+
+	k_sleep(K_MSEC(STREAM_BENCH_MS));
+
+	accel_stream_stop();
+	ms = k_uptime_get() - start;
+	accel_stream_get_stats(&st);
+
+	measured = sensor_emul_measurements(accel) - measured;
+	lost = measured - st.samples;
+	rate = st.samples * 1000 / ms;
+	bus_permille = st.bus_bits * 1000 * 1000 / ms / bus_hz;
+
+	printk("stream %4u Hz, %2u/block: %4u samples/s, %u lost, "
+	       "largest block %2u, bus %u.%u%% of %u kHz, %u.%u wakeups/s\n",
+	       odr_hz, watermark, rate, lost, largest_block,
+	       bus_permille / 10, bus_permille % 10, (uint32_t)(bus_hz / 1000),
+	       (uint32_t)(st.wakeups * 10000 / ms / 10),
+	       (uint32_t)(st.wakeups * 10000 / ms % 10));
+
+	return lost == 0 && st.errors == 0 &&
+	       rate * 1000 >= odr_hz * (1000 - STREAM_BENCH_RATE_TOLERANCE);
+}
+
+void stream_bench_run(void)
+{
+	const struct emul *accel = EMUL_DT_GET(DT_NODELABEL(accel));
+	bool ok = true;
+
+	printk("Accelerometer stream: %u ms per run, FIFO of %u samples\n",
+	       STREAM_BENCH_MS, ACCEL_STREAM_FIFO_DEPTH);
+
+	for (size_t i = 0; i < ARRAY_SIZE(runs); i++) {
+		ok &= run_one(accel, runs[i].odr_hz, runs[i].watermark);
+	}
+
+	printk("stream bench %s\n", ok ? "done" : "failed");
+}
@@ -0,0 +1,20 @@
+/*
+ * Accelerometer streaming bench for native_sim with the emulated LIS2DH.
+ *
+ * stream_bench_run() streams for STREAM_BENCH_MS of simulated time at each
+ * output data rate, once with one sample per block, which costs what a
+ * data-ready interrupt does, and once with larger blocks. For each run it
+ * reports the sustained sample rate, the samples lost, the I2C bus
+ * utilization and the CPU wake-ups per second.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef STREAM_BENCH_H_
+#define STREAM_BENCH_H_
+
+#define STREAM_BENCH_MS 2000
+
+void stream_bench_run(void);
+
+#endif /* STREAM_BENCH_H_ */
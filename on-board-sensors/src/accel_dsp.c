@@ -0,0 +1,305 @@
+/*
+ * Fixed-point accelerometer features, see accel_dsp.h
+ *
+ * The FFT is radix-2 decimation in time and halves every stage, so its
+ * output is the DFT over DSP_FFT_LEN, as CMSIS-DSP's arm_rfft_q15() gives
+ * it. The input is shifted up to its full scale first and the energies
+ * shifted back after (block floating point): small vibrations would lose
+ * most of their bits to the six halvings otherwise.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+
+#include <zephyr/sys/util.h>
+
+#include "accel_dsp.h"
+
+BUILD_ASSERT(DSP_FFT_LEN == 64, "the sine table is for 64 points");
+
+const uint8_t dsp_band_bins[DSP_BANDS + 1] = { 1, 4, 8, 16, 33 };
+
+#ifndef CONFIG_CMSIS_DSP
+/* sin(2 pi k / 64) for k < 48, cos(x) being sin(x + 16) */
+static const q15_t sine[DSP_FFT_LEN * 3 / 4] = {
+	0, 3212, 6393, 9512, 12539, 15446, 18204, 20787,
+	23170, 25329, 27245, 28898, 30273, 31356, 32137, 32609,
+	32767, 32609, 32137, 31356, 30273, 28898, 27245, 25329,
+	23170, 20787, 18204, 15446, 12539, 9512, 6393, 3212,
+	0, -3212, -6393, -9512, -12539, -15446, -18204, -20787,
+	-23170, -25329, -27245, -28898, -30273, -31356, -32137, -32609,
+};
+#endif
+
+static inline q15_t sat16(int32_t v)
+{
+	return CLAMP(v, INT16_MIN, INT16_MAX);
+}
+
+/* Bit by bit, with a select rather than a branch */
+static inline uint32_t isqrt32(uint32_t v)
+{
+	uint32_t r = 0;
+
+	for (int b = 15; b >= 0; b--) {
+		uint32_t t = r | BIT(b);
+
+		r = t * t <= v ? t : r;
+	}
+
+	return r;
+}
+
+void dsp_from_mg(const int16_t *xyz, size_t n, uint8_t range_g,
+		 q15_t *x, q15_t *y, q15_t *z)
+{
+	/* Q15 per mg, Q10 */
+	int32_t scale = (32768 << 10) / (range_g * 1000);
+
+	for (size_t i = 0; i < n; i++) {
+		x[i] = sat16((xyz[3 * i] * scale) >> 10);
+		y[i] = sat16((xyz[3 * i + 1] * scale) >> 10);
+		z[i] = sat16((xyz[3 * i + 2] * scale) >> 10);
+	}
+}
+
+void dsp_magnitude_q15(const q15_t *x, const q15_t *y, const q15_t *z,
+		       q15_t *mag, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		uint32_t sq = (uint32_t)(x[i] * x[i]) +
+			      (uint32_t)(y[i] * y[i]) +
+			      (uint32_t)(z[i] * z[i]);
+
+		mag[i] = MIN(isqrt32(sq), INT16_MAX);
+	}
+}
+
+void dsp_offset_q15(const q15_t *v, q15_t offset, q15_t *out, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		out[i] = sat16(v[i] - offset);
+	}
+}
+
+#ifdef CONFIG_CMSIS_DSP
+
+q15_t dsp_mean_q15(const q15_t *v, size_t n)
+{
+	q15_t mean;
+
+	arm_mean_q15(v, n, &mean);
+
+	return mean;
+}
+
+q15_t dsp_rms_q15(const q15_t *v, size_t n)
+{
+	q15_t rms;
+
+	arm_rms_q15(v, n, &rms);
+
+	return rms;
+}
+
+q15_t dsp_peak_q15(const q15_t *v, size_t n)
+{
+	uint32_t index;
+	q15_t peak;
+
+	arm_absmax_q15(v, n, &peak, &index);
+
+	return peak;
+}
+
+/* DFT over DSP_FFT_LEN of the real input, interleaved re and im */
+static void fft_q15(q15_t *in, q15_t *out)
+{
+	arm_rfft_instance_q15 rfft;
+
+	arm_rfft_init_q15(&rfft, DSP_FFT_LEN, 0, 1);
+	arm_rfft_q15(&rfft, in, out);
+}
+
+#else
+
+q15_t dsp_mean_q15(const q15_t *v, size_t n)
+{
+	int32_t sum = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		sum += v[i];
+	}
+
+	return sum / (int32_t)n;
+}
+
+q15_t dsp_rms_q15(const q15_t *v, size_t n)
+{
+	int64_t sum = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		sum += v[i] * v[i];
+	}
+
+	return MIN(isqrt32(sum / n), INT16_MAX);
+}
+
+q15_t dsp_peak_q15(const q15_t *v, size_t n)
+{
+	int32_t peak = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		int32_t a = v[i] < 0 ? -v[i] : v[i];
+
+		peak = MAX(peak, a);
+	}
+
+	return MIN(peak, INT16_MAX);
+}
+
+static void fft_q15(q15_t *in, q15_t *out)
+{
+	q15_t re[DSP_FFT_LEN];
+	q15_t im[DSP_FFT_LEN];
+
+	for (size_t i = 0, j = 0; i < DSP_FFT_LEN; i++) {
+		re[j] = in[i];
+		im[j] = 0;
+
+		/* j is i bit-reversed, for the next i */
+		size_t bit = DSP_FFT_LEN >> 1;
+
+		for (; j & bit; bit >>= 1) {
+			j ^= bit;
+		}
+		j |= bit;
+	}
+
+	for (size_t len = 2; len <= DSP_FFT_LEN; len <<= 1) {
+		size_t step = DSP_FFT_LEN / len;
+
+		for (size_t i = 0; i < DSP_FFT_LEN; i += len) {
+			for (size_t k = 0; k < len / 2; k++) {
+				int32_t c = sine[k * step + DSP_FFT_LEN / 4];
+				int32_t s = sine[k * step];
+				size_t a = i + k;
+				size_t b = a + len / 2;
+				int32_t tr = (re[b] * c + im[b] * s) >> 15;
+				int32_t ti = (im[b] * c - re[b] * s) >> 15;
+				int32_t ar = re[a];
+				int32_t ai = im[a];
+
+				re[a] = sat16((ar + tr) >> 1);
+				im[a] = sat16((ai + ti) >> 1);
+				re[b] = sat16((ar - tr) >> 1);
+				im[b] = sat16((ai - ti) >> 1);
+			}
+		}
+	}
+
+	for (size_t k = 0; k <= DSP_FFT_LEN / 2; k++) {
+		out[2 * k] = re[k];
+		out[2 * k + 1] = im[k];
+	}
+}
+
+#endif /* CONFIG_CMSIS_DSP */
+
+static int32_t atan2_i32(int32_t y, int32_t x)
+{
+	int32_t ax = abs(x);
+	int32_t ay = abs(y);
+	int32_t lo = MIN(ax, ay);
+	int32_t hi = MAX(ax, ay);
+	int32_t r, a;
+
+	if (hi == 0) {
+		return 0;
+	}
+
+	/* atan(r) / pi ~ r / 4 + r (1 - r) (0.0779 + 0.0211 r), r <= 1 */
+	r = (lo << 15) / hi;
+	a = (r >> 2) + ((((r * (32768 - r)) >> 15) *
+			 (2552 + ((691 * r) >> 15))) >> 15);
+
+	if (ay > ax) {
+		a = 16384 - a;
+	}
+	if (x < 0) {
+		a = 32768 - a;
+	}
+
+	return y < 0 ? -a : a;
+}
+
+q15_t dsp_atan2_q15(q15_t y, q15_t x)
+{
+	return sat16(atan2_i32(y, x));
+}
+
+q15_t dsp_tilt_q15(q15_t x, q15_t y, q15_t z)
+{
+	uint32_t h = isqrt32((uint32_t)(x * x) + (uint32_t)(y * y));
+
+	return sat16(atan2_i32(h, z));
+}
+
+void dsp_band_energy_q15(const q15_t *v, q31_t bands[DSP_BANDS])
+{
+	q15_t in[DSP_FFT_LEN];
+	q15_t out[2 * DSP_FFT_LEN];
+	int32_t peak = dsp_peak_q15(v, DSP_FFT_LEN);
+	int shift = 0;
+
+	while (shift < 15 && (peak << (shift + 1)) <= INT16_MAX) {
+		shift++;
+	}
+
+	for (size_t i = 0; i < DSP_FFT_LEN; i++) {
+		in[i] = v[i] << shift;
+	}
+
+	fft_q15(in, out);
+
+	for (int b = 0; b < DSP_BANDS; b++) {
+		int64_t sum = 0;
+
+		for (size_t k = dsp_band_bins[b]; k < dsp_band_bins[b + 1];
+		     k++) {
+			int32_t re = out[2 * k];
+			int32_t im = out[2 * k + 1];
+			/* Bins but the last stand for their mirror image too */
+			int64_t p = (int64_t)(re * re) + im * im;
+
+			sum += k < DSP_FFT_LEN / 2 ? 2 * p : p;
+		}
+
+		bands[b] = MIN(sum >> (2 * shift), INT32_MAX);
+	}
+}
+
+void dsp_features(const int16_t *xyz, uint8_t range_g,
+		  struct dsp_features *f)
+{
+	q15_t x[DSP_FFT_LEN];
+	q15_t y[DSP_FFT_LEN];
+	q15_t z[DSP_FFT_LEN];
+	q15_t mag[DSP_FFT_LEN];
+
+	dsp_from_mg(xyz, DSP_FFT_LEN, range_g, x, y, z);
+
+	f->mean[0] = dsp_mean_q15(x, DSP_FFT_LEN);
+	f->mean[1] = dsp_mean_q15(y, DSP_FFT_LEN);
+	f->mean[2] = dsp_mean_q15(z, DSP_FFT_LEN);
+	f->tilt = dsp_tilt_q15(f->mean[0], f->mean[1], f->mean[2]);
+
+	dsp_magnitude_q15(x, y, z, mag, DSP_FFT_LEN);
+
+	/* The vibration, reusing x */
+	dsp_offset_q15(mag, dsp_mean_q15(mag, DSP_FFT_LEN), x, DSP_FFT_LEN);
+	f->vib_rms = dsp_rms_q15(x, DSP_FFT_LEN);
+	f->vib_peak = dsp_peak_q15(x, DSP_FFT_LEN);
+	dsp_band_energy_q15(x, f->bands);
+}
@@ -0,0 +1,76 @@
+/*
+ * Fixed-point features of accelerometer blocks.
+ *
+ * Samples are Q15 fractions of the full scale, one array per axis: every
+ * kernel is a counted loop over contiguous int16 data with 32 or 64-bit
+ * accumulators and no early exit, which the compiler can vectorize. With
+ * CONFIG_CMSIS_DSP the mean, RMS, peak and FFT come from CMSIS-DSP.
+ *
+ * Magnitudes over the full scale (a corner at sqrt(3) of it) saturate.
+ * Angles are Q15 fractions of 180 degrees. Band energies are the share of
+ * the mean square, about the mean, that falls in each band of a
+ * DSP_FFT_LEN-point FFT, in Q30 of the full scale squared, so that they
+ * add up to the squared RMS of the signal less its DC part.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ACCEL_DSP_H_
+#define ACCEL_DSP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef CONFIG_CMSIS_DSP
+#include <arm_math.h>
+#else
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+#endif
+
+/* Samples per feature block, a power of two for the FFT */
+#define DSP_FFT_LEN 64
+#define DSP_BANDS 4
+
+/* First FFT bin of each band, then one past the last; bin k is k/64 ODR */
+extern const uint8_t dsp_band_bins[DSP_BANDS + 1];
+
+struct dsp_features {
+	q15_t mean[3];		/* X, Y, Z */
+	q15_t vib_rms;		/* magnitude about its mean */
+	q15_t vib_peak;		/* largest magnitude off its mean */
+	q15_t tilt;		/* between the mean and +Z */
+	q31_t bands[DSP_BANDS];	/* of the magnitude */
+};
+
+/* Interleaved X, Y, Z in mg to one Q15 array per axis, saturating */
+void dsp_from_mg(const int16_t *xyz, size_t n, uint8_t range_g,
+		 q15_t *x, q15_t *y, q15_t *z);
+
+/* sqrt(x^2 + y^2 + z^2) per sample */
+void dsp_magnitude_q15(const q15_t *x, const q15_t *y, const q15_t *z,
+		       q15_t *mag, size_t n);
+
+q15_t dsp_mean_q15(const q15_t *v, size_t n);
+q15_t dsp_rms_q15(const q15_t *v, size_t n);
+
+/* Largest absolute value */
+q15_t dsp_peak_q15(const q15_t *v, size_t n);
+
+/* v - offset per sample, saturating */
+void dsp_offset_q15(const q15_t *v, q15_t offset, q15_t *out, size_t n);
+
+/* atan2(y, x), within 0.1 degree */
+q15_t dsp_atan2_q15(q15_t y, q15_t x);
+
+/* Angle between (x, y, z) and +Z */
+q15_t dsp_tilt_q15(q15_t x, q15_t y, q15_t z);
+
+/* Band energies of DSP_FFT_LEN samples with no DC part */
+void dsp_band_energy_q15(const q15_t *v, q31_t bands[DSP_BANDS]);
+
+/* Every feature of DSP_FFT_LEN interleaved samples in mg */
+void dsp_features(const int16_t *xyz, uint8_t range_g,
+		  struct dsp_features *f);
+
+#endif /* ACCEL_DSP_H_ */
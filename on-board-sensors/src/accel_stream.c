@@ -0,0 +1,368 @@
+/*
+ * LIS2DH accelerometer streaming, see accel_stream.h
+ *
+ * The FIFO runs in stream mode at the chosen output data rate, high
+ * resolution, and the watermark threshold is set so that INT1 rises once
+ * the FIFO holds a block's worth of samples. A drain costs two transfers
+ * whatever the block size: FIFO_SRC_REG for the level, then the output
+ * registers, which the part rolls over from OUT_Z_H to OUT_X_L in FIFO
+ * mode, for every stored sample. The samples are converted to mg in place.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/logging/log.h>
+
+#include "accel_stream.h"
+
+LOG_MODULE_REGISTER(accel_stream, LOG_LEVEL_INF);
+
+#define ACCEL_NODE DT_COMPAT_GET_ANY_STATUS_OKAY(st_lis2dh)
+
+#define LIS2DH_REG_CTRL1	0x20
+#define LIS2DH_REG_CTRL3	0x22
+#define LIS2DH_REG_CTRL4	0x23
+#define LIS2DH_REG_CTRL5	0x24
+#define LIS2DH_REG_OUT_X_L	0x28
+#define LIS2DH_REG_FIFO_CTRL	0x2e
+#define LIS2DH_REG_FIFO_SRC	0x2f
+
+#define LIS2DH_AUTOINCREMENT	BIT(7)
+#define LIS2DH_ODR_SHIFT	4
+#define LIS2DH_XYZ_EN		BIT_MASK(3)
+#define LIS2DH_I1_WTM		BIT(2)
+#define LIS2DH_FS_SHIFT		4
+#define LIS2DH_HR		BIT(3)
+#define LIS2DH_FIFO_EN		BIT(6)
+#define LIS2DH_FM_BYPASS	(0 << 6)
+#define LIS2DH_FM_STREAM	(2 << 6)
+#define LIS2DH_FIFO_OVRN	BIT(6)
+#define LIS2DH_FSS_MASK		BIT_MASK(5)
+
+/* Bytes per sample, X, Y and Z little-endian */
+#define SAMPLE_BYTES 6
+
+#if DT_NODE_EXISTS(ACCEL_NODE)
+
+static const struct device *const accel_dev = DEVICE_DT_GET(ACCEL_NODE);
+static const struct i2c_dt_spec bus = I2C_DT_SPEC_GET(ACCEL_NODE);
+static const struct gpio_dt_spec int1 =
+	GPIO_DT_SPEC_GET_BY_IDX_OR(ACCEL_NODE, irq_gpios, 0, { 0 });
+
+/* CTRL_REG1 ODR codes */
+static const struct {
+	uint16_t hz;
+	uint8_t code;
+} odrs[] = {
+	{ 1, 1 }, { 10, 2 }, { 25, 3 }, { 50, 4 },
+	{ 100, 5 }, { 200, 6 }, { 400, 7 }, { 1344, 9 },
+};
+
+/* By CTRL_REG4 full scale, mg per digit at high resolution */
+static const uint8_t ranges_g[] = { 2, 4, 8, 16 };
+static const uint8_t sensitivity_mg[] = { 1, 2, 4, 12 };
+
+static struct accel_stream_cfg cfg;
+static struct accel_stream_stats stats;
+static bool running;
+static uint8_t sensitivity;
+static uint8_t saved_ctrl1;
+static uint8_t saved_ctrl4;
+
+/* Raw FIFO bytes, then the same samples in mg */
+static int16_t block[ACCEL_STREAM_FIFO_DEPTH * 3];
+
+static struct gpio_callback int1_cb;
+
+static void drain_handler(struct k_work *work);
+static K_WORK_DEFINE(drain_work, drain_handler);
+
+static void drain_timer_expiry(struct k_timer *timer);
+static K_TIMER_DEFINE(drain_timer, drain_timer_expiry, NULL);
+
+/*
+ * Start, address and the bytes written with their ACKs, stop, and for a
+ * read a repeated start, the address and the bytes read
+ */
+static void bus_account(size_t wr, size_t rd)
+{
+	stats.bus_bits += 2 + 9 * (1 + wr);
+	if (rd > 0) {
+		stats.bus_bits += 1 + 9 * (1 + rd);
+	}
+}
+
+static int reg_write(uint8_t reg, uint8_t val)
+{
+	bus_account(2, 0);
+
+	return i2c_reg_write_byte_dt(&bus, reg, val);
+}
+
+static int reg_read(uint8_t reg, uint8_t *val)
+{
+	bus_account(1, 1);
+
+	return i2c_reg_read_byte_dt(&bus, reg, val);
+}
+
+static void drain(void)
+{
+	uint8_t src;
+	size_t n;
+
+	if (reg_read(LIS2DH_REG_FIFO_SRC, &src) < 0) {
+		stats.errors++;
+		return;
+	}
+
+	if (src & LIS2DH_FIFO_OVRN) {
+		n = ACCEL_STREAM_FIFO_DEPTH;
+		stats.overruns++;
+	} else {
+		n = src & LIS2DH_FSS_MASK;
+	}
+
+	if (n == 0) {
+		return;
+	}
+
+	bus_account(1, n * SAMPLE_BYTES);
+	if (i2c_burst_read_dt(&bus, LIS2DH_REG_OUT_X_L | LIS2DH_AUTOINCREMENT,
+			      (uint8_t *)block, n * SAMPLE_BYTES) < 0) {
+		stats.errors++;
+		return;
+	}
+
+	/* Left-justified 12-bit samples */
+	for (size_t i = 0; i < n * 3; i++) {
+		int16_t raw = sys_le16_to_cpu((uint16_t)block[i]);
+
+		block[i] = (raw >> 4) * sensitivity;
+	}
+
+	stats.samples += n;
+	stats.blocks++;
+
+	cfg.cb(block, n, cfg.user_data);
+}
+
+static void drain_handler(struct k_work *work)
+{
+	ARG_UNUSED(work);
+
+	if (!running) {
+		return;
+	}
+
+	drain();
+
+	/* Samples that arrived during the burst keep INT1 up, no new edge */
+	if (int1.port != NULL && gpio_pin_get_dt(&int1) > 0) {
+		k_work_submit(&drain_work);
+	}
+}
+
+static void int1_handler(const struct device *port, struct gpio_callback *cb,
+			 gpio_port_pins_t pins)
+{
+	ARG_UNUSED(port);
+	ARG_UNUSED(cb);
+	ARG_UNUSED(pins);
+
+	stats.wakeups++;
+	k_work_submit(&drain_work);
+}
+
+static void drain_timer_expiry(struct k_timer *timer)
+{
+	ARG_UNUSED(timer);
+
+	stats.wakeups++;
+	k_work_submit(&drain_work);
+}
+
+static int setup_int1(void)
+{
+	int r;
+
+	r = gpio_pin_configure_dt(&int1, GPIO_INPUT);
+	if (r < 0) {
+		return r;
+	}
+
+	gpio_init_callback(&int1_cb, int1_handler, BIT(int1.pin));
+	r = gpio_add_callback(int1.port, &int1_cb);
+	if (r < 0) {
+		return r;
+	}
+
+	return gpio_pin_interrupt_configure_dt(&int1, GPIO_INT_EDGE_TO_ACTIVE);
+}
+
+/* FIFO and interrupt off, the driver's rate and range back */
+static int restore(void)
+{
+	int r;
+
+	r = reg_write(LIS2DH_REG_CTRL3, 0);
+	r = r ? r : reg_write(LIS2DH_REG_FIFO_CTRL, LIS2DH_FM_BYPASS);
+	r = r ? r : reg_write(LIS2DH_REG_CTRL5, 0);
+	r = r ? r : reg_write(LIS2DH_REG_CTRL1, saved_ctrl1);
+	r = r ? r : reg_write(LIS2DH_REG_CTRL4, saved_ctrl4);
+
+	return r;
+}
+
+int accel_stream_start(const struct accel_stream_cfg *new_cfg)
+{
+	int odr = -1;
+	int fs = -1;
+	int r;
+
+	if (!device_is_ready(accel_dev) || !device_is_ready(bus.bus)) {
+		return -ENODEV;
+	}
+
+	if (running) {
+		return -EBUSY;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(odrs); i++) {
+		if (odrs[i].hz == new_cfg->odr_hz) {
+			odr = odrs[i].code;
+		}
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(ranges_g); i++) {
+		if (ranges_g[i] == new_cfg->range_g) {
+			fs = i;
+		}
+	}
+
+	if (odr < 0 || fs < 0 || new_cfg->cb == NULL ||
+	    new_cfg->watermark < 1 ||
+	    new_cfg->watermark >= ACCEL_STREAM_FIFO_DEPTH) {
+		return -EINVAL;
+	}
+
+	cfg = *new_cfg;
+	sensitivity = sensitivity_mg[fs];
+	memset(&stats, 0, sizeof(stats));
+
+	r = reg_read(LIS2DH_REG_CTRL1, &saved_ctrl1);
+	r = r ? r : reg_read(LIS2DH_REG_CTRL4, &saved_ctrl4);
+	if (r < 0) {
+		return r;
+	}
+
+	if (int1.port != NULL) {
+		r = setup_int1();
+		if (r < 0) {
+			LOG_ERR("INT1 setup failed: %d", r);
+			return r;
+		}
+	}
+
+	running = true;
+
+	/*
+	 * Bypass mode empties the FIFO. WTM follows a FIFO holding more than
+	 * FTH samples, so FTH is one less than the block.
+	 */
+	r = r ? r : reg_write(LIS2DH_REG_FIFO_CTRL, LIS2DH_FM_BYPASS);
+	r = r ? r : reg_write(LIS2DH_REG_CTRL1,
+			      (odr << LIS2DH_ODR_SHIFT) | LIS2DH_XYZ_EN);
+	r = r ? r : reg_write(LIS2DH_REG_CTRL4,
+			      (fs << LIS2DH_FS_SHIFT) | LIS2DH_HR);
+	r = r ? r : reg_write(LIS2DH_REG_CTRL5, LIS2DH_FIFO_EN);
+	r = r ? r : reg_write(LIS2DH_REG_FIFO_CTRL,
+			      LIS2DH_FM_STREAM | (cfg.watermark - 1));
+	r = r ? r : reg_write(LIS2DH_REG_CTRL3,
+			      int1.port != NULL ? LIS2DH_I1_WTM : 0);
+	if (r < 0) {
+		accel_stream_stop();
+		return r;
+	}
+
+	if (int1.port == NULL) {
+		k_timeout_t period = K_USEC(cfg.watermark * USEC_PER_SEC /
+					    cfg.odr_hz);
+
+		k_timer_start(&drain_timer, period, period);
+	}
+
+	LOG_INF("%u Hz in blocks of %u, drained on %s", cfg.odr_hz,
+		cfg.watermark, int1.port != NULL ? "INT1" : "a timer");
+
+	return 0;
+}
+
+int accel_stream_stop(void)
+{
+	struct k_work_sync sync;
+
+	if (!running) {
+		return 0;
+	}
+
+	running = false;
+
+	if (int1.port != NULL) {
+		gpio_pin_interrupt_configure_dt(&int1, GPIO_INT_DISABLE);
+		gpio_remove_callback(int1.port, &int1_cb);
+	}
+	k_timer_stop(&drain_timer);
+	k_work_cancel_sync(&drain_work, &sync);
+
+	drain();
+
+	return restore();
+}
+
+void accel_stream_get_stats(struct accel_stream_stats *out)
+{
+	*out = stats;
+}
+
+uint32_t accel_stream_bus_hz(void)
+{
+	return DT_PROP_OR(DT_BUS(ACCEL_NODE), clock_frequency,
+			  I2C_BITRATE_STANDARD);
+}
+
+#else /* No LIS2DH */
+
+int accel_stream_start(const struct accel_stream_cfg *new_cfg)
+{
+	ARG_UNUSED(new_cfg);
+
+	return -ENODEV;
+}
+
+int accel_stream_stop(void)
+{
+	return 0;
+}
+
+void accel_stream_get_stats(struct accel_stream_stats *out)
+{
+	memset(out, 0, sizeof(*out));
+}
+
+uint32_t accel_stream_bus_hz(void)
+{
+	return 0;
+}
+
+#endif
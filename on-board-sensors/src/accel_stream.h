@@ -0,0 +1,63 @@
+/*
+ * LIS2DH accelerometer streaming through the device FIFO.
+ *
+ * accel_stream_start() sets the output data rate, turns the 32-sample FIFO
+ * on in stream mode and routes its watermark to INT1, the first irq-gpios
+ * line of the lis2dh node. Each watermark interrupt submits one drain to
+ * the system work queue, which reads the FIFO level and then every stored
+ * sample in a single I2C burst, and hands the block to the callback as
+ * packed X, Y, Z triples in mg. Without irq-gpios a timer drains the FIFO
+ * once per watermark period instead.
+ *
+ * The Zephyr lis2dh driver has no FIFO support, so the stream talks to the
+ * part over I2C itself and owns it while running: the driver must not
+ * fetch samples until accel_stream_stop(), which delivers what is left in
+ * the FIFO and restores the driver's settings.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ACCEL_STREAM_H_
+#define ACCEL_STREAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ACCEL_STREAM_FIFO_DEPTH 32
+
+/* count samples of X, Y, Z in mg, valid during the call only */
+typedef void (*accel_stream_cb_t)(const int16_t *xyz, size_t count,
+				  void *user_data);
+
+struct accel_stream_cfg {
+	uint16_t odr_hz;	/* 1, 10, 25, 50, 100, 200, 400 or 1344 */
+	uint8_t watermark;	/* samples per block, 1 to 31 */
+	uint8_t range_g;	/* 2, 4, 8 or 16 */
+	accel_stream_cb_t cb;
+	void *user_data;
+};
+
+struct accel_stream_stats {
+	uint32_t samples;
+	uint32_t blocks;
+	uint32_t overruns;	/* drains that found the FIFO full */
+	uint32_t wakeups;	/* watermark interrupts or timer expiries */
+	uint32_t errors;	/* failed bus transfers */
+	uint64_t bus_bits;	/* on the wire, start, stop and ACK included */
+};
+
+/*
+ * Returns -ENODEV without a ready LIS2DH, -EINVAL for an unsupported
+ * configuration, -EBUSY if already streaming, or the bus error.
+ */
+int accel_stream_start(const struct accel_stream_cfg *cfg);
+
+int accel_stream_stop(void);
+
+/* Counters since the last accel_stream_start() */
+void accel_stream_get_stats(struct accel_stream_stats *stats);
+
+/* SCL frequency of the accelerometer's bus, for the bus utilization */
+uint32_t accel_stream_bus_hz(void);
+
+#endif /* ACCEL_STREAM_H_ */
@@ -0,0 +1,214 @@
+/*
+ * Streaming per-channel statistics, see aggregate.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "aggregate.h"
+
+const float agg_quantiles[AGG_QUANTILES] = { 0.5f, 0.9f };
+
+static void pane_clear(struct agg_pane *pane)
+{
+	memset(pane, 0, sizeof(*pane));
+}
+
+static void p2_clear(struct agg_p2 *s)
+{
+	memset(s, 0, sizeof(*s));
+}
+
+int agg_init(struct agg_channel *ch, const char *name, uint8_t panes,
+	     bool quantiles)
+{
+	if (panes == 0 || panes > AGG_MAX_PANES) {
+		return -EINVAL;
+	}
+
+	memset(ch, 0, sizeof(*ch));
+	ch->name = name;
+	ch->panes = panes;
+	ch->quantiles = quantiles && panes == 1;
+
+	return 0;
+}
+
+static void pane_add(struct agg_pane *pane, float x)
+{
+	float d;
+
+	if (pane->count == 0 || x < pane->min) {
+		pane->min = x;
+	}
+	if (pane->count == 0 || x > pane->max) {
+		pane->max = x;
+	}
+
+	pane->count++;
+	d = x - pane->mean;
+	pane->mean += d / pane->count;
+	pane->m2 += d * (x - pane->mean);
+}
+
+/* Piecewise-parabolic prediction of marker i moved by d (+1 or -1) */
+static float p2_parabolic(const struct agg_p2 *s, int i, int d)
+{
+	const float *q = s->q;
+	const int32_t *n = s->n;
+
+	return q[i] + (float)d / (n[i + 1] - n[i - 1]) *
+	       ((n[i] - n[i - 1] + d) * (q[i + 1] - q[i]) / (n[i + 1] - n[i]) +
+		(n[i + 1] - n[i] - d) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]));
+}
+
+static void p2_add(struct agg_p2 *s, float p, float x)
+{
+	int k;
+
+	if (s->count < 5) {
+		/* Insertion sort of the first five samples */
+		for (k = s->count; k > 0 && s->q[k - 1] > x; k--) {
+			s->q[k] = s->q[k - 1];
+		}
+		s->q[k] = x;
+
+		if (++s->count == 5) {
+			for (int i = 0; i < 5; i++) {
+				s->n[i] = i;
+			}
+			s->np[0] = 0.0f;
+			s->np[1] = 2.0f * p;
+			s->np[2] = 4.0f * p;
+			s->np[3] = 2.0f + 2.0f * p;
+			s->np[4] = 4.0f;
+		}
+		return;
+	}
+
+	if (x < s->q[0]) {
+		s->q[0] = x;
+		k = 0;
+	} else if (x >= s->q[4]) {
+		s->q[4] = x;
+		k = 3;
+	} else {
+		for (k = 0; k < 3 && x >= s->q[k + 1]; k++) {
+		}
+	}
+
+	for (int i = k + 1; i < 5; i++) {
+		s->n[i]++;
+	}
+
+	s->np[1] += p / 2.0f;
+	s->np[2] += p;
+	s->np[3] += (1.0f + p) / 2.0f;
+	s->np[4] += 1.0f;
+
+	for (int i = 1; i < 4; i++) {
+		float d = s->np[i] - s->n[i];
+		int ds;
+		float q;
+
+		if (!((d >= 1.0f && s->n[i + 1] - s->n[i] > 1) ||
+		      (d <= -1.0f && s->n[i - 1] - s->n[i] < -1))) {
+			continue;
+		}
+
+		ds = d > 0 ? 1 : -1;
+		q = p2_parabolic(s, i, ds);
+		if (!(s->q[i - 1] < q && q < s->q[i + 1])) {
+			/* Linear instead, the parabola left the neighbours */
+			q = s->q[i] + ds * (s->q[i + ds] - s->q[i]) /
+				      (s->n[i + ds] - s->n[i]);
+		}
+
+		s->q[i] = q;
+		s->n[i] += ds;
+	}
+
+	s->count++;
+}
+
+static float p2_estimate(const struct agg_p2 *s, float p)
+{
+	if (s->count >= 5) {
+		return s->q[2];
+	}
+
+	/* Still sorted samples, take the nearest rank */
+	return s->q[(int)(p * (s->count - 1) + 0.5f)];
+}
+
+void agg_add(struct agg_channel *ch, float x)
+{
+	pane_add(&ch->pane[ch->cur], x);
+
+	if (ch->quantiles) {
+		for (int i = 0; i < AGG_QUANTILES; i++) {
+			p2_add(&ch->p2[i], agg_quantiles[i], x);
+		}
+	}
+}
+
+bool agg_summarize(const struct agg_channel *ch, struct agg_summary *s)
+{
+	memset(s, 0, sizeof(*s));
+
+	for (int i = 0; i < ch->panes; i++) {
+		const struct agg_pane *pane = &ch->pane[i];
+		uint32_t n;
+		float d;
+
+		if (pane->count == 0) {
+			continue;
+		}
+
+		if (s->count == 0) {
+			s->min = pane->min;
+			s->max = pane->max;
+		} else {
+			s->min = pane->min < s->min ? pane->min : s->min;
+			s->max = pane->max > s->max ? pane->max : s->max;
+		}
+
+		/* s->variance holds the merged m2 until the end */
+		n = s->count + pane->count;
+		d = pane->mean - s->mean;
+		s->mean += d * pane->count / n;
+		s->variance += pane->m2 +
+			       d * d * ((float)s->count * pane->count / n);
+		s->count = n;
+	}
+
+	if (s->count == 0) {
+		return false;
+	}
+
+	s->variance = s->count > 1 ? s->variance / (s->count - 1) : 0.0f;
+
+	if (ch->quantiles) {
+		s->has_quantiles = true;
+		for (int i = 0; i < AGG_QUANTILES; i++) {
+			s->quantile[i] = p2_estimate(&ch->p2[i],
+						     agg_quantiles[i]);
+		}
+	}
+
+	return true;
+}
+
+void agg_slide(struct agg_channel *ch)
+{
+	ch->cur = (ch->cur + 1) % ch->panes;
+	pane_clear(&ch->pane[ch->cur]);
+
+	if (ch->quantiles) {
+		for (int i = 0; i < AGG_QUANTILES; i++) {
+			p2_clear(&ch->p2[i]);
+		}
+	}
+}
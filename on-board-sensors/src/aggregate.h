@@ -0,0 +1,80 @@
+/*
+ * Streaming per-channel statistics over time windows.
+ *
+ * Each channel keeps count, min, max, mean and variance (Welford's online
+ * algorithm) for up to AGG_MAX_PANES panes. A tumbling window is one pane
+ * that is cleared after each summary. A sliding window of length L that
+ * moves by S keeps L / S panes: a summary merges them (Chan et al.'s
+ * pairwise update for the variance) and the oldest pane is then dropped.
+ *
+ * Quantiles are estimated with the P-square algorithm (Jain and Chlamtac,
+ * 1985), five markers per quantile. The markers cannot be merged, so they
+ * are only kept for tumbling windows.
+ *
+ * Memory per channel is fixed, whatever the sample rate.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef AGGREGATE_H_
+#define AGGREGATE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define AGG_MAX_PANES	 4
+#define AGG_QUANTILES	 2
+
+/* Quantiles estimated when enabled, in AGG_QUANTILES order */
+extern const float agg_quantiles[AGG_QUANTILES];
+
+struct agg_pane {
+	uint32_t count;
+	float mean;
+	float m2;		/* sum of squared deviations from the mean */
+	float min;
+	float max;
+};
+
+struct agg_p2 {
+	float q[5];		/* marker heights */
+	int32_t n[5];		/* marker positions */
+	float np[5];		/* desired positions */
+	uint32_t count;
+};
+
+struct agg_channel {
+	const char *name;
+	uint8_t panes;
+	uint8_t cur;
+	bool quantiles;
+	struct agg_pane pane[AGG_MAX_PANES];
+	struct agg_p2 p2[AGG_QUANTILES];
+};
+
+struct agg_summary {
+	uint32_t count;
+	float min;
+	float max;
+	float mean;
+	float variance;
+	bool has_quantiles;
+	float quantile[AGG_QUANTILES];
+};
+
+/*
+ * panes is 1 for a tumbling window, window length / slide for a sliding
+ * one. Quantiles are ignored for sliding windows.
+ */
+int agg_init(struct agg_channel *ch, const char *name, uint8_t panes,
+	     bool quantiles);
+
+void agg_add(struct agg_channel *ch, float x);
+
+/* Summary of the whole window, false if it holds no sample */
+bool agg_summarize(const struct agg_channel *ch, struct agg_summary *s);
+
+/* Move the window by one slide (or to the next tumbling window) */
+void agg_slide(struct agg_channel *ch);
+
+#endif /* AGGREGATE_H_ */
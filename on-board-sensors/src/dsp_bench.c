@@ -0,0 +1,256 @@
+/*
+ * Accelerometer feature bench, see dsp_bench.h
+ *
+ * The float reference follows the same steps as dsp_features(), with a
+ * float radix-2 FFT, so that the times compare the arithmetic and not the
+ * algorithms. Each block is timed over DSP_BENCH_REPEAT runs. Times come
+ * from the host clock on native_sim, where simulated time and the cycle
+ * counter stand still while code runs, and from the cycle counter
+ * elsewhere.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/random/random.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#ifdef CONFIG_ARCH_POSIX
+#include "host_clock.h"
+#endif
+
+#include "accel_dsp.h"
+#include "dsp_bench.h"
+
+#define DSP_BENCH_REPEAT 4
+
+#define PI_F 3.14159265f
+
+struct ref_features {
+	float mean[3];		/* mg */
+	float vib_rms;
+	float vib_peak;
+	float tilt;		/* degrees */
+	float bands[DSP_BANDS];	/* mg^2 */
+};
+
+static int16_t block[DSP_FFT_LEN * 3];
+static float twiddle_re[DSP_FFT_LEN / 2];
+static float twiddle_im[DSP_FFT_LEN / 2];
+
+/* Host microseconds on native_sim, cycles elsewhere */
+static uint64_t bench_now(void)
+{
+#ifdef CONFIG_ARCH_POSIX
+	return host_clock_us();
+#else
+	return k_cycle_get_32();
+#endif
+}
+
+static uint32_t bench_elapsed(uint64_t start)
+{
+#ifdef CONFIG_ARCH_POSIX
+	return bench_now() - start;
+#else
+	return (uint32_t)bench_now() - (uint32_t)start;
+#endif
+}
+
+static float frand(float lo, float hi)
+{
+	return lo + (hi - lo) * (sys_rand32_get() % 10001) / 10000.0f;
+}
+
+/* Gravity at a random tilt, two tones on the magnitude and some noise */
+static void make_block(uint16_t odr_hz)
+{
+	float theta = frand(0.0f, PI_F);
+	float phi = frand(-PI_F, PI_F);
+	float a1 = frand(20.0f, 300.0f);
+	float a2 = frand(5.0f, 100.0f);
+	float f1 = frand(5.0f, odr_hz / 8.0f);
+	float f2 = frand(odr_hz / 8.0f, odr_hz / 2.2f);
+	float g[3] = {
+		sinf(theta) * cosf(phi), sinf(theta) * sinf(phi), cosf(theta),
+	};
+
+	for (int i = 0; i < DSP_FFT_LEN; i++) {
+		float t = (float)i / odr_hz;
+		float m = 1000.0f + a1 * sinf(2 * PI_F * f1 * t) +
+			  a2 * sinf(2 * PI_F * f2 * t);
+
+		for (int j = 0; j < 3; j++) {
+			block[3 * i + j] = lroundf(m * g[j] +
+						   frand(-10.0f, 10.0f));
+		}
+	}
+}
+
+static void ref_fft(float *re, float *im)
+{
+	for (size_t i = 1, j = 0; i < DSP_FFT_LEN; i++) {
+		size_t bit = DSP_FFT_LEN >> 1;
+
+		for (; j & bit; bit >>= 1) {
+			j ^= bit;
+		}
+		j |= bit;
+
+		if (i < j) {
+			float t = re[i];
+
+			re[i] = re[j];
+			re[j] = t;
+		}
+	}
+
+	memset(im, 0, DSP_FFT_LEN * sizeof(float));
+
+	for (size_t len = 2; len <= DSP_FFT_LEN; len <<= 1) {
+		size_t step = DSP_FFT_LEN / len;
+
+		for (size_t i = 0; i < DSP_FFT_LEN; i += len) {
+			for (size_t k = 0; k < len / 2; k++) {
+				float c = twiddle_re[k * step];
+				float s = twiddle_im[k * step];
+				size_t a = i + k;
+				size_t b = a + len / 2;
+				float tr = re[b] * c + im[b] * s;
+				float ti = im[b] * c - re[b] * s;
+
+				re[b] = re[a] - tr;
+				im[b] = im[a] - ti;
+				re[a] += tr;
+				im[a] += ti;
+			}
+		}
+	}
+}
+
+static void ref_features(struct ref_features *f)
+{
+	float mag[DSP_FFT_LEN];
+	float im[DSP_FFT_LEN];
+	float mean = 0.0f;
+	float sum = 0.0f;
+
+	memset(f, 0, sizeof(*f));
+
+	for (int i = 0; i < DSP_FFT_LEN; i++) {
+		float x = block[3 * i];
+		float y = block[3 * i + 1];
+		float z = block[3 * i + 2];
+
+		f->mean[0] += x / DSP_FFT_LEN;
+		f->mean[1] += y / DSP_FFT_LEN;
+		f->mean[2] += z / DSP_FFT_LEN;
+		mag[i] = sqrtf(x * x + y * y + z * z);
+		mean += mag[i] / DSP_FFT_LEN;
+	}
+
+	f->tilt = atan2f(hypotf(f->mean[0], f->mean[1]), f->mean[2]) *
+		  180.0f / PI_F;
+
+	for (int i = 0; i < DSP_FFT_LEN; i++) {
+		mag[i] -= mean;
+		sum += mag[i] * mag[i];
+		f->vib_peak = MAX(f->vib_peak, fabsf(mag[i]));
+	}
+	f->vib_rms = sqrtf(sum / DSP_FFT_LEN);
+
+	ref_fft(mag, im);
+
+	for (int b = 0; b < DSP_BANDS; b++) {
+		for (int k = dsp_band_bins[b]; k < dsp_band_bins[b + 1]; k++) {
+			float p = (mag[k] * mag[k] + im[k] * im[k]) /
+				  (DSP_FFT_LEN * DSP_FFT_LEN);
+
+			f->bands[b] += k < DSP_FFT_LEN / 2 ? 2 * p : p;
+		}
+	}
+}
+
+static void print_time(const char *name, uint64_t total, uint32_t runs)
+{
+#ifdef CONFIG_ARCH_POSIX
+	printk("dsp %s: %u ns/block\n", name,
+	       (uint32_t)(total * NSEC_PER_USEC / runs));
+#else
+	printk("dsp %s: %u cycles/block, %u ns/block\n", name,
+	       (uint32_t)(total / runs),
+	       (uint32_t)(k_cyc_to_ns_floor64(total) / runs));
+#endif
+}
+
+void dsp_bench_run(uint32_t blocks, uint8_t range_g, uint16_t odr_hz)
+{
+	/* mg per Q15 step, and mg^2 per Q30 step */
+	const float mg = range_g * 1000.0f / 32768.0f;
+	const float mg2 = mg * mg;
+	float err_rms = 0.0f, err_peak = 0.0f, err_tilt = 0.0f;
+	float err_band = 0.0f;
+	uint64_t q15_time = 0, ref_time = 0;
+	struct dsp_features q;
+	struct ref_features r;
+	uint64_t start;
+
+	if (blocks == 0) {
+		return;
+	}
+
+	for (int k = 0; k < DSP_FFT_LEN / 2; k++) {
+		twiddle_re[k] = cosf(2 * PI_F * k / DSP_FFT_LEN);
+		twiddle_im[k] = sinf(2 * PI_F * k / DSP_FFT_LEN);
+	}
+
+	for (uint32_t i = 0; i < blocks; i++) {
+		float total = 0.0f;
+
+		make_block(odr_hz);
+
+		start = bench_now();
+		for (int j = 0; j < DSP_BENCH_REPEAT; j++) {
+			dsp_features(block, range_g, &q);
+		}
+		q15_time += bench_elapsed(start);
+
+		start = bench_now();
+		for (int j = 0; j < DSP_BENCH_REPEAT; j++) {
+			ref_features(&r);
+		}
+		ref_time += bench_elapsed(start);
+
+		err_rms = MAX(err_rms, fabsf(q.vib_rms * mg - r.vib_rms));
+		err_peak = MAX(err_peak, fabsf(q.vib_peak * mg - r.vib_peak));
+		err_tilt = MAX(err_tilt, fabsf(q.tilt * 180.0f / 32768.0f -
+					       r.tilt));
+
+		/* Band errors against the block's whole vibration energy */
+		for (int b = 0; b < DSP_BANDS; b++) {
+			total += r.bands[b];
+		}
+		for (int b = 0; b < DSP_BANDS; b++) {
+			err_band = MAX(err_band,
+				       fabsf(q.bands[b] * mg2 -
+					     r.bands[b]) / total);
+		}
+	}
+
+	printk("dsp bench: %u blocks of %u samples at %u Hz, %s kernels\n",
+	       blocks, DSP_FFT_LEN, odr_hz,
+	       IS_ENABLED(CONFIG_CMSIS_DSP) ? "CMSIS-DSP" : "C");
+	print_time("q15", q15_time, blocks * DSP_BENCH_REPEAT);
+	print_time("float", ref_time, blocks * DSP_BENCH_REPEAT);
+	printk("dsp error: rms %u.%02u mg, peak %u.%02u mg, tilt %u.%03u deg, "
+	       "bands %u.%02u%% of the energy\n",
+	       (uint32_t)err_rms, (uint32_t)(err_rms * 100) % 100,
+	       (uint32_t)err_peak, (uint32_t)(err_peak * 100) % 100,
+	       (uint32_t)err_tilt, (uint32_t)(err_tilt * 1000) % 1000,
+	       (uint32_t)(err_band * 100),
+	       (uint32_t)(err_band * 10000) % 100);
+}
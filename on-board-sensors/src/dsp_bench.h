@@ -0,0 +1,19 @@
+/*
+ * Accelerometer feature bench.
+ *
+ * dsp_bench_run() computes the features of synthetic blocks, gravity at a
+ * random tilt with two vibration tones and noise on top, with the Q15
+ * kernels of accel_dsp.h and with a float reference, then reports the time
+ * per block of each and the largest error of the Q15 features.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef DSP_BENCH_H_
+#define DSP_BENCH_H_
+
+#include <stdint.h>
+
+void dsp_bench_run(uint32_t blocks, uint8_t range_g, uint16_t odr_hz);
+
+#endif /* DSP_BENCH_H_ */
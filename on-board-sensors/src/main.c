@@ -18,7 +18,7 @@
 #include <zephyr/net/net_ip.h>
 #include <zephyr/net/socket.h>
 #include <zephyr/sys/util.h>
-#include <zephyr/random/rand32.h>
+#include <zephyr/random/random.h>
 #include <zephyr/devicetree.h>
 #include <zephyr/devicetree/io-channels.h>
 #include <errno.h>
@@ -28,6 +28,15 @@
 #include <zephyr/logging/log.h>
 #include <math.h>
 
+#include "accel_dsp.h"
+#include "accel_stream.h"
+#include "aggregate.h"
+#include "dsp_bench.h"
+
+#ifdef CONFIG_EMUL
+#include "stream_bench.h"
+#endif
+
 #define LOG_LEVEL LOG_LEVEL_INF
 
 LOG_MODULE_REGISTER(sensortest);
@@ -62,11 +71,13 @@ static void sensor_work_handler(struct k_work *work);
 static const char *device_labels[NUM_DEVICES] = {
 	[BUTTON] = "BUTTON",
 	[LIGHT] = "LIGHT",
+	[ACCEL] = "ACCEL",
 	[HUMIDITY] = "HUMIDITY",
 };
 
 static const char *device_names[NUM_DEVICES] = {
 	[LIGHT] = "opt3001-light@44",
+	[ACCEL] = "lis2dh-accel@18",
 	[HUMIDITY] = "hdc2010-humidity@41",
 };
 
@@ -94,11 +105,128 @@ static int fd = -1;
 #define TIMED_SENSOR_READ 60
 static int sensor_read_count = TIMED_SENSOR_READ;
 
+/*
+ * Aggregation: sample every SAMPLE_INTERVAL_MS and only log one summary
+ * per channel every AGG_SLIDE_MS, over the last AGG_WINDOW_MS. Equal
+ * lengths give tumbling windows, AGG_WINDOW_MS must be a multiple of
+ * AGG_SLIDE_MS, at most AGG_MAX_PANES times. Quantiles are only estimated
+ * for tumbling windows. Set AGGREGATE to 0 to log every reading instead.
+ */
+#define AGGREGATE 1
+#define SAMPLE_INTERVAL_MS (AGGREGATE ? 100 : 1000)
+#define AGG_WINDOW_MS 60000
+#define AGG_SLIDE_MS 60000
+#define AGG_WITH_QUANTILES true
+
+/* Values run through the aggregation at boot to time it, 0 to skip */
+#define AGG_BENCH_SAMPLES 10000
+
+#define SUMMARY_LEN 1024
+
+/*
+ * Accelerometer streaming: the LIS2DH FIFO samples at ACCEL_ODR_HZ and is
+ * drained in blocks of ACCEL_WATERMARK samples on its watermark interrupt
+ * (src/accel_stream.c). read_sensors() then reports the latest sample
+ * instead of fetching one through the driver. Set ACCEL_STREAM to 0 for
+ * the driver's one-shot reads.
+ */
+#define ACCEL_STREAM 1
+#define ACCEL_ODR_HZ 400
+#define ACCEL_WATERMARK 25
+#define ACCEL_RANGE_G 2
+
+/*
+ * Vibration features: after every read_sensors() the last DSP_FFT_LEN
+ * streamed samples go through the Q15 kernels of src/accel_dsp.c, and the
+ * vibration RMS and peak, the tilt and the RMS in each band are
+ * aggregated like any other channel. DSP_BENCH_BLOCKS synthetic blocks
+ * are timed against a float reference at boot, 0 to skip.
+ */
+#define DSP_FEATURES 1
+#define DSP_BENCH_BLOCKS 50
+
+enum agg_chan {
+	AGG_LIGHT,
+	AGG_ACCEL_X,
+	AGG_ACCEL_Y,
+	AGG_ACCEL_Z,
+	AGG_HUMIDITY,
+	AGG_TEMP,
+	AGG_VIB_RMS,
+	AGG_VIB_PEAK,
+	AGG_TILT,
+	AGG_BAND_0,
+	AGG_BAND_1,
+	AGG_BAND_2,
+	AGG_BAND_3,
+	AGG_CHANNELS,
+};
+
+/* Named as in the per-reading text, "<device index><channel letter>" */
+static const char *const agg_names[AGG_CHANNELS] = {
+	[AGG_LIGHT] = "1l",
+	[AGG_ACCEL_X] = "2x",
+	[AGG_ACCEL_Y] = "2y",
+	[AGG_ACCEL_Z] = "2z",
+	[AGG_HUMIDITY] = "3h",
+	[AGG_TEMP] = "3t",
+	[AGG_VIB_RMS] = "2r",
+	[AGG_VIB_PEAK] = "2p",
+	[AGG_TILT] = "2a",
+	[AGG_BAND_0] = "2e0",
+	[AGG_BAND_1] = "2e1",
+	[AGG_BAND_2] = "2e2",
+	[AGG_BAND_3] = "2e3",
+};
+
+static struct agg_channel agg[AGG_CHANNELS];
+static char summary[SUMMARY_LEN];
+
+static bool accel_streaming;
+static struct k_spinlock accel_lock;
+/* The last DSP_FFT_LEN samples of X, Y, Z in mg, a ring */
+static int16_t accel_window[DSP_FFT_LEN * 3];
+static size_t accel_pos;
+static size_t accel_count;
+static int64_t accel_stream_start_ms;
+
+static struct {
+	uint32_t values;
+	uint32_t raw_bytes;	/* per-reading text for the same values */
+	uint32_t summary_bytes;
+	uint64_t cycles;
+} agg_stats;
+
+static void aggregate_float(enum agg_chan chan, float v)
+{
+	uint32_t start;
+
+	if (!AGGREGATE) {
+		return;
+	}
+
+	start = k_cycle_get_32();
+	agg_add(&agg[chan], v);
+	agg_stats.cycles += k_cycle_get_32() - start;
+	agg_stats.values++;
+}
+
+static void aggregate(enum agg_chan chan, const struct sensor_value *val)
+{
+	aggregate_float(chan, val->val1 + val->val2 / 1000000.0f);
+}
+
 
 static void print_sensor_value(size_t idx, const char *chan,
 			       struct sensor_value *val)
 {
-	LOG_INF("%s: %s%d,%d", device_labels[idx], chan, val->val1, val->val2);
+	if (AGGREGATE) {
+		LOG_DBG("%s: %s%d,%d", device_labels[idx], chan, val->val1,
+			val->val2);
+	} else {
+		LOG_INF("%s: %s%d,%d", device_labels[idx], chan, val->val1,
+			val->val2);
+	}
 
 	sprintf(outstr+strlen(outstr), "%d%c:", idx, chan[0]);
 	sprintf(outstr+strlen(outstr), "%d", val->val1);
@@ -110,6 +238,104 @@ static void print_sensor_value(size_t idx, const char *chan,
 }
 
 
+/* Block callback, on the system work queue */
+static void accel_block(const int16_t *xyz, size_t count, void *user_data)
+{
+	k_spinlock_key_t key = k_spin_lock(&accel_lock);
+
+	ARG_UNUSED(user_data);
+
+	for (size_t i = 0; i < count; i++) {
+		memcpy(&accel_window[accel_pos * 3], &xyz[i * 3],
+		       3 * sizeof(int16_t));
+		accel_pos = (accel_pos + 1) % DSP_FFT_LEN;
+	}
+	accel_count = MIN(accel_count + count, DSP_FFT_LEN);
+	k_spin_unlock(&accel_lock, key);
+}
+
+static void mg_to_value(int16_t mg, struct sensor_value *val)
+{
+	int64_t um_s2 = (int64_t)mg * SENSOR_G / 1000;
+
+	val->val1 = um_s2 / 1000000;
+	val->val2 = um_s2 % 1000000;
+}
+
+/* The latest streamed sample, as the driver would report it */
+static void read_accel_stream(void)
+{
+	static const char *const chans[3] = { "x: ", "y: ", "z: " };
+	struct sensor_value val;
+	int16_t xyz[3];
+	k_spinlock_key_t key = k_spin_lock(&accel_lock);
+	size_t last = (accel_pos + DSP_FFT_LEN - 1) % DSP_FFT_LEN;
+
+	memcpy(xyz, &accel_window[last * 3], sizeof(xyz));
+	k_spin_unlock(&accel_lock, key);
+
+	for (int i = 0; i < 3; i++) {
+		mg_to_value(xyz[i], &val);
+		print_sensor_value(ACCEL, chans[i], &val);
+		aggregate(AGG_ACCEL_X + i, &val);
+	}
+}
+
+/* Features of the last DSP_FFT_LEN streamed samples */
+static void read_accel_features(void)
+{
+	/* m/s^2 per Q15 step */
+	const float step = ACCEL_RANGE_G * SENSOR_G / 1000000.0f / 32768.0f;
+	int16_t xyz[DSP_FFT_LEN * 3];
+	struct dsp_features f;
+	k_spinlock_key_t key;
+	size_t head;
+
+	if (!DSP_FEATURES || !accel_streaming) {
+		return;
+	}
+
+	key = k_spin_lock(&accel_lock);
+	if (accel_count < DSP_FFT_LEN) {
+		k_spin_unlock(&accel_lock, key);
+		return;
+	}
+	/* Oldest first */
+	head = accel_pos * 3;
+	memcpy(xyz, &accel_window[head],
+	       (DSP_FFT_LEN * 3 - head) * sizeof(int16_t));
+	memcpy(&xyz[DSP_FFT_LEN * 3 - head], accel_window,
+	       head * sizeof(int16_t));
+	k_spin_unlock(&accel_lock, key);
+
+	dsp_features(xyz, ACCEL_RANGE_G, &f);
+
+	aggregate_float(AGG_VIB_RMS, f.vib_rms * step);
+	aggregate_float(AGG_VIB_PEAK, f.vib_peak * step);
+	aggregate_float(AGG_TILT, f.tilt * 180.0f / 32768.0f);
+	/* As the RMS in each band, the energies are too small for hundredths */
+	for (int b = 0; b < DSP_BANDS; b++) {
+		aggregate_float(AGG_BAND_0 + b, sqrtf(f.bands[b]) * step);
+	}
+}
+
+static void log_accel_stream(void)
+{
+	struct accel_stream_stats st;
+	int64_t ms = k_uptime_get() - accel_stream_start_ms;
+
+	if (!accel_streaming || ms <= 0) {
+		return;
+	}
+
+	accel_stream_get_stats(&st);
+
+	LOG_INF("accel stream: %u samples/s in %u blocks, %u wakeups/s, "
+		"%u overruns, bus %u bit/s", (uint32_t)(st.samples * 1000 / ms),
+		st.blocks, (uint32_t)(st.wakeups * 1000 / ms), st.overruns,
+		(uint32_t)(st.bus_bits * 1000 / ms));
+}
+
 static void read_sensors(void)
 {
 	struct sensor_value val;
@@ -125,12 +351,19 @@ static void read_sensors(void)
 			continue;
 		}
 
+		/* The stream owns the part, a fetch would pop the FIFO */
+		if (i == ACCEL && accel_streaming) {
+			read_accel_stream();
+			continue;
+		}
+
 		sensor_sample_fetch(devices[i]);
 
 		if (i == LIGHT) {
 			sensor_channel_get(devices[i], SENSOR_CHAN_LIGHT, &val);
 			print_sensor_value(i, "l: ", &val);
-			
+			aggregate(AGG_LIGHT, &val);
+
 			continue;
 		}
 
@@ -138,13 +371,16 @@ static void read_sensors(void)
 			sensor_channel_get(devices[i], SENSOR_CHAN_ACCEL_X,
 					   &val);
 			print_sensor_value(i, "x: ", &val);
+			aggregate(AGG_ACCEL_X, &val);
 			sensor_channel_get(devices[i], SENSOR_CHAN_ACCEL_Y,
 					   &val);
 			print_sensor_value(i, "y: ", &val);
+			aggregate(AGG_ACCEL_Y, &val);
 			sensor_channel_get(devices[i], SENSOR_CHAN_ACCEL_Z,
 					   &val);
 			print_sensor_value(i, "z: ", &val);
-			
+			aggregate(AGG_ACCEL_Z, &val);
+
 			continue;
 		}
 
@@ -152,18 +388,139 @@ static void read_sensors(void)
 			sensor_channel_get(devices[i], SENSOR_CHAN_HUMIDITY,
 					   &val);
 			print_sensor_value(i, "h: ", &val);
+			aggregate(AGG_HUMIDITY, &val);
 			sensor_channel_get(devices[i], SENSOR_CHAN_AMBIENT_TEMP,
 					   &val);
 			print_sensor_value(i, "t: ", &val);
-			
+			aggregate(AGG_TEMP, &val);
+
 			continue;
 		}
 	}
+
+	agg_stats.raw_bytes += strlen(outstr);
 }
 
+/* Hundredths, as the per-reading text */
+static int put_fixed(char *buf, size_t size, float v)
+{
+	int32_t c;
+
+	/* Light variance easily leaves the int32 range */
+	v = CLAMP(v, -2.0e7f, 2.0e7f);
+	c = (int32_t)(v * 100.0f + (v < 0 ? -0.5f : 0.5f));
 
-void main(void)
+	return snprintf(buf, size, "%s%d.%02d", c < 0 ? "-" : "",
+			abs(c / 100), abs(c % 100));
+}
+
+/*
+ * One record per channel with samples in the window:
+ * "<name>:<count>,<min>,<max>,<mean>,<variance>[,<p50>,<p90>];"
+ */
+static void emit_summaries(void)
 {
+	struct agg_summary s;
+	size_t len = 0;
+
+	for (int i = 0; i < AGG_CHANNELS; i++) {
+		float vals[4 + AGG_QUANTILES];
+		char rec[128];
+		int rec_len;
+		int n = 4;
+
+		if (!agg_summarize(&agg[i], &s)) {
+			agg_slide(&agg[i]);
+			continue;
+		}
+
+		vals[0] = s.min;
+		vals[1] = s.max;
+		vals[2] = s.mean;
+		vals[3] = s.variance;
+		if (s.has_quantiles) {
+			memcpy(&vals[4], s.quantile, sizeof(s.quantile));
+			n += AGG_QUANTILES;
+		}
+
+		rec_len = snprintf(rec, sizeof(rec), "%s:%u", agg[i].name,
+				   s.count);
+		for (int j = 0; j < n; j++) {
+			rec[rec_len++] = ',';
+			rec_len += put_fixed(rec + rec_len,
+					     sizeof(rec) - rec_len - 1, vals[j]);
+		}
+		rec[rec_len++] = ';';
+
+		if (len + rec_len < SUMMARY_LEN) {
+			memcpy(summary + len, rec, rec_len);
+			len += rec_len;
+		}
+
+		agg_slide(&agg[i]);
+	}
+
+	if (len == 0) {
+		return;
+	}
+
+	summary[len] = '\0';
+
+	LOG_INF("%s", summary);
+	agg_stats.summary_bytes += len;
+
+	LOG_INF("agg: %u values, %u B as readings, %u B as summaries "
+		"(%u%%), %u cycles/value", agg_stats.values,
+		agg_stats.raw_bytes, agg_stats.summary_bytes,
+		agg_stats.raw_bytes ?
+		(uint32_t)((uint64_t)agg_stats.summary_bytes * 100U /
+			   agg_stats.raw_bytes) : 0,
+		agg_stats.values ?
+		(uint32_t)(agg_stats.cycles / agg_stats.values) : 0);
+}
+
+static void bench_one(const char *name, uint8_t panes, bool quantiles)
+{
+	struct agg_channel ch;
+	struct agg_summary s;
+	uint32_t cycles = 0;
+	uint32_t start;
+
+	agg_init(&ch, "b", panes, quantiles);
+
+	for (uint32_t i = 0; i < AGG_BENCH_SAMPLES; i++) {
+		float x = 20.0f + (sys_rand32_get() % 1000) / 100.0f;
+
+		start = k_cycle_get_32();
+		agg_add(&ch, x);
+		if (i % (AGG_BENCH_SAMPLES / 8 + 1) == 0) {
+			agg_summarize(&ch, &s);
+			agg_slide(&ch);
+		}
+		cycles += k_cycle_get_32() - start;
+	}
+
+	LOG_INF("agg bench %s: %u cycles, %u ns per value", name,
+		cycles / AGG_BENCH_SAMPLES,
+		(uint32_t)(k_cyc_to_ns_floor64(cycles) / AGG_BENCH_SAMPLES));
+}
+
+/* Cycle counts only mean something on qemu_x86 or hardware */
+static void agg_bench(void)
+{
+	if (AGG_BENCH_SAMPLES == 0) {
+		return;
+	}
+
+	bench_one("stats", 1, false);
+	bench_one("stats+quantiles", 1, true);
+	bench_one("sliding 4 panes", AGG_MAX_PANES, false);
+}
+
+
+int main(void)
+{
+	int64_t next_summary;
 	int r;
 	
 	for (size_t i = 0; i < NUM_DEVICES; ++i) {
@@ -230,8 +587,54 @@ void main(void)
 	// r = gpio_add_callback(devices[BUTTON], &button_callback);
 	// __ASSERT(r == 0, "gpio_add_callback() failed: %d", r);
 
+	if (AGGREGATE) {
+		for (int i = 0; i < AGG_CHANNELS; i++) {
+			agg_init(&agg[i], agg_names[i],
+				 AGG_WINDOW_MS / AGG_SLIDE_MS,
+				 AGG_WITH_QUANTILES);
+		}
+		agg_bench();
+	}
+
+	if (DSP_FEATURES && DSP_BENCH_BLOCKS > 0) {
+		dsp_bench_run(DSP_BENCH_BLOCKS, ACCEL_RANGE_G, ACCEL_ODR_HZ);
+	}
+
+	if (ACCEL_STREAM && devices[ACCEL] != NULL) {
+		const struct accel_stream_cfg cfg = {
+			.odr_hz = ACCEL_ODR_HZ,
+			.watermark = ACCEL_WATERMARK,
+			.range_g = ACCEL_RANGE_G,
+			.cb = accel_block,
+		};
+
+#ifdef CONFIG_EMUL
+		stream_bench_run();
+#endif
+
+		r = accel_stream_start(&cfg);
+		if (r < 0) {
+			LOG_ERR("accel stream failed: %d, reading once per "
+				"round", r);
+		}
+		accel_streaming = r == 0;
+		accel_stream_start_ms = k_uptime_get();
+	}
+
+	next_summary = k_uptime_get() + AGG_SLIDE_MS;
+
 	for (;;) {
 		read_sensors();
-		k_sleep(K_MSEC(1000));
+		read_accel_features();
+
+		if (AGGREGATE && k_uptime_get() >= next_summary) {
+			emit_summaries();
+			log_accel_stream();
+			next_summary += AGG_SLIDE_MS;
+		}
+
+		k_sleep(K_MSEC(SAMPLE_INTERVAL_MS));
 	}
+
+	return 0;
 }
@@ -0,0 +1,273 @@
+/*
+ * CoAP Observe check, see coap_check.h
+ *
+ * The client is a socket in the calling thread: a notification is sent
+ * from the sensor work, and only looked for once the work is done, with a
+ * timeout for the loopback delivery.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/net/coap.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/sys/util.h>
+
+#include "coap_check.h"
+#include "senml_cbor.h"
+
+/* More than COAP_CON_EVERY, so that confirmable ones are among them */
+#define COAP_CHECK_ROUNDS 25
+#define COAP_CHECK_TIMEOUT_MS 200
+#define COAP_CHECK_PORT 5683
+#define COAP_CHECK_MSG_LEN 128
+#define COAP_CHECK_OPTIONS 8
+
+/* CBOR array of one record, the light resource's */
+#define CBOR_ARRAY_OF_ONE 0x81
+
+static const uint8_t token[] = { 'c', 'h', 'k', '1' };
+
+static const struct sockaddr_in6 server = {
+	.sin6_family = AF_INET6,
+	.sin6_port = htons(COAP_CHECK_PORT),
+	.sin6_addr = IN6ADDR_LOOPBACK_INIT,
+};
+
+static struct {
+	uint32_t notifications;
+	uint32_t con;
+	uint32_t datagram_bytes;
+	uint32_t payload_bytes;
+	int last_seq;
+	const char *error;
+} check;
+
+static int sock = -1;
+
+static int send_get(int observe)
+{
+	uint8_t buf[COAP_CHECK_MSG_LEN];
+	struct coap_packet pkt;
+	int r;
+
+	r = coap_packet_init(&pkt, buf, sizeof(buf), COAP_VERSION_1,
+			     COAP_TYPE_NON_CON, sizeof(token), token,
+			     COAP_METHOD_GET, coap_next_id());
+	if (r == 0) {
+		r = coap_append_option_int(&pkt, COAP_OPTION_OBSERVE, observe);
+	}
+	if (r == 0) {
+		r = coap_packet_append_option(&pkt, COAP_OPTION_URI_PATH,
+					      (const uint8_t *)"sensors",
+					      strlen("sensors"));
+	}
+	if (r == 0) {
+		r = coap_packet_append_option(&pkt, COAP_OPTION_URI_PATH,
+					      (const uint8_t *)"light",
+					      strlen("light"));
+	}
+	if (r < 0) {
+		return r;
+	}
+
+	r = sendto(sock, pkt.data, pkt.offset, 0,
+		   (const struct sockaddr *)&server, sizeof(server));
+
+	return r < 0 ? -errno : 0;
+}
+
+static int send_ack(const struct coap_packet *con)
+{
+	uint8_t buf[COAP_CHECK_MSG_LEN];
+	struct coap_packet ack;
+	int r;
+
+	r = coap_packet_init(&ack, buf, sizeof(buf), COAP_VERSION_1,
+			     COAP_TYPE_ACK, 0, NULL, COAP_CODE_EMPTY,
+			     coap_header_get_id(con));
+	if (r < 0) {
+		return r;
+	}
+
+	r = sendto(sock, ack.data, ack.offset, 0,
+		   (const struct sockaddr *)&server, sizeof(server));
+
+	return r < 0 ? -errno : 0;
+}
+
+/* Returns the datagram length, 0 on timeout or a negative error */
+static int receive(uint8_t *buf, size_t size)
+{
+	struct pollfd pfd = {
+		.fd = sock,
+		.events = POLLIN,
+	};
+	int r;
+
+	r = poll(&pfd, 1, COAP_CHECK_TIMEOUT_MS);
+	if (r <= 0) {
+		return r < 0 ? -errno : 0;
+	}
+
+	r = recv(sock, buf, size, 0);
+
+	return r < 0 ? -errno : r;
+}
+
+/* A 2.05 response to the client, returns its Observe option or -ENOENT */
+static int check_response(uint8_t *buf, size_t len, struct coap_packet *pkt)
+{
+	struct coap_option options[COAP_CHECK_OPTIONS];
+	uint8_t tok[COAP_TOKEN_MAX_LEN];
+	const uint8_t *payload;
+	uint16_t payload_len;
+
+	if (coap_packet_parse(pkt, buf, len, options,
+			      ARRAY_SIZE(options)) < 0) {
+		check.error = "unparsable response";
+		return -EINVAL;
+	}
+
+	if (coap_header_get_code(pkt) != COAP_RESPONSE_CODE_CONTENT ||
+	    coap_header_get_token(pkt, tok) != sizeof(token) ||
+	    memcmp(tok, token, sizeof(token)) != 0) {
+		check.error = "not a 2.05 with the client's token";
+		return -EINVAL;
+	}
+
+	if (coap_get_option_int(pkt, COAP_OPTION_CONTENT_FORMAT) !=
+	    SENML_CBOR_CONTENT_FORMAT) {
+		check.error = "not SenML/CBOR";
+		return -EINVAL;
+	}
+
+	payload = coap_packet_get_payload(pkt, &payload_len);
+	if (payload == NULL || payload_len == 0) {
+		check.error = "no payload";
+		return -EINVAL;
+	}
+
+	return coap_get_option_int(pkt, COAP_OPTION_OBSERVE);
+}
+
+static void take_sample(struct k_work *sensor_work)
+{
+	struct k_work_sync sync;
+
+	k_work_submit(sensor_work);
+	k_work_flush(sensor_work, &sync);
+}
+
+static void expect_notification(void)
+{
+	uint8_t buf[COAP_CHECK_MSG_LEN];
+	struct coap_packet pkt;
+	const uint8_t *payload;
+	uint16_t payload_len;
+	int len, seq;
+
+	len = receive(buf, sizeof(buf));
+	if (len <= 0) {
+		check.error = "notification missing";
+		return;
+	}
+
+	seq = check_response(buf, len, &pkt);
+	if (seq < 0) {
+		if (check.error == NULL) {
+			check.error = "notification without Observe";
+		}
+		return;
+	}
+
+	if (seq <= check.last_seq) {
+		check.error = "Observe sequence not rising";
+		return;
+	}
+
+	payload = coap_packet_get_payload(&pkt, &payload_len);
+	if (payload[0] != CBOR_ARRAY_OF_ONE) {
+		check.error = "not a pack of one record";
+		return;
+	}
+
+	if (coap_header_get_type(&pkt) == COAP_TYPE_CON) {
+		check.con++;
+		send_ack(&pkt);
+	}
+
+	check.last_seq = seq;
+	check.notifications++;
+	check.datagram_bytes += len;
+	check.payload_bytes += payload_len;
+
+	/* Exactly one per sample */
+	if (receive(buf, sizeof(buf)) > 0) {
+		check.error = "more than one notification per sample";
+	}
+}
+
+void coap_check_run(struct k_work *sensor_work)
+{
+	uint8_t buf[COAP_CHECK_MSG_LEN];
+	struct coap_packet pkt;
+	int len;
+
+	memset(&check, 0, sizeof(check));
+	check.last_seq = -1;
+
+	sock = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock < 0) {
+		printk("coap check failed: socket: %d\n", errno);
+		return;
+	}
+
+	/* Register: the response carries the current state and Observe */
+	len = send_get(0) == 0 ? receive(buf, sizeof(buf)) : -EIO;
+	if (len <= 0) {
+		check.error = "no response to the registration";
+	} else if (check_response(buf, len, &pkt) < 0 && check.error == NULL) {
+		check.error = "registration not accepted";
+	}
+
+	for (int i = 0; i < COAP_CHECK_ROUNDS && check.error == NULL; i++) {
+		take_sample(sensor_work);
+		expect_notification();
+	}
+
+	/* Deregister: the response has no Observe, and nothing follows */
+	if (check.error == NULL) {
+		len = send_get(1) == 0 ? receive(buf, sizeof(buf)) : -EIO;
+		if (len <= 0) {
+			check.error = "no response to the deregistration";
+		} else if (check_response(buf, len, &pkt) != -ENOENT &&
+			   check.error == NULL) {
+			check.error = "still observing after deregistration";
+		}
+
+		take_sample(sensor_work);
+		if (check.error == NULL && receive(buf, sizeof(buf)) > 0) {
+			check.error = "notified after deregistration";
+		}
+	}
+
+	close(sock);
+
+	if (check.notifications > 0) {
+		printk("coap check: %u/%u notifications (%u CON), %u B per "
+		       "datagram, %u B of SenML payload\n",
+		       check.notifications, COAP_CHECK_ROUNDS, check.con,
+		       check.datagram_bytes / check.notifications,
+		       check.payload_bytes / check.notifications);
+	}
+
+	if (check.error != NULL) {
+		printk("coap check failed: %s\n", check.error);
+	} else {
+		printk("coap check done\n");
+	}
+}
@@ -0,0 +1,22 @@
+/*
+ * CoAP Observe check for native_sim with the emulated sensors.
+ *
+ * coap_check_run() registers an Observe client for /sensors/light with the
+ * sample's CoAP server over the loopback interface, takes samples through
+ * the sensor work item and checks that each one brings exactly one
+ * notification: 2.05 Content with the client's token, a rising Observe
+ * sequence and a SenML/CBOR pack of one record. Confirmable notifications
+ * are acknowledged. After the client deregisters, a sample must bring no
+ * notification. It then prints the datagram and payload sizes on air.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef COAP_CHECK_H_
+#define COAP_CHECK_H_
+
+#include <zephyr/kernel.h>
+
+void coap_check_run(struct k_work *sensor_work);
+
+#endif /* COAP_CHECK_H_ */
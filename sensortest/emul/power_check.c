@@ -0,0 +1,185 @@
+/*
+ * Power management check, see power_check.h
+ *
+ * The trace callback runs in the sensor work and the radio idle work, it
+ * follows the state of every device and keeps the first ordering error.
+ * native_sim does not advance its clock while code runs, so the time in
+ * each state adds up to the uptime exactly, give or take POWER_CHECK_SLACK_MS.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/sys/util.h>
+
+#include "power.h"
+#include "power_check.h"
+#include "sensor_emul.h"
+
+#define POWER_CHECK_ROUNDS 10
+#define POWER_CHECK_IDLE_MS 2000
+#define POWER_CHECK_SLACK_MS 2
+
+static struct {
+	const char *bus;
+	const char *names[POWER_MAX_DEVICES];
+	bool active[POWER_MAX_DEVICES];
+	bool changed[POWER_MAX_DEVICES];	/* in the current round */
+	uint32_t resumes[POWER_MAX_DEVICES];
+	size_t count;
+	const char *error;
+} check;
+
+static int check_index(const char *name)
+{
+	for (size_t i = 0; i < check.count; i++) {
+		if (strcmp(check.names[i], name) == 0) {
+			return i;
+		}
+	}
+
+	if (check.count == ARRAY_SIZE(check.names)) {
+		return -1;
+	}
+
+	check.names[check.count] = name;
+
+	return check.count++;
+}
+
+static bool sensor_active(void)
+{
+	for (size_t i = 0; i < check.count; i++) {
+		if (check.active[i] && strcmp(check.names[i], check.bus) != 0 &&
+		    strcmp(check.names[i], "radio") != 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void check_trace(const char *name, bool active)
+{
+	bool is_bus = strcmp(name, check.bus) == 0;
+	int i = check_index(name);
+
+	if (check.error != NULL || i < 0) {
+		return;
+	}
+
+	if (check.active[i] == active) {
+		check.error = active ? "resumed twice" : "suspended twice";
+	} else if (active && !is_bus && strcmp(name, "radio") != 0) {
+		int b = check_index(check.bus);
+
+		if (b < 0 || !check.active[b]) {
+			check.error = "sensor resumed before its bus";
+		}
+	} else if (!active && is_bus && sensor_active()) {
+		check.error = "bus suspended before a sensor";
+	}
+
+	check.active[i] = active;
+	check.changed[i] = true;
+	check.resumes[i] += active;
+}
+
+static void check_round_end(void)
+{
+	for (size_t i = 0; i < check.count && check.error == NULL; i++) {
+		if (check.changed[i] && check.active[i]) {
+			check.error = "still active after a round";
+		}
+		check.changed[i] = false;
+	}
+}
+
+static const struct power_stats *stats_find(const struct power_stats *stats,
+					    size_t n, const char *name)
+{
+	for (size_t i = 0; i < n; i++) {
+		if (strcmp(stats[i].name, name) == 0) {
+			return &stats[i];
+		}
+	}
+
+	return NULL;
+}
+
+void power_check_run(struct k_work *sensor_work)
+{
+	const struct emul *light = EMUL_DT_GET(DT_NODELABEL(light));
+	struct power_stats before[POWER_MAX_DEVICES];
+	struct power_stats after[POWER_MAX_DEVICES];
+	struct k_work_sync sync;
+	uint32_t measurements;
+	size_t n_before, n_after;
+	int64_t start, elapsed;
+	int light_idx;
+
+	check.bus = DEVICE_DT_GET(DT_BUS(DT_NODELABEL(light)))->name;
+
+	/* Everything from the bench has settled by now */
+	k_sleep(K_MSEC(POWER_CHECK_IDLE_MS));
+	n_before = power_stats_get(before, ARRAY_SIZE(before));
+	for (size_t i = 0; i < n_before; i++) {
+		int idx = check_index(before[i].name);
+
+		if (idx >= 0) {
+			check.active[idx] = before[i].active;
+		}
+	}
+
+	measurements = sensor_emul_measurements(light);
+	start = k_uptime_get();
+	power_set_trace(check_trace);
+
+	for (int i = 0; i < POWER_CHECK_ROUNDS; i++) {
+		k_work_submit(sensor_work);
+		k_work_flush(sensor_work, &sync);
+		k_sleep(K_MSEC(POWER_CHECK_IDLE_MS));
+		check_round_end();
+	}
+
+	power_set_trace(NULL);
+	elapsed = k_uptime_get() - start;
+	n_after = power_stats_get(after, ARRAY_SIZE(after));
+
+	light_idx = check_index(DEVICE_DT_GET(DT_NODELABEL(light))->name);
+	if (check.error == NULL &&
+	    (light_idx < 0 || check.resumes[light_idx] != POWER_CHECK_ROUNDS ||
+	     sensor_emul_measurements(light) - measurements !=
+	     POWER_CHECK_ROUNDS)) {
+		check.error = "light not resumed once per fetch";
+	}
+
+	for (size_t i = 0; i < n_after; i++) {
+		const struct power_stats *b = stats_find(before, n_before,
+							 after[i].name);
+		uint32_t active_ms = after[i].active_ms - (b ? b->active_ms : 0);
+		uint32_t suspended_ms = after[i].suspended_ms -
+					(b ? b->suspended_ms : 0);
+
+		printk("pm: %s: %u resumes, active %u ms, suspended %u ms\n",
+		       after[i].name, after[i].resumes - (b ? b->resumes : 0),
+		       active_ms, suspended_ms);
+
+		if (check.error == NULL && b != NULL &&
+		    (active_ms + suspended_ms > elapsed + POWER_CHECK_SLACK_MS ||
+		     active_ms + suspended_ms + POWER_CHECK_SLACK_MS < elapsed)) {
+			check.error = "state times do not add up";
+		}
+	}
+
+	if (check.error != NULL) {
+		printk("power check failed: %s\n", check.error);
+	} else {
+		printk("power check done\n");
+	}
+}
@@ -0,0 +1,20 @@
+/*
+ * Power management check for native_sim with the emulated sensors.
+ *
+ * power_check_run() takes a few samples seconds apart through the sample's
+ * sensor work item and checks, from the power.h trace, that the bus is
+ * resumed before and suspended after each sensor, and that everything
+ * that woke up for a round is suspended again before the next one. It
+ * then prints the time each device spent in each state.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef POWER_CHECK_H_
+#define POWER_CHECK_H_
+
+#include <zephyr/kernel.h>
+
+void power_check_run(struct k_work *sensor_work);
+
+#endif /* POWER_CHECK_H_ */
@@ -0,0 +1,291 @@
+/*
+ * Telemetry send path bench, see send_bench.h
+ *
+ * Every datagram carries the three fields of a sampling round, formatted
+ * from the same values: into a flat buffer of the sample's outstr size for
+ * sendto() and net_context_sendto(), straight into the net_pkt for
+ * telemetry_pkt.h. The sink checks each payload, which also checks the
+ * headers and the checksum telemetry_pkt.c writes.
+ *
+ * Times include the loopback delivery to the sink, the same for every
+ * path, and come from the host clock on native_sim.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/net/net_context.h>
+#include <zephyr/net/net_if.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+
+#ifdef CONFIG_ARCH_POSIX
+#include "host_clock.h"
+#endif
+
+#include "send_bench.h"
+#include "telemetry_pkt.h"
+
+#define SEND_BENCH_DATAGRAMS 1000
+#define SEND_BENCH_WARMUP 50
+#define SEND_BENCH_DRAIN_MS 200
+#define SEND_BENCH_TIMEOUT_MS 100
+
+/* sensortest's outstr */
+#define SEND_BENCH_TEXT_MAX 256
+#define SEND_BENCH_PKT_MAX 64
+
+#define SINK_STACK_SIZE 2048
+#define SINK_PRIO K_PRIO_COOP(7)
+
+enum send_path {
+	PATH_SOCKET,
+	PATH_CONTEXT,
+	PATH_PKT,
+	PATHS,
+};
+
+static const char *const path_names[PATHS] = {
+	[PATH_SOCKET] = "socket",
+	[PATH_CONTEXT] = "net_context",
+	[PATH_PKT] = "net_pkt",
+};
+
+static const struct {
+	const char *name;
+	int val1;
+	int val2;
+} readings[] = {
+	{ "1l", 84, 320000 },
+	{ "2h", 45, 100000 },
+	{ "2t", 23, 500000 },
+};
+
+static const struct sockaddr_in6 dest = {
+	.sin6_family = AF_INET6,
+	.sin6_port = htons(SEND_BENCH_PORT),
+	.sin6_addr = IN6ADDR_LOOPBACK_INIT,
+};
+
+static int tx_sock = -1;
+static struct net_context *tx_ctx;
+static struct telemetry_pkt_ep tx_ep;
+static char text[SEND_BENCH_TEXT_MAX];
+static size_t pkt_buffers;
+
+static char expected[SEND_BENCH_TEXT_MAX];
+static size_t expected_len;
+static atomic_t delivered;
+
+static K_THREAD_STACK_DEFINE(sink_stack, SINK_STACK_SIZE);
+static struct k_thread sink_thread;
+static uint8_t rx_buf[SEND_BENCH_TEXT_MAX];
+
+static uint64_t bench_now_us(void)
+{
+#ifdef CONFIG_ARCH_POSIX
+	return host_clock_us();
+#else
+	return k_ticks_to_us_floor64(k_uptime_ticks());
+#endif
+}
+
+static void sink(void *p1, void *p2, void *p3)
+{
+	struct sockaddr_in6 addr = {
+		.sin6_family = AF_INET6,
+		.sin6_port = htons(SEND_BENCH_PORT),
+		.sin6_addr = IN6ADDR_ANY_INIT,
+	};
+	ssize_t len;
+	int sock;
+
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	sock = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock < 0 ||
+	    bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		printk("sink: socket failed: %d\n", errno);
+		return;
+	}
+
+	for (;;) {
+		len = recv(sock, rx_buf, sizeof(rx_buf), 0);
+		if (len == (ssize_t)expected_len &&
+		    memcmp(rx_buf, expected, expected_len) == 0) {
+			atomic_inc(&delivered);
+		}
+	}
+}
+
+/* The datagram in a flat buffer, as the sample builds outstr */
+static size_t format_text(void)
+{
+	size_t len = 0;
+
+	for (size_t i = 0; i < ARRAY_SIZE(readings); i++) {
+		len += snprintf(text + len, sizeof(text) - len, "%s:%d.%02d;",
+				readings[i].name, readings[i].val1,
+				readings[i].val2 / 10000);
+	}
+
+	return len;
+}
+
+static int send_socket(void)
+{
+	size_t len = format_text();
+
+	if (sendto(tx_sock, text, len, 0, (const struct sockaddr *)&dest,
+		   sizeof(dest)) < 0) {
+		return -errno;
+	}
+
+	return 0;
+}
+
+static int send_context(void)
+{
+	size_t len = format_text();
+	int r;
+
+	r = net_context_sendto(tx_ctx, text, len,
+			       (const struct sockaddr *)&dest, sizeof(dest),
+			       NULL, K_MSEC(SEND_BENCH_TIMEOUT_MS), NULL);
+
+	return MIN(r, 0);
+}
+
+static int send_pkt(void)
+{
+	struct net_pkt *pkt;
+	int r = 0;
+
+	pkt = telemetry_pkt_begin(&tx_ep, SEND_BENCH_PKT_MAX,
+				  K_MSEC(SEND_BENCH_TIMEOUT_MS));
+	if (pkt == NULL) {
+		return -ENOMEM;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(readings) && r == 0; i++) {
+		r = telemetry_pkt_printf(pkt, "%s:%d.%02d;", readings[i].name,
+					 readings[i].val1,
+					 readings[i].val2 / 10000);
+	}
+
+	pkt_buffers = telemetry_pkt_buffers(pkt);
+
+	if (r == 0) {
+		r = telemetry_pkt_send(&tx_ep, pkt);
+	}
+	if (r < 0) {
+		telemetry_pkt_abort(pkt);
+	}
+
+	return r;
+}
+
+static int send_one(enum send_path path)
+{
+	switch (path) {
+	case PATH_SOCKET:
+		return send_socket();
+	case PATH_CONTEXT:
+		return send_context();
+	default:
+		return send_pkt();
+	}
+}
+
+static bool run_path(enum send_path path)
+{
+	uint32_t failed = 0;
+	uint32_t elapsed_us, ns, got;
+	uint64_t start;
+
+	for (int i = 0; i < SEND_BENCH_WARMUP; i++) {
+		send_one(path);
+	}
+	k_sleep(K_MSEC(SEND_BENCH_DRAIN_MS));
+
+	atomic_set(&delivered, 0);
+	start = bench_now_us();
+
+	for (int i = 0; i < SEND_BENCH_DATAGRAMS; i++) {
+		if (send_one(path) < 0) {
+			failed++;
+		}
+	}
+
+	elapsed_us = bench_now_us() - start;
+	k_sleep(K_MSEC(SEND_BENCH_DRAIN_MS));
+
+	got = atomic_get(&delivered);
+	ns = (uint64_t)elapsed_us * NSEC_PER_USEC / SEND_BENCH_DATAGRAMS;
+
+	/* Staging is the flat buffer formatted before the stack copies it */
+	printk("send %s: %u datagrams, %u failed, %u delivered, "
+	       "%u ns/datagram, staging %u B", path_names[path],
+	       SEND_BENCH_DATAGRAMS, failed, got, ns,
+	       path == PATH_PKT ? 0 : (uint32_t)sizeof(text));
+	if (path == PATH_PKT) {
+		printk(", %u TX buffers/datagram (%u B with the net_pkt)",
+		       (uint32_t)pkt_buffers,
+		       (uint32_t)(sizeof(struct net_pkt) + pkt_buffers *
+				  (sizeof(struct net_buf) +
+				   CONFIG_NET_BUF_DATA_SIZE)));
+	}
+	printk("\n");
+
+	return got == SEND_BENCH_DATAGRAMS;
+}
+
+void send_bench_run(void)
+{
+	const char *failed = NULL;
+
+	expected_len = format_text();
+	memcpy(expected, text, expected_len);
+
+	k_thread_create(&sink_thread, sink_stack,
+			K_THREAD_STACK_SIZEOF(sink_stack), sink,
+			NULL, NULL, NULL, SINK_PRIO, 0, K_NO_WAIT);
+	k_thread_name_set(&sink_thread, "sink");
+
+	tx_sock = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+	if (net_context_get(AF_INET6, SOCK_DGRAM, IPPROTO_UDP, &tx_ctx) < 0) {
+		tx_ctx = NULL;
+	}
+	tx_ep.iface = net_if_get_default();
+	tx_ep.dest = dest;
+	tx_ep.src_port = SEND_BENCH_PORT - 1;
+
+	if (tx_sock < 0 || tx_ctx == NULL) {
+		printk("send bench failed: no socket or net_context\n");
+		return;
+	}
+
+	k_sleep(K_MSEC(SEND_BENCH_DRAIN_MS));
+
+	for (int path = 0; path < PATHS; path++) {
+		if (!run_path(path) && failed == NULL) {
+			failed = path_names[path];
+		}
+	}
+
+	close(tx_sock);
+	net_context_put(tx_ctx);
+
+	if (failed != NULL) {
+		printk("send bench failed: %s lost datagrams\n", failed);
+	} else {
+		printk("send bench done\n");
+	}
+}
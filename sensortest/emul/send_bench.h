@@ -0,0 +1,20 @@
+/*
+ * Telemetry send path bench for native_sim.
+ *
+ * send_bench_run() formats and sends the same text datagram through
+ * sendto(), net_context_sendto() and telemetry_pkt.h in turn, to a sink
+ * socket on the loopback interface, and reports the time and the RAM each
+ * path takes per datagram.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef SEND_BENCH_H_
+#define SEND_BENCH_H_
+
+/* Port the sink listens on, next to the sample's telemetry */
+#define SEND_BENCH_PORT 9997
+
+void send_bench_run(void);
+
+#endif /* SEND_BENCH_H_ */
@@ -0,0 +1,241 @@
+/*
+ * Sampling-to-UDP bench, see sensor_bench.h
+ *
+ * Each phase takes BENCH_SAMPLES samples through the whole pipeline:
+ * sensor_sample_fetch() on the emulated I2C bus, formatting or compression,
+ * the flash backlog check and sendto(). The collector decodes what arrives
+ * so that lost samples show up.
+ *
+ * Times come from the host clock on native_sim, where simulated time does
+ * not move while the CPU is busy, and from the kernel clock elsewhere.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/sys/util.h>
+
+#ifdef CONFIG_ARCH_POSIX
+#include "host_clock.h"
+#endif
+
+#include "sensor_bench.h"
+#include "sensor_emul.h"
+#include "ts_codec.h"
+
+/* Samples per phase, a multiple of sensortest's TS_BATCH_SAMPLES */
+#define BENCH_SAMPLES 480
+#define BENCH_MAX_DATAGRAMS (2 * BENCH_SAMPLES)
+#define BENCH_DRAIN_MS 200
+
+#define COLLECTOR_STACK_SIZE 2048
+#define COLLECTOR_PRIO K_PRIO_COOP(7)
+
+/* Pacing of each phase in samples per second, 0 for back to back */
+static const uint32_t bench_rates_hz[] = { 10, 100, 0 };
+
+/*
+ * Shared by the sensor work handler and the collector, both cooperative
+ * threads, so neither can interrupt an update of the other.
+ */
+static struct {
+	uint64_t begin_us;	/* of the sample in progress or the last one */
+	uint32_t samples;
+	uint64_t cpu_us;
+	uint32_t cpu_max_us;
+	uint32_t datagrams;
+	uint32_t bytes;
+	uint32_t delivered;	/* samples the collector decoded */
+	uint32_t lat_us[BENCH_MAX_DATAGRAMS];
+} phase;
+
+static K_THREAD_STACK_DEFINE(collector_stack, COLLECTOR_STACK_SIZE);
+static struct k_thread collector_thread;
+static uint8_t rx_buf[512];
+
+static uint64_t bench_now_us(void)
+{
+#ifdef CONFIG_ARCH_POSIX
+	return host_clock_us();
+#else
+	return k_ticks_to_us_floor64(k_uptime_ticks());
+#endif
+}
+
+void sensor_bench_sample_begin(void)
+{
+	phase.begin_us = bench_now_us();
+}
+
+void sensor_bench_sample_end(void)
+{
+	uint32_t us = bench_now_us() - phase.begin_us;
+
+	phase.samples++;
+	phase.cpu_us += us;
+	phase.cpu_max_us = MAX(phase.cpu_max_us, us);
+}
+
+/* Samples in a datagram: a block count, or the light reading in text */
+static uint32_t samples_in(const uint8_t *buf, size_t len)
+{
+	struct ts_decoder dec;
+	uint32_t n = 0;
+	int r;
+
+	if (buf[0] != TS_MAGIC) {
+		return len >= 3 && memcmp(buf, "1l:", 3) == 0;
+	}
+
+	for (; len > 0; buf += r, len -= r) {
+		r = ts_decoder_init(&dec, buf, len);
+		if (r < 0) {
+			break;
+		}
+		n += dec.count;
+	}
+
+	return n;
+}
+
+static void collector(void *p1, void *p2, void *p3)
+{
+	struct sockaddr_in6 addr = {
+		.sin6_family = AF_INET6,
+		.sin6_port = htons(SENSOR_BENCH_PORT),
+		.sin6_addr = IN6ADDR_ANY_INIT,
+	};
+	ssize_t len;
+	int sock;
+
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	sock = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock < 0 ||
+	    bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		printk("collector: socket failed: %d\n", errno);
+		return;
+	}
+
+	for (;;) {
+		len = recv(sock, rx_buf, sizeof(rx_buf), 0);
+		if (len <= 0) {
+			continue;
+		}
+
+		if (phase.datagrams < BENCH_MAX_DATAGRAMS) {
+			phase.lat_us[phase.datagrams] =
+				bench_now_us() - phase.begin_us;
+		}
+		phase.datagrams++;
+		phase.bytes += len;
+		phase.delivered += samples_in(rx_buf, len);
+	}
+}
+
+static void sort_u32(uint32_t *v, size_t n)
+{
+	for (size_t i = 1; i < n; i++) {
+		uint32_t x = v[i];
+		size_t j;
+
+		for (j = i; j > 0 && v[j - 1] > x; j--) {
+			v[j] = v[j - 1];
+		}
+		v[j] = x;
+	}
+}
+
+static uint32_t percentile(const uint32_t *sorted, size_t n, uint32_t pct)
+{
+	return n > 0 ? sorted[MIN(n - 1, n * pct / 100)] : 0;
+}
+
+static uint32_t run_phase(struct k_work *sensor_work, uint32_t rate_hz)
+{
+	struct k_work_sync sync;
+	uint64_t start;
+	uint32_t elapsed_us;
+	uint32_t rate;
+	char name[16];
+	size_t n;
+
+	memset(&phase, 0, sizeof(phase));
+	start = bench_now_us();
+
+	for (int i = 0; i < BENCH_SAMPLES; i++) {
+		k_work_submit(sensor_work);
+		k_work_flush(sensor_work, &sync);
+
+		if (rate_hz > 0) {
+			k_sleep(K_USEC(USEC_PER_SEC / rate_hz));
+		} else {
+			k_yield();
+		}
+	}
+
+	elapsed_us = MAX(bench_now_us() - start, 1);
+	k_sleep(K_MSEC(BENCH_DRAIN_MS));
+
+	n = MIN(phase.datagrams, BENCH_MAX_DATAGRAMS);
+	sort_u32(phase.lat_us, n);
+	rate = (uint64_t)phase.samples * USEC_PER_SEC / elapsed_us;
+
+	if (rate_hz > 0) {
+		snprintf(name, sizeof(name), "%u Hz", rate_hz);
+	} else {
+		snprintf(name, sizeof(name), "back-to-back");
+	}
+
+	printk("bench %s: %u samples, %u delivered, %u datagrams, %u B, "
+	       "%u samples/s\n", name, phase.samples, phase.delivered,
+	       phase.datagrams, phase.bytes, rate);
+	printk("bench %s: latency p50 %u p99 %u max %u us, "
+	       "cpu %u us/sample (max %u)\n", name,
+	       percentile(phase.lat_us, n, 50), percentile(phase.lat_us, n, 99),
+	       n > 0 ? phase.lat_us[n - 1] : 0,
+	       (uint32_t)(phase.cpu_us / MAX(phase.samples, 1)),
+	       phase.cpu_max_us);
+
+	return phase.delivered;
+}
+
+void sensor_bench_run(struct k_work *sensor_work)
+{
+	const struct emul *light = EMUL_DT_GET(DT_NODELABEL(light));
+	const struct emul *humidity = EMUL_DT_GET(DT_NODELABEL(humidity));
+	uint32_t delivered = 0;
+
+	k_thread_create(&collector_thread, collector_stack,
+			K_THREAD_STACK_SIZEOF(collector_stack), collector,
+			NULL, NULL, NULL, COLLECTOR_PRIO, 0, K_NO_WAIT);
+	k_thread_name_set(&collector_thread, "collector");
+	k_sleep(K_MSEC(BENCH_DRAIN_MS));
+
+	/* One frame per measurement, the same data whatever the pacing */
+	sensor_emul_set_rate(light, 0);
+	sensor_emul_set_rate(humidity, 0);
+
+	for (size_t i = 0; i < ARRAY_SIZE(bench_rates_hz); i++) {
+		delivered += run_phase(sensor_work, bench_rates_hz[i]);
+	}
+
+	printk("emul: %u light, %u humidity measurements\n",
+	       sensor_emul_measurements(light),
+	       sensor_emul_measurements(humidity));
+
+	if (delivered == 0) {
+		printk("bench failed: no telemetry delivered\n");
+	} else {
+		printk("bench done\n");
+	}
+}
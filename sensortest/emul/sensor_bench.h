@@ -0,0 +1,26 @@
+/*
+ * Sampling-to-UDP bench for native_sim with the emulated sensors.
+ *
+ * sensor_bench_run() drives the sample's sensor work item at several rates
+ * while a collector thread receives the telemetry over the loopback
+ * interface, then reports throughput, sample-to-collector latency and CPU
+ * time per sample. The sensor work handler brackets each sample with
+ * sensor_bench_sample_begin() and sensor_bench_sample_end().
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef SENSOR_BENCH_H_
+#define SENSOR_BENCH_H_
+
+#include <zephyr/kernel.h>
+
+/* Port the collector listens on, where the sample sends its telemetry */
+#define SENSOR_BENCH_PORT 9999
+
+void sensor_bench_run(struct k_work *sensor_work);
+
+void sensor_bench_sample_begin(void);
+void sensor_bench_sample_end(void);
+
+#endif /* SENSOR_BENCH_H_ */
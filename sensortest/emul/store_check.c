@@ -0,0 +1,172 @@
+/*
+ * Store-and-forward check, see store_check.h
+ *
+ * Records are STORE_CHECK_LEN bytes, "r<number>" padded with dots, so
+ * that a batch splits back into records by length alone. There are enough
+ * of them to fill more than one flash sector, and the reset comes after
+ * the drain has moved into the second one and erased the first.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+
+#include "store_check.h"
+#include "telemetry_store.h"
+
+#define STORE_CHECK_RECORDS 200
+#define STORE_CHECK_LEN 32
+#define STORE_CHECK_BATCHES_BEFORE_RESET 8
+
+BUILD_ASSERT(STORE_CHECK_LEN <= TELEMETRY_RECORD_MAX);
+
+static struct {
+	uint8_t seen[STORE_CHECK_RECORDS];
+	int last;
+	uint32_t received;
+	const char *error;
+} check;
+
+static int send_down(const uint8_t *buf, size_t len)
+{
+	ARG_UNUSED(buf);
+	ARG_UNUSED(len);
+
+	return -ENETDOWN;
+}
+
+static int send_discard(const uint8_t *buf, size_t len)
+{
+	ARG_UNUSED(buf);
+	ARG_UNUSED(len);
+
+	return 0;
+}
+
+static int send_up(const uint8_t *buf, size_t len)
+{
+	if (len % STORE_CHECK_LEN != 0) {
+		check.error = "batch split a record";
+		return 0;
+	}
+
+	for (size_t off = 0; off < len; off += STORE_CHECK_LEN) {
+		const char *rec = (const char *)buf + off;
+		unsigned long n = strtoul(rec + 1, NULL, 10);
+
+		if (rec[0] != 'r' || n >= STORE_CHECK_RECORDS) {
+			check.error = "record corrupted";
+			continue;
+		}
+
+		/* Resent records are counted below */
+		if ((int)n < check.last && check.seen[n] == 0 &&
+		    check.error == NULL) {
+			check.error = "records out of order";
+		}
+
+		check.last = n;
+		check.seen[n]++;
+		check.received++;
+	}
+
+	return 0;
+}
+
+/* Sends everything queued, returns the number of batches */
+static int drain_all(int (*send)(const uint8_t *buf, size_t len))
+{
+	int batches = 0;
+	int r;
+
+	while (telemetry_store_pending()) {
+		r = telemetry_store_drain(send, 16);
+		if (r <= 0) {
+			break;
+		}
+		batches += r;
+	}
+
+	return batches;
+}
+
+void store_check_run(void)
+{
+	char rec[STORE_CHECK_LEN];
+	uint32_t before_reset, missing = 0, resent = 0;
+	int r;
+
+	memset(&check, 0, sizeof(check));
+	check.last = -1;
+
+	if (telemetry_store_init() != 0) {
+		printk("store check failed: no telemetry store\n");
+		return;
+	}
+
+	/* Whatever an earlier run left behind */
+	drain_all(send_discard);
+
+	for (int i = 0; i < STORE_CHECK_RECORDS; i++) {
+		memset(rec, '.', sizeof(rec));
+		r = snprintf(rec, sizeof(rec), "r%04d", i);
+		rec[r] = '.';
+
+		if (telemetry_store_append((const uint8_t *)rec,
+					   sizeof(rec)) != 0) {
+			printk("store check failed: append %d\n", i);
+			return;
+		}
+	}
+
+	/* Link down: nothing leaves, nothing is lost */
+	r = telemetry_store_drain(send_down, 1);
+	if (r > 0 || !telemetry_store_pending()) {
+		printk("store check failed: drained while the link was down\n");
+		return;
+	}
+
+	/* Link back, then a reset in the middle of the drain */
+	r = telemetry_store_drain(send_up, STORE_CHECK_BATCHES_BEFORE_RESET);
+	before_reset = check.received;
+
+	if (r != STORE_CHECK_BATCHES_BEFORE_RESET ||
+	    telemetry_store_init() != 0) {
+		printk("store check failed: drain before the reset: %d\n", r);
+		return;
+	}
+
+	drain_all(send_up);
+
+	for (int i = 0; i < STORE_CHECK_RECORDS; i++) {
+		if (check.seen[i] == 0) {
+			missing++;
+		} else {
+			resent += check.seen[i] - 1;
+		}
+	}
+
+	printk("store check: %u records, %u sent before the reset, %u after, "
+	       "%u missing, %u resent\n", STORE_CHECK_RECORDS, before_reset,
+	       check.received - before_reset, missing, resent);
+	telemetry_store_report();
+
+	if (check.error == NULL && missing > 0) {
+		check.error = "records missing";
+	}
+	if (check.error == NULL && resent > 0) {
+		check.error = "records resent after the reset";
+	}
+
+	if (check.error != NULL) {
+		printk("store check failed: %s\n", check.error);
+	} else {
+		printk("store check done\n");
+	}
+}
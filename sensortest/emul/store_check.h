@@ -0,0 +1,17 @@
+/*
+ * Store-and-forward check for native_sim, on the flash simulator.
+ *
+ * store_check_run() empties the telemetry store, appends records while the
+ * link is down, drains part of them once it is back, starts the store over
+ * from flash as a reset would, and drains the rest. Every record must
+ * arrive once and in order: the drain resumes from its last mark.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef STORE_CHECK_H_
+#define STORE_CHECK_H_
+
+void store_check_run(void);
+
+#endif /* STORE_CHECK_H_ */
@@ -0,0 +1,1239 @@
+/*
+ * Telemetry collector for Linux gateways.
+ *
+ *   collector [options]          receive until interrupted
+ *   collector bench [options]    blast the collector over loopback from
+ *                                simulated nodes and check what it saw
+ *
+ *   -p PORT    UDP port, repeat for more (9999)
+ *   -t N       decoder threads (2)
+ *   -o DIR     write columnar output to DIR
+ *   -i S       report every S seconds (1)
+ *   -n N       bench: datagrams to send (1000000)
+ *   -N N       bench: simulated nodes (64)
+ *
+ * One receiver thread per port reads batches of BATCH_MSGS datagrams with
+ * recvmmsg(), with the kernel receive timestamp of each. Every datagram of
+ * a batch belongs to the decoder its source address and port hash to, so
+ * each node is decoded by one thread and in order. The batch goes to the
+ * decoders that own part of it and back to the free pool once the last
+ * has finished with it; nothing is copied on the way.
+ *
+ * Formats are tried in the order of the formats[] table:
+ *   ts     sensortest compressed blocks (src/ts_codec.h)
+ *   text   sensortest text, "1l:84.32;2h:45.10;2t:23.50;", with the
+ *          optional "@<ms>;" timestamp of stored records and "#<seq>;"
+ *          sequence number
+ *   raw    anything else, such as the socket server's replies, counted only
+ *
+ * A node is a source address and port. Nodes that send "#<seq>;" are
+ * checked for sequence gaps, the others for time gaps: samples more than
+ * GAP_FACTOR times the node's average interval apart.
+ *
+ * With -o, every decoder writes one file per column, appending rows of
+ * COLUMN_ROWS at a time, little endian:
+ *
+ *   rx_ns.<k>    u64  kernel receive time, CLOCK_REALTIME ns
+ *   node.<k>     u32  node id, decoder k in the top byte
+ *   seq.<k>      u32  sequence number, 0xffffffff if none
+ *   t_ms.<k>     u32  device timestamp, 0 if none
+ *   chan.<k>     2 B  channel name, "1l", "2h", ...
+ *   value.<k>    i32  value in hundredths
+ *
+ * and nodes.<k>.csv with the address and the counters of each node.
+ *
+ * Latency is from the kernel receive timestamp to the end of the decode of
+ * the batch, so it includes the time a datagram waited in the socket.
+ *
+ * Build: cc -O2 -pthread -Isrc -o collector host/collector.c src/ts_codec.c
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ts_codec.h"
+
+#define DEFAULT_PORT	  9999
+#define MAX_PORTS	  4
+#define MAX_DECODERS	  16
+#define BATCH_MSGS	  64
+#define BATCH_POOL	  256
+#define MSG_MAX		  512
+#define RCVBUF_BYTES	  (16 * 1024 * 1024)
+#define RCV_TIMEOUT_MS	  100
+#define COLUMN_ROWS	  65536
+#define NODE_SLOTS	  4096	/* per decoder, a power of two */
+#define GAP_FACTOR	  3
+#define GAP_MIN_SAMPLES	  8
+#define SEQ_NONE	  UINT32_MAX
+
+/* Latency histogram: 4 buckets per power of two of nanoseconds */
+#define LAT_SUB_BITS	  2
+#define LAT_BUCKETS	  (64 << LAT_SUB_BITS)
+
+#define BENCH_DATAGRAMS	  1000000
+#define BENCH_NODES	  64
+#define BENCH_SENDERS	  2
+#define BENCH_IDLE_MS	  500
+
+struct batch {
+	int count;
+	atomic_int refs;
+	struct mmsghdr msgs[BATCH_MSGS];
+	struct iovec iov[BATCH_MSGS];
+	struct sockaddr_in6 src[BATCH_MSGS];
+	uint8_t ctrl[BATCH_MSGS][64];
+	uint64_t rx_ns[BATCH_MSGS];
+	uint8_t owner[BATCH_MSGS];
+	uint8_t data[BATCH_MSGS][MSG_MAX];
+};
+
+/* A bounded queue of batches, also used as the free pool */
+struct queue {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct batch *items[BATCH_POOL];
+	size_t head;
+	size_t count;
+	bool closed;
+};
+
+struct node {
+	struct in6_addr addr;
+	uint16_t port;
+	bool used;
+	uint32_t id;
+	uint64_t datagrams;
+	uint64_t samples;	/* values, one per channel and sample */
+	/* sequence numbers, "#<seq>;" */
+	bool has_seq;
+	uint32_t next_seq;
+	uint64_t seq_gaps;
+	uint64_t seq_lost;
+	uint64_t reordered;
+	/* sample times, device or receive time in ms */
+	uint64_t last_ms;
+	uint32_t avg_ms;	/* average interval, in 1/16 ms */
+	uint32_t intervals;
+	uint64_t time_gaps;
+};
+
+enum format_id {
+	FORMAT_TS,
+	FORMAT_TEXT,
+	FORMAT_RAW,
+	FORMATS,
+};
+
+struct stats {
+	uint64_t datagrams;
+	uint64_t bytes;
+	uint64_t samples;
+	uint64_t truncated;
+	uint64_t bad;
+	uint64_t formats[FORMATS];
+	uint64_t seq_lost;
+	uint64_t seq_gaps;
+	uint64_t reordered;
+	uint64_t time_gaps;
+	uint32_t nodes;
+	uint64_t lat[LAT_BUCKETS];
+};
+
+struct columns {
+	size_t rows;
+	uint64_t rx_ns[COLUMN_ROWS];
+	uint32_t node[COLUMN_ROWS];
+	uint32_t seq[COLUMN_ROWS];
+	uint32_t t_ms[COLUMN_ROWS];
+	char chan[COLUMN_ROWS][2];
+	int32_t value[COLUMN_ROWS];
+};
+
+enum column_id {
+	COL_RX_NS,
+	COL_NODE,
+	COL_SEQ,
+	COL_T_MS,
+	COL_CHAN,
+	COL_VALUE,
+	COLUMNS,
+};
+
+static const char *const column_names[COLUMNS] = {
+	[COL_RX_NS] = "rx_ns",
+	[COL_NODE] = "node",
+	[COL_SEQ] = "seq",
+	[COL_T_MS] = "t_ms",
+	[COL_CHAN] = "chan",
+	[COL_VALUE] = "value",
+};
+
+struct decoder {
+	int index;
+	pthread_t thread;
+	struct queue queue;
+	struct node nodes[NODE_SLOTS];
+	struct stats stats;
+	/* copy of stats for the reporter, updated after every batch */
+	pthread_mutex_t lock;
+	struct stats published;
+	struct columns *cols;
+	FILE *files[COLUMNS];
+};
+
+/* What a format decoder gets of a datagram */
+struct datagram {
+	struct decoder *d;
+	struct node *node;
+	const uint8_t *buf;
+	size_t len;
+	uint64_t rx_ns;
+};
+
+struct format {
+	const char *name;
+	bool (*match)(const uint8_t *buf, size_t len);
+	/* Returns the samples decoded, negative if malformed */
+	int (*decode)(struct datagram *dg);
+};
+
+struct receiver {
+	int fd;
+	uint16_t port;
+	pthread_t thread;
+	atomic_uint_fast64_t kernel_drops;
+};
+
+static struct queue free_batches;
+static struct decoder decoders[MAX_DECODERS];
+static int decoder_count = 2;
+static struct receiver receivers[MAX_PORTS];
+static int receiver_count;
+static const char *out_dir;
+static atomic_bool stopping;
+
+static uint64_t clock_ns(clockid_t clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000U + ts.tv_nsec;
+}
+
+static void queue_init(struct queue *q)
+{
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->cond, NULL);
+}
+
+static void queue_push(struct queue *q, struct batch *b)
+{
+	pthread_mutex_lock(&q->lock);
+	/* Never full: there are only BATCH_POOL batches */
+	q->items[(q->head + q->count++) % BATCH_POOL] = b;
+	pthread_cond_signal(&q->cond);
+	pthread_mutex_unlock(&q->lock);
+}
+
+/* NULL once the queue is closed and empty */
+static struct batch *queue_pop(struct queue *q)
+{
+	struct batch *b = NULL;
+
+	pthread_mutex_lock(&q->lock);
+	while (q->count == 0 && !q->closed) {
+		pthread_cond_wait(&q->cond, &q->lock);
+	}
+	if (q->count > 0) {
+		b = q->items[q->head];
+		q->head = (q->head + 1) % BATCH_POOL;
+		q->count--;
+	}
+	pthread_mutex_unlock(&q->lock);
+
+	return b;
+}
+
+static void queue_close(struct queue *q)
+{
+	pthread_mutex_lock(&q->lock);
+	q->closed = true;
+	pthread_cond_broadcast(&q->cond);
+	pthread_mutex_unlock(&q->lock);
+}
+
+static uint32_t node_hash(const struct sockaddr_in6 *src)
+{
+	const uint32_t *a = (const uint32_t *)&src->sin6_addr;
+	uint32_t h = 2166136261U;
+
+	for (int i = 0; i < 4; i++) {
+		h = (h ^ a[i]) * 16777619U;
+	}
+	h = (h ^ src->sin6_port) * 16777619U;
+
+	return h ^ (h >> 15);
+}
+
+static struct node *node_get(struct decoder *d, const struct sockaddr_in6 *src)
+{
+	uint32_t h = node_hash(src) / MAX_DECODERS;
+
+	for (uint32_t i = 0; i < NODE_SLOTS; i++) {
+		struct node *n = &d->nodes[(h + i) & (NODE_SLOTS - 1)];
+
+		if (!n->used) {
+			n->used = true;
+			n->addr = src->sin6_addr;
+			n->port = src->sin6_port;
+			n->id = (uint32_t)d->index << 24 | d->stats.nodes++;
+			return n;
+		}
+
+		if (n->port == src->sin6_port &&
+		    memcmp(&n->addr, &src->sin6_addr, sizeof(n->addr)) == 0) {
+			return n;
+		}
+	}
+
+	return NULL;
+}
+
+static void node_seq(struct decoder *d, struct node *n, uint32_t seq)
+{
+	if (!n->has_seq) {
+		n->has_seq = true;
+	} else if (seq > n->next_seq) {
+		n->seq_gaps++;
+		n->seq_lost += seq - n->next_seq;
+		d->stats.seq_gaps++;
+		d->stats.seq_lost += seq - n->next_seq;
+	} else if (seq < n->next_seq) {
+		n->reordered++;
+		d->stats.reordered++;
+		return;
+	}
+
+	n->next_seq = seq + 1;
+}
+
+/* For nodes without sequence numbers */
+static void node_time(struct decoder *d, struct node *n, uint64_t ms)
+{
+	uint64_t interval;
+
+	if (n->has_seq || n->last_ms == 0 || ms <= n->last_ms) {
+		n->last_ms = ms > n->last_ms ? ms : n->last_ms;
+		return;
+	}
+
+	interval = ms - n->last_ms;
+	n->last_ms = ms;
+
+	if (n->intervals >= GAP_MIN_SAMPLES &&
+	    interval * 16 > (uint64_t)GAP_FACTOR * n->avg_ms) {
+		n->time_gaps++;
+		d->stats.time_gaps++;
+		return;
+	}
+
+	/* Gaps stay out of the average */
+	if (n->intervals++ == 0) {
+		n->avg_ms = interval * 16;
+	} else {
+		n->avg_ms += ((int64_t)interval * 16 - n->avg_ms) / 8;
+	}
+}
+
+static void columns_flush(struct decoder *d)
+{
+	struct columns *c = d->cols;
+
+	if (c == NULL || c->rows == 0) {
+		return;
+	}
+
+	fwrite(c->rx_ns, sizeof(c->rx_ns[0]), c->rows, d->files[COL_RX_NS]);
+	fwrite(c->node, sizeof(c->node[0]), c->rows, d->files[COL_NODE]);
+	fwrite(c->seq, sizeof(c->seq[0]), c->rows, d->files[COL_SEQ]);
+	fwrite(c->t_ms, sizeof(c->t_ms[0]), c->rows, d->files[COL_T_MS]);
+	fwrite(c->chan, sizeof(c->chan[0]), c->rows, d->files[COL_CHAN]);
+	fwrite(c->value, sizeof(c->value[0]), c->rows, d->files[COL_VALUE]);
+	c->rows = 0;
+}
+
+static void emit(struct datagram *dg, uint32_t seq, uint32_t t_ms,
+		 const char *chan, int32_t value)
+{
+	struct columns *c = dg->d->cols;
+
+	dg->d->stats.samples++;
+	dg->node->samples++;
+
+	if (c == NULL) {
+		return;
+	}
+
+	c->rx_ns[c->rows] = dg->rx_ns;
+	c->node[c->rows] = dg->node->id;
+	c->seq[c->rows] = seq;
+	c->t_ms[c->rows] = t_ms;
+	memcpy(c->chan[c->rows], chan, 2);
+	c->value[c->rows] = value;
+
+	if (++c->rows == COLUMN_ROWS) {
+		columns_flush(dg->d);
+	}
+}
+
+static bool match_ts(const uint8_t *buf, size_t len)
+{
+	return len >= TS_HDR_LEN(1) && buf[0] == TS_MAGIC;
+}
+
+static int decode_ts(struct datagram *dg)
+{
+	struct ts_decoder dec;
+	int32_t vals[TS_MAX_CHANNELS];
+	const uint8_t *buf = dg->buf;
+	size_t len = dg->len;
+	int samples = 0;
+	uint32_t t;
+	int r;
+
+	/* Stored blocks are drained back to back in one datagram */
+	while (len > 0) {
+		r = ts_decoder_init(&dec, buf, len);
+		if (r < 0) {
+			return r;
+		}
+		buf += r;
+		len -= r;
+
+		while ((r = ts_decode(&dec, &t, vals)) > 0) {
+			node_time(dg->d, dg->node, t);
+			for (int i = 0; i < dec.channels; i++) {
+				emit(dg, SEQ_NONE, t, dec.names[i], vals[i]);
+			}
+			samples++;
+		}
+		if (r < 0) {
+			return r;
+		}
+	}
+
+	return samples;
+}
+
+static bool match_text(const uint8_t *buf, size_t len)
+{
+	return len >= 4 && ((buf[0] >= '0' && buf[0] <= '9') ||
+			    buf[0] == '@' || buf[0] == '#');
+}
+
+static bool parse_u32(const char *p, const char *end, uint32_t *v)
+{
+	uint64_t n = 0;
+
+	if (p == end) {
+		return false;
+	}
+
+	for (; p < end; p++) {
+		if (*p < '0' || *p > '9' || n > UINT32_MAX / 10) {
+			return false;
+		}
+		n = n * 10 + (*p - '0');
+	}
+
+	*v = n;
+
+	return n <= UINT32_MAX;
+}
+
+/* "84.32", "-5.2" or "12" to hundredths, as host/ts_tool.c reads them */
+static bool parse_hundredths(const char *p, const char *end, int32_t *v)
+{
+	bool neg = p < end && *p == '-';
+	int64_t whole = 0;
+	int frac = 0;
+	int digits = 0;
+
+	p += neg;
+	if (p == end) {
+		return false;
+	}
+
+	for (; p < end && *p != '.'; p++) {
+		if (*p < '0' || *p > '9' || whole > INT32_MAX / 100) {
+			return false;
+		}
+		whole = whole * 10 + (*p - '0');
+	}
+
+	if (p < end) {
+		for (p++; p < end; p++) {
+			if (*p < '0' || *p > '9') {
+				return false;
+			}
+			if (digits < 2) {
+				frac = frac * 10 + (*p - '0');
+				digits++;
+			}
+		}
+	}
+	for (; digits < 2; digits++) {
+		frac *= 10;
+	}
+
+	*v = (neg ? -1 : 1) * (int32_t)(whole * 100 + frac);
+
+	return true;
+}
+
+static int decode_text(struct datagram *dg)
+{
+	const char *p = (const char *)dg->buf;
+	const char *end = p + dg->len;
+	uint32_t seq = SEQ_NONE;
+	uint32_t t_ms = 0;
+	bool timed = false;
+	int samples = 0;
+	int32_t v;
+
+	while (p < end) {
+		const char *semi = memchr(p, ';', end - p);
+
+		if (semi == NULL) {
+			semi = end;
+		}
+
+		if (*p == '@' && parse_u32(p + 1, semi, &t_ms)) {
+			timed = true;
+		} else if (*p == '#' && parse_u32(p + 1, semi, &seq)) {
+			node_seq(dg->d, dg->node, seq);
+		} else if (semi - p >= 4 && p[2] == ':' &&
+			   parse_hundredths(p + 3, semi, &v)) {
+			emit(dg, seq, t_ms, p, v);
+			samples++;
+		} else if (semi > p) {
+			return -EINVAL;
+		}
+
+		p = semi + 1;
+	}
+
+	/* One sampling round per datagram */
+	node_time(dg->d, dg->node, timed ? t_ms : dg->rx_ns / 1000000U);
+
+	return samples;
+}
+
+static bool match_raw(const uint8_t *buf, size_t len)
+{
+	(void)buf;
+	(void)len;
+
+	return true;
+}
+
+static int decode_raw(struct datagram *dg)
+{
+	node_time(dg->d, dg->node, dg->rx_ns / 1000000U);
+
+	return 0;
+}
+
+/* New binary formats go before text, with a distinct first byte */
+static const struct format formats[FORMATS] = {
+	[FORMAT_TS] = { "ts", match_ts, decode_ts },
+	[FORMAT_TEXT] = { "text", match_text, decode_text },
+	[FORMAT_RAW] = { "raw", match_raw, decode_raw },
+};
+
+static void decode_datagram(struct decoder *d, struct batch *b, int i)
+{
+	struct datagram dg = {
+		.d = d,
+		.buf = b->data[i],
+		.len = b->msgs[i].msg_len,
+		.rx_ns = b->rx_ns[i],
+	};
+
+	d->stats.datagrams++;
+	d->stats.bytes += dg.len;
+
+	if (b->msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+		d->stats.truncated++;
+		return;
+	}
+
+	dg.node = node_get(d, &b->src[i]);
+	if (dg.node == NULL) {
+		d->stats.bad++;
+		return;
+	}
+	dg.node->datagrams++;
+
+	for (int f = 0; f < FORMATS; f++) {
+		if (formats[f].match(dg.buf, dg.len)) {
+			d->stats.formats[f]++;
+			if (formats[f].decode(&dg) < 0) {
+				d->stats.bad++;
+			}
+			break;
+		}
+	}
+}
+
+static int lat_bucket(uint64_t ns)
+{
+	int msb;
+
+	if (ns < (1U << LAT_SUB_BITS)) {
+		return ns;
+	}
+
+	msb = 63 - __builtin_clzll(ns);
+
+	return ((msb - LAT_SUB_BITS + 1) << LAT_SUB_BITS) |
+	       ((ns >> (msb - LAT_SUB_BITS)) & ((1U << LAT_SUB_BITS) - 1));
+}
+
+/* Lower bound of a bucket */
+static uint64_t lat_bucket_ns(int bucket)
+{
+	int shift = (bucket >> LAT_SUB_BITS) - 1;
+	uint64_t sub = bucket & ((1U << LAT_SUB_BITS) - 1);
+
+	if (shift < 0) {
+		return bucket;
+	}
+
+	return ((1ULL << LAT_SUB_BITS) | sub) << shift;
+}
+
+static void *decoder_thread(void *arg)
+{
+	struct decoder *d = arg;
+	struct batch *b;
+	uint64_t now;
+
+	while ((b = queue_pop(&d->queue)) != NULL) {
+		for (int i = 0; i < b->count; i++) {
+			if (b->owner[i] == d->index) {
+				decode_datagram(d, b, i);
+			}
+		}
+
+		now = clock_ns(CLOCK_REALTIME);
+		for (int i = 0; i < b->count; i++) {
+			if (b->owner[i] == d->index && b->rx_ns[i] != 0) {
+				d->stats.lat[lat_bucket(now > b->rx_ns[i] ?
+							now - b->rx_ns[i] : 0)]++;
+			}
+		}
+
+		if (atomic_fetch_sub(&b->refs, 1) == 1) {
+			queue_push(&free_batches, b);
+		}
+
+		pthread_mutex_lock(&d->lock);
+		d->published = d->stats;
+		pthread_mutex_unlock(&d->lock);
+	}
+
+	columns_flush(d);
+
+	return NULL;
+}
+
+static void batch_prepare(struct batch *b)
+{
+	for (int i = 0; i < BATCH_MSGS; i++) {
+		struct msghdr *h = &b->msgs[i].msg_hdr;
+
+		b->iov[i].iov_base = b->data[i];
+		b->iov[i].iov_len = MSG_MAX;
+		h->msg_name = &b->src[i];
+		h->msg_namelen = sizeof(b->src[i]);
+		h->msg_iov = &b->iov[i];
+		h->msg_iovlen = 1;
+		h->msg_control = b->ctrl[i];
+		h->msg_controllen = sizeof(b->ctrl[i]);
+		h->msg_flags = 0;
+	}
+}
+
+static void batch_stamp(struct receiver *rx, struct batch *b, int i)
+{
+	struct msghdr *h = &b->msgs[i].msg_hdr;
+
+	b->rx_ns[i] = 0;
+
+	for (struct cmsghdr *c = CMSG_FIRSTHDR(h); c; c = CMSG_NXTHDR(h, c)) {
+		if (c->cmsg_level != SOL_SOCKET) {
+			continue;
+		}
+
+		if (c->cmsg_type == SCM_TIMESTAMPNS) {
+			struct timespec ts;
+
+			memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+			b->rx_ns[i] = (uint64_t)ts.tv_sec * 1000000000U +
+				      ts.tv_nsec;
+		} else if (c->cmsg_type == SO_RXQ_OVFL) {
+			uint32_t drops;
+
+			/* Datagrams dropped on this socket so far */
+			memcpy(&drops, CMSG_DATA(c), sizeof(drops));
+			atomic_store(&rx->kernel_drops, drops);
+		}
+	}
+}
+
+static void *receiver_thread(void *arg)
+{
+	struct receiver *rx = arg;
+	uint32_t owners;
+	struct batch *b;
+	int n;
+
+	while (!atomic_load(&stopping)) {
+		b = queue_pop(&free_batches);
+		if (b == NULL) {
+			break;
+		}
+
+		batch_prepare(b);
+		n = recvmmsg(rx->fd, b->msgs, BATCH_MSGS, MSG_WAITFORONE, NULL);
+		if (n <= 0) {
+			queue_push(&free_batches, b);
+			continue;
+		}
+
+		b->count = n;
+		owners = 0;
+		for (int i = 0; i < n; i++) {
+			batch_stamp(rx, b, i);
+			b->owner[i] = node_hash(&b->src[i]) % decoder_count;
+			owners |= 1U << b->owner[i];
+		}
+
+		atomic_store(&b->refs, __builtin_popcount(owners));
+		for (int k = 0; k < decoder_count; k++) {
+			if (owners & (1U << k)) {
+				queue_push(&decoders[k].queue, b);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static int open_port(struct receiver *rx, uint16_t port)
+{
+	struct sockaddr_in6 addr = {
+		.sin6_family = AF_INET6,
+		.sin6_port = htons(port),
+		.sin6_addr = IN6ADDR_ANY_INIT,
+	};
+	struct timeval tv = { .tv_usec = RCV_TIMEOUT_MS * 1000 };
+	int size = RCVBUF_BYTES;
+	int on = 1;
+
+	rx->port = port;
+	rx->fd = socket(AF_INET6, SOCK_DGRAM, 0);
+	if (rx->fd < 0) {
+		perror("socket");
+		return -errno;
+	}
+
+	/* Beyond rmem_max only with CAP_NET_ADMIN, the smaller size is kept */
+	if (setsockopt(rx->fd, SOL_SOCKET, SO_RCVBUFFORCE, &size,
+		       sizeof(size)) < 0) {
+		setsockopt(rx->fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+	}
+	setsockopt(rx->fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+	setsockopt(rx->fd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on));
+	setsockopt(rx->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+	if (bind(rx->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		fprintf(stderr, "bind %u: %s\n", port, strerror(errno));
+		close(rx->fd);
+		return -errno;
+	}
+
+	return 0;
+}
+
+static int open_columns(struct decoder *d)
+{
+	char path[512];
+
+	d->cols = calloc(1, sizeof(*d->cols));
+	if (d->cols == NULL) {
+		return -ENOMEM;
+	}
+
+	for (int c = 0; c < COLUMNS; c++) {
+		snprintf(path, sizeof(path), "%s/%s.%d", out_dir,
+			 column_names[c], d->index);
+		d->files[c] = fopen(path, "wb");
+		if (d->files[c] == NULL) {
+			perror(path);
+			return -errno;
+		}
+	}
+
+	return 0;
+}
+
+static void write_nodes(struct decoder *d)
+{
+	char path[512];
+	char addr[INET6_ADDRSTRLEN];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/nodes.%d.csv", out_dir, d->index);
+	f = fopen(path, "w");
+	if (f == NULL) {
+		perror(path);
+		return;
+	}
+
+	fprintf(f, "id,address,port,datagrams,values,seq_gaps,seq_lost,"
+		"reordered,time_gaps\n");
+	for (int i = 0; i < NODE_SLOTS; i++) {
+		const struct node *n = &d->nodes[i];
+
+		if (!n->used) {
+			continue;
+		}
+
+		inet_ntop(AF_INET6, &n->addr, addr, sizeof(addr));
+		fprintf(f, "%u,%s,%u,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%"
+			PRIu64 ",%" PRIu64 ",%" PRIu64 "\n", n->id, addr,
+			ntohs(n->port), n->datagrams, n->samples, n->seq_gaps,
+			n->seq_lost, n->reordered, n->time_gaps);
+	}
+
+	fclose(f);
+}
+
+static int collector_start(const uint16_t *ports, int port_count)
+{
+	static struct batch pool[BATCH_POOL];
+
+	queue_init(&free_batches);
+	for (int i = 0; i < BATCH_POOL; i++) {
+		queue_push(&free_batches, &pool[i]);
+	}
+
+	if (out_dir != NULL) {
+		mkdir(out_dir, 0755);
+	}
+
+	for (int k = 0; k < decoder_count; k++) {
+		struct decoder *d = &decoders[k];
+
+		d->index = k;
+		queue_init(&d->queue);
+		pthread_mutex_init(&d->lock, NULL);
+		if (out_dir != NULL && open_columns(d) < 0) {
+			return -EIO;
+		}
+		pthread_create(&d->thread, NULL, decoder_thread, d);
+	}
+
+	for (int i = 0; i < port_count; i++) {
+		if (open_port(&receivers[i], ports[i]) < 0) {
+			return -EIO;
+		}
+		receiver_count++;
+		pthread_create(&receivers[i].thread, NULL, receiver_thread,
+			       &receivers[i]);
+	}
+
+	return 0;
+}
+
+static void collector_stop(void)
+{
+	atomic_store(&stopping, true);
+
+	for (int i = 0; i < receiver_count; i++) {
+		pthread_join(receivers[i].thread, NULL);
+		close(receivers[i].fd);
+	}
+
+	for (int k = 0; k < decoder_count; k++) {
+		queue_close(&decoders[k].queue);
+		pthread_join(decoders[k].thread, NULL);
+
+		if (out_dir != NULL) {
+			for (int c = 0; c < COLUMNS; c++) {
+				fclose(decoders[k].files[c]);
+			}
+			write_nodes(&decoders[k]);
+		}
+	}
+}
+
+static void stats_sum(struct stats *sum, uint64_t *kernel_drops)
+{
+	memset(sum, 0, sizeof(*sum));
+
+	for (int k = 0; k < decoder_count; k++) {
+		struct stats s;
+
+		pthread_mutex_lock(&decoders[k].lock);
+		s = decoders[k].published;
+		pthread_mutex_unlock(&decoders[k].lock);
+
+		sum->datagrams += s.datagrams;
+		sum->bytes += s.bytes;
+		sum->samples += s.samples;
+		sum->truncated += s.truncated;
+		sum->bad += s.bad;
+		sum->seq_lost += s.seq_lost;
+		sum->seq_gaps += s.seq_gaps;
+		sum->reordered += s.reordered;
+		sum->time_gaps += s.time_gaps;
+		sum->nodes += s.nodes;
+		for (int f = 0; f < FORMATS; f++) {
+			sum->formats[f] += s.formats[f];
+		}
+		for (int i = 0; i < LAT_BUCKETS; i++) {
+			sum->lat[i] += s.lat[i];
+		}
+	}
+
+	*kernel_drops = 0;
+	for (int i = 0; i < receiver_count; i++) {
+		*kernel_drops += atomic_load(&receivers[i].kernel_drops);
+	}
+}
+
+/* Upper bound of a bucket in microseconds, rounded up */
+static uint64_t lat_bucket_us(int bucket)
+{
+	if (bucket + 1 >= LAT_BUCKETS) {
+		return UINT64_MAX / 1000;
+	}
+
+	return (lat_bucket_ns(bucket + 1) + 999) / 1000;
+}
+
+static uint64_t lat_percentile(const uint64_t *lat, uint64_t total, int pct)
+{
+	uint64_t want = total * pct / 100;
+	uint64_t seen = 0;
+
+	for (int i = 0; i < LAT_BUCKETS; i++) {
+		seen += lat[i];
+		if (seen > want) {
+			return lat_bucket_us(i);
+		}
+	}
+
+	return 0;
+}
+
+static uint64_t lat_max(const uint64_t *lat)
+{
+	for (int i = LAT_BUCKETS - 1; i >= 0; i--) {
+		if (lat[i] > 0) {
+			return lat_bucket_us(i);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Rates over the interval since prev, latency over the whole run. The
+ * latencies are histogram buckets, printed as the bound below which they
+ * fall, within 25%.
+ */
+static void report(const char *name, const struct stats *now,
+		   const struct stats *prev, uint64_t kernel_drops,
+		   double seconds)
+{
+	uint64_t lat_total = 0;
+
+	for (int i = 0; i < LAT_BUCKETS; i++) {
+		lat_total += now->lat[i];
+	}
+
+	printf("%s: %.0f datagrams/s, %.0f values/s, %.1f MB/s, "
+	       "%" PRIu64 " datagrams from %u nodes (ts %" PRIu64
+	       ", text %" PRIu64 ", raw %" PRIu64 ")\n", name,
+	       (now->datagrams - prev->datagrams) / seconds,
+	       (now->samples - prev->samples) / seconds,
+	       (now->bytes - prev->bytes) / seconds / 1e6, now->datagrams,
+	       now->nodes, now->formats[FORMAT_TS], now->formats[FORMAT_TEXT],
+	       now->formats[FORMAT_RAW]);
+	printf("%s: latency p50 <%" PRIu64 " p99 <%" PRIu64 " max <%" PRIu64
+	       " us, kernel drops %" PRIu64 ", seq lost %" PRIu64 " in %" PRIu64 " gaps, reordered %"
+	       PRIu64 ", time gaps %" PRIu64 ", bad %" PRIu64 ", truncated %"
+	       PRIu64 "\n", name,
+	       lat_percentile(now->lat, lat_total, 50),
+	       lat_percentile(now->lat, lat_total, 99),
+	       lat_max(now->lat), kernel_drops, now->seq_lost,
+	       now->seq_gaps, now->reordered, now->time_gaps, now->bad,
+	       now->truncated);
+	fflush(stdout);
+}
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	atomic_store(&stopping, true);
+}
+
+static int collect(int interval_s)
+{
+	struct stats prev = { 0 }, now;
+	uint64_t drops;
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	while (!atomic_load(&stopping)) {
+		sleep(interval_s);
+		stats_sum(&now, &drops);
+		report("ingest", &now, &prev, drops, interval_s);
+		prev = now;
+	}
+
+	collector_stop();
+	stats_sum(&now, &drops);
+	report("total", &now, &(struct stats){ 0 }, drops, 1);
+
+	return 0;
+}
+
+struct sender {
+	pthread_t thread;
+	int nodes;
+	uint64_t datagrams;
+	uint16_t port;
+	uint64_t sent;
+};
+
+/* Sends round robin from its nodes, a socket each, like sensortest text */
+static void *sender_thread(void *arg)
+{
+	struct sender *s = arg;
+	struct sockaddr_in6 dst = {
+		.sin6_family = AF_INET6,
+		.sin6_port = htons(s->port),
+		.sin6_addr = IN6ADDR_LOOPBACK_INIT,
+	};
+	struct mmsghdr msgs[BATCH_MSGS];
+	struct iovec iov[BATCH_MSGS];
+	char bufs[BATCH_MSGS][64];
+	uint32_t *seq = calloc(s->nodes, sizeof(*seq));
+	int *fds = calloc(s->nodes, sizeof(*fds));
+	int node = 0;
+
+	for (int i = 0; i < s->nodes; i++) {
+		fds[i] = socket(AF_INET6, SOCK_DGRAM, 0);
+	}
+
+	while (s->sent < s->datagrams) {
+		int n = 0;
+		int r;
+
+		/* One node per sendmmsg() call, its socket is its address */
+		while (n < BATCH_MSGS && s->sent + n < s->datagrams) {
+			uint32_t q = seq[node]++;
+
+			iov[n].iov_base = bufs[n];
+			iov[n].iov_len = snprintf(bufs[n], sizeof(bufs[n]),
+				"#%u;1l:%u.%02u;2h:%u.%02u;2t:%u.%02u;", q,
+				80 + q % 8, q % 100, 40 + q % 5, q % 97,
+				20 + q % 3, q % 89);
+			memset(&msgs[n], 0, sizeof(msgs[n]));
+			msgs[n].msg_hdr.msg_name = &dst;
+			msgs[n].msg_hdr.msg_namelen = sizeof(dst);
+			msgs[n].msg_hdr.msg_iov = &iov[n];
+			msgs[n].msg_hdr.msg_iovlen = 1;
+			n++;
+		}
+
+		r = sendmmsg(fds[node], msgs, n, 0);
+		if (r < 0) {
+			if (errno == ENOBUFS || errno == EAGAIN) {
+				r = 0;
+			} else {
+				perror("sendmmsg");
+				break;
+			}
+		}
+
+		/* Unsent ones are sent again with the same numbers */
+		seq[node] -= n - r;
+		s->sent += r;
+		node = (node + 1) % s->nodes;
+	}
+
+	for (int i = 0; i < s->nodes; i++) {
+		close(fds[i]);
+	}
+	free(fds);
+	free(seq);
+
+	return NULL;
+}
+
+static int bench(uint16_t port, uint64_t datagrams, int nodes)
+{
+	struct sender senders[BENCH_SENDERS];
+	struct stats prev = { 0 }, now;
+	uint64_t start, last_change, drops, sent = 0;
+	uint64_t seen = 0;
+	bool ok;
+
+	start = clock_ns(CLOCK_MONOTONIC);
+	for (int i = 0; i < BENCH_SENDERS; i++) {
+		senders[i] = (struct sender){
+			.nodes = (i + 1) * nodes / BENCH_SENDERS -
+				 i * nodes / BENCH_SENDERS,
+			.datagrams = (i + 1) * datagrams / BENCH_SENDERS -
+				     i * datagrams / BENCH_SENDERS,
+			.port = port,
+		};
+		pthread_create(&senders[i].thread, NULL, sender_thread,
+			       &senders[i]);
+	}
+
+	for (int i = 0; i < BENCH_SENDERS; i++) {
+		pthread_join(senders[i].thread, NULL);
+		sent += senders[i].sent;
+	}
+
+	/* Until the collector has seen nothing new for BENCH_IDLE_MS */
+	last_change = clock_ns(CLOCK_MONOTONIC);
+	while (clock_ns(CLOCK_MONOTONIC) - last_change <
+	       BENCH_IDLE_MS * 1000000ULL) {
+		usleep(10000);
+		stats_sum(&now, &drops);
+		if (now.datagrams != seen) {
+			seen = now.datagrams;
+			last_change = clock_ns(CLOCK_MONOTONIC);
+		}
+	}
+
+	collector_stop();
+	stats_sum(&now, &drops);
+	report("bench", &now, &prev, drops,
+	       (last_change - start) / 1e9);
+
+	/*
+	 * Every gap found must be a datagram lost. Losses at the end of a
+	 * node's stream leave no gap behind them.
+	 */
+	ok = now.datagrams > 0 && now.datagrams <= sent &&
+	     now.seq_lost <= sent - now.datagrams &&
+	     now.nodes == (uint32_t)nodes && now.bad == 0;
+	printf("bench: sent %" PRIu64 ", received %" PRIu64 ", lost %" PRIu64
+	       ", seq lost %" PRIu64 "\n", sent, now.datagrams,
+	       sent - now.datagrams, now.seq_lost);
+	printf("bench %s\n", ok ? "done" : "failed");
+
+	return ok ? 0 : 1;
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "usage: %s [bench] [-p port]... [-t decoders] "
+		"[-o dir] [-i seconds] [-n datagrams] [-N nodes]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+	uint16_t ports[MAX_PORTS];
+	int port_count = 0;
+	int interval_s = 1;
+	uint64_t datagrams = BENCH_DATAGRAMS;
+	int nodes = BENCH_NODES;
+	bool bench_mode = false;
+	int opt;
+
+	if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+		bench_mode = true;
+		argc--;
+		argv++;
+	}
+
+	while ((opt = getopt(argc, argv, "p:t:o:i:n:N:")) != -1) {
+		switch (opt) {
+		case 'p':
+			if (port_count == MAX_PORTS) {
+				usage(argv[0]);
+				return 2;
+			}
+			ports[port_count++] = atoi(optarg);
+			break;
+		case 't':
+			decoder_count = atoi(optarg);
+			break;
+		case 'o':
+			out_dir = optarg;
+			break;
+		case 'i':
+			interval_s = atoi(optarg);
+			break;
+		case 'n':
+			datagrams = strtoull(optarg, NULL, 10);
+			break;
+		case 'N':
+			nodes = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 2;
+		}
+	}
+
+	if (decoder_count < 1 || decoder_count > MAX_DECODERS ||
+	    interval_s < 1 || nodes < BENCH_SENDERS) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	if (port_count == 0) {
+		ports[port_count++] = DEFAULT_PORT;
+	}
+
+	if (collector_start(ports, port_count) < 0) {
+		return 1;
+	}
+
+	if (bench_mode) {
+		return bench(ports[0], datagrams, nodes);
+	}
+
+	return collect(interval_s);
+}
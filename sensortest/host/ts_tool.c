@@ -0,0 +1,380 @@
+/*
+ * Host side of the sensortest compressed telemetry, see src/ts_codec.h
+ *
+ *   ts_tool listen [port]   print datagrams received on UDP port (9999),
+ *                           compressed blocks decoded, one line per sample
+ *   ts_tool decode FILE     decode concatenated blocks from FILE
+ *   ts_tool bench FILE      compress a recorded trace and report the ratio
+ *                           and the encode and decode time per sample
+ *
+ * Samples are printed as the sample's text telemetry with the timestamp the
+ * flash backlog uses, "@<ms>;1l:84.32;2h:45.10;2t:23.50;", which is also
+ * the trace format bench reads. Lines without a timestamp are taken to be
+ * TRACE_INTERVAL_MS apart.
+ *
+ * Build: cc -O2 -Isrc -o ts_tool host/ts_tool.c src/ts_codec.c
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+
+#include "ts_codec.h"
+
+#define DEFAULT_PORT	  9999
+#define TRACE_INTERVAL_MS 5000
+#define TRACE_MAX_SAMPLES 100000
+#define BENCH_BLOCK_LEN	  80
+#define BENCH_ROUNDS	  20
+
+struct trace {
+	size_t samples;
+	uint8_t channels;
+	char names[TS_MAX_CHANNELS][3];
+	uint32_t *t;
+	int32_t *vals;		/* samples x channels */
+	size_t text_bytes;	/* as sent in text mode, timestamps excluded */
+};
+
+static void print_value(int32_t v)
+{
+	printf("%s%d.%02d;", v < 0 ? "-" : "", abs(v / 100), abs(v % 100));
+}
+
+static int decode_blocks(const uint8_t *buf, size_t len)
+{
+	struct ts_decoder dec;
+	int32_t vals[TS_MAX_CHANNELS];
+	uint32_t t;
+	int block_len;
+	int r;
+
+	while (len > 0) {
+		block_len = ts_decoder_init(&dec, buf, len);
+		if (block_len < 0) {
+			fprintf(stderr, "invalid block\n");
+			return -EINVAL;
+		}
+
+		while ((r = ts_decode(&dec, &t, vals)) > 0) {
+			printf("@%u;", t);
+			for (int i = 0; i < dec.channels; i++) {
+				printf("%.2s:", dec.names[i]);
+				print_value(vals[i]);
+			}
+			printf("\n");
+		}
+
+		if (r < 0) {
+			fprintf(stderr, "truncated block\n");
+			return r;
+		}
+
+		buf += block_len;
+		len -= block_len;
+	}
+
+	return 0;
+}
+
+static int listen_udp(int port)
+{
+	struct sockaddr_in6 addr = {
+		.sin6_family = AF_INET6,
+		.sin6_port = htons(port),
+		.sin6_addr = IN6ADDR_ANY_INIT,
+	};
+	uint8_t buf[2048];
+	ssize_t len;
+	int fd;
+
+	fd = socket(AF_INET6, SOCK_DGRAM, 0);
+	if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		perror("socket");
+		return 1;
+	}
+
+	for (;;) {
+		len = recv(fd, buf, sizeof(buf), 0);
+		if (len < 0) {
+			perror("recv");
+			return 1;
+		}
+
+		if (len > 0 && buf[0] == TS_MAGIC) {
+			decode_blocks(buf, len);
+		} else {
+			printf("%.*s\n", (int)len, buf);
+		}
+		fflush(stdout);
+	}
+}
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+	FILE *f = fopen(path, "rb");
+	uint8_t *buf = NULL;
+	size_t size = 0;
+	size_t n;
+
+	if (!f) {
+		perror(path);
+		return NULL;
+	}
+
+	*len = 0;
+	do {
+		if (*len == size) {
+			size = size ? 2 * size : 4096;
+			buf = realloc(buf, size + 1);
+			if (!buf) {
+				fclose(f);
+				return NULL;
+			}
+		}
+		n = fread(buf + *len, 1, size - *len, f);
+		*len += n;
+	} while (n > 0);
+
+	fclose(f);
+	buf[*len] = '\0';
+
+	return buf;
+}
+
+/* "84.32", "-5.20" or "12" to hundredths */
+static int32_t parse_value(const char *s)
+{
+	int neg = *s == '-';
+	char *end;
+	long whole = strtol(s + neg, &end, 10);
+	long frac = 0;
+
+	if (*end == '.') {
+		for (int i = 1; i <= 2; i++) {
+			frac *= 10;
+			if (end[i] >= '0' && end[i] <= '9') {
+				frac += end[i] - '0';
+			} else {
+				break;
+			}
+		}
+	}
+
+	return (neg ? -1 : 1) * (int32_t)(whole * 100 + frac);
+}
+
+static int parse_line(struct trace *tr, char *line, uint32_t *last_t)
+{
+	int32_t *vals = &tr->vals[tr->samples * TS_MAX_CHANNELS];
+	uint32_t t = *last_t + TRACE_INTERVAL_MS;
+	uint8_t ch = 0;
+	char *field;
+	char *save;
+
+	for (field = strtok_r(line, ";", &save); field;
+	     field = strtok_r(NULL, ";", &save)) {
+		if (field[0] == '@') {
+			t = strtoul(field + 1, NULL, 10);
+			continue;
+		}
+
+		if (strlen(field) < 4 || field[2] != ':') {
+			continue;
+		}
+
+		if (tr->samples == 0) {
+			memcpy(tr->names[ch], field, 2);
+		} else if (ch >= tr->channels ||
+			   memcmp(tr->names[ch], field, 2) != 0) {
+			/* Another channel set, not part of this series */
+			return 0;
+		}
+
+		tr->text_bytes += strlen(field) + 1;
+		vals[ch++] = parse_value(field + 3);
+		if (ch == TS_MAX_CHANNELS) {
+			break;
+		}
+	}
+
+	if (ch == 0 || (tr->samples > 0 && ch != tr->channels)) {
+		return 0;
+	}
+
+	tr->channels = ch;
+	tr->t[tr->samples++] = t;
+	*last_t = t;
+
+	return 1;
+}
+
+static int load_trace(const char *path, struct trace *tr)
+{
+	uint32_t last_t = 0;
+	size_t len;
+	char *text = (char *)read_file(path, &len);
+	char *line;
+	char *save;
+
+	if (!text) {
+		return -ENOENT;
+	}
+
+	memset(tr, 0, sizeof(*tr));
+	tr->t = calloc(TRACE_MAX_SAMPLES, sizeof(*tr->t));
+	tr->vals = calloc(TRACE_MAX_SAMPLES * TS_MAX_CHANNELS,
+			  sizeof(*tr->vals));
+	if (!tr->t || !tr->vals) {
+		return -ENOMEM;
+	}
+
+	for (line = strtok_r(text, "\n", &save);
+	     line && tr->samples < TRACE_MAX_SAMPLES;
+	     line = strtok_r(NULL, "\n", &save)) {
+		parse_line(tr, line, &last_t);
+	}
+
+	free(text);
+
+	return tr->samples > 0 ? 0 : -ENODATA;
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Compress the whole trace into out, returns the bytes used */
+static size_t compress_trace(const struct trace *tr, uint8_t *out,
+			     size_t *blocks)
+{
+	const char *names[TS_MAX_CHANNELS];
+	uint8_t block[BENCH_BLOCK_LEN];
+	struct ts_encoder enc;
+	size_t used = 0;
+	size_t len;
+
+	for (int i = 0; i < tr->channels; i++) {
+		names[i] = tr->names[i];
+	}
+
+	ts_encoder_init(&enc, block, sizeof(block), names, tr->channels);
+	*blocks = 0;
+
+	for (size_t i = 0; i <= tr->samples; i++) {
+		const int32_t *vals = &tr->vals[i * TS_MAX_CHANNELS];
+
+		if (i < tr->samples &&
+		    ts_encode(&enc, tr->t[i], vals) != -ENOSPC) {
+			continue;
+		}
+
+		len = ts_encoder_finish(&enc);
+		memcpy(out + used, block, len);
+		used += len;
+		(*blocks)++;
+		ts_encoder_reset(&enc);
+
+		if (i < tr->samples) {
+			ts_encode(&enc, tr->t[i], vals);
+		}
+	}
+
+	return used;
+}
+
+static int bench(const char *path)
+{
+	struct trace tr;
+	struct ts_decoder dec;
+	int32_t vals[TS_MAX_CHANNELS];
+	uint8_t *out;
+	size_t used = 0;
+	size_t blocks;
+	size_t n = 0;
+	double start, enc_ns, dec_ns;
+	uint32_t t;
+	int r;
+
+	r = load_trace(path, &tr);
+	if (r < 0) {
+		fprintf(stderr, "%s: no samples\n", path);
+		return 1;
+	}
+
+	out = malloc(tr.samples * (TS_HDR_LEN(TS_MAX_CHANNELS) + 40));
+	if (!out) {
+		return 1;
+	}
+
+	start = now_ns();
+	for (int i = 0; i < BENCH_ROUNDS; i++) {
+		used = compress_trace(&tr, out, &blocks);
+	}
+	enc_ns = (now_ns() - start) / BENCH_ROUNDS / tr.samples;
+
+	/* Decode and check the round trip */
+	start = now_ns();
+	for (size_t off = 0; off < used; off += r) {
+		r = ts_decoder_init(&dec, out + off, used - off);
+		if (r < 0) {
+			break;
+		}
+		while (ts_decode(&dec, &t, vals) > 0) {
+			if (t != tr.t[n] ||
+			    memcmp(vals, &tr.vals[n * TS_MAX_CHANNELS],
+				   tr.channels * sizeof(vals[0])) != 0) {
+				fprintf(stderr, "mismatch at sample %zu\n", n);
+				return 1;
+			}
+			n++;
+		}
+	}
+	dec_ns = (now_ns() - start) / tr.samples;
+
+	printf("%zu samples x %u channels in %zu blocks of up to %u B\n",
+	       tr.samples, tr.channels, blocks, BENCH_BLOCK_LEN);
+	printf("text %zu B, compressed %zu B: ratio %.2f, %.2f bits/value\n",
+	       tr.text_bytes, used, (double)tr.text_bytes / used,
+	       used * 8.0 / (tr.samples * tr.channels));
+	printf("encode %.1f ns/sample, decode %.1f ns/sample, round trip %s\n",
+	       enc_ns, dec_ns, n == tr.samples ? "ok" : "short");
+
+	return n == tr.samples ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+	uint8_t *buf;
+	size_t len;
+
+	if (argc >= 2 && strcmp(argv[1], "listen") == 0) {
+		return listen_udp(argc > 2 ? atoi(argv[2]) : DEFAULT_PORT);
+	}
+
+	if (argc == 3 && strcmp(argv[1], "decode") == 0) {
+		buf = read_file(argv[2], &len);
+		return buf && decode_blocks(buf, len) == 0 ? 0 : 1;
+	}
+
+	if (argc == 3 && strcmp(argv[1], "bench") == 0) {
+		return bench(argv[2]);
+	}
+
+	fprintf(stderr, "usage: %s listen [port] | decode FILE | bench FILE\n",
+		argv[0]);
+
+	return 2;
+}
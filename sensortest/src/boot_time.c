@@ -0,0 +1,51 @@
+/*
+ * Boot phase timestamps, see boot_time.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+
+#include "boot_time.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(boot_time, LOG_LEVEL_INF);
+
+static const char *const phase_names[BOOT_PHASES] = {
+	[BOOT_MAIN] = "main",
+	[BOOT_NET] = "net",
+	[BOOT_SENSORS] = "sensors",
+	[BOOT_FIRST_SAMPLE] = "first sample",
+	[BOOT_FIRST_DATAGRAM] = "first datagram",
+	[BOOT_SERVICES] = "services",
+};
+
+static uint32_t stamps_us[BOOT_PHASES];
+static ATOMIC_DEFINE(reached, BOOT_PHASES);
+
+void boot_time_mark(enum boot_phase phase)
+{
+	uint32_t us = k_ticks_to_us_floor32(k_uptime_ticks());
+
+	if (!atomic_test_and_set_bit(reached, phase)) {
+		stamps_us[phase] = us;
+	}
+}
+
+bool boot_time_reached(enum boot_phase phase)
+{
+	return atomic_test_bit(reached, phase);
+}
+
+void boot_time_report(void)
+{
+	for (int i = 0; i < BOOT_PHASES; i++) {
+		if (!atomic_test_bit(reached, i)) {
+			continue;
+		}
+
+		LOG_INF("boot: %-14s at %u.%03u ms", phase_names[i],
+			stamps_us[i] / 1000U, stamps_us[i] % 1000U);
+	}
+}
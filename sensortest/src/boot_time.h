@@ -0,0 +1,32 @@
+/*
+ * Boot phase timestamps, from kernel start to the first datagram.
+ *
+ * Each phase is stamped the first time it is reached. Time before the
+ * kernel starts (ROM boot code, clock setup) is not included.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef BOOT_TIME_H_
+#define BOOT_TIME_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum boot_phase {
+	BOOT_MAIN,		/* drivers, network stack and services initialized */
+	BOOT_NET,		/* radio configured, telemetry socket open */
+	BOOT_SENSORS,		/* sensors opened */
+	BOOT_FIRST_SAMPLE,	/* first readings fetched */
+	BOOT_FIRST_DATAGRAM,	/* first datagram handed to the network */
+	BOOT_SERVICES,		/* deferred services started */
+	BOOT_PHASES,
+};
+
+void boot_time_mark(enum boot_phase phase);
+bool boot_time_reached(enum boot_phase phase);
+
+/* Log every phase reached, in milliseconds since kernel start */
+void boot_time_report(void);
+
+#endif /* BOOT_TIME_H_ */
@@ -0,0 +1,571 @@
+/*
+ * CoAP resource server with Observe, see coap_server.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/net/coap.h>
+#include <zephyr/net/coap_link_format.h>
+#include <zephyr/net/hostname.h>
+#include <zephyr/net/socket.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "coap_server.h"
+#include "senml_cbor.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(coap_server, LOG_LEVEL_INF);
+
+#define COAP_PORT 5683
+#define MAX_COAP_MSG_LEN 128
+#define NUM_OPTIONS 8
+#define NUM_OBSERVERS 4
+#define NUM_PENDINGS 4
+#define COAP_MAX_RETRANSMIT 4
+
+/* Every COAP_CON_EVERY-th notification is confirmable */
+#define COAP_CON_EVERY 10
+
+#define MAX_RECORDS 2
+
+#define THREAD_STACK_SIZE 2048
+#define THREAD_PRIORITY 7
+
+struct res_record {
+	const char *name;
+	const char *unit;
+};
+
+struct res_state {
+	/* Must stay first: the link-format code reads it from user_data */
+	struct coap_core_metadata meta;
+	const struct res_record *records;
+	size_t num_records;
+	struct sensor_value vals[MAX_RECORDS];
+	bool valid;
+	bool confirmable;
+	uint32_t rounds;
+};
+
+static const char * const observable_attrs[] = { "obs", "ct=112", NULL };
+
+static const struct res_record light_records[] = {
+	{ "light", "lx" },
+};
+
+static const struct res_record climate_records[] = {
+	{ "humidity", "%RH" },
+	{ "temp", "Cel" },
+};
+
+static struct res_state states[COAP_RES_COUNT] = {
+	[COAP_RES_LIGHT] = {
+		.meta.attributes = observable_attrs,
+		.records = light_records,
+		.num_records = ARRAY_SIZE(light_records),
+	},
+	[COAP_RES_CLIMATE] = {
+		.meta.attributes = observable_attrs,
+		.records = climate_records,
+		.num_records = ARRAY_SIZE(climate_records),
+	},
+};
+
+static const char * const light_path[] = { "sensors", "light", NULL };
+static const char * const climate_path[] = { "sensors", "climate", NULL };
+
+static int sensor_get(struct coap_resource *resource,
+		      struct coap_packet *request,
+		      struct sockaddr *addr, socklen_t addr_len);
+static void sensor_notify(struct coap_resource *resource,
+			  struct coap_observer *observer);
+static int well_known_core_get(struct coap_resource *resource,
+			       struct coap_packet *request,
+			       struct sockaddr *addr, socklen_t addr_len);
+
+/* Sensor resources are indexed by enum coap_sensor_res */
+static struct coap_resource resources[] = {
+	[COAP_RES_LIGHT] = {
+		.get = sensor_get,
+		.notify = sensor_notify,
+		.path = light_path,
+		.user_data = &states[COAP_RES_LIGHT].meta,
+	},
+	[COAP_RES_CLIMATE] = {
+		.get = sensor_get,
+		.notify = sensor_notify,
+		.path = climate_path,
+		.user_data = &states[COAP_RES_CLIMATE].meta,
+	},
+	{
+		.get = well_known_core_get,
+		.path = COAP_WELL_KNOWN_CORE_PATH,
+	},
+	{ },
+};
+
+static struct coap_observer observers[NUM_OBSERVERS];
+static struct coap_pending pendings[NUM_PENDINGS];
+static uint8_t pending_bufs[NUM_PENDINGS][MAX_COAP_MSG_LEN];
+
+static char base_name[32];
+static int sock = -1;
+
+K_MUTEX_DEFINE(coap_lock);
+
+static void retransmit_handler(struct k_work *work);
+K_WORK_DELAYABLE_DEFINE(retransmit_work, retransmit_handler);
+
+K_THREAD_STACK_DEFINE(coap_stack, THREAD_STACK_SIZE);
+static struct k_thread coap_thread_data;
+
+static struct {
+	uint32_t non;
+	uint32_t con;
+	uint32_t retransmits;
+	uint32_t dropped;	/* readings that did not fit a message */
+	uint32_t datagrams;
+	uint32_t bytes;
+} stats;
+
+static int send_packet(const uint8_t *data, size_t len,
+		       const struct sockaddr *addr)
+{
+	if (sendto(sock, data, len, 0, addr, sizeof(struct sockaddr_in6)) < 0) {
+		return -errno;
+	}
+
+	stats.datagrams++;
+	stats.bytes += len;
+
+	return 0;
+}
+
+static bool sockaddr_equal(const struct sockaddr *a, const struct sockaddr *b)
+{
+	const struct sockaddr_in6 *a6 = (const struct sockaddr_in6 *)a;
+	const struct sockaddr_in6 *b6 = (const struct sockaddr_in6 *)b;
+
+	return a->sa_family == b->sa_family && a6->sin6_port == b6->sin6_port &&
+	       net_ipv6_addr_cmp(&a6->sin6_addr, &b6->sin6_addr);
+}
+
+static struct coap_observer *find_observer(struct coap_resource *resource,
+					   const struct sockaddr *addr)
+{
+	struct coap_observer *observer;
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&resource->observers, observer, list) {
+		if (sockaddr_equal(&observer->addr, addr)) {
+			return observer;
+		}
+	}
+
+	return NULL;
+}
+
+static void remove_observer(struct coap_resource *resource,
+			    struct coap_observer *observer)
+{
+	coap_remove_observer(resource, observer);
+	/* An observer slot with no address family is free */
+	memset(observer, 0, sizeof(*observer));
+}
+
+/* The collector went away: stop notifying it about anything */
+static void drop_observer(const struct sockaddr *addr)
+{
+	struct coap_observer *observer;
+
+	for (size_t i = 0; i < COAP_RES_COUNT; i++) {
+		observer = find_observer(&resources[i], addr);
+		if (observer != NULL) {
+			remove_observer(&resources[i], observer);
+			LOG_INF("observer dropped from %s", resources[i].path[1]);
+		}
+	}
+}
+
+static int build_reading(struct coap_packet *pkt, uint8_t *buf,
+			 struct coap_resource *resource, uint8_t type,
+			 const uint8_t *token, uint8_t tkl, uint16_t id,
+			 bool observe)
+{
+	struct res_state *state = CONTAINER_OF(resource->user_data,
+					       struct res_state, meta);
+	uint8_t payload[MAX_COAP_MSG_LEN];
+	struct senml_writer w;
+	size_t num = state->valid ? state->num_records : 0;
+	int r;
+
+	r = coap_packet_init(pkt, buf, MAX_COAP_MSG_LEN, COAP_VERSION_1, type,
+			     tkl, token, COAP_RESPONSE_CODE_CONTENT, id);
+	if (r < 0) {
+		return r;
+	}
+
+	if (observe) {
+		r = coap_append_option_int(pkt, COAP_OPTION_OBSERVE,
+					   resource->age);
+		if (r < 0) {
+			return r;
+		}
+	}
+
+	r = coap_append_option_int(pkt, COAP_OPTION_CONTENT_FORMAT,
+				   SENML_CBOR_CONTENT_FORMAT);
+	if (r < 0) {
+		return r;
+	}
+
+	/* Whatever the header and options left, less the payload marker */
+	senml_begin(&w, payload, MAX_COAP_MSG_LEN - pkt->offset - 1, num);
+	for (size_t i = 0; i < num; i++) {
+		senml_record(&w, i == 0 ? base_name : NULL,
+			     state->records[i].name, state->records[i].unit,
+			     state->vals[i].val1, state->vals[i].val2);
+	}
+
+	r = senml_end(&w);
+	if (r < 0) {
+		/* A long hostname in the base name, say */
+		stats.dropped++;
+		LOG_WRN("%s reading does not fit in %d B", resource->path[1],
+			MAX_COAP_MSG_LEN);
+		return -EMSGSIZE;
+	}
+
+	r = coap_packet_append_payload_marker(pkt);
+	if (r < 0) {
+		return r;
+	}
+
+	return coap_packet_append_payload(pkt, payload, r);
+}
+
+static int sensor_get(struct coap_resource *resource,
+		      struct coap_packet *request,
+		      struct sockaddr *addr, socklen_t addr_len)
+{
+	uint8_t token[COAP_TOKEN_MAX_LEN];
+	uint8_t buf[MAX_COAP_MSG_LEN];
+	struct coap_observer *observer;
+	struct coap_packet response;
+	bool observing = false;
+	uint16_t id;
+	uint8_t type;
+	uint8_t tkl;
+	int observe;
+	int r;
+
+	observe = coap_get_option_int(request, COAP_OPTION_OBSERVE);
+	type = coap_header_get_type(request);
+	id = coap_header_get_id(request);
+	tkl = coap_header_get_token(request, token);
+
+	k_mutex_lock(&coap_lock, K_FOREVER);
+
+	observer = find_observer(resource, addr);
+
+	if (observe == 0) {
+		/* A re-registration replaces the token of the old one */
+		if (observer != NULL) {
+			remove_observer(resource, observer);
+		}
+
+		observer = coap_observer_next_unused(observers, NUM_OBSERVERS);
+		if (observer != NULL) {
+			coap_observer_init(observer, request, addr);
+			coap_register_observer(resource, observer);
+			observing = true;
+			LOG_INF("observer added to %s", resource->path[1]);
+		} else {
+			LOG_WRN("no room for another observer");
+		}
+	} else if (observe == 1 && observer != NULL) {
+		remove_observer(resource, observer);
+	}
+
+	if (type == COAP_TYPE_CON) {
+		type = COAP_TYPE_ACK;
+	} else {
+		type = COAP_TYPE_NON_CON;
+		id = coap_next_id();
+	}
+
+	r = build_reading(&response, buf, resource, type, token, tkl, id,
+			  observing);
+	if (r == 0) {
+		r = send_packet(response.data, response.offset, addr);
+	}
+
+	k_mutex_unlock(&coap_lock);
+
+	return r;
+}
+
+static int notify_confirmable(struct coap_resource *resource,
+			      struct coap_observer *observer)
+{
+	struct coap_pending *pending;
+	struct coap_packet pkt;
+	uint8_t *buf;
+	int r;
+
+	pending = coap_pending_next_unused(pendings, NUM_PENDINGS);
+	if (pending == NULL) {
+		return -ENOMEM;
+	}
+
+	buf = pending_bufs[pending - pendings];
+	r = build_reading(&pkt, buf, resource, COAP_TYPE_CON, observer->token,
+			  observer->tkl, coap_next_id(), true);
+	if (r < 0) {
+		return r;
+	}
+
+	r = coap_pending_init(pending, &pkt, &observer->addr,
+			      COAP_MAX_RETRANSMIT);
+	if (r < 0) {
+		return r;
+	}
+
+	coap_pending_cycle(pending);
+
+	r = send_packet(pkt.data, pkt.offset, &observer->addr);
+	if (r < 0) {
+		coap_pending_clear(pending);
+		return r;
+	}
+
+	pending = coap_pending_next_to_expire(pendings, NUM_PENDINGS);
+	if (pending != NULL) {
+		k_work_reschedule(&retransmit_work, K_MSEC(pending->timeout));
+	}
+
+	stats.con++;
+
+	return 0;
+}
+
+/* Called by coap_resource_notify() for every observer of the resource */
+static void sensor_notify(struct coap_resource *resource,
+			  struct coap_observer *observer)
+{
+	struct res_state *state = CONTAINER_OF(resource->user_data,
+					       struct res_state, meta);
+	uint8_t buf[MAX_COAP_MSG_LEN];
+	struct coap_packet pkt;
+	int r;
+
+	/*
+	 * Fall back to a non-confirmable one if no pending slot is left, not
+	 * if the reading is too big for any message.
+	 */
+	if (state->confirmable) {
+		r = notify_confirmable(resource, observer);
+		if (r == 0 || r == -EMSGSIZE) {
+			return;
+		}
+	}
+
+	if (build_reading(&pkt, buf, resource, COAP_TYPE_NON_CON,
+			  observer->token, observer->tkl, coap_next_id(),
+			  true) == 0 &&
+	    send_packet(pkt.data, pkt.offset, &observer->addr) == 0) {
+		stats.non++;
+	}
+}
+
+static int well_known_core_get(struct coap_resource *resource,
+			       struct coap_packet *request,
+			       struct sockaddr *addr, socklen_t addr_len)
+{
+	uint8_t buf[MAX_COAP_MSG_LEN];
+	struct coap_packet response;
+	int r;
+
+	r = coap_well_known_core_get(resource, request, &response, buf,
+				     sizeof(buf));
+	if (r < 0) {
+		return r;
+	}
+
+	return send_packet(response.data, response.offset, addr);
+}
+
+static void retransmit_handler(struct k_work *work)
+{
+	struct coap_pending *pending;
+
+	k_mutex_lock(&coap_lock, K_FOREVER);
+
+	pending = coap_pending_next_to_expire(pendings, NUM_PENDINGS);
+	if (pending != NULL) {
+		if (coap_pending_cycle(pending)) {
+			send_packet(pending->data, pending->len, &pending->addr);
+			stats.retransmits++;
+		} else {
+			/* No ACK after all retries: the collector is gone */
+			drop_observer(&pending->addr);
+			coap_pending_clear(pending);
+		}
+	}
+
+	pending = coap_pending_next_to_expire(pendings, NUM_PENDINGS);
+	if (pending != NULL) {
+		k_work_reschedule(&retransmit_work, K_MSEC(pending->timeout));
+	}
+
+	k_mutex_unlock(&coap_lock);
+}
+
+static void handle_reply(struct coap_packet *pkt, struct sockaddr *addr,
+			 bool reset)
+{
+	struct coap_pending *pending;
+
+	k_mutex_lock(&coap_lock, K_FOREVER);
+
+	pending = coap_pending_received(pkt, pendings, NUM_PENDINGS);
+	if (pending != NULL) {
+		coap_pending_clear(pending);
+	}
+
+	/* RST to a notification cancels the observation (RFC 7641 3.6) */
+	if (reset) {
+		drop_observer(addr);
+	}
+
+	k_mutex_unlock(&coap_lock);
+}
+
+static void coap_server_thread(void *arg1, void *arg2, void *arg3)
+{
+	struct coap_option options[NUM_OPTIONS];
+	uint8_t buf[MAX_COAP_MSG_LEN];
+	struct sockaddr_in6 client_addr;
+	socklen_t client_addr_len;
+	struct coap_packet pkt;
+	ssize_t received;
+	uint8_t type;
+
+	while (1) {
+		client_addr_len = sizeof(client_addr);
+		received = recvfrom(sock, buf, sizeof(buf), 0,
+				    (struct sockaddr *)&client_addr,
+				    &client_addr_len);
+		if (received < 0) {
+			LOG_ERR("recvfrom failed: %d", errno);
+			k_sleep(K_SECONDS(1));
+			continue;
+		}
+
+		if (coap_packet_parse(&pkt, buf, received, options,
+				      NUM_OPTIONS) < 0) {
+			continue;
+		}
+
+		type = coap_header_get_type(&pkt);
+		if (type == COAP_TYPE_ACK || type == COAP_TYPE_RESET) {
+			handle_reply(&pkt, (struct sockaddr *)&client_addr,
+				     type == COAP_TYPE_RESET);
+			continue;
+		}
+
+		coap_handle_request(&pkt, resources, options, NUM_OPTIONS,
+				    (struct sockaddr *)&client_addr,
+				    client_addr_len);
+	}
+}
+
+int coap_server_init(void)
+{
+	struct sockaddr_in6 addr;
+
+	snprintf(base_name, sizeof(base_name), "%s/",
+		 IS_ENABLED(CONFIG_NET_HOSTNAME_ENABLE) ?
+		 net_hostname_get() : "sensortest");
+
+	sock = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock < 0) {
+		LOG_ERR("failed to open CoAP socket: %d", errno);
+		return -errno;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin6_family = AF_INET6;
+	addr.sin6_port = htons(COAP_PORT);
+	addr.sin6_addr = in6addr_any;
+
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		LOG_ERR("failed to bind CoAP socket: %d", errno);
+		close(sock);
+		sock = -1;
+		return -errno;
+	}
+
+	k_thread_create(&coap_thread_data, coap_stack, THREAD_STACK_SIZE,
+			coap_server_thread, NULL, NULL, NULL,
+			THREAD_PRIORITY, 0, K_NO_WAIT);
+	k_thread_name_set(&coap_thread_data, "coap_server");
+
+	LOG_INF("CoAP server listening on port %d", COAP_PORT);
+
+	return 0;
+}
+
+int coap_server_publish(enum coap_sensor_res res,
+			const struct sensor_value *vals)
+{
+	struct res_state *state = &states[res];
+	uint32_t sent;
+
+	if (sock < 0) {
+		return 0;
+	}
+
+	k_mutex_lock(&coap_lock, K_FOREVER);
+
+	memcpy(state->vals, vals, state->num_records * sizeof(*vals));
+	state->valid = true;
+	state->confirmable = (state->rounds++ % COAP_CON_EVERY) == 0;
+
+	sent = stats.non + stats.con;
+	coap_resource_notify(&resources[res]);
+	sent = stats.non + stats.con - sent;
+
+	k_mutex_unlock(&coap_lock);
+
+	return sent;
+}
+
+void coap_server_report(uint32_t interval_ms)
+{
+	uint32_t rate;
+	size_t active = 0;
+
+	/* Not in the middle of a publish, which counts what it sent */
+	k_mutex_lock(&coap_lock, K_FOREVER);
+
+	rate = (uint64_t)(stats.non + stats.con) * 1000000U / interval_ms;
+
+	for (size_t i = 0; i < NUM_OBSERVERS; i++) {
+		if (observers[i].addr.sa_family != 0) {
+			active++;
+		}
+	}
+
+	LOG_INF("coap: %zu observers, %u.%03u notifications/s "
+		"(%u NON, %u CON, %u retx, %u too big), %u datagrams, %u bytes",
+		active, rate / 1000U, rate % 1000U,
+		stats.non, stats.con, stats.retransmits, stats.dropped,
+		stats.datagrams, stats.bytes);
+
+	memset(&stats, 0, sizeof(stats));
+
+	k_mutex_unlock(&coap_lock);
+}
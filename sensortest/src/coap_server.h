@@ -0,0 +1,35 @@
+/*
+ * CoAP resource server exposing the sensor readings with Observe (RFC 7641).
+ *
+ * Only collectors that registered as observers receive notifications.
+ * Notifications are non-confirmable, with every COAP_CON_EVERY-th one
+ * confirmable so that observers which went away are dropped.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef COAP_SERVER_H_
+#define COAP_SERVER_H_
+
+#include <zephyr/drivers/sensor.h>
+
+enum coap_sensor_res {
+	COAP_RES_LIGHT,		/* light */
+	COAP_RES_CLIMATE,	/* humidity, temperature */
+	COAP_RES_COUNT,
+};
+
+int coap_server_init(void);
+
+/*
+ * Publish a new reading of a resource and notify its observers. vals holds
+ * one value per record of the resource, in the order listed above. Returns
+ * the number of notifications sent.
+ */
+int coap_server_publish(enum coap_sensor_res res,
+			const struct sensor_value *vals);
+
+/* Log notifications/s and bytes sent since the previous report */
+void coap_server_report(uint32_t interval_ms);
+
+#endif /* COAP_SERVER_H_ */
@@ -18,16 +18,38 @@
 #include <zephyr/net/net_ip.h>
 #include <zephyr/net/socket.h>
 #include <zephyr/sys/util.h>
-#include <zephyr/random/rand32.h>
+#include <zephyr/random/random.h>
 #include <zephyr/devicetree.h>
 #include <zephyr/devicetree/io-channels.h>
 #include <errno.h>
 #include <zephyr/linker/sections.h>
 #include <zephyr/net/net_core.h>
 #include <zephyr/net/net_mgmt.h>
+#include <zephyr/net/net_config.h>
+#include <zephyr/net/net_context.h>
+#include <zephyr/sys/atomic.h>
 
 #include <math.h>
 
+#include "boot_time.h"
+#include "coap_server.h"
+#include "net_cache.h"
+#include "power.h"
+#include "telemetry_pkt.h"
+#include "telemetry_store.h"
+#include "ts_codec.h"
+
+#ifdef CONFIG_EMUL
+#include "power_check.h"
+#include "coap_check.h"
+#include "send_bench.h"
+#include "sensor_bench.h"
+#include "store_check.h"
+#else
+#define sensor_bench_sample_begin()
+#define sensor_bench_sample_end()
+#endif
+
 #define LOG_LEVEL LOG_LEVEL_INF
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(sensortest);
@@ -77,6 +99,14 @@ static const enum api apis[NUM_DEVICES] = {
 
 static struct device *devices[NUM_DEVICES];
 
+/* Bus of the sensors, resumed only around each fetch */
+#if DT_HAS_COMPAT_STATUS_OKAY(ti_opt3001)
+#define SENSOR_BUS_NODE DT_BUS(DT_COMPAT_GET_ANY_STATUS_OKAY(ti_opt3001))
+#define SENSOR_BUS DEVICE_DT_GET(SENSOR_BUS_NODE)
+#else
+#define SENSOR_BUS NULL
+#endif
+
 static struct led_work led_work;
 K_WORK_DEFINE(sensor_work, sensor_work_handler);
 static struct gpio_callback button_callback_data;
@@ -84,6 +114,140 @@ static const struct gpio_dt_spec button = GPIO_DT_SPEC_GET(DT_ALIAS(sw0), gpios)
 
 static struct sockaddr_in6 addr;
 static int fd = -1;
+static struct net_context *ctx;
+static struct telemetry_pkt_ep pkt_ep;
+static struct net_if *iface;
+
+/* Batches sent from the flash backlog per sampling round */
+#define STORE_DRAIN_BATCHES 4
+
+/*
+ * Telemetry transport, can be set from the build with -DTELEMETRY_MODE=...:
+ *  - TELEMETRY_MCAST: text datagrams to ff02::1 port 9999, every node in
+ *    the PAN receives them. Readings that cannot be sent are kept in the
+ *    flash store.
+ *  - TELEMETRY_COAP: CoAP resources with Observe, only subscribed
+ *    collectors receive SenML/CBOR notifications. Nothing is stored: an
+ *    observer only wants the latest reading.
+ *  - TELEMETRY_MCAST_TS: as TELEMETRY_MCAST, with the samples batched into
+ *    compressed time series blocks (ts_codec.h), decoded by host/ts_tool.
+ */
+#define TELEMETRY_MCAST 0
+#define TELEMETRY_COAP 1
+#define TELEMETRY_MCAST_TS 2
+#ifndef TELEMETRY_MODE
+#define TELEMETRY_MODE TELEMETRY_MCAST
+#endif
+
+/*
+ * How text datagrams leave, can be set from the build with
+ * -DTELEMETRY_PATH=...:
+ *  - TELEMETRY_PATH_SOCKET: sendto() of outstr.
+ *  - TELEMETRY_PATH_CONTEXT: net_context_sendto() of outstr, without the
+ *    socket layer.
+ *  - TELEMETRY_PATH_PKT: the readings are written straight into the
+ *    outgoing net_pkt (telemetry_pkt.h), outstr is not used.
+ * Stored records and compressed blocks take the same path from their
+ * buffers.
+ */
+#define TELEMETRY_PATH_SOCKET 0
+#define TELEMETRY_PATH_CONTEXT 1
+#define TELEMETRY_PATH_PKT 2
+#ifndef TELEMETRY_PATH
+#define TELEMETRY_PATH TELEMETRY_PATH_SOCKET
+#endif
+
+#define TELEMETRY_PORT 9999
+#define TELEMETRY_SRC_PORT 9998
+#define TELEMETRY_TX_TIMEOUT_MS 100
+
+/* Payload allocated up front for one text datagram */
+#define TEXT_DATAGRAM_MAX 64
+
+#if TELEMETRY_PATH == TELEMETRY_PATH_PKT
+static struct net_pkt *tx_pkt;	/* text datagram being written */
+#endif
+
+/* With the emulated sensors on native_sim the collector is local */
+#ifdef CONFIG_EMUL
+#define TELEMETRY_DEST "::1"
+#else
+#define TELEMETRY_DEST "ff02::1"
+#endif
+
+/* Compressed blocks: size, and samples after which a block is sent */
+#define TS_BLOCK_LEN 80
+#define TS_BATCH_SAMPLES 12
+
+/* Set TELEMETRY_REPORT_S to 0 to disable the transport statistics */
+#define TELEMETRY_REPORT_S 60
+
+static struct {
+	uint32_t datagrams;
+	uint32_t bytes;
+} mcast_stats;
+
+enum ts_channel {
+	TS_LIGHT,
+	TS_HUMIDITY,
+	TS_TEMP,
+	TS_CHANNELS,
+};
+
+static int32_t ts_vals[TS_CHANNELS];
+
+#if TELEMETRY_MODE == TELEMETRY_MCAST_TS
+/* Named as in the text datagrams, "<device index><channel letter>" */
+static const char *const ts_names[TS_CHANNELS] = {
+	[TS_LIGHT] = "1l",
+	[TS_HUMIDITY] = "2h",
+	[TS_TEMP] = "2t",
+};
+
+static uint8_t ts_block[TS_BLOCK_LEN];
+static struct ts_encoder ts_enc;
+
+static struct {
+	uint32_t samples;
+	uint32_t text_bytes;	/* what the text datagrams would have taken */
+	uint32_t blocks;
+	uint32_t bytes;
+	uint64_t encode_cycles;
+} ts_stats;
+#endif
+
+/*
+ * Fast start, with CONFIG_NET_CONFIG_AUTO_INIT=n (fast_start.conf): the
+ * sensors open in parallel while the radio is set up from net_cache.h,
+ * the first sample goes out without waiting for the timer, and net_config
+ * only runs after it, unless the cache made it unnecessary.
+ */
+#ifdef CONFIG_NET_CONFIG_AUTO_INIT
+#define FAST_START 0
+#else
+#define FAST_START 1
+#endif
+
+#define SENSOR_OPEN_STACK_SIZE 1024
+#define SENSOR_OPEN_PRIO K_PRIO_COOP(8)
+#define SENSOR_OPEN_TIMEOUT_MS 1000
+#define FIRST_DATAGRAM_TIMEOUT_MS 2000
+
+#if FAST_START
+static K_THREAD_STACK_ARRAY_DEFINE(sensor_open_stack, NUM_DEVICES,
+				   SENSOR_OPEN_STACK_SIZE);
+static struct k_thread sensor_open_thread[NUM_DEVICES];
+static K_SEM_DEFINE(first_datagram, 0, 1);
+#endif
+
+/*
+ * Sensors opened, devices[i] of a sensor is only used once its bit is set:
+ * with a fast start a slow sensor may still be opening after main moved on
+ */
+static ATOMIC_DEFINE(opened, NUM_DEVICES);
+
+/* Sensors whose first reading was taken while opening them */
+static ATOMIC_DEFINE(prefetched, NUM_DEVICES);
 
 /* Set TIMED_SENSOR_READ to 0 to disable */
 #define TIMED_SENSOR_READ 6
@@ -164,32 +328,307 @@ static void led_work_handler(struct k_work *work)
 static void print_sensor_value(size_t idx, const char *chan,
 			       struct sensor_value *val)
 {
+	char field[TELEMETRY_PKT_FIELD_MAX];
+	size_t len;
+
 	LOG_INF("%s: %s%d,%d", device_labels[idx], chan, val->val1, val->val2);
 
-	sprintf(outstr+strlen(outstr), "%d%c:", idx, chan[0]);
-	sprintf(outstr+strlen(outstr), "%d", val->val1);
 	if (val->val2 != 0) {
-		sprintf(outstr+strlen(outstr), ".%02d;", abs(val->val2) / 10000);
+		snprintf(field, sizeof(field), "%d%c:%d.%02d;", (int)idx, chan[0],
+			 val->val1, abs(val->val2) / 10000);
 	} else {
-		sprintf(outstr+strlen(outstr), ";");
+		snprintf(field, sizeof(field), "%d%c:%d;", (int)idx, chan[0],
+			 val->val1);
+	}
+
+#if TELEMETRY_MODE == TELEMETRY_MCAST && TELEMETRY_PATH == TELEMETRY_PATH_PKT
+	/* Behind a backlog the sample is stored, as text */
+	if (tx_pkt == NULL && outstr[0] == '\0' &&
+	    !telemetry_store_pending() && net_if_is_up(iface)) {
+		tx_pkt = telemetry_pkt_begin(&pkt_ep, TEXT_DATAGRAM_MAX,
+					     K_MSEC(TELEMETRY_TX_TIMEOUT_MS));
+	}
+
+	if (tx_pkt != NULL) {
+		if (telemetry_pkt_write(tx_pkt, field, strlen(field)) < 0) {
+			LOG_WRN("datagram full, %s dropped", field);
+		}
+		return;
+	}
+#endif
+
+	len = strlen(outstr);
+	snprintf(outstr + len, sizeof(outstr) - len, "%s", field);
+}
+
+static bool transport_ready(void)
+{
+	switch (TELEMETRY_PATH) {
+	case TELEMETRY_PATH_CONTEXT:
+		return ctx != NULL;
+	case TELEMETRY_PATH_PKT:
+		return true;
+	default:
+		return fd >= 0;
 	}
 }
 
+static int transport_send(const uint8_t *buf, size_t len)
+{
+#if TELEMETRY_PATH == TELEMETRY_PATH_CONTEXT
+	return net_context_sendto(ctx, buf, len,
+				  (const struct sockaddr *)&addr, sizeof(addr),
+				  NULL, K_MSEC(TELEMETRY_TX_TIMEOUT_MS), NULL);
+#elif TELEMETRY_PATH == TELEMETRY_PATH_PKT
+	struct net_pkt *pkt;
+	int r;
+
+	pkt = telemetry_pkt_begin(&pkt_ep, len,
+				  K_MSEC(TELEMETRY_TX_TIMEOUT_MS));
+	if (pkt == NULL) {
+		return -ENOMEM;
+	}
+
+	r = telemetry_pkt_write(pkt, buf, len);
+	if (r == 0) {
+		r = telemetry_pkt_send(&pkt_ep, pkt);
+	}
+	if (r < 0) {
+		telemetry_pkt_abort(pkt);
+	}
+
+	return r;
+#else
+	int r = sendto(fd, buf, len, 0, (const struct sockaddr *) &addr,
+		       sizeof(addr));
+
+	return r < 0 ? -errno : r;
+#endif
+}
+
+static void first_datagram_sent(void)
+{
+	if (!boot_time_reached(BOOT_FIRST_DATAGRAM)) {
+		boot_time_mark(BOOT_FIRST_DATAGRAM);
+#if FAST_START
+		k_sem_give(&first_datagram);
+#endif
+	}
+}
+
+static void datagram_sent(size_t len)
+{
+	first_datagram_sent();
+
+	mcast_stats.datagrams++;
+	mcast_stats.bytes += len;
+}
+
+static int send_datagram(const uint8_t *buf, size_t len)
+{
+	int r;
+
+	if (!transport_ready() || !net_if_is_up(iface)) {
+		return -ENETDOWN;
+	}
+
+	/* The radio sleeps again once the datagram has left */
+	power_radio_get();
+	r = transport_send(buf, len);
+	power_radio_put();
+
+	if (r < 0) {
+		return r;
+	}
+
+	datagram_sent(len);
+
+	return 0;
+}
+
+static void drain_backlog(void)
+{
+	if (telemetry_store_pending() &&
+	    telemetry_store_drain(send_datagram, STORE_DRAIN_BATCHES) > 0) {
+		telemetry_store_report();
+	}
+}
+
+#if TELEMETRY_PATH == TELEMETRY_PATH_PKT
+/* Send the datagram written into tx_pkt, or put it back into outstr */
+static void send_tx_pkt(void)
+{
+	struct net_pkt *pkt = tx_pkt;
+	size_t len = telemetry_pkt_payload_len(pkt);
+	int r;
+
+	tx_pkt = NULL;
+
+	power_radio_get();
+	r = telemetry_pkt_send(&pkt_ep, pkt);
+	power_radio_put();
+
+	if (r == 0) {
+		datagram_sent(len);
+		return;
+	}
+
+	/* Only a failed send pays for the copy, to store the record */
+	len = telemetry_pkt_read_payload(pkt, (uint8_t *)outstr,
+					 sizeof(outstr) - 1);
+	outstr[len] = '\0';
+	telemetry_pkt_abort(pkt);
+}
+#endif
+
 static void send_sensor_value()
 {
-	if ((fd >= 0) && (strlen(outstr) > 0)) {
-		sendto(fd, outstr, strlen(outstr), 0,
-			(const struct sockaddr *) &addr,
-			sizeof(addr));
+	char record[TELEMETRY_RECORD_MAX];
+	size_t len;
+	int r;
+
+#if TELEMETRY_PATH == TELEMETRY_PATH_PKT
+	if (tx_pkt != NULL) {
+		send_tx_pkt();
+		if (outstr[0] == '\0') {
+			drain_backlog();
+			return;
+		}
+	}
+#endif
+
+	len = strlen(outstr);
+	if (len == 0) {
+		return;
 	}
 
+	/*
+	 * Samples queue behind an existing backlog so that the collector
+	 * sees them in order. Stored records carry their uptime as "@<ms>;".
+	 */
+	if (telemetry_store_pending() ||
+	    send_datagram((const uint8_t *)outstr, len) < 0) {
+		r = snprintf(record, sizeof(record), "@%u;%s",
+			     k_uptime_get_32(), outstr);
+		if (r > 0) {
+			telemetry_store_append((const uint8_t *)record,
+					       MIN(r, sizeof(record) - 1));
+		}
+	}
+
+	drain_backlog();
+
 	outstr[0] = '\0';
 }
 
+#if TELEMETRY_MODE == TELEMETRY_MCAST_TS
+static void ts_flush(void)
+{
+	size_t len = ts_encoder_finish(&ts_enc);
+
+	if (len == 0) {
+		return;
+	}
+
+	/* Blocks carry their own timestamps and length, stored as they are */
+	if (telemetry_store_pending() || send_datagram(ts_block, len) < 0) {
+		telemetry_store_append(ts_block, len);
+	}
+
+	ts_stats.blocks++;
+	ts_stats.bytes += len;
+	ts_encoder_reset(&ts_enc);
+
+	drain_backlog();
+}
+
+static void ts_publish(void)
+{
+	uint32_t now = k_uptime_get_32();
+	uint32_t start = k_cycle_get_32();
+	int r;
+
+	r = ts_encode(&ts_enc, now, ts_vals);
+	ts_stats.encode_cycles += k_cycle_get_32() - start;
+
+	if (r == -ENOSPC) {
+		ts_flush();
+		start = k_cycle_get_32();
+		r = ts_encode(&ts_enc, now, ts_vals);
+		ts_stats.encode_cycles += k_cycle_get_32() - start;
+	}
+
+	if (r < 0) {
+		LOG_WRN("ts: sample dropped: %d", r);
+	} else {
+		ts_stats.samples++;
+		ts_stats.text_bytes += strlen(outstr);
+	}
+
+	outstr[0] = '\0';
+
+	/* The first sample goes out on its own, for a quick start */
+	if (ts_enc.count >= TS_BATCH_SAMPLES ||
+	    !boot_time_reached(BOOT_FIRST_DATAGRAM)) {
+		ts_flush();
+	}
+}
+#endif
+
+static void publish_sensor_values(enum coap_sensor_res res,
+				  const struct sensor_value *vals)
+{
+#if TELEMETRY_MODE == TELEMETRY_COAP
+	/* The first notification to an observer counts as the first datagram */
+	if (coap_server_publish(res, vals) > 0) {
+		first_datagram_sent();
+	}
+	outstr[0] = '\0';
+#elif TELEMETRY_MODE == TELEMETRY_MCAST_TS
+	/* Values are collected in ts_vals, the sample goes out as a whole */
+	ARG_UNUSED(res);
+	ARG_UNUSED(vals);
+#else
+	ARG_UNUSED(res);
+	ARG_UNUSED(vals);
+	send_sensor_value();
+#endif
+}
+
+static void report_telemetry(uint32_t interval_ms)
+{
+#if TELEMETRY_MODE == TELEMETRY_COAP
+	coap_server_report(interval_ms);
+#else
+	uint32_t rate = (uint64_t)mcast_stats.datagrams * 1000000U / interval_ms;
+
+	LOG_INF("mcast: %u.%03u datagrams/s, %u datagrams, %u bytes",
+		rate / 1000U, rate % 1000U, mcast_stats.datagrams,
+		mcast_stats.bytes);
+	memset(&mcast_stats, 0, sizeof(mcast_stats));
+#endif
+
+	power_report();
+
+#if TELEMETRY_MODE == TELEMETRY_MCAST_TS
+	if (ts_stats.samples > 0 && ts_stats.bytes > 0) {
+		uint32_t ratio = (uint64_t)ts_stats.text_bytes * 100U /
+				 ts_stats.bytes;
+
+		LOG_INF("ts: %u samples, %u text B -> %u B in %u blocks, "
+			"ratio %u.%02u, encode %u cycles/sample",
+			ts_stats.samples, ts_stats.text_bytes, ts_stats.bytes,
+			ts_stats.blocks, ratio / 100U, ratio % 100U,
+			(uint32_t)(ts_stats.encode_cycles / ts_stats.samples));
+	}
+#endif
+}
+
 static void sensor_work_handler(struct k_work *work)
 {
-	struct sensor_value val;
+	struct sensor_value val[2];
 
+	sensor_bench_sample_begin();
 	outstr[0] = '\0';
 
 	for (size_t i = 0; i < NUM_DEVICES; ++i) {
@@ -197,30 +636,48 @@ static void sensor_work_handler(struct k_work *work)
 			continue;
 		}
 
-		if (devices[i] == NULL) {
+		if (!atomic_test_bit(opened, i)) {
 			continue;
 		}
 
-		sensor_sample_fetch(devices[i]);
+		if (!atomic_test_and_clear_bit(prefetched, i)) {
+			if (power_sensor_get(devices[i]) < 0) {
+				continue;
+			}
+			sensor_sample_fetch(devices[i]);
+			power_sensor_put(devices[i]);
+		}
 
 		if (i == LIGHT) {
-			sensor_channel_get(devices[i], SENSOR_CHAN_LIGHT, &val);
-			print_sensor_value(i, "l: ", &val);
-			send_sensor_value();
+			sensor_channel_get(devices[i], SENSOR_CHAN_LIGHT, &val[0]);
+			print_sensor_value(i, "l: ", &val[0]);
+			ts_vals[TS_LIGHT] = val[0].val1 * 100 + val[0].val2 / 10000;
+			publish_sensor_values(COAP_RES_LIGHT, val);
 			continue;
 		}
 
 		if (i == HUMIDITY) {
 			sensor_channel_get(devices[i], SENSOR_CHAN_HUMIDITY,
-					   &val);
-			print_sensor_value(i, "h: ", &val);
+					   &val[0]);
+			print_sensor_value(i, "h: ", &val[0]);
+			ts_vals[TS_HUMIDITY] = val[0].val1 * 100 +
+					       val[0].val2 / 10000;
 			sensor_channel_get(devices[i], SENSOR_CHAN_AMBIENT_TEMP,
-					   &val);
-			print_sensor_value(i, "t: ", &val);
-			send_sensor_value();
+					   &val[1]);
+			print_sensor_value(i, "t: ", &val[1]);
+			ts_vals[TS_TEMP] = val[1].val1 * 100 + val[1].val2 / 10000;
+			publish_sensor_values(COAP_RES_CLIMATE, val);
 			continue;
 		}
 	}
+
+	boot_time_mark(BOOT_FIRST_SAMPLE);
+
+#if TELEMETRY_MODE == TELEMETRY_MCAST_TS
+	ts_publish();
+#endif
+
+	sensor_bench_sample_end();
 }
 
 static void button_handler(const struct device *dev, struct gpio_callback *cb,
@@ -236,23 +693,140 @@ static void button_handler(const struct device *dev, struct gpio_callback *cb,
 	k_work_submit(&sensor_work);
 }
 
-void main(void)
+static int sensor_open(size_t i)
+{
+	devices[i] = (struct device *)device_get_binding(device_names[i]);
+	if (devices[i] == NULL) {
+		LOG_ERR("failed to open device %s", device_labels[i]);
+		return -ENODEV;
+	}
+
+	return 0;
+}
+
+static void sensor_opened(size_t i)
+{
+	if (devices[i] != NULL) {
+		atomic_set_bit(opened, i);
+	}
+}
+
+#if FAST_START
+/* Opens a sensor and takes its first reading while main sets up the radio */
+static void sensor_open_entry(void *p1, void *p2, void *p3)
+{
+	size_t i = POINTER_TO_UINT(p1);
+
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	if (sensor_open(i) == 0 && power_sensor_get(devices[i]) == 0) {
+		if (sensor_sample_fetch(devices[i]) == 0) {
+			atomic_set_bit(prefetched, i);
+		}
+		power_sensor_put(devices[i]);
+	}
+
+	/* Last, main may have stopped waiting for us */
+	sensor_opened(i);
+}
+
+/* What CONFIG_NET_CONFIG_AUTO_INIT would have done before main */
+static void start_deferred_services(bool net_cached)
+{
+	if (!net_cached) {
+		net_config_init_app(NULL, "sensortest");
+		net_cache_save(iface);
+	}
+
+	boot_time_mark(BOOT_SERVICES);
+}
+#endif
+
+static void report_boot_time(void)
+{
+	static bool reported;
+
+	if (!reported && boot_time_reached(BOOT_FIRST_DATAGRAM)) {
+		boot_time_report();
+		reported = true;
+	}
+}
+
+int main(void)
 {
 	int r;
-	struct net_if *iface = net_if_get_default();
+	uint32_t uptime_s = 0;
+#if FAST_START
+	int64_t open_deadline;
+	bool net_cached;
+#endif
+
+	boot_time_mark(BOOT_MAIN);
 
+	iface = net_if_get_default();
 	outstr[0] = '\0';
 
-	fd = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
-	if (fd < 0) {
-		LOG_ERR("failed to open socket");
-	} else {
-		memset(&addr, 0, sizeof(struct sockaddr_in6));
-		addr.sin6_family = AF_INET6;
-		addr.sin6_port = htons(9999);
-		inet_pton(AF_INET6, "ff02::1", &addr.sin6_addr);
+	power_init(SENSOR_BUS, iface);
+#if TELEMETRY_MODE == TELEMETRY_COAP
+	/* Requests and Observe registrations can arrive at any time */
+	power_radio_get();
+#endif
+
+#if FAST_START
+	for (size_t i = 0; i < NUM_DEVICES; ++i) {
+		if (apis[i] != SENSOR_API) {
+			continue;
+		}
+
+		k_thread_create(&sensor_open_thread[i], sensor_open_stack[i],
+				K_THREAD_STACK_SIZEOF(sensor_open_stack[i]),
+				sensor_open_entry, UINT_TO_POINTER(i), NULL, NULL,
+				SENSOR_OPEN_PRIO, 0, K_NO_WAIT);
 	}
 
+	net_cached = net_cache_apply(iface);
+#endif
+
+#if TELEMETRY_MODE == TELEMETRY_COAP
+	coap_server_init();
+#else
+	telemetry_store_init();
+
+#if TELEMETRY_MODE == TELEMETRY_MCAST_TS
+	ts_encoder_init(&ts_enc, ts_block, sizeof(ts_block), ts_names,
+			TS_CHANNELS);
+#endif
+
+	memset(&addr, 0, sizeof(struct sockaddr_in6));
+	addr.sin6_family = AF_INET6;
+	addr.sin6_port = htons(TELEMETRY_PORT);
+	inet_pton(AF_INET6, TELEMETRY_DEST, &addr.sin6_addr);
+
+	switch (TELEMETRY_PATH) {
+	case TELEMETRY_PATH_CONTEXT:
+		if (net_context_get(AF_INET6, SOCK_DGRAM, IPPROTO_UDP,
+				    &ctx) < 0) {
+			LOG_ERR("failed to get a net_context");
+			ctx = NULL;
+		}
+		break;
+	case TELEMETRY_PATH_PKT:
+		pkt_ep.iface = iface;
+		pkt_ep.dest = addr;
+		pkt_ep.src_port = TELEMETRY_SRC_PORT;
+		break;
+	default:
+		fd = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+		if (fd < 0) {
+			LOG_ERR("failed to open socket");
+		}
+		break;
+	}
+#endif
+
+	boot_time_mark(BOOT_NET);
+
 	//setup_telnet_ipv6(iface);
 
 	for (size_t i = 0; i < NUM_DEVICES; ++i) {
@@ -282,11 +856,10 @@ void main(void)
 			break;
 
 		case SENSOR_API:
-			devices[i] =
-				(struct device *)device_get_binding(device_names[i]);
-			if (devices[i] == NULL) {
-				LOG_ERR("failed to open device %s", device_labels[i]);
-				continue;
+			/* Already opening in parallel with a fast start */
+			if (!FAST_START) {
+				sensor_open(i);
+				sensor_opened(i);
 			}
 			break;
 
@@ -295,6 +868,44 @@ void main(void)
 		}
 	}
 
+#if FAST_START
+	/*
+	 * A sensor still opening after the timeout is sampled from the first
+	 * round after its worker is done, see opened
+	 */
+	open_deadline = k_uptime_get() + SENSOR_OPEN_TIMEOUT_MS;
+	for (size_t i = 0; i < NUM_DEVICES; ++i) {
+		if (apis[i] == SENSOR_API &&
+		    k_thread_join(&sensor_open_thread[i],
+				  K_MSEC(MAX(open_deadline - k_uptime_get(),
+					     0))) != 0) {
+			LOG_WRN("%s still opening", device_labels[i]);
+		}
+	}
+#endif
+
+	boot_time_mark(BOOT_SENSORS);
+
+#if FAST_START
+	/* With CoAP and no observer yet, services start after the timeout */
+	k_work_submit(&sensor_work);
+	k_sem_take(&first_datagram, K_MSEC(FIRST_DATAGRAM_TIMEOUT_MS));
+	start_deferred_services(net_cached);
+#endif
+
+	report_boot_time();
+
+#ifdef CONFIG_EMUL
+	/* Before the timer starts sampling at random */
+#if TELEMETRY_MODE == TELEMETRY_COAP
+	coap_check_run(&sensor_work);
+#endif
+	store_check_run();
+	sensor_bench_run(&sensor_work);
+	power_check_run(&sensor_work);
+	send_bench_run();
+#endif
+
 	/* setup timer-driven LED event */
 	k_work_init_delayable(&led_work.dwork, led_work_handler);
 	//led_work.active_led = LED_SUBG;
@@ -304,5 +915,14 @@ void main(void)
 
 	for (;;) {
 		k_sleep(K_MSEC(1000));
+
+		report_boot_time();
+
+		if (TELEMETRY_REPORT_S > 0 &&
+		    ++uptime_s % MAX(TELEMETRY_REPORT_S, 1) == 0) {
+			report_telemetry(TELEMETRY_REPORT_S * MSEC_PER_SEC);
+		}
 	}
+
+	return 0;
 }
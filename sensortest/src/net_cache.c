@@ -0,0 +1,166 @@
+/*
+ * Network configuration cache, see net_cache.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/linker/section_tags.h>
+#include <zephyr/net/net_if.h>
+#include <zephyr/net/net_mgmt.h>
+#include <zephyr/sys/crc.h>
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef CONFIG_NET_L2_IEEE802154
+#include <zephyr/net/ieee802154_mgmt.h>
+#endif
+
+#include "net_cache.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(net_cache, LOG_LEVEL_INF);
+
+#define NET_CACHE_MAGIC 0x4e455443 /* "NETC" */
+
+#if defined(CONFIG_NET_L2_IEEE802154) && defined(CONFIG_NET_CONFIG_SETTINGS)
+#define NET_CACHE_RADIO 1
+#endif
+
+struct net_cache {
+	uint32_t magic;
+	uint32_t build;		/* build_crc() of the image that saved it */
+	uint16_t pan_id;
+	uint16_t channel;
+	int16_t tx_power;
+	uint8_t addr_count;
+	struct in6_addr addrs[NET_CACHE_ADDRS];
+	uint32_t crc;
+};
+
+/* Left alone by the startup code, so a warm reset finds it as it was */
+static __noinit struct net_cache cache;
+
+/*
+ * The settings net_config applies in this image. Reflashing with others
+ * and warm resetting must not bring the old ones back from the cache.
+ */
+static const char build_id[] =
+#ifdef CONFIG_NET_CONFIG_MY_IPV6_ADDR
+	CONFIG_NET_CONFIG_MY_IPV6_ADDR " "
+#endif
+#ifdef CONFIG_NET_CONFIG_PEER_IPV6_ADDR
+	CONFIG_NET_CONFIG_PEER_IPV6_ADDR " "
+#endif
+#ifdef NET_CACHE_RADIO
+	STRINGIFY(CONFIG_NET_CONFIG_IEEE802154_PAN_ID) " "
+	STRINGIFY(CONFIG_NET_CONFIG_IEEE802154_CHANNEL) " "
+	STRINGIFY(CONFIG_NET_CONFIG_IEEE802154_RADIO_TX_POWER) " "
+#endif
+	STRINGIFY(NET_CACHE_ADDRS);
+
+static uint32_t build_crc(void)
+{
+	return crc32_ieee((const uint8_t *)build_id, sizeof(build_id) - 1);
+}
+
+static uint32_t cache_crc(void)
+{
+	return crc32_ieee((const uint8_t *)&cache,
+			  offsetof(struct net_cache, crc));
+}
+
+#ifdef NET_CACHE_RADIO
+static bool is_ieee802154(struct net_if *iface)
+{
+	return net_if_l2(iface) == &NET_L2_GET_NAME(IEEE802154);
+}
+
+static int radio_setup(struct net_if *iface, uint16_t pan_id,
+		       uint16_t channel, int16_t tx_power)
+{
+	if (net_mgmt(NET_REQUEST_IEEE802154_SET_PAN_ID, iface, &pan_id,
+		     sizeof(pan_id)) ||
+	    net_mgmt(NET_REQUEST_IEEE802154_SET_CHANNEL, iface, &channel,
+		     sizeof(channel)) ||
+	    net_mgmt(NET_REQUEST_IEEE802154_SET_TX_POWER, iface, &tx_power,
+		     sizeof(tx_power))) {
+		return -EIO;
+	}
+
+	return 0;
+}
+#endif
+
+bool net_cache_apply(struct net_if *iface)
+{
+	bool valid = cache.magic == NET_CACHE_MAGIC &&
+		     cache.build == build_crc() &&
+		     cache.addr_count <= NET_CACHE_ADDRS &&
+		     cache.crc == cache_crc();
+
+#ifdef NET_CACHE_RADIO
+	if (is_ieee802154(iface)) {
+		int r;
+
+		if (valid) {
+			r = radio_setup(iface, cache.pan_id, cache.channel,
+					cache.tx_power);
+		} else {
+			r = radio_setup(iface, CONFIG_NET_CONFIG_IEEE802154_PAN_ID,
+					CONFIG_NET_CONFIG_IEEE802154_CHANNEL,
+					CONFIG_NET_CONFIG_IEEE802154_RADIO_TX_POWER);
+		}
+
+		if (r < 0) {
+			LOG_WRN("802.15.4 setup failed: %d", r);
+		}
+	}
+#endif
+
+	if (!valid) {
+		return false;
+	}
+
+	for (int i = 0; i < cache.addr_count; i++) {
+		net_if_ipv6_addr_add(iface, &cache.addrs[i], NET_ADDR_MANUAL, 0);
+	}
+
+	return true;
+}
+
+void net_cache_save(struct net_if *iface)
+{
+	struct net_if_ipv6 *ipv6;
+
+	memset(&cache, 0, sizeof(cache));
+
+	if (net_if_config_ipv6_get(iface, &ipv6) == 0) {
+		for (int i = 0; i < NET_IF_MAX_IPV6_ADDR &&
+				cache.addr_count < NET_CACHE_ADDRS; i++) {
+			struct net_if_addr *ifaddr = &ipv6->unicast[i];
+
+			if (ifaddr->is_used &&
+			    ifaddr->addr_type == NET_ADDR_MANUAL) {
+				cache.addrs[cache.addr_count++] =
+					ifaddr->address.in6_addr;
+			}
+		}
+	}
+
+#ifdef NET_CACHE_RADIO
+	if (is_ieee802154(iface)) {
+		net_mgmt(NET_REQUEST_IEEE802154_GET_PAN_ID, iface,
+			 &cache.pan_id, sizeof(cache.pan_id));
+		net_mgmt(NET_REQUEST_IEEE802154_GET_CHANNEL, iface,
+			 &cache.channel, sizeof(cache.channel));
+		net_mgmt(NET_REQUEST_IEEE802154_GET_TX_POWER, iface,
+			 &cache.tx_power, sizeof(cache.tx_power));
+	}
+#endif
+
+	cache.magic = NET_CACHE_MAGIC;
+	cache.build = build_crc();
+	cache.crc = cache_crc();
+}
@@ -0,0 +1,34 @@
+/*
+ * Network configuration kept across resets that preserve RAM.
+ *
+ * After the network has been configured the slow way (net_config), the
+ * IEEE 802.15.4 settings and the static IPv6 addresses are saved in a
+ * no-init RAM section. On the next boot they are applied directly, without
+ * net_config and its waits. After a power loss, or once an image with
+ * other net_config settings is flashed, the cache is invalid and the slow
+ * path runs once again.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef NET_CACHE_H_
+#define NET_CACHE_H_
+
+#include <stdbool.h>
+
+#include <zephyr/net/net_if.h>
+
+/* Static IPv6 addresses remembered */
+#define NET_CACHE_ADDRS 2
+
+/*
+ * Apply what is needed for the first datagram: the cached 802.15.4
+ * settings, or those of prj.conf. Returns true if the cache was valid,
+ * in which case its addresses have been added as well.
+ */
+bool net_cache_apply(struct net_if *iface);
+
+/* Save the settings and static addresses iface has now */
+void net_cache_save(struct net_if *iface);
+
+#endif /* NET_CACHE_H_ */
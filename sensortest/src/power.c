@@ -0,0 +1,342 @@
+/*
+ * Power management between sampling rounds, see power.h
+ *
+ * Devices whose drivers do not implement runtime PM are only accounted:
+ * pm_device_runtime_get() and _put() return 0 for them without doing
+ * anything. Without an 802.15.4 interface, as on native_sim, the radio is
+ * accounted the same way.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/net/net_if.h>
+#include <zephyr/net/net_pkt.h>
+#include <zephyr/pm/device_runtime.h>
+#include <zephyr/sys/util.h>
+#include <errno.h>
+
+#ifdef CONFIG_NET_L2_IEEE802154
+#include <zephyr/net/ieee802154_radio.h>
+#endif
+
+#include "power.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(power, LOG_LEVEL_INF);
+
+/* How often a radio waiting to sleep checks the TX queue again */
+#define RADIO_IDLE_POLL_MS 5
+
+struct power_dev {
+	const struct device *dev;	/* NULL when only accounted */
+	const char *name;
+	uint8_t users;
+	bool active;
+	uint32_t resumes;
+	int64_t since;
+	uint64_t ms[2];			/* suspended, active */
+};
+
+static struct power_dev devs[POWER_MAX_DEVICES];
+static size_t dev_count;
+static struct power_dev *bus;
+static struct power_dev *radio;
+static power_trace_t trace;
+
+/* Taken by the sensor work and the radio idle work, both may sleep */
+K_MUTEX_DEFINE(power_lock);
+
+static void radio_idle_handler(struct k_work *work);
+K_WORK_DELAYABLE_DEFINE(radio_idle, radio_idle_handler);
+
+static struct power_dev *dev_add(const struct device *dev, const char *name,
+				 bool active)
+{
+	struct power_dev *pd;
+
+	if (dev_count == ARRAY_SIZE(devs)) {
+		return NULL;
+	}
+
+	pd = &devs[dev_count++];
+	pd->dev = dev;
+	pd->name = name;
+	pd->active = active;
+	pd->since = k_uptime_get();
+
+	return pd;
+}
+
+static struct power_dev *dev_find(const struct device *dev)
+{
+	for (size_t i = 0; i < dev_count; i++) {
+		if (devs[i].dev == dev) {
+			return &devs[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* Runtime PM for sensors and the bus, off when the usage count drops to 0 */
+static void runtime_enable(const struct device *dev)
+{
+	int r = pm_device_runtime_enable(dev);
+
+	if (r < 0) {
+		LOG_DBG("%s: no runtime PM (%d), accounted only", dev->name, r);
+	}
+}
+
+static int radio_set(const struct device *dev, bool active)
+{
+#ifdef CONFIG_NET_L2_IEEE802154
+	const struct ieee802154_radio_api *api = dev->api;
+
+	return active ? api->start(dev) : api->stop(dev);
+#else
+	ARG_UNUSED(dev);
+	ARG_UNUSED(active);
+
+	return -ENOTSUP;
+#endif
+}
+
+static int set_active(struct power_dev *pd, bool active)
+{
+	int64_t now;
+	int r = 0;
+
+	if (pd->dev == NULL) {
+		/* accounted only */
+	} else if (pd == radio) {
+		r = radio_set(pd->dev, active);
+	} else if (active) {
+		r = pm_device_runtime_get(pd->dev);
+	} else {
+		r = pm_device_runtime_put(pd->dev);
+	}
+
+	if (r < 0) {
+		LOG_WRN("%s: %s failed: %d", pd->name,
+			active ? "resume" : "suspend", r);
+		return r;
+	}
+
+	now = k_uptime_get();
+	pd->ms[pd->active] += now - pd->since;
+	pd->since = now;
+	pd->active = active;
+	if (active) {
+		pd->resumes++;
+	}
+
+	if (trace != NULL) {
+		trace(pd->name, active);
+	}
+
+	return 0;
+}
+
+static int dev_get(struct power_dev *pd)
+{
+	int r;
+
+	if (pd == NULL) {
+		return 0;
+	}
+
+	if (pd->users == 0) {
+		r = set_active(pd, true);
+		if (r < 0) {
+			return r;
+		}
+	}
+
+	pd->users++;
+
+	return 0;
+}
+
+static void dev_put(struct power_dev *pd)
+{
+	if (pd != NULL && pd->users > 0 && --pd->users == 0) {
+		set_active(pd, false);
+	}
+}
+
+static bool tx_pending(void)
+{
+	struct k_mem_slab *rx, *tx;
+	struct net_buf_pool *rx_data, *tx_data;
+
+	net_pkt_get_info(&rx, &tx, &rx_data, &tx_data);
+
+	return k_mem_slab_num_used_get(tx) > 0;
+}
+
+static void radio_idle_handler(struct k_work *work)
+{
+	ARG_UNUSED(work);
+
+	k_mutex_lock(&power_lock, K_FOREVER);
+
+	if (radio != NULL && radio->users == 0 && radio->active) {
+		if (tx_pending()) {
+			k_work_reschedule(&radio_idle, K_MSEC(RADIO_IDLE_POLL_MS));
+		} else {
+			set_active(radio, false);
+		}
+	}
+
+	k_mutex_unlock(&power_lock);
+}
+
+void power_init(const struct device *bus_dev, struct net_if *iface)
+{
+	const struct device *radio_dev = NULL;
+
+	k_mutex_lock(&power_lock, K_FOREVER);
+
+	if (bus_dev != NULL) {
+		runtime_enable(bus_dev);
+		bus = dev_add(bus_dev, bus_dev->name, false);
+	}
+
+#ifdef CONFIG_NET_L2_IEEE802154
+	if (iface != NULL &&
+	    net_if_l2(iface) == &NET_L2_GET_NAME(IEEE802154)) {
+		radio_dev = net_if_get_device(iface);
+	}
+#else
+	ARG_UNUSED(iface);
+#endif
+
+	/* The L2 started the radio, it sleeps once nothing is queued */
+	radio = dev_add(radio_dev, radio_dev ? radio_dev->name : "radio", true);
+
+	k_mutex_unlock(&power_lock);
+
+	k_work_reschedule(&radio_idle, K_NO_WAIT);
+}
+
+int power_sensor_get(const struct device *sensor)
+{
+	struct power_dev *pd;
+	int r = -ENOMEM;
+
+	k_mutex_lock(&power_lock, K_FOREVER);
+
+	pd = dev_find(sensor);
+	if (pd == NULL) {
+		runtime_enable(sensor);
+		pd = dev_add(sensor, sensor->name, false);
+	}
+
+	if (pd != NULL) {
+		r = dev_get(bus);
+		if (r == 0) {
+			r = dev_get(pd);
+			if (r < 0) {
+				dev_put(bus);
+			}
+		}
+	}
+
+	k_mutex_unlock(&power_lock);
+
+	return r;
+}
+
+void power_sensor_put(const struct device *sensor)
+{
+	struct power_dev *pd;
+
+	k_mutex_lock(&power_lock, K_FOREVER);
+
+	pd = dev_find(sensor);
+	if (pd != NULL && pd->users > 0) {
+		dev_put(pd);
+		dev_put(bus);
+	}
+
+	k_mutex_unlock(&power_lock);
+}
+
+void power_radio_get(void)
+{
+	k_mutex_lock(&power_lock, K_FOREVER);
+
+	if (radio != NULL) {
+		k_work_cancel_delayable(&radio_idle);
+		radio->users++;
+		if (!radio->active) {
+			set_active(radio, true);
+		}
+	}
+
+	k_mutex_unlock(&power_lock);
+}
+
+void power_radio_put(void)
+{
+	k_mutex_lock(&power_lock, K_FOREVER);
+
+	if (radio != NULL && radio->users > 0 && --radio->users == 0) {
+		k_work_reschedule(&radio_idle, K_NO_WAIT);
+	}
+
+	k_mutex_unlock(&power_lock);
+}
+
+void power_set_trace(power_trace_t cb)
+{
+	k_mutex_lock(&power_lock, K_FOREVER);
+	trace = cb;
+	k_mutex_unlock(&power_lock);
+}
+
+size_t power_stats_get(struct power_stats *stats, size_t max)
+{
+	int64_t now;
+	size_t n;
+
+	k_mutex_lock(&power_lock, K_FOREVER);
+
+	now = k_uptime_get();
+	n = MIN(dev_count, max);
+
+	for (size_t i = 0; i < n; i++) {
+		const struct power_dev *pd = &devs[i];
+		uint64_t ms[2] = { pd->ms[0], pd->ms[1] };
+
+		ms[pd->active] += now - pd->since;
+		stats[i].name = pd->name;
+		stats[i].active = pd->active;
+		stats[i].resumes = pd->resumes;
+		stats[i].active_ms = ms[1];
+		stats[i].suspended_ms = ms[0];
+	}
+
+	k_mutex_unlock(&power_lock);
+
+	return n;
+}
+
+void power_report(void)
+{
+	struct power_stats stats[POWER_MAX_DEVICES];
+	size_t n = power_stats_get(stats, ARRAY_SIZE(stats));
+
+	for (size_t i = 0; i < n; i++) {
+		uint64_t total = MAX((uint64_t)stats[i].active_ms +
+				     stats[i].suspended_ms, 1);
+		uint32_t pm = stats[i].suspended_ms * 1000ULL / total;
+
+		LOG_INF("pm: %s: %u resumes, active %u ms, suspended %u ms "
+			"(%u.%u%%)", stats[i].name, stats[i].resumes,
+			stats[i].active_ms, stats[i].suspended_ms, pm / 10,
+			pm % 10);
+	}
+}
@@ -0,0 +1,63 @@
+/*
+ * Power management between sampling rounds.
+ *
+ * Sensors and their I2C bus are resumed with device runtime PM only for
+ * sensor_sample_fetch(): the bus before the sensor, the sensor before the
+ * bus on the way down. The 802.15.4 radio is stopped once no TX packet is
+ * left after the last power_radio_put(). With CONFIG_PM the kernel picks
+ * the system power state when everything is idle.
+ *
+ * Each device's time in the active and suspended states is accounted here,
+ * also for devices whose drivers do not support runtime PM, so that the
+ * ordering can be checked on native_sim (emul/power_check.c).
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef POWER_H_
+#define POWER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/device.h>
+#include <zephyr/net/net_if.h>
+
+/* Sensors, their bus and the radio */
+#define POWER_MAX_DEVICES 6
+
+struct power_stats {
+	const char *name;
+	bool active;
+	uint32_t resumes;
+	uint32_t active_ms;
+	uint32_t suspended_ms;
+};
+
+/* Called on every resume (true) and suspend (false) */
+typedef void (*power_trace_t)(const char *name, bool active);
+
+/*
+ * Enable runtime PM on the sensor bus (may be NULL), which is suspended
+ * until the first fetch, and let the radio behind iface sleep once idle.
+ */
+void power_init(const struct device *bus, struct net_if *iface);
+
+/* Resume the bus and then the sensor, for one fetch */
+int power_sensor_get(const struct device *sensor);
+void power_sensor_put(const struct device *sensor);
+
+/* The radio stays on from the first get until the TX queue has drained */
+void power_radio_get(void);
+void power_radio_put(void);
+
+void power_set_trace(power_trace_t trace);
+
+/* Time in each state up to now, returns the number of devices */
+size_t power_stats_get(struct power_stats *stats, size_t max);
+
+/* Log the share of time each device spent suspended */
+void power_report(void);
+
+#endif /* POWER_H_ */
@@ -0,0 +1,136 @@
+/*
+ * Minimal SenML/CBOR writer, see senml_cbor.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "senml_cbor.h"
+
+/* CBOR major types */
+#define CBOR_UINT	0
+#define CBOR_NINT	1
+#define CBOR_TEXT	3
+#define CBOR_ARRAY	4
+#define CBOR_MAP	5
+#define CBOR_FLOAT32	0xfa
+
+/* SenML CBOR labels */
+#define SENML_BN	-2
+#define SENML_N		0
+#define SENML_U		1
+#define SENML_V		2
+
+static void put_bytes(struct senml_writer *w, const void *data, size_t len)
+{
+	if (w->overflow || w->len + len > w->size) {
+		w->overflow = true;
+		return;
+	}
+
+	memcpy(w->buf + w->len, data, len);
+	w->len += len;
+}
+
+static void put_head(struct senml_writer *w, uint8_t major, uint32_t val)
+{
+	uint8_t head[5];
+	size_t len;
+
+	if (val < 24) {
+		head[0] = (major << 5) | val;
+		len = 1;
+	} else if (val <= UINT8_MAX) {
+		head[0] = (major << 5) | 24;
+		head[1] = val;
+		len = 2;
+	} else if (val <= UINT16_MAX) {
+		head[0] = (major << 5) | 25;
+		head[1] = val >> 8;
+		head[2] = val;
+		len = 3;
+	} else {
+		head[0] = (major << 5) | 26;
+		head[1] = val >> 24;
+		head[2] = val >> 16;
+		head[3] = val >> 8;
+		head[4] = val;
+		len = 5;
+	}
+
+	put_bytes(w, head, len);
+}
+
+static void put_int(struct senml_writer *w, int32_t val)
+{
+	if (val < 0) {
+		put_head(w, CBOR_NINT, (uint32_t)(-(val + 1)));
+	} else {
+		put_head(w, CBOR_UINT, (uint32_t)val);
+	}
+}
+
+static void put_text(struct senml_writer *w, const char *str)
+{
+	size_t len = strlen(str);
+
+	put_head(w, CBOR_TEXT, len);
+	put_bytes(w, str, len);
+}
+
+static void put_float(struct senml_writer *w, float val)
+{
+	uint8_t out[5];
+	uint32_t bits;
+
+	memcpy(&bits, &val, sizeof(bits));
+	out[0] = CBOR_FLOAT32;
+	out[1] = bits >> 24;
+	out[2] = bits >> 16;
+	out[3] = bits >> 8;
+	out[4] = bits;
+
+	put_bytes(w, out, sizeof(out));
+}
+
+void senml_begin(struct senml_writer *w, uint8_t *buf, size_t size,
+		 size_t num_records)
+{
+	w->buf = buf;
+	w->size = size;
+	w->len = 0;
+	w->overflow = false;
+
+	put_head(w, CBOR_ARRAY, num_records);
+}
+
+void senml_record(struct senml_writer *w, const char *base_name,
+		  const char *name, const char *unit,
+		  int32_t val1, int32_t val2)
+{
+	put_head(w, CBOR_MAP, 3 + (base_name != NULL));
+
+	if (base_name != NULL) {
+		put_int(w, SENML_BN);
+		put_text(w, base_name);
+	}
+
+	put_int(w, SENML_N);
+	put_text(w, name);
+	put_int(w, SENML_U);
+	put_text(w, unit);
+
+	put_int(w, SENML_V);
+	if (val2 == 0) {
+		put_int(w, val1);
+	} else {
+		put_float(w, (float)val1 + (float)val2 / 1000000.0f);
+	}
+}
+
+int senml_end(struct senml_writer *w)
+{
+	return w->overflow ? -ENOMEM : (int)w->len;
+}
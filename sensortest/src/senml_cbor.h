@@ -0,0 +1,43 @@
+/*
+ * Minimal SenML/CBOR (RFC 8428) writer for sensor readings.
+ *
+ * Only what the telemetry needs is supported: a pack of records with an
+ * optional base name, a name, a unit and a numeric value. Values without a
+ * fractional part are written as CBOR integers, others as float32.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef SENML_CBOR_H_
+#define SENML_CBOR_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* CoAP Content-Format for application/senml+cbor */
+#define SENML_CBOR_CONTENT_FORMAT 112
+
+struct senml_writer {
+	uint8_t *buf;
+	size_t size;
+	size_t len;
+	bool overflow;
+};
+
+/* Start a pack of num_records records */
+void senml_begin(struct senml_writer *w, uint8_t *buf, size_t size,
+		 size_t num_records);
+
+/*
+ * Append one record. base_name may be NULL and is normally only given for
+ * the first record of the pack. val1/val2 follow struct sensor_value.
+ */
+void senml_record(struct senml_writer *w, const char *base_name,
+		  const char *name, const char *unit,
+		  int32_t val1, int32_t val2);
+
+/* Returns the encoded length, or -ENOMEM if the buffer was too small */
+int senml_end(struct senml_writer *w);
+
+#endif /* SENML_CBOR_H_ */
@@ -0,0 +1,208 @@
+/*
+ * Zero-copy telemetry datagrams, see telemetry_pkt.h
+ *
+ * The headers are written as placeholders when the packet is allocated and
+ * overwritten once the payload length is known. The UDP checksum is summed
+ * over the buffer fragments in place.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/net/net_core.h>
+#include <zephyr/net/net_if.h>
+#include <zephyr/net/net_ip.h>
+#include <zephyr/net/net_pkt.h>
+#include <zephyr/sys/util.h>
+
+#include "telemetry_pkt.h"
+
+struct net_pkt *telemetry_pkt_begin(const struct telemetry_pkt_ep *ep,
+				    size_t max_len, k_timeout_t timeout)
+{
+	uint8_t hdr[TELEMETRY_PKT_HDR_LEN] = { 0 };
+	struct net_pkt *pkt;
+
+	if (ep->iface == NULL) {
+		return NULL;
+	}
+
+	/* Room for the headers is added to max_len */
+	pkt = net_pkt_alloc_with_buffer(ep->iface, max_len, AF_INET6,
+					IPPROTO_UDP, timeout);
+	if (pkt == NULL) {
+		return NULL;
+	}
+
+	if (net_pkt_write(pkt, hdr, sizeof(hdr)) < 0) {
+		net_pkt_unref(pkt);
+		return NULL;
+	}
+
+	return pkt;
+}
+
+int telemetry_pkt_write(struct net_pkt *pkt, const void *data, size_t len)
+{
+	return net_pkt_write(pkt, data, len);
+}
+
+int telemetry_pkt_printf(struct net_pkt *pkt, const char *fmt, ...)
+{
+	char field[TELEMETRY_PKT_FIELD_MAX];
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(field, sizeof(field), fmt, ap);
+	va_end(ap);
+
+	if (n < 0 || n >= sizeof(field)) {
+		return -ENOSPC;
+	}
+
+	return net_pkt_write(pkt, field, n);
+}
+
+size_t telemetry_pkt_payload_len(struct net_pkt *pkt)
+{
+	size_t len = net_pkt_get_len(pkt);
+
+	return len > TELEMETRY_PKT_HDR_LEN ? len - TELEMETRY_PKT_HDR_LEN : 0;
+}
+
+size_t telemetry_pkt_read_payload(struct net_pkt *pkt, uint8_t *buf,
+				  size_t max)
+{
+	size_t len = MIN(telemetry_pkt_payload_len(pkt), max);
+
+	net_pkt_cursor_init(pkt);
+	if (net_pkt_skip(pkt, TELEMETRY_PKT_HDR_LEN) < 0 ||
+	    net_pkt_read(pkt, buf, len) < 0) {
+		return 0;
+	}
+
+	return len;
+}
+
+/* One's complement sum of bytes in network order, odd tracks the position */
+static uint32_t sum_bytes(uint32_t sum, const uint8_t *p, size_t len,
+			  bool *odd)
+{
+	for (; len > 0; p++, len--) {
+		sum += *odd ? *p : (uint32_t)*p << 8;
+		*odd = !*odd;
+	}
+
+	return sum;
+}
+
+/* Over the pseudo-header and everything after the IPv6 header */
+static uint16_t udp_checksum(struct net_pkt *pkt, const struct net_ipv6_hdr *ip,
+			     uint16_t udp_len)
+{
+	size_t skip = sizeof(*ip);
+	bool odd = false;
+	uint32_t sum;
+
+	sum = sum_bytes(0, (const uint8_t *)&ip->src, sizeof(ip->src), &odd);
+	sum = sum_bytes(sum, (const uint8_t *)&ip->dst, sizeof(ip->dst), &odd);
+	sum += udp_len + IPPROTO_UDP;
+
+	for (struct net_buf *buf = pkt->buffer; buf != NULL; buf = buf->frags) {
+		if (skip >= buf->len) {
+			skip -= buf->len;
+			continue;
+		}
+
+		sum = sum_bytes(sum, buf->data + skip, buf->len - skip, &odd);
+		skip = 0;
+	}
+
+	while (sum >> 16) {
+		sum = (sum & 0xffff) + (sum >> 16);
+	}
+
+	/* 0 means no checksum, which IPv6 does not allow for UDP */
+	sum = ~sum & 0xffff;
+
+	return sum == 0 ? 0xffff : sum;
+}
+
+int telemetry_pkt_send(const struct telemetry_pkt_ep *ep, struct net_pkt *pkt)
+{
+	uint16_t udp_len = sizeof(struct net_udp_hdr) +
+			   telemetry_pkt_payload_len(pkt);
+	uint8_t hop_limit = net_if_ipv6_get_hop_limit(ep->iface);
+	const struct in6_addr *src;
+	struct net_ipv6_hdr ip = {
+		.vtc = 0x60,
+		.len = htons(udp_len),
+		.nexthdr = IPPROTO_UDP,
+		.hop_limit = hop_limit,
+	};
+	struct net_udp_hdr udp = {
+		.src_port = htons(ep->src_port),
+		.dst_port = ep->dest.sin6_port,
+		.len = htons(udp_len),
+	};
+	int r;
+
+	src = net_if_ipv6_select_src_addr(ep->iface, &ep->dest.sin6_addr);
+	if (src == NULL) {
+		return -EADDRNOTAVAIL;
+	}
+
+	memcpy(&ip.src, src, sizeof(ip.src));
+	memcpy(&ip.dst, &ep->dest.sin6_addr, sizeof(ip.dst));
+
+	/* Buffers allocated for a longer payload go back to the pool */
+	net_pkt_trim_buffer(pkt);
+
+	net_pkt_cursor_init(pkt);
+	net_pkt_set_overwrite(pkt, true);
+	r = net_pkt_write(pkt, &ip, sizeof(ip));
+	if (r == 0) {
+		r = net_pkt_write(pkt, &udp, sizeof(udp));
+	}
+	if (r == 0) {
+		udp.chksum = htons(udp_checksum(pkt, &ip, udp_len));
+		net_pkt_cursor_init(pkt);
+		net_pkt_skip(pkt, sizeof(ip));
+		r = net_pkt_write(pkt, &udp, sizeof(udp));
+	}
+	net_pkt_set_overwrite(pkt, false);
+
+	if (r < 0) {
+		return r;
+	}
+
+	net_pkt_set_ip_hdr_len(pkt, sizeof(ip));
+	net_pkt_set_ipv6_ext_len(pkt, 0);
+	net_pkt_set_ipv6_next_hdr(pkt, IPPROTO_UDP);
+	net_pkt_set_ipv6_hop_limit(pkt, hop_limit);
+	net_pkt_cursor_init(pkt);
+
+	return net_send_data(pkt);
+}
+
+void telemetry_pkt_abort(struct net_pkt *pkt)
+{
+	net_pkt_unref(pkt);
+}
+
+size_t telemetry_pkt_buffers(struct net_pkt *pkt)
+{
+	size_t n = 0;
+
+	for (struct net_buf *buf = pkt->buffer; buf != NULL; buf = buf->frags) {
+		n++;
+	}
+
+	return n;
+}
@@ -0,0 +1,70 @@
+/*
+ * Zero-copy telemetry datagrams.
+ *
+ * A datagram is written straight into the buffers of its outgoing net_pkt,
+ * behind room for the IPv6 and UDP headers, which telemetry_pkt_send()
+ * fills in before handing the packet to the stack with net_send_data().
+ * sendto() and net_context_sendto() both take a flat buffer, which the
+ * application has to format first and the stack then copies into a new
+ * net_pkt; here the packet is allocated once and is the only copy.
+ *
+ * Fields are formatted on the stack, at most TELEMETRY_PKT_FIELD_MAX
+ * bytes at a time, so no datagram-sized buffer is needed.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TELEMETRY_PKT_H_
+#define TELEMETRY_PKT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/net/net_if.h>
+#include <zephyr/net/net_ip.h>
+#include <zephyr/net/net_pkt.h>
+
+#define TELEMETRY_PKT_FIELD_MAX 32
+
+/* IPv6 and UDP, in front of the payload */
+#define TELEMETRY_PKT_HDR_LEN \
+	(sizeof(struct net_ipv6_hdr) + sizeof(struct net_udp_hdr))
+
+/* Where datagrams go: out of iface to dest, from src_port */
+struct telemetry_pkt_ep {
+	struct net_if *iface;
+	struct sockaddr_in6 dest;
+	uint16_t src_port;
+};
+
+/*
+ * Allocate a packet for up to max_len bytes of payload, NULL if the pools
+ * stay empty for timeout or ep has no interface.
+ */
+struct net_pkt *telemetry_pkt_begin(const struct telemetry_pkt_ep *ep,
+				    size_t max_len, k_timeout_t timeout);
+
+/* Append to the payload, fails once the allocated buffers are full */
+int telemetry_pkt_write(struct net_pkt *pkt, const void *data, size_t len);
+int telemetry_pkt_printf(struct net_pkt *pkt, const char *fmt, ...);
+
+size_t telemetry_pkt_payload_len(struct net_pkt *pkt);
+
+/* Copy the payload out, for a datagram that could not be sent */
+size_t telemetry_pkt_read_payload(struct net_pkt *pkt, uint8_t *buf,
+				  size_t max);
+
+/*
+ * Fill in the headers and send. On success the stack owns the packet, on
+ * failure the caller still does.
+ */
+int telemetry_pkt_send(const struct telemetry_pkt_ep *ep, struct net_pkt *pkt);
+
+/* Drop a packet that was not sent */
+void telemetry_pkt_abort(struct net_pkt *pkt);
+
+/* Buffers holding the packet, headers included */
+size_t telemetry_pkt_buffers(struct net_pkt *pkt);
+
+#endif /* TELEMETRY_PKT_H_ */
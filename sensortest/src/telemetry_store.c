@@ -0,0 +1,454 @@
+/*
+ * Store-and-forward queue for sensor telemetry, see telemetry_store.h
+ *
+ * Every FCB entry starts with a type byte: a telemetry record, whose data
+ * follows, or a drain mark, which holds the cursor as it was after a batch
+ * went out. A mark can only point into its own sector or an older one, so
+ * one pointing into a sector that comes after it in the log is stale: that
+ * sector was erased and reused after the mark was written.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/fs/fcb.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/util.h>
+#include <errno.h>
+#include <string.h>
+
+#include "telemetry_store.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(telemetry_store, LOG_LEVEL_INF);
+
+#define STORE_PARTITION	storage_partition
+#define STORE_MAX_SECTORS	16
+#define STORE_MAGIC	0x54454c45 /* "TELE" */
+
+enum store_type {
+	STORE_RECORD = 'R',
+	STORE_MARK = 'M',
+};
+
+struct store_mark {
+	uint8_t type;		/* STORE_MARK */
+	uint8_t sector;		/* index in sectors[] */
+	uint16_t data_len;
+	uint32_t elem_off;
+	uint32_t data_off;
+} __packed;
+
+#if FIXED_PARTITION_EXISTS(STORE_PARTITION)
+
+#define STORE_AREA_ID	FIXED_PARTITION_ID(STORE_PARTITION)
+
+static struct flash_sector sectors[STORE_MAX_SECTORS];
+BUILD_ASSERT(STORE_MAX_SECTORS <= 32, "restore_cb() tracks sectors in 32 bits");
+
+static struct fcb fcb;
+static bool ready;
+K_MUTEX_DEFINE(store_lock);
+
+/*
+ * Last record handed to the network. A NULL sector means nothing in the
+ * oldest sector has been sent yet.
+ */
+static struct fcb_entry cursor;
+
+static struct {
+	uint32_t records;
+	uint32_t dropped;
+	uint32_t marks;
+	uint64_t payload_bytes;
+	uint64_t flash_bytes;	/* headers, type bytes, marks and padding included */
+	uint64_t erased_bytes;
+	uint64_t append_cycles;
+	uint32_t drained;
+	uint64_t drained_bytes;
+	uint64_t drain_cycles;
+} stats;
+
+/* Bytes an FCB entry really programs: length, data and CRC, each aligned */
+static size_t record_flash_size(size_t len)
+{
+	size_t align = MAX(fcb.f_align, 1);
+
+	return ROUND_UP(len < 0x80 ? 1 : 2, align) + ROUND_UP(len, align) +
+	       ROUND_UP(1, align);
+}
+
+static int store_rotate(void);
+
+static int entry_type(const struct flash_area *fap,
+		      const struct fcb_entry *loc, uint8_t *type)
+{
+	return flash_area_read(fap, FCB_ENTRY_FA_DATA_OFF(*loc), type, 1);
+}
+
+/* The next telemetry record after loc, skipping marks */
+static int next_record(struct fcb_entry *loc)
+{
+	uint8_t type;
+	int rc;
+
+	while ((rc = fcb_getnext(&fcb, loc)) == 0) {
+		rc = entry_type(fcb.fap, loc, &type);
+		if (rc != 0 || type == STORE_RECORD) {
+			break;
+		}
+	}
+
+	return rc;
+}
+
+static int count_unsent_cb(struct fcb_entry_ctx *ctx, void *arg)
+{
+	uint32_t *count = arg;
+	uint8_t type;
+
+	if (entry_type(ctx->fap, &ctx->loc, &type) != 0 ||
+	    type != STORE_RECORD) {
+		return 0;
+	}
+
+	if (cursor.fe_sector != ctx->loc.fe_sector ||
+	    ctx->loc.fe_elem_off > cursor.fe_elem_off) {
+		(*count)++;
+	}
+
+	return 0;
+}
+
+/* Appends one entry, rotating out the oldest sector if allowed to */
+static int store_write(const uint8_t *entry, size_t len, bool rotate)
+{
+	struct fcb_entry loc;
+	int rc;
+
+	rc = fcb_append(&fcb, len, &loc);
+	if (rc == -ENOSPC && rotate) {
+		rc = store_rotate();
+		if (rc == 0) {
+			rc = fcb_append(&fcb, len, &loc);
+		}
+	}
+
+	if (rc == 0) {
+		rc = flash_area_write(fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), entry,
+				      len);
+	}
+
+	if (rc == 0) {
+		rc = fcb_append_finish(&fcb, &loc);
+	}
+
+	if (rc == 0) {
+		stats.flash_bytes += record_flash_size(len);
+	}
+
+	return rc;
+}
+
+/*
+ * Records how far the drain got. Never at the price of a sector of unsent
+ * records: without room, the next reset resends from an older mark.
+ */
+static void store_mark(void)
+{
+	struct store_mark mark = {
+		.type = STORE_MARK,
+		.sector = cursor.fe_sector - sectors,
+		.data_len = cursor.fe_data_len,
+		.elem_off = cursor.fe_elem_off,
+		.data_off = cursor.fe_data_off,
+	};
+
+	if (store_write((const uint8_t *)&mark, sizeof(mark), false) == 0) {
+		stats.marks++;
+	}
+}
+
+struct restore_ctx {
+	uint32_t seen;		/* sectors walked so far */
+};
+
+/* Walks the whole log, the cursor ends up at the last valid mark */
+static int restore_cb(struct fcb_entry_ctx *ctx, void *arg)
+{
+	struct restore_ctx *restore = arg;
+	struct store_mark mark;
+
+	restore->seen |= BIT(ctx->loc.fe_sector - sectors);
+
+	if (ctx->loc.fe_data_len != sizeof(mark) ||
+	    flash_area_read(ctx->fap, FCB_ENTRY_FA_DATA_OFF(ctx->loc), &mark,
+			    sizeof(mark)) != 0 ||
+	    mark.type != STORE_MARK) {
+		return 0;
+	}
+
+	if (mark.sector >= fcb.f_sector_cnt ||
+	    !(restore->seen & BIT(mark.sector))) {
+		/* Stale, what it covered may not all have been sent */
+		cursor.fe_sector = NULL;
+		return 0;
+	}
+
+	cursor.fe_sector = &sectors[mark.sector];
+	cursor.fe_elem_off = mark.elem_off;
+	cursor.fe_data_off = mark.data_off;
+	cursor.fe_data_len = mark.data_len;
+
+	return 0;
+}
+
+/* Erase the oldest sector, accounting for records that never made it out */
+static int store_rotate(void)
+{
+	struct flash_sector *oldest = fcb.f_oldest;
+	uint32_t lost = 0;
+	int rc;
+
+	if (cursor.fe_sector == NULL || cursor.fe_sector == oldest) {
+		fcb_walk(&fcb, oldest, count_unsent_cb, &lost);
+		cursor.fe_sector = NULL;
+	}
+
+	rc = fcb_rotate(&fcb);
+	if (rc == 0) {
+		stats.erased_bytes += oldest->fs_size;
+		stats.dropped += lost;
+	}
+
+	return rc;
+}
+
+int telemetry_store_init(void)
+{
+	struct restore_ctx restore = { 0 };
+	const struct flash_area *fa;
+	uint32_t cnt = ARRAY_SIZE(sectors);
+	int rc;
+
+	/* A second call starts over from flash, as a reset would */
+	ready = false;
+
+	rc = flash_area_get_sectors(STORE_AREA_ID, &cnt, sectors);
+	if (rc != 0) {
+		LOG_ERR("failed to get storage sectors: %d", rc);
+		return rc;
+	}
+
+	fcb.f_magic = STORE_MAGIC;
+	fcb.f_version = 1;
+	fcb.f_sectors = sectors;
+	fcb.f_sector_cnt = cnt;
+	fcb.f_scratch_cnt = 0;
+
+	rc = fcb_init(STORE_AREA_ID, &fcb);
+	if (rc != 0) {
+		/* Foreign or corrupt contents: start over with an empty log */
+		LOG_WRN("reformatting telemetry store (%d)", rc);
+		rc = flash_area_open(STORE_AREA_ID, &fa);
+		if (rc == 0) {
+			rc = flash_area_erase(fa, 0, fa->fa_size);
+			flash_area_close(fa);
+		}
+		if (rc == 0) {
+			rc = fcb_init(STORE_AREA_ID, &fcb);
+		}
+		if (rc != 0) {
+			LOG_ERR("failed to init telemetry store: %d", rc);
+			return rc;
+		}
+	}
+
+	cursor.fe_sector = NULL;
+	fcb_walk(&fcb, NULL, restore_cb, &restore);
+	ready = true;
+
+	if (!telemetry_store_pending()) {
+		LOG_INF("telemetry store: %u sectors, empty", cnt);
+	} else {
+		LOG_INF("telemetry store: %u sectors, backlog pending%s", cnt,
+			cursor.fe_sector != NULL ? ", resuming from the last mark" :
+			"");
+	}
+
+	return 0;
+}
+
+int telemetry_store_append(const uint8_t *data, size_t len)
+{
+	static uint8_t entry[1 + TELEMETRY_RECORD_MAX];
+	uint32_t start = k_cycle_get_32();
+	int rc;
+
+	if (!ready) {
+		return -ENODEV;
+	}
+
+	if (len == 0 || len > TELEMETRY_RECORD_MAX) {
+		return -EMSGSIZE;
+	}
+
+	k_mutex_lock(&store_lock, K_FOREVER);
+
+	/* One write of type and data, for flashes with a write block size */
+	entry[0] = STORE_RECORD;
+	memcpy(entry + 1, data, len);
+
+	/* Full: give up the oldest samples rather than the newest */
+	rc = store_write(entry, len + 1, true);
+
+	if (rc == 0) {
+		stats.records++;
+		stats.payload_bytes += len;
+		stats.append_cycles += k_cycle_get_32() - start;
+	} else {
+		LOG_ERR("failed to append record: %d", rc);
+	}
+
+	k_mutex_unlock(&store_lock);
+
+	return rc;
+}
+
+bool telemetry_store_pending(void)
+{
+	struct fcb_entry loc;
+	bool pending;
+
+	if (!ready) {
+		return false;
+	}
+
+	k_mutex_lock(&store_lock, K_FOREVER);
+	loc = cursor;
+	pending = next_record(&loc) == 0;
+	k_mutex_unlock(&store_lock);
+
+	return pending;
+}
+
+int telemetry_store_drain(telemetry_send_t send, int max_batches)
+{
+	static uint8_t batch[TELEMETRY_BATCH_MAX];
+	struct fcb_entry loc, last;
+	int sent = 0;
+	int rc = 0;
+
+	if (!ready) {
+		return -ENODEV;
+	}
+
+	k_mutex_lock(&store_lock, K_FOREVER);
+
+	while (sent < max_batches) {
+		uint32_t start = k_cycle_get_32();
+		uint32_t count = 0;
+		size_t used = 0;
+
+		/* Pack as many whole records as fit in one datagram */
+		loc = cursor;
+		while (next_record(&loc) == 0) {
+			size_t len = loc.fe_data_len - 1;
+
+			if (used + len > sizeof(batch)) {
+				break;
+			}
+
+			rc = flash_area_read(fcb.fap,
+					     FCB_ENTRY_FA_DATA_OFF(loc) + 1,
+					     batch + used, len);
+			if (rc != 0) {
+				break;
+			}
+
+			used += len;
+			last = loc;
+			count++;
+		}
+
+		if (rc != 0 || count == 0) {
+			break;
+		}
+
+		/* Link still down: keep the records and back off */
+		rc = send(batch, used);
+		if (rc < 0) {
+			break;
+		}
+
+		cursor = last;
+		sent++;
+
+		/* Sectors the cursor has moved past are fully sent */
+		while (fcb.f_oldest != cursor.fe_sector && rc == 0) {
+			rc = store_rotate();
+		}
+
+		store_mark();
+
+		stats.drained += count;
+		stats.drained_bytes += used;
+		stats.drain_cycles += k_cycle_get_32() - start;
+	}
+
+	k_mutex_unlock(&store_lock);
+
+	return sent > 0 ? sent : MIN(rc, 0);
+}
+
+void telemetry_store_report(void)
+{
+	uint64_t drain_us = k_cyc_to_us_floor64(stats.drain_cycles);
+
+	if (stats.records == 0) {
+		return;
+	}
+
+	LOG_INF("store: %u records (%u dropped), %u marks, write amp %u.%02u, "
+		"%u KiB erased, append %u us",
+		stats.records, stats.dropped, stats.marks,
+		(uint32_t)(stats.flash_bytes / stats.payload_bytes),
+		(uint32_t)(stats.flash_bytes * 100U / stats.payload_bytes % 100U),
+		(uint32_t)(stats.erased_bytes / 1024U),
+		(uint32_t)k_cyc_to_us_floor64(stats.append_cycles / stats.records));
+
+	if (drain_us > 0) {
+		LOG_INF("store: %u records drained, %u B/s",
+			stats.drained,
+			(uint32_t)(stats.drained_bytes * USEC_PER_SEC / drain_us));
+	}
+}
+
+#else /* !FIXED_PARTITION_EXISTS(STORE_PARTITION) */
+
+int telemetry_store_init(void)
+{
+	LOG_WRN("no storage_partition, telemetry is not stored");
+	return -ENODEV;
+}
+
+int telemetry_store_append(const uint8_t *data, size_t len)
+{
+	return -ENODEV;
+}
+
+bool telemetry_store_pending(void)
+{
+	return false;
+}
+
+int telemetry_store_drain(telemetry_send_t send, int max_batches)
+{
+	return -ENODEV;
+}
+
+void telemetry_store_report(void)
+{
+}
+
+#endif /* FIXED_PARTITION_EXISTS(STORE_PARTITION) */
@@ -0,0 +1,47 @@
+/*
+ * Store-and-forward queue for sensor telemetry.
+ *
+ * Records that could not be sent are appended to a flash circular buffer
+ * (FCB) on the storage partition and drained in batches once the link is
+ * back. After every batch sent, a small mark entry records how far the
+ * drain got, and telemetry_store_init() resumes from the last mark, so a
+ * reset resends at most the batch that was in flight. Delivery is
+ * at-least-once: without room for a mark, or when the sector a mark points
+ * into has been erased and reused since, the drain starts over from the
+ * oldest record.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TELEMETRY_STORE_H_
+#define TELEMETRY_STORE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Largest record accepted by telemetry_store_append() */
+#define TELEMETRY_RECORD_MAX	128
+
+/* Largest batch handed to the send callback while draining */
+#define TELEMETRY_BATCH_MAX	512
+
+/* Returns 0 once the batch has been handed to the network */
+typedef int (*telemetry_send_t)(const uint8_t *buf, size_t len);
+
+/* Also after a reset, from what is in flash: resumes from the last mark */
+int telemetry_store_init(void);
+int telemetry_store_append(const uint8_t *data, size_t len);
+bool telemetry_store_pending(void);
+
+/*
+ * Send up to max_batches batches of queued records. Stops at the first
+ * failed send so that a flapping link is not hammered. Returns the number
+ * of batches sent or a negative error.
+ */
+int telemetry_store_drain(telemetry_send_t send, int max_batches);
+
+/* Log write amplification, append cost and drain throughput */
+void telemetry_store_report(void);
+
+#endif /* TELEMETRY_STORE_H_ */
@@ -0,0 +1,285 @@
+/*
+ * Compressed time series blocks, see ts_codec.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "ts_codec.h"
+
+/* Bucket widths after the 10, 110 and 1110 prefixes, 1111 is 32 bits */
+static const uint8_t ts_widths[] = { 7, 10, 14 };
+static const uint8_t val_widths[] = { 6, 12, 20 };
+
+static inline uint32_t zigzag(int32_t v)
+{
+	return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v)
+{
+	return (int32_t)((v >> 1) ^ (0U - (v & 1)));
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static int put_bits(struct ts_encoder *enc, uint32_t value, uint8_t n)
+{
+	uint8_t *data = enc->buf + TS_HDR_LEN(enc->channels);
+	size_t cap = (enc->size - TS_HDR_LEN(enc->channels)) * 8;
+
+	if (enc->bits + n > cap) {
+		return -ENOSPC;
+	}
+
+	while (n > 0) {
+		uint8_t used = enc->bits % 8;
+		uint8_t take = n < 8 - used ? n : 8 - used;
+		uint8_t chunk = (value >> (n - take)) & ((1U << take) - 1);
+		uint8_t *p = &data[enc->bits / 8];
+
+		if (used == 0) {
+			*p = 0;
+		}
+
+		*p |= chunk << (8 - used - take);
+		enc->bits += take;
+		n -= take;
+	}
+
+	return 0;
+}
+
+static int put_bucketed(struct ts_encoder *enc, uint32_t v,
+			const uint8_t *widths)
+{
+	int r;
+
+	if (v == 0) {
+		return put_bits(enc, 0, 1);
+	}
+
+	for (int i = 0; i < 3; i++) {
+		if (v < (1U << widths[i])) {
+			r = put_bits(enc, (1U << (i + 2)) - 2, i + 2);
+			return r ? r : put_bits(enc, v, widths[i]);
+		}
+	}
+
+	r = put_bits(enc, 0xf, 4);
+
+	return r ? r : put_bits(enc, v, 32);
+}
+
+int ts_encoder_init(struct ts_encoder *enc, uint8_t *buf, size_t size,
+		    const char *const *names, uint8_t channels)
+{
+	if (channels == 0 || channels > TS_MAX_CHANNELS ||
+	    size > TS_BLOCK_MAX || size <= TS_HDR_LEN(channels)) {
+		return -EINVAL;
+	}
+
+	memset(enc, 0, sizeof(*enc));
+	enc->buf = buf;
+	enc->size = size;
+	enc->channels = channels;
+
+	for (int i = 0; i < channels; i++) {
+		buf[8 + 2 * i] = names[i][0];
+		buf[9 + 2 * i] = names[i][0] ? names[i][1] : 0;
+	}
+
+	return 0;
+}
+
+void ts_encoder_reset(struct ts_encoder *enc)
+{
+	enc->bits = 0;
+	enc->count = 0;
+	enc->prev_delta = 0;
+	memset(enc->prev, 0, sizeof(enc->prev));
+}
+
+int ts_encode(struct ts_encoder *enc, uint32_t t_ms, const int32_t *vals)
+{
+	size_t mark = enc->bits;
+	int32_t delta = 0;
+	int r = 0;
+
+	if (enc->count == UINT8_MAX) {
+		return -ENOSPC;
+	}
+
+	if (enc->count > 0) {
+		delta = (int32_t)(t_ms - enc->prev_t);
+		r = put_bucketed(enc, zigzag((int32_t)((uint32_t)delta -
+						       enc->prev_delta)),
+				 ts_widths);
+	}
+
+	for (int i = 0; i < enc->channels && r == 0; i++) {
+		r = put_bucketed(enc, zigzag((int32_t)((uint32_t)vals[i] -
+						       enc->prev[i])),
+				 val_widths);
+	}
+
+	if (r < 0) {
+		/* Roll back, clearing what went into the last byte */
+		if (mark % 8) {
+			enc->buf[TS_HDR_LEN(enc->channels) + mark / 8] &=
+				0xff << (8 - mark % 8);
+		}
+		enc->bits = mark;
+		return enc->count == 0 ? -EMSGSIZE : r;
+	}
+
+	if (enc->count == 0) {
+		put_le32(enc->buf + 4, t_ms);
+	}
+
+	enc->prev_t = t_ms;
+	enc->prev_delta = delta;
+	memcpy(enc->prev, vals, enc->channels * sizeof(vals[0]));
+	enc->count++;
+
+	return 0;
+}
+
+size_t ts_encoder_finish(struct ts_encoder *enc)
+{
+	size_t len = TS_HDR_LEN(enc->channels) + (enc->bits + 7) / 8;
+
+	if (enc->count == 0) {
+		return 0;
+	}
+
+	enc->buf[0] = TS_MAGIC;
+	enc->buf[1] = TS_VERSION << 4 | enc->channels;
+	enc->buf[2] = len;
+	enc->buf[3] = enc->count;
+
+	return len;
+}
+
+int ts_decoder_init(struct ts_decoder *dec, const uint8_t *buf, size_t len)
+{
+	uint8_t channels;
+	size_t block_len;
+
+	if (len < TS_HDR_LEN(1) || buf[0] != TS_MAGIC ||
+	    buf[1] >> 4 != TS_VERSION) {
+		return -EINVAL;
+	}
+
+	channels = buf[1] & 0xf;
+	block_len = buf[2];
+	if (channels == 0 || channels > TS_MAX_CHANNELS ||
+	    block_len < TS_HDR_LEN(channels) || block_len > len) {
+		return -EINVAL;
+	}
+
+	memset(dec, 0, sizeof(*dec));
+	dec->channels = channels;
+	dec->count = buf[3];
+	dec->t = get_le32(buf + 4);
+	dec->data = buf + TS_HDR_LEN(channels);
+	dec->data_bits = (block_len - TS_HDR_LEN(channels)) * 8;
+
+	for (int i = 0; i < channels; i++) {
+		dec->names[i][0] = buf[8 + 2 * i];
+		dec->names[i][1] = buf[9 + 2 * i];
+	}
+
+	return block_len;
+}
+
+static int get_bits(struct ts_decoder *dec, uint8_t n, uint32_t *value)
+{
+	uint32_t v = 0;
+
+	if (dec->bits + n > dec->data_bits) {
+		return -EINVAL;
+	}
+
+	while (n > 0) {
+		uint8_t used = dec->bits % 8;
+		uint8_t take = n < 8 - used ? n : 8 - used;
+		uint8_t byte = dec->data[dec->bits / 8];
+
+		v = (v << take) |
+		    ((byte >> (8 - used - take)) & ((1U << take) - 1));
+		dec->bits += take;
+		n -= take;
+	}
+
+	*value = v;
+
+	return 0;
+}
+
+static int get_bucketed(struct ts_decoder *dec, const uint8_t *widths,
+			uint32_t *value)
+{
+	uint32_t bit;
+	int i;
+
+	/* Count the leading ones of the prefix, up to four */
+	for (i = 0; i < 4; i++) {
+		if (get_bits(dec, 1, &bit) < 0) {
+			return -EINVAL;
+		}
+		if (!bit) {
+			break;
+		}
+	}
+
+	if (i == 0) {
+		*value = 0;
+		return 0;
+	}
+
+	return get_bits(dec, i < 4 ? widths[i - 1] : 32, value);
+}
+
+int ts_decode(struct ts_decoder *dec, uint32_t *t_ms, int32_t *vals)
+{
+	uint32_t v;
+
+	if (dec->index == dec->count) {
+		return 0;
+	}
+
+	if (dec->index > 0) {
+		if (get_bucketed(dec, ts_widths, &v) < 0) {
+			return -EINVAL;
+		}
+		dec->delta = (int32_t)((uint32_t)dec->delta + unzigzag(v));
+		dec->t += dec->delta;
+	}
+
+	for (int i = 0; i < dec->channels; i++) {
+		if (get_bucketed(dec, val_widths, &v) < 0) {
+			return -EINVAL;
+		}
+		dec->prev[i] = (int32_t)((uint32_t)dec->prev[i] + unzigzag(v));
+		vals[i] = dec->prev[i];
+	}
+
+	*t_ms = dec->t;
+	dec->index++;
+
+	return 1;
+}
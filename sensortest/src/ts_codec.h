@@ -0,0 +1,101 @@
+/*
+ * Compressed time series blocks for sensor telemetry, in the style of
+ * Gorilla (Pelkonen et al., VLDB 2015).
+ *
+ * A block holds samples of up to TS_MAX_CHANNELS integer channels taken at
+ * the same time. Timestamps are stored as delta-of-delta and values as the
+ * zig-zag encoded difference to the previous sample, both in variable-size
+ * bit fields:
+ *
+ *   0                          zero
+ *   10   + 7 / 6 bits          small
+ *   110  + 10 / 12 bits
+ *   1110 + 14 / 20 bits
+ *   1111 + 32 bits             anything
+ *
+ * (timestamp / value widths). Block layout, little endian:
+ *
+ *   magic (0xa5), version << 4 | channels, block length, sample count,
+ *   first timestamp (u32 ms), two-character name per channel, bit stream
+ *
+ * The block length makes blocks self-delimiting, so they can be
+ * concatenated. The encoder works in a caller-provided buffer of at most
+ * TS_BLOCK_MAX bytes and keeps no other state than struct ts_encoder.
+ *
+ * The code has no Zephyr dependencies so that host tools can share it.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TS_CODEC_H_
+#define TS_CODEC_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TS_MAGIC	0xa5
+#define TS_VERSION	1
+#define TS_MAX_CHANNELS	8
+#define TS_BLOCK_MAX	255
+#define TS_HDR_LEN(channels) ((size_t)(8 + 2 * (channels)))
+
+struct ts_encoder {
+	uint8_t *buf;
+	size_t size;
+	size_t bits;		/* bit stream length */
+	uint8_t channels;
+	uint8_t count;
+	uint32_t prev_t;
+	int32_t prev_delta;
+	int32_t prev[TS_MAX_CHANNELS];
+};
+
+/*
+ * Start encoding into buf. names holds one two-character name per channel,
+ * for sensortest "<device index><channel letter>", for example "2t".
+ */
+int ts_encoder_init(struct ts_encoder *enc, uint8_t *buf, size_t size,
+		    const char *const *names, uint8_t channels);
+
+/*
+ * Append one sample, vals holds one value per channel. Returns -ENOSPC if
+ * the block is full (the sample is not added, finish the block and retry)
+ * and -EMSGSIZE if the sample does not even fit an empty block.
+ */
+int ts_encode(struct ts_encoder *enc, uint32_t t_ms, const int32_t *vals);
+
+static inline bool ts_encoder_empty(const struct ts_encoder *enc)
+{
+	return enc->count == 0;
+}
+
+/* Complete the header and return the block length, 0 if empty */
+size_t ts_encoder_finish(struct ts_encoder *enc);
+
+/* Start a new block in the same buffer, with the same channels */
+void ts_encoder_reset(struct ts_encoder *enc);
+
+struct ts_decoder {
+	const uint8_t *data;
+	size_t data_bits;
+	size_t bits;		/* read position */
+	uint8_t channels;
+	uint8_t count;
+	uint8_t index;
+	char names[TS_MAX_CHANNELS][3];
+	uint32_t t;
+	int32_t delta;
+	int32_t prev[TS_MAX_CHANNELS];
+};
+
+/*
+ * Parse the block header at buf. Returns the block length, the next block
+ * (if any) starts there, or -EINVAL if buf does not hold a valid block.
+ */
+int ts_decoder_init(struct ts_decoder *dec, const uint8_t *buf, size_t len);
+
+/* Returns 1 and the next sample, 0 at the end, -EINVAL if truncated */
+int ts_decode(struct ts_decoder *dec, uint32_t *t_ms, int32_t *vals);
+
+#endif /* TS_CODEC_H_ */
@@ -8,8 +8,8 @@
 #include <zephyr/device.h>
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/sys/printk.h>
-#include <zephyr/sys/__assert.h>
-#include <string.h>
+
+#include "led_pattern.h"
 
 /* size of stack area used by each thread */
 #define STACKSIZE 1024
@@ -17,6 +17,9 @@
 /* scheduling priority used by each thread */
 #define PRIORITY 7
 
+/* Toggles between two reports of the LED engine's costs */
+#define STATS_EVERY 10
+
 #define LED0_NODE DT_ALIAS(led0)
 
 #if !DT_NODE_HAS_STATUS(LED0_NODE, okay)
@@ -24,12 +27,12 @@
 #endif
 
 struct printk_data_t {
-	void *fifo_reserved; /* 1st word reserved for use by fifo */
 	uint32_t led;
 	uint32_t cnt;
 };
 
-K_FIFO_DEFINE(printk_fifo);
+/* Filled from the LED engine, so no heap: the messages are copied */
+K_MSGQ_DEFINE(printk_msgq, sizeof(struct printk_data_t), 4, 4);
 
 struct led {
 	struct gpio_dt_spec spec;
@@ -41,59 +44,71 @@ static const struct led led0 = {
 	.num = 0,
 };
 
-void blink(const struct led *led, uint32_t sleep_ms, uint32_t id)
-{
-	const struct gpio_dt_spec *spec = &led->spec;
-	int cnt = 0;
-	int ret;
+/* Toggle every 1000 ms, forever */
+LED_PATTERN_DEFINE(blink0_pattern, 0, { 2000, 50, 1 });
 
-	if (!device_is_ready(spec->port)) {
-		printk("Error: %s device is not ready\n", spec->port->name);
-		return;
-	}
+static uint32_t toggles[LED_PATTERN_MAX_LEDS];
 
-	ret = gpio_pin_configure_dt(spec, GPIO_OUTPUT);
-	if (ret != 0) {
-		printk("Error %d: failed to configure pin %d (LED '%d')\n",
-			ret, spec->pin, led->num);
-		return;
-	}
-
-	while (1) {
-		gpio_pin_set(spec->port, spec->pin, cnt % 2);
+/* From the LED engine, on the system work queue */
+static void led_edge(int id, bool on)
+{
+	struct printk_data_t tx_data = { .led = led0.num,
+					 .cnt = ++toggles[id] };
 
-		struct printk_data_t tx_data = { .led = id, .cnt = cnt };
+	ARG_UNUSED(on);
 
-		size_t size = sizeof(struct printk_data_t);
-		char *mem_ptr = k_malloc(size);
-		__ASSERT_NO_MSG(mem_ptr != 0);
+	k_msgq_put(&printk_msgq, &tx_data, K_NO_WAIT);
+}
 
-		memcpy(mem_ptr, &tx_data, size);
+/* The LED blinks from the LED engine's timer, no thread of its own */
+static int blink_init(const struct led *led)
+{
+	const struct gpio_dt_spec *spec = &led->spec;
+	int id;
 
-		k_fifo_put(&printk_fifo, mem_ptr);
+	led_pattern_set_edge_cb(led_edge);
 
-		k_msleep(sleep_ms);
-		cnt++;
+	id = led_pattern_add_gpio(spec);
+	if (id < 0) {
+		printk("Error %d: failed to set up pin %d (LED '%d')\n",
+			id, spec->pin, led->num);
+		return id;
 	}
+
+	return led_pattern_play(id, &blink0_pattern);
 }
 
-void blink0(void)
+static void print_led_stats(void)
 {
-	blink(&led0, 1000, 0);
+	struct led_pattern_stats st;
+	int64_t ms;
+
+	led_pattern_get_stats(&st);
+	ms = MAX(k_uptime_get() - st.since_ms, 1);
+
+	printk("LED engine: %u wakeups, %u toggles in %u ms "
+	       "(%u.%03u wakeups/s), %u B RAM\n", st.wakeups, st.edges,
+	       (uint32_t)ms, (uint32_t)(st.wakeups * 1000ULL / ms),
+	       (uint32_t)(st.wakeups * 1000000ULL / ms % 1000), st.ram_bytes);
 }
 
 void uart_out(void)
 {
+	struct printk_data_t rx_data;
+
+	if (blink_init(&led0) < 0) {
+		return;
+	}
+
 	while (1) {
-		struct printk_data_t *rx_data = k_fifo_get(&printk_fifo,
-							   K_FOREVER);
+		k_msgq_get(&printk_msgq, &rx_data, K_FOREVER);
 		printk("Toggled led%d; counter=%d\n",
-		       rx_data->led, rx_data->cnt);
-		k_free(rx_data);
+		       rx_data.led, rx_data.cnt);
+		if (rx_data.cnt % STATS_EVERY == 0) {
+			print_led_stats();
+		}
 	}
 }
 
-K_THREAD_DEFINE(blink0_id, STACKSIZE, blink0, NULL, NULL, NULL,
-		PRIORITY, 0, 0);
 K_THREAD_DEFINE(uart_out_id, STACKSIZE, uart_out, NULL, NULL, NULL,
 		PRIORITY, 0, 0);
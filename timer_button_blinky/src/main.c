@@ -10,63 +10,49 @@
 #include <inttypes.h>
 #include <zephyr/device.h>
 
+#include "led_pattern.h"
 
 // LOG_MODULE_REGISTER(main, LOG_LEVEL_DBG);
 
-#define MAIN_SLEEP_TIME_MS   1
 #define BLINK_TIMER_INTERVAL_MS 500
 
 static const struct gpio_dt_spec led_blink = GPIO_DT_SPEC_GET(DT_ALIAS(led0), gpios);
 static const struct gpio_dt_spec button = GPIO_DT_SPEC_GET(DT_ALIAS(sw0), gpios);
 static struct gpio_callback button_cb_data;
 
-static struct k_timer blink_timer;
+/* Toggle every BLINK_TIMER_INTERVAL_MS, from the LED engine's timer */
+LED_PATTERN_DEFINE(blink_pattern, 0, { 2 * BLINK_TIMER_INTERVAL_MS, 50, 1 });
+/* Solid, which needs no timer at all */
+LED_PATTERN_DEFINE(on_pattern, 0, { 1000, 100, 1 });
+
+static int blink_id;
 
 void button_pressed(const struct device *dev, struct gpio_callback *cb,
 		    uint32_t pins)
 {
 	static bool state_button = false;
 
-	// gpio_pin_set_dt(&led_blink, 1);
 	printk("Button pressed at %" PRIu32 "\n", k_cycle_get_32());
 
 	if(state_button){
-		k_timer_start(&blink_timer, K_MSEC(BLINK_TIMER_INTERVAL_MS), K_MSEC(BLINK_TIMER_INTERVAL_MS));    
+		led_pattern_play(blink_id, &blink_pattern);
 		state_button = !state_button;
 	} else{
-		k_timer_stop(&blink_timer);    
+		led_pattern_stop(blink_id);
 		state_button = !state_button;
 	}
 }
 
-void blink_timer_handler(struct k_timer *blink_timer){
-	
-	int ret;
-	
-	// ret = gpio_pin_toggle_dt(&led_blink);
-	if (ret < 0) {
-		return;
-	}
-}
-
-void blink_timer_stop(struct k_timer *blink_timer){
-	gpio_pin_set_dt(&led_blink, 0);
-}
-
 int main(void)
 {
 	int ret;
 
-	if (!gpio_is_ready_dt(&led_blink)) {
+	blink_id = led_pattern_add_gpio(&led_blink);
+	if (blink_id < 0) {
 		return -1;
 	}
+	led_pattern_play(blink_id, &on_pattern);
 
-	ret = gpio_pin_configure_dt(&led_blink, GPIO_OUTPUT_ACTIVE);
-	if (ret < 0) {
-		return -1;
-	}	
-
-	
 	if (!gpio_is_ready_dt(&button)) {
 		printk("Error: button device %s is not ready\n",
 		       button.port->name);
@@ -88,18 +74,12 @@ int main(void)
 		return -1;
 	}
 
-	
 	gpio_init_callback(&button_cb_data, button_pressed, BIT(button.pin));
 	gpio_add_callback(button.port, &button_cb_data);
 
-	k_timer_init(&blink_timer, blink_timer_handler, blink_timer_stop);
-    
-	
-
-	while (1) {
-		k_msleep(MAIN_SLEEP_TIME_MS);
-	}
-
+	/*
+	 * The button interrupt and the LED engine do all the work: main
+	 * returns instead of waking up every millisecond to sleep again.
+	 */
 	return 0;
 }
-